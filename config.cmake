@@ -31,9 +31,19 @@ set(LIBRARY_TARGETS p101_fsm)
 # Source files for the library
 set(p101_fsm_SOURCES
         src/effect.c
+        src/effect_ring.c
+        src/event.c
+        src/executor.c
         src/fsm.c
+        src/journal.c
+        src/timer.c
 )
 
+# The epoll reactor is Linux-only.
+if (CMAKE_SYSTEM_NAME STREQUAL "Linux")
+    list(APPEND p101_fsm_SOURCES src/reactor.c)
+endif ()
+
 # Header files for installation
 set(p101_fsm_HEADERS
         include/p101_fsm/errors.h
@@ -47,4 +57,17 @@ set(p101_fsm_LINK_LIBRARIES
         p101_c
         p101_text
         p101_transition
+        pthread
 )
+
+# Optional lean variant of the library: the same sources built with
+# P101_FSM_LEAN, which compiles the trace and fault-injection hooks out of the
+# step and effect hot paths. The tests always build the instrumented sources.
+option(P101_FSM_BUILD_FAST "Also build p101_fsm_fast without hot-path trace and fault hooks" OFF)
+if (P101_FSM_BUILD_FAST)
+    list(APPEND LIBRARY_TARGETS p101_fsm_fast)
+    set(p101_fsm_fast_SOURCES ${p101_fsm_SOURCES})
+    set(p101_fsm_fast_LINK_LIBRARIES ${p101_fsm_LINK_LIBRARIES})
+    # The shared CMakeLists creates the targets after this file, so attach the define once they exist.
+    cmake_language(DEFER CALL target_compile_definitions p101_fsm_fast PRIVATE P101_FSM_LEAN=1)
+endif ()
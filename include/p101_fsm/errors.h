@@ -28,6 +28,8 @@ typedef enum
     P101_FSM_ERROR_EFFECT,
     P101_FSM_ERROR_EFFECT_CAPACITY,
     P101_FSM_ERROR_SEQUENCE_EXHAUSTED,
+    P101_FSM_ERROR_INBOX_FULL,
+    P101_FSM_ERROR_JOURNAL_CORRUPT,
 } p101_fsm_error;
 
 #endif    // LIBP101_FSM_ERRORS_H
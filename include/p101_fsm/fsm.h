@@ -25,8 +25,22 @@ extern "C"
 {
 #endif
 
+    struct p101_fsm_definition;
     struct p101_fsm_info;
     struct p101_fsm_effect_batch;
+    struct p101_fsm_effect_batch_pool;
+    struct p101_fsm_effect_kinds;
+    struct p101_fsm_effect_ring;
+    struct p101_fsm_journal;
+    struct p101_fsm_pool;
+    struct p101_fsm_executor;
+    struct p101_fsm_task;
+    struct p101_fsm_inbox;
+    struct p101_fsm_reactor;
+    struct p101_fsm_reactor_machine;
+    struct p101_fsm_timer_wheel;
+    struct p101_fsm_timer;
+    struct timespec;
     struct p101_fsm_effect_sink;
 
     typedef enum
@@ -38,6 +52,22 @@ extern "C"
 
     typedef int p101_fsm_state_id;
 
+    typedef enum
+    {
+        P101_FSM_EFFECT_KIND_NONE = 0,
+    } p101_fsm_effect_kind;
+
+    typedef int p101_fsm_effect_kind_id;
+
+    typedef enum
+    {
+        P101_FSM_TRANSITION_INDEX_HASH = 0,
+        P101_FSM_TRANSITION_INDEX_DENSE,
+        P101_FSM_TRANSITION_INDEX_CSR,
+        P101_FSM_TRANSITION_INDEX_PERFECT_HASH,
+        P101_FSM_TRANSITION_INDEX_AUTOMATIC,
+    } p101_fsm_transition_index;
+
     typedef enum
     {
         P101_FSM_DECISION_INVALID = 0,
@@ -109,7 +139,7 @@ extern "C"
     /*
      * One deterministic FSM transition and its exact staged effects. The
      * effect view remains valid only until its batch is finished, reused, or
-     * destroyed. Durable journal ordering belongs outside the FSM.
+     * destroyed. p101_fsm_journal_append() records it durably.
      */
     struct p101_fsm_step_receipt
     {
@@ -123,17 +153,45 @@ extern "C"
 
     typedef enum
     {
-        P101_FSM_RUN_ERROR   = -1,
-        P101_FSM_RUN_PAUSED  = 0,
-        P101_FSM_RUN_EXITED  = 1,
-        P101_FSM_RUN_REFUSED = 2,
+        P101_FSM_RUN_ERROR            = -1,
+        P101_FSM_RUN_PAUSED           = 0,
+        P101_FSM_RUN_EXITED           = 1,
+        P101_FSM_RUN_REFUSED          = 2,
+        P101_FSM_RUN_BUDGET_EXHAUSTED = 3,
     } p101_fsm_run_result;
 
+    /*
+     * kind_id is the interned ID of kind for an effect emitted with
+     * p101_fsm_emit_effect_id(), and P101_FSM_EFFECT_KIND_NONE otherwise.
+     * NONE is 0, so a zero-initialised effect has its kind copied by a batch
+     * like any other string kind.
+     */
     struct p101_fsm_effect
     {
-        const char *kind;
-        const void *data;
-        size_t      data_size;
+        const char             *kind;
+        const void             *data;
+        size_t                  data_size;
+        p101_fsm_effect_kind_id kind_id;
+    };
+
+    /*
+     * An event posted to a machine's inbox. kind and data belong to the
+     * application; data must stay valid until the event has been stepped.
+     */
+    struct p101_fsm_event
+    {
+        int   kind;
+        void *data;
+    };
+
+    /*
+     * What an event step passes to the state callback as arg: the arg given
+     * to the step and the event being delivered.
+     */
+    struct p101_fsm_event_context
+    {
+        void                 *arg;
+        struct p101_fsm_event event;
     };
 
     typedef void (*p101_fsm_effect_handler_func)(const struct p101_env *env, struct p101_error *err, void *context, const struct p101_fsm_effect *effect);
@@ -144,6 +202,25 @@ extern "C"
         void                        *context;
     };
 
+    typedef void (*p101_fsm_effect_span_handler_func)(const struct p101_env *env, struct p101_error *err, void *context, const struct p101_fsm_effect effects[], size_t count);
+
+    struct p101_fsm_effect_span_sink
+    {
+        p101_fsm_effect_span_handler_func handle;
+        void                             *context;
+    };
+
+    /*
+     * The effects one committed step of p101_fsm_run_batched() left in its
+     * batch: count effects starting at index first.
+     */
+    struct p101_fsm_effect_segment
+    {
+        size_t sequence;
+        size_t first;
+        size_t count;
+    };
+
     typedef void (*p101_fsm_state_func)(const struct p101_env *env, struct p101_error *err, void *arg, struct p101_fsm_effect_sink *sink, struct p101_fsm_decision *decision);
     typedef void (*p101_fsm_info_will_change_state_notifier_func)(const struct p101_env *env, struct p101_error *err, const struct p101_fsm_info *info, p101_fsm_state_id from_state_id, p101_fsm_state_id to_state_id);
     typedef void (*p101_fsm_info_did_change_state_notifier_func)(const struct p101_env *env, struct p101_error *err, const struct p101_fsm_info *info, p101_fsm_state_id from_state_id, p101_fsm_state_id to_state_id, p101_fsm_state_id next_state_id);
@@ -161,9 +238,10 @@ extern "C"
 
     /*
      * The machine validates the transition table and builds an owned,
-     * immutable hash map. env/err are borrowed for application callbacks;
-     * fsm_env/fsm_err are borrowed for FSM allocation, validation,
-     * notification, and policy. All borrowed objects must outlive the machine.
+     * immutable transition index in a private definition. env/err are
+     * borrowed for application callbacks; fsm_env/fsm_err are borrowed for
+     * FSM allocation, validation, notification, and policy. All borrowed
+     * objects must outlive the machine.
      * Pass the FSM error object to destroy so a recursive destruction refusal
      * has an explicit error destination.
      *
@@ -175,10 +253,69 @@ extern "C"
                                                p101_fsm_info_bad_change_state_handler_func handler) P101_ATTR_MALLOC P101_ATTR_WARN_UNUSED_RESULT;
     void                  p101_fsm_info_destroy(const struct p101_env *env, struct p101_error *fsm_err, struct p101_fsm_info **pinfo);
     const char           *p101_fsm_info_get_name(const struct p101_env *env, const struct p101_fsm_info *info);
+
+    /*
+     * A definition is the validated name and transition map on their own. It
+     * is compiled once and shared by reference: every machine created from it
+     * holds a reference, so destroying the definition only drops the caller's
+     * reference and the storage is freed with the last machine. Such a machine
+     * adds only its state, sequence, hooks, and borrowed contexts. The env
+     * passed to definition_create must outlive every machine that uses it.
+     * Creating and destroying machines of one definition may happen on
+     * different threads; each machine is still single-threaded.
+     *
+     * When every state ID falls in a small range the definition indexes
+     * transitions with a dense [from][to] matrix. When only the source IDs are
+     * compact it keeps each state's outgoing edges in one CSR row; otherwise
+     * it uses the hash map. get_transition_index reports which one was built.
+     *
+     * create_with_index builds the requested index instead of choosing one.
+     * P101_FSM_TRANSITION_INDEX_PERFECT_HASH builds a minimal perfect hash:
+     * one slot per transition and exactly one probe per lookup, at the cost of
+     * a slower construction. Requesting DENSE or CSR for IDs outside their
+     * range limits fails with P101_FSM_ERROR_INVALID_ARGUMENT.
+     * P101_FSM_TRANSITION_INDEX_AUTOMATIC behaves like definition_create.
+     */
+    struct p101_fsm_definition       *p101_fsm_definition_create(const struct p101_env *env, struct p101_error *err, const char *name, const struct p101_fsm_transition transitions[], size_t transition_count) P101_ATTR_MALLOC
+        P101_ATTR_WARN_UNUSED_RESULT;
+    struct p101_fsm_definition       *p101_fsm_definition_create_with_index(const struct p101_env *env, struct p101_error *err, const char *name, const struct p101_fsm_transition transitions[], size_t transition_count,
+                                                                            p101_fsm_transition_index index) P101_ATTR_MALLOC P101_ATTR_WARN_UNUSED_RESULT;
+    void                              p101_fsm_definition_destroy(const struct p101_env *env, struct p101_fsm_definition **pdefinition);
+    const char                       *p101_fsm_definition_get_name(const struct p101_env *env, const struct p101_fsm_definition *definition);
+    p101_fsm_transition_index         p101_fsm_definition_get_transition_index(const struct p101_env *env, const struct p101_fsm_definition *definition);
+    struct p101_fsm_info             *p101_fsm_info_create_from_definition(const struct p101_env *env, struct p101_error *err, struct p101_fsm_definition *definition, const struct p101_env *fsm_env, struct p101_error *fsm_err,
+                                                                           p101_fsm_info_bad_change_state_handler_func handler) P101_ATTR_MALLOC P101_ATTR_WARN_UNUSED_RESULT;
+    const struct p101_fsm_definition *p101_fsm_info_get_definition(const struct p101_env *env, const struct p101_fsm_info *info);
+
+    /*
+     * The _init variants construct into caller-owned storage instead of the
+     * heap, so definitions and machines can live in static arrays, on the
+     * stack, or inside larger structures. Storage must be aligned to the
+     * matching storage_align() and hold at least storage_size() bytes.
+     * definition_init chooses its index as definition_create does, so a
+     * definition's size depends on its name and table and is 0 for a table
+     * that cannot be indexed. Nothing is allocated: destroy still drops the
+     * reference or machine, but the caller releases the storage, and only
+     * after every machine using a caller-stored definition is destroyed.
+     */
+    struct p101_fsm_definition *p101_fsm_definition_init(const struct p101_env *env, struct p101_error *err, void *storage, size_t storage_size, const char *name, const struct p101_fsm_transition transitions[], size_t transition_count)
+        P101_ATTR_WARN_UNUSED_RESULT;
+    size_t                      p101_fsm_definition_storage_size(const struct p101_env *env, const char *name, const struct p101_fsm_transition transitions[], size_t transition_count);
+    size_t                      p101_fsm_definition_storage_align(const struct p101_env *env);
+    struct p101_fsm_info       *p101_fsm_info_init(const struct p101_env *env, struct p101_error *err, void *storage, size_t storage_size, struct p101_fsm_definition *definition, const struct p101_env *fsm_env, struct p101_error *fsm_err,
+                                                   p101_fsm_info_bad_change_state_handler_func handler) P101_ATTR_WARN_UNUSED_RESULT;
+    size_t                      p101_fsm_info_storage_size(const struct p101_env *env);
+    size_t                      p101_fsm_info_storage_align(const struct p101_env *env);
+
     p101_fsm_state_id     p101_fsm_info_get_current_state(const struct p101_env *env, const struct p101_fsm_info *info);
     size_t                p101_fsm_info_get_step_sequence(const struct p101_env *env, const struct p101_fsm_info *info);
     bool                  p101_fsm_info_is_terminal(const struct p101_env *env, const struct p101_fsm_info *info);
 
+    /*
+     * Setting or clearing the will-change or did-change notifier or the step
+     * observer also selects the machine's step body. A machine with none of
+     * them steps through a path that skips every hook test.
+     */
     void                                          p101_fsm_info_set_will_change_state_notifier(const struct p101_env *env, struct p101_fsm_info *info, p101_fsm_info_will_change_state_notifier_func notifier);
     void                                          p101_fsm_info_set_did_change_state_notifier(const struct p101_env *env, struct p101_fsm_info *info, p101_fsm_info_did_change_state_notifier_func notifier);
     void                                          p101_fsm_info_set_bad_change_state_notifier(const struct p101_env *env, struct p101_fsm_info *info, p101_fsm_info_bad_change_state_notifier_func notifier);
@@ -200,6 +337,23 @@ extern "C"
     void p101_fsm_decide_exit(struct p101_fsm_decision *decision);
     void p101_fsm_emit_effect(const struct p101_env *env, struct p101_error *err, struct p101_fsm_effect_sink *sink, const char *kind, const void *data, size_t data_size);
 
+    /*
+     * An effect-kind registry maps kind strings to dense IDs starting at 1.
+     * Intern the vocabulary before machines emit, then treat the registry as
+     * read-only; interning an existing kind returns its ID. emit_effect_id
+     * sends the registry's copy of the name with the ID, so string-routed
+     * sinks keep working while others index a table by kind_id. A batch
+     * borrows an interned kind instead of copying it, so the registry must
+     * outlive delivery.
+     */
+    struct p101_fsm_effect_kinds *p101_fsm_effect_kinds_create(const struct p101_env *env, struct p101_error *err) P101_ATTR_MALLOC P101_ATTR_WARN_UNUSED_RESULT;
+    void                          p101_fsm_effect_kinds_destroy(const struct p101_env *env, struct p101_fsm_effect_kinds **kinds);
+    p101_fsm_effect_kind_id       p101_fsm_effect_kinds_intern(const struct p101_env *env, struct p101_error *err, struct p101_fsm_effect_kinds *kinds, const char *kind);
+    p101_fsm_effect_kind_id       p101_fsm_effect_kinds_find(const struct p101_env *env, const struct p101_fsm_effect_kinds *kinds, const char *kind);
+    const char                   *p101_fsm_effect_kinds_get_name(const struct p101_env *env, const struct p101_fsm_effect_kinds *kinds, p101_fsm_effect_kind_id id);
+    size_t                        p101_fsm_effect_kinds_count(const struct p101_env *env, const struct p101_fsm_effect_kinds *kinds);
+    void                          p101_fsm_emit_effect_id(const struct p101_env *env, struct p101_error *err, struct p101_fsm_effect_sink *sink, const struct p101_fsm_effect_kinds *kinds, p101_fsm_effect_kind_id kind_id, const void *data, size_t data_size);
+
     /*
      * A bounded batch stages effect kind strings and payload bytes without
      * allocating during exactly one step. Calling
@@ -207,16 +361,184 @@ extern "C"
      * fresh batch. p101_fsm_step_with_receipt() binds that batch to one exact
      * step, and finish_receipt() delivers it only for an applied state change.
      * Do not pass a batch sink to p101_fsm_run(), because run spans multiple
-     * step transactions. Delivery itself is external and cannot be rolled back
-     * if its handler fails.
+     * step transactions; p101_fsm_run_batched() is the batched run. Delivery
+     * itself is external and cannot be rolled back if its handler fails.
+     * batch_init places the batch, its records, and its bytes in caller
+     * storage sized by batch_storage_size().
+     *
+     * batch_create_growable stages bytes in chunks of chunk_size instead,
+     * allocating another chunk (larger only for one oversized effect) when
+     * the current one is full. A zero maximum_effects or maximum_bytes means
+     * no ceiling; otherwise the ceiling is refused as for a bounded batch.
+     * Starting a fresh batch keeps every chunk for reuse, so allocation
+     * follows the largest step seen rather than the worst case. For a
+     * bounded batch, batch_get_allocated_bytes() reports maximum_bytes.
+     *
+     * Payloads are packed by default. batch_set_alignment() makes every
+     * payload staged afterwards start on a power-of-two boundary, such as
+     * batch_storage_align(), so a handler can read a typed payload in place.
+     * In a bounded batch the padding counts against maximum_bytes. The
+     * alignment can change only while nothing is staged and is kept when the
+     * batch is reused; effect_reserve uses it when it exceeds
+     * alignof(max_align_t).
      */
     struct p101_fsm_effect_batch *p101_fsm_effect_batch_create(const struct p101_env *env, struct p101_error *err, size_t maximum_effects, size_t maximum_bytes) P101_ATTR_MALLOC P101_ATTR_WARN_UNUSED_RESULT;
+    struct p101_fsm_effect_batch *p101_fsm_effect_batch_create_growable(const struct p101_env *env, struct p101_error *err, size_t chunk_size, size_t maximum_effects, size_t maximum_bytes) P101_ATTR_MALLOC P101_ATTR_WARN_UNUSED_RESULT;
+    struct p101_fsm_effect_batch *p101_fsm_effect_batch_init(const struct p101_env *env, struct p101_error *err, void *storage, size_t storage_size, size_t maximum_effects, size_t maximum_bytes) P101_ATTR_WARN_UNUSED_RESULT;
+    size_t                        p101_fsm_effect_batch_storage_size(const struct p101_env *env, size_t maximum_effects, size_t maximum_bytes);
+    size_t                        p101_fsm_effect_batch_storage_align(const struct p101_env *env);
     void                          p101_fsm_effect_batch_destroy(const struct p101_env *env, struct p101_fsm_effect_batch **batch);
     void                          p101_fsm_effect_batch_sink(struct p101_fsm_effect_batch *batch, struct p101_fsm_effect_sink *sink);
     size_t                        p101_fsm_effect_batch_count(const struct p101_fsm_effect_batch *batch);
+    size_t                        p101_fsm_effect_batch_get_allocated_bytes(const struct p101_env *env, const struct p101_fsm_effect_batch *batch);
+    int                           p101_fsm_effect_batch_set_alignment(const struct p101_env *env, struct p101_error *err, struct p101_fsm_effect_batch *batch, size_t alignment);
+    size_t                        p101_fsm_effect_batch_get_alignment(const struct p101_env *env, const struct p101_fsm_effect_batch *batch);
     int                           p101_fsm_effect_batch_finish_receipt(const struct p101_env *env, struct p101_error *err, struct p101_fsm_effect_batch *batch, const struct p101_fsm_step_receipt *receipt, struct p101_fsm_effect_sink *target);
     bool                          p101_fsm_step_receipt_effect(const struct p101_fsm_step_receipt *receipt, size_t index, struct p101_fsm_effect *effect);
 
+    /*
+     * finish_receipt_span delivers a committed batch with one call: the
+     * handler receives every staged effect, in emission order, as one
+     * read-only array that is valid only during the call. A handler can
+     * then write the whole step with one writev() or one submission. An
+     * empty batch or an uncommitted step calls nothing. Either way, and
+     * whether or not the handler raises, the batch is consumed as with
+     * finish_receipt.
+     */
+    int p101_fsm_effect_batch_finish_receipt_span(const struct p101_env *env, struct p101_error *err, struct p101_fsm_effect_batch *batch, const struct p101_fsm_step_receipt *receipt, struct p101_fsm_effect_span_sink *target);
+
+    /*
+     * run_batched is p101_fsm_run() with a fresh batch as its sink. Each step
+     * stages into the batch after the previous one; when the step does not
+     * apply a state change its effects are discarded, and when it does and
+     * emitted something, one segment records where they are. A full segments
+     * array ends the run with P101_FSM_RUN_BUDGET_EXHAUSTED before the next
+     * step, and a step that overflows a bounded batch is refused as usual;
+     * either way the committed segments are kept. batch_flush then delivers
+     * every committed effect, in step and emission order, in one span call,
+     * and consumes the batch. Only a batch staged by run_batched can be
+     * flushed.
+     */
+    p101_fsm_run_result p101_fsm_run_batched(struct p101_fsm_info *info, void *arg, struct p101_fsm_effect_batch *batch, struct p101_fsm_effect_segment segments[], size_t maximum_segments, size_t *segment_count, struct p101_fsm_step_result *last_result)
+        P101_ATTR_WARN_UNUSED_RESULT;
+    int p101_fsm_effect_batch_flush(const struct p101_env *env, struct p101_error *err, struct p101_fsm_effect_batch *batch, struct p101_fsm_effect_span_sink *target);
+
+    /*
+     * An effect ring hands committed effects from the stepping thread to one
+     * consumer thread without locks. ring_publish copies the effects of a
+     * committed receipt into the ring, each tagged with the receipt's
+     * binding, then consumes the batch as finish_receipt does. Publishing is
+     * all or nothing: when the ring lacks room it raises
+     * P101_FSM_ERROR_EFFECT_CAPACITY and leaves the batch staged, so the same
+     * receipt can be published again later. Payloads are aligned for any
+     * object type; interned kinds are borrowed from their registry.
+     *
+     * Exactly one thread publishes and exactly one other thread consumes.
+     * ring_peek and ring_release take no env so the consumer never touches
+     * the publisher's environment. ring_peek views the oldest entry, whose
+     * kind and data stay valid until ring_release; then the space is reused.
+     * entry_capacity rounds up to a power of two and byte_capacity to a
+     * multiple of alignof(max_align_t).
+     */
+    struct p101_fsm_effect_ring_entry
+    {
+        struct p101_fsm_step_binding binding;
+        struct p101_fsm_effect       effect;
+    };
+
+    struct p101_fsm_effect_ring *p101_fsm_effect_ring_create(const struct p101_env *env, struct p101_error *err, size_t entry_capacity, size_t byte_capacity) P101_ATTR_MALLOC P101_ATTR_WARN_UNUSED_RESULT;
+    void                         p101_fsm_effect_ring_destroy(const struct p101_env *env, struct p101_fsm_effect_ring **ring);
+    size_t                       p101_fsm_effect_ring_get_capacity(const struct p101_env *env, const struct p101_fsm_effect_ring *ring);
+    int                          p101_fsm_effect_ring_publish(const struct p101_env *env, struct p101_error *err, struct p101_fsm_effect_ring *ring, struct p101_fsm_effect_batch *batch, const struct p101_fsm_step_receipt *receipt);
+    bool                         p101_fsm_effect_ring_peek(struct p101_fsm_effect_ring *ring, struct p101_fsm_effect_ring_entry *entry);
+    void                         p101_fsm_effect_ring_release(struct p101_fsm_effect_ring *ring);
+    size_t                       p101_fsm_effect_ring_count(const struct p101_fsm_effect_ring *ring);
+
+    /*
+     * A journal appends each committed receipt and its effects to a local
+     * file as one binary record whose length and body each carry a CRC-32,
+     * then consumes the batch as finish_receipt does; a receipt that did not
+     * commit writes nothing. Records are buffered and written with group
+     * commit: the file is synced once sync_bytes are unsynced or
+     * sync_interval_ms has passed since the last sync, checked on each
+     * append, and on every append when both are 0. durable_records counts
+     * the records known to be on disk; journal_sync forces a sync and
+     * journal_close syncs before closing. A record that cannot be buffered
+     * leaves the batch staged. A failed write or sync is not retried, since
+     * a later fsync can succeed after the kernel dropped the data: every
+     * later append and sync raises the same errno and durable_records stops.
+     *
+     * journal_replay reads the records back in order. A record cut short at
+     * the end of the file ends the replay cleanly; a record whose checksums
+     * or sizes do not match raises P101_FSM_ERROR_JOURNAL_CORRUPT. The effects
+     * passed to the handler, including their kinds, are valid only during
+     * the call, and kind_id is always P101_FSM_EFFECT_KIND_NONE.
+     */
+    struct p101_fsm_journal_record
+    {
+        size_t            sequence;
+        p101_fsm_state_id from_state;
+        p101_fsm_state_id attempted_state;
+        p101_fsm_state_id next_state;
+        size_t            effect_count;
+    };
+
+    typedef void (*p101_fsm_journal_replay_func)(const struct p101_env *env, struct p101_error *err, void *context, const struct p101_fsm_journal_record *record, const struct p101_fsm_effect effects[]);
+
+    struct p101_fsm_journal *p101_fsm_journal_open(const struct p101_env *env, struct p101_error *err, const char *path, size_t buffer_size, size_t sync_bytes, unsigned int sync_interval_ms) P101_ATTR_MALLOC P101_ATTR_WARN_UNUSED_RESULT;
+    int                      p101_fsm_journal_close(const struct p101_env *env, struct p101_error *err, struct p101_fsm_journal **journal);
+    int                      p101_fsm_journal_append(const struct p101_env *env, struct p101_error *err, struct p101_fsm_journal *journal, struct p101_fsm_effect_batch *batch, const struct p101_fsm_step_receipt *receipt);
+    int                      p101_fsm_journal_sync(const struct p101_env *env, struct p101_error *err, struct p101_fsm_journal *journal);
+    uint64_t                 p101_fsm_journal_get_records(const struct p101_env *env, const struct p101_fsm_journal *journal);
+    uint64_t                 p101_fsm_journal_get_durable_records(const struct p101_env *env, const struct p101_fsm_journal *journal);
+    uint64_t                 p101_fsm_journal_get_syncs(const struct p101_env *env, const struct p101_fsm_journal *journal);
+    int                      p101_fsm_journal_replay(const struct p101_env *env, struct p101_error *err, const char *path, p101_fsm_journal_replay_func handler, void *context);
+
+    /*
+     * A batch pool lends growable batches, made as by batch_create_growable
+     * with the pool's parameters, so batch memory follows the number of steps
+     * in flight rather than the number of machines. pool_acquire lends an
+     * idle batch, or makes one when none is idle, for one
+     * p101_fsm_step_with_receipt(). pool_finish_receipt finishes the receipt
+     * as finish_receipt does and takes the batch back, even when a handler
+     * fails. A stale receipt leaves the batch lent, and so does a finish that
+     * fails before consuming it, whose receipt can then be retried. After
+     * any other finish, such as effect_ring_publish or journal_append,
+     * pool_release takes it back.
+     * Returning a batch makes its receipts stale.
+     *
+     * The high-water mark is the most batches lent at once since the last
+     * pool_trim. pool_trim frees the chunks and effect records of idle
+     * batches beyond it and starts a new mark, so trimming periodically sizes
+     * the pool to recent demand. The batch objects themselves live until
+     * pool_destroy, so a receipt kept across a trim is only stale. A pool is
+     * used by one thread at a time. pool_destroy destroys every batch it
+     * made, lent or idle, so no batch or receipt may outlive it.
+     */
+    struct p101_fsm_effect_batch_pool *p101_fsm_effect_batch_pool_create(const struct p101_env *env, struct p101_error *err, size_t chunk_size, size_t maximum_effects, size_t maximum_bytes) P101_ATTR_MALLOC P101_ATTR_WARN_UNUSED_RESULT;
+    void                               p101_fsm_effect_batch_pool_destroy(const struct p101_env *env, struct p101_fsm_effect_batch_pool **pool);
+    struct p101_fsm_effect_batch      *p101_fsm_effect_batch_pool_acquire(const struct p101_env *env, struct p101_error *err, struct p101_fsm_effect_batch_pool *pool) P101_ATTR_WARN_UNUSED_RESULT;
+    int                                p101_fsm_effect_batch_pool_release(const struct p101_env *env, struct p101_error *err, struct p101_fsm_effect_batch_pool *pool, struct p101_fsm_effect_batch *batch);
+    int                                p101_fsm_effect_batch_pool_finish_receipt(const struct p101_env *env, struct p101_error *err, struct p101_fsm_effect_batch_pool *pool, const struct p101_fsm_step_receipt *receipt, struct p101_fsm_effect_sink *target);
+    void                               p101_fsm_effect_batch_pool_trim(const struct p101_env *env, struct p101_fsm_effect_batch_pool *pool);
+    size_t                             p101_fsm_effect_batch_pool_get_high_water(const struct p101_env *env, const struct p101_fsm_effect_batch_pool *pool);
+    size_t                             p101_fsm_effect_batch_pool_get_lent(const struct p101_env *env, const struct p101_fsm_effect_batch_pool *pool);
+    size_t                             p101_fsm_effect_batch_pool_get_idle(const struct p101_env *env, const struct p101_fsm_effect_batch_pool *pool);
+
+    /*
+     * effect_reserve returns size writable bytes inside a batch sink's arena,
+     * aligned for any object type, so a callback can build a payload in place
+     * instead of building it elsewhere and having emit copy it. effect_commit
+     * or effect_commit_id then stages it with its first data_size bytes. Other
+     * emits may happen in between; a second reserve abandons the first. The
+     * region is counted against the batch's limits when reserved and belongs
+     * to the batch once committed. Reserving from a NULL sink returns NULL
+     * without an error; any other non-batch sink raises P101_FSM_ERROR_EFFECT.
+     */
+    void *p101_fsm_effect_reserve(const struct p101_env *env, struct p101_error *err, struct p101_fsm_effect_sink *sink, size_t size);
+    void  p101_fsm_effect_commit(const struct p101_env *env, struct p101_error *err, struct p101_fsm_effect_sink *sink, const char *kind, size_t data_size);
+    void  p101_fsm_effect_commit_id(const struct p101_env *env, struct p101_error *err, struct p101_fsm_effect_sink *sink, const struct p101_fsm_effect_kinds *kinds, p101_fsm_effect_kind_id kind_id, size_t data_size);
+
     /*
      * step executes exactly one state callback or one rejected-transition
      * policy decision. State is committed only after a callback returns a
@@ -224,10 +546,172 @@ extern "C"
      * notifier succeeds.
      *
      * run is only a convenience loop around step. last_result may be NULL.
+     * run_bounded is the same loop with a budget: it takes at most
+     * maximum_steps steps and, when deadline is not NULL, starts none at or
+     * after that CLOCK_MONOTONIC time. A machine that is still transitioning
+     * when either runs out yields P101_FSM_RUN_BUDGET_EXHAUSTED and can be run
+     * again later. When no step starts, because maximum_steps is 0 or the
+     * deadline has passed, last_result reports P101_FSM_STEP_ERROR with
+     * sequence 0 and every state P101_FSM_STATE_NONE, as for a NULL machine.
+     *
+     * step_many steps each machine in infos once, in order, writing one result
+     * per slot and sharing sink. args may be NULL; NULL machines report
+     * P101_FSM_STEP_ERROR without raising. While one machine runs, the next
+     * machine's dense row or CSR edges are prefetched. Returns the number of
+     * results that are not P101_FSM_STEP_ERROR.
      */
     p101_fsm_step_status p101_fsm_step(struct p101_fsm_info *info, void *arg, struct p101_fsm_effect_sink *sink, struct p101_fsm_step_result *result) P101_ATTR_WARN_UNUSED_RESULT;
+    size_t               p101_fsm_step_many(struct p101_fsm_info *const infos[], void *const args[], struct p101_fsm_effect_sink *sink, struct p101_fsm_step_result results[], size_t count) P101_ATTR_WARN_UNUSED_RESULT;
     p101_fsm_step_status p101_fsm_step_with_receipt(struct p101_fsm_info *info, void *arg, struct p101_fsm_effect_batch *batch, struct p101_fsm_step_receipt *receipt) P101_ATTR_WARN_UNUSED_RESULT;
     p101_fsm_run_result  p101_fsm_run(struct p101_fsm_info *info, void *arg, struct p101_fsm_effect_sink *sink, struct p101_fsm_step_result *last_result) P101_ATTR_WARN_UNUSED_RESULT;
+    p101_fsm_run_result  p101_fsm_run_bounded(struct p101_fsm_info *info, void *arg, struct p101_fsm_effect_sink *sink, size_t maximum_steps, const struct timespec *deadline, struct p101_fsm_step_result *last_result)
+        P101_ATTR_WARN_UNUSED_RESULT;
+
+    /*
+     * A pool runs many sessions of one definition without a machine per
+     * session. It stores each session's current state, source state, step
+     * sequence, and flags in parallel arrays inside one allocation, so a
+     * sweep is a linear pass and a session costs a few bytes. Sessions are
+     * numbered from 0 to capacity - 1 and start at the definition's initial
+     * state; reset_session returns one there for reuse.
+     *
+     * pool_step follows the same commit rules and results as step. A pool has
+     * no notifiers, observer, or bad-transition handler: an unknown edge
+     * reports P101_FSM_STEP_ERROR with P101_FSM_REFUSAL_UNKNOWN_TRANSITION and
+     * raises P101_FSM_ERROR_UNKNOWN_TRANSITION, as the default handler does.
+     * Every session shares the pool's borrowed error objects, so a raised
+     * error stops all of them until it is reset. step_range steps sessions
+     * [first, first + count) once each, with args and results indexed from
+     * first, and returns the number of results that are not
+     * P101_FSM_STEP_ERROR. count_in_state counts live sessions in a state.
+     */
+    struct p101_fsm_pool *p101_fsm_pool_create(const struct p101_env *env, struct p101_error *err, struct p101_fsm_definition *definition, size_t capacity, const struct p101_env *fsm_env, struct p101_error *fsm_err) P101_ATTR_MALLOC
+        P101_ATTR_WARN_UNUSED_RESULT;
+    void                  p101_fsm_pool_destroy(const struct p101_env *env, struct p101_error *fsm_err, struct p101_fsm_pool **ppool);
+    size_t                p101_fsm_pool_get_capacity(const struct p101_env *env, const struct p101_fsm_pool *pool);
+    p101_fsm_state_id     p101_fsm_pool_get_current_state(const struct p101_env *env, const struct p101_fsm_pool *pool, size_t session);
+    size_t                p101_fsm_pool_get_step_sequence(const struct p101_env *env, const struct p101_fsm_pool *pool, size_t session);
+    bool                  p101_fsm_pool_is_terminal(const struct p101_env *env, const struct p101_fsm_pool *pool, size_t session);
+    size_t                p101_fsm_pool_count_in_state(const struct p101_env *env, const struct p101_fsm_pool *pool, p101_fsm_state_id state_id);
+    void                  p101_fsm_pool_reset_session(const struct p101_env *env, struct p101_fsm_pool *pool, size_t session);
+    p101_fsm_step_status  p101_fsm_pool_step(struct p101_fsm_pool *pool, size_t session, void *arg, struct p101_fsm_effect_sink *sink, struct p101_fsm_step_result *result) P101_ATTR_WARN_UNUSED_RESULT;
+    size_t                p101_fsm_pool_step_range(struct p101_fsm_pool *pool, size_t first, size_t count, void *const args[], struct p101_fsm_effect_sink *sink, struct p101_fsm_step_result results[]) P101_ATTR_WARN_UNUSED_RESULT;
+
+    /*
+     * An inbox is a bounded queue of events for one machine. post may be
+     * called from any thread without a lock and returns false when the inbox
+     * is full; everything else belongs to the thread that steps the machine.
+     * capacity is rounded up to a power of two of at least 2.
+     *
+     * step_event delivers the oldest event to the current state callback,
+     * which receives a struct p101_fsm_event_context as its arg. The event is
+     * consumed once the step transitions, pauses, or exits; after any other
+     * outcome it stays at the head of the inbox for a later step. A
+     * bad-transition redirect moves the machine without running a callback,
+     * so its event stays and goes to the redirected state on the next step.
+     * With an empty inbox no callback runs and the result is
+     * P101_FSM_STEP_PAUSED in the current state, with the step sequence
+     * unchanged. run_events keeps stepping one event at a time while the
+     * steps transition or pause, stops with P101_FSM_RUN_REFUSED at any
+     * refusal, a redirect included, and reports P101_FSM_RUN_PAUSED once the
+     * inbox is empty.
+     */
+    struct p101_fsm_inbox *p101_fsm_inbox_create(const struct p101_env *env, struct p101_error *err, size_t capacity) P101_ATTR_MALLOC P101_ATTR_WARN_UNUSED_RESULT;
+    void                   p101_fsm_inbox_destroy(const struct p101_env *env, struct p101_fsm_inbox **pinbox);
+    size_t                 p101_fsm_inbox_get_capacity(const struct p101_env *env, const struct p101_fsm_inbox *inbox);
+    size_t                 p101_fsm_inbox_count(const struct p101_fsm_inbox *inbox);
+    bool                   p101_fsm_inbox_post(struct p101_fsm_inbox *inbox, const struct p101_fsm_event *event) P101_ATTR_WARN_UNUSED_RESULT;
+    p101_fsm_step_status   p101_fsm_step_event(struct p101_fsm_info *info, struct p101_fsm_inbox *inbox, void *arg, struct p101_fsm_effect_sink *sink, struct p101_fsm_step_result *result) P101_ATTR_WARN_UNUSED_RESULT;
+    p101_fsm_run_result    p101_fsm_run_events(struct p101_fsm_info *info, struct p101_fsm_inbox *inbox, void *arg, struct p101_fsm_effect_sink *sink, struct p101_fsm_step_result *last_result) P101_ATTR_WARN_UNUSED_RESULT;
+
+    /*
+     * An executor runs machines to completion on a fixed set of worker
+     * threads. A task binds one machine to its arg and sink; scheduling it
+     * queues one p101_fsm_run on the next worker in turn, and idle workers
+     * steal queued tasks from busy ones. A task is never run by two workers
+     * at once: scheduling a task that is already queued does nothing, and
+     * scheduling one that is running queues one more run after the current
+     * run returns. Each task should own its machine, arg, and error objects,
+     * because tasks run concurrently. get_result reports the last run, or
+     * P101_FSM_RUN_PAUSED before the first.
+     *
+     * A task created with an inbox runs run_events instead of run, and is
+     * only queued while its inbox holds events: scheduling it with an empty
+     * inbox does nothing. executor_post posts an event to the task's inbox and
+     * schedules the task, raising P101_FSM_ERROR_INBOX_FULL when the event
+     * does not fit.
+     *
+     * wait blocks until no task is queued or running, and destroy waits the
+     * same way before joining the workers; neither may be called from a task.
+     * A task can only be destroyed while it is not queued or running.
+     */
+    struct p101_fsm_executor *p101_fsm_executor_create(const struct p101_env *env, struct p101_error *err, size_t worker_count) P101_ATTR_MALLOC P101_ATTR_WARN_UNUSED_RESULT;
+    void                      p101_fsm_executor_destroy(const struct p101_env *env, struct p101_error *err, struct p101_fsm_executor **pexecutor);
+    int                       p101_fsm_executor_schedule(const struct p101_env *env, struct p101_error *err, struct p101_fsm_executor *executor, struct p101_fsm_task *task);
+    int                       p101_fsm_executor_post(const struct p101_env *env, struct p101_error *err, struct p101_fsm_executor *executor, struct p101_fsm_task *task, const struct p101_fsm_event *event);
+    void                      p101_fsm_executor_wait(const struct p101_env *env, struct p101_fsm_executor *executor);
+    struct p101_fsm_task     *p101_fsm_task_create(const struct p101_env *env, struct p101_error *err, struct p101_fsm_info *info, void *arg, struct p101_fsm_effect_sink *sink) P101_ATTR_MALLOC P101_ATTR_WARN_UNUSED_RESULT;
+    struct p101_fsm_task     *p101_fsm_task_create_with_inbox(const struct p101_env *env, struct p101_error *err, struct p101_fsm_info *info, struct p101_fsm_inbox *inbox, void *arg, struct p101_fsm_effect_sink *sink) P101_ATTR_MALLOC
+        P101_ATTR_WARN_UNUSED_RESULT;
+    void                      p101_fsm_task_destroy(const struct p101_env *env, struct p101_error *err, struct p101_fsm_task **ptask);
+    p101_fsm_run_result       p101_fsm_task_get_result(const struct p101_env *env, const struct p101_fsm_task *task);
+
+    /*
+     * A timer wheel gives paused machines timeouts. Time is counted in ticks
+     * whose length the caller chooses: advance moves the wheel forward and
+     * runs each machine whose timer falls due, with p101_fsm_run, until it
+     * pauses again. It returns the number of timers that expired. While that
+     * run lasts, has_expired reports true, so a callback can tell a timeout
+     * from an ordinary step.
+     *
+     * A timer binds one machine to the wheel. arm schedules it ticks from
+     * now, replacing any earlier arming, and cancel disarms it; arming,
+     * cancelling, and expiring a timer each take constant time. Callbacks may
+     * arm and cancel any timer, and usually re-arm their own before pausing.
+     * A timer cannot be detached during its own expiry, and the wheel can
+     * only be destroyed once every timer has been detached. The wheel and its
+     * timers belong to one thread.
+     */
+    struct p101_fsm_timer_wheel *p101_fsm_timer_wheel_create(const struct p101_env *env, struct p101_error *err) P101_ATTR_MALLOC P101_ATTR_WARN_UNUSED_RESULT;
+    void                         p101_fsm_timer_wheel_destroy(const struct p101_env *env, struct p101_error *err, struct p101_fsm_timer_wheel **pwheel);
+    uint64_t                     p101_fsm_timer_wheel_get_time(const struct p101_env *env, const struct p101_fsm_timer_wheel *wheel);
+    size_t                       p101_fsm_timer_wheel_get_armed(const struct p101_env *env, const struct p101_fsm_timer_wheel *wheel);
+    size_t                       p101_fsm_timer_wheel_advance(const struct p101_env *env, struct p101_error *err, struct p101_fsm_timer_wheel *wheel, uint64_t ticks);
+    struct p101_fsm_timer       *p101_fsm_timer_attach(const struct p101_env *env, struct p101_error *err, struct p101_fsm_timer_wheel *wheel, struct p101_fsm_info *info, void *arg, struct p101_fsm_effect_sink *sink) P101_ATTR_WARN_UNUSED_RESULT;
+    void                         p101_fsm_timer_detach(const struct p101_env *env, struct p101_error *err, struct p101_fsm_timer **ptimer);
+    int                          p101_fsm_timer_arm(const struct p101_env *env, struct p101_error *err, struct p101_fsm_timer *timer, uint64_t ticks);
+    void                         p101_fsm_timer_cancel(const struct p101_env *env, struct p101_fsm_timer *timer);
+    bool                         p101_fsm_timer_is_armed(const struct p101_env *env, const struct p101_fsm_timer *timer);
+    bool                         p101_fsm_timer_has_expired(const struct p101_env *env, const struct p101_fsm_timer *timer);
+    p101_fsm_run_result          p101_fsm_timer_get_result(const struct p101_env *env, const struct p101_fsm_timer *timer);
+
+#if defined(__linux__)
+    /*
+     * A reactor resumes paused machines when a descriptor they wait on is
+     * ready, using one epoll set for every attached machine. Before pausing,
+     * a callback calls watch with the descriptor and an EPOLLIN/EPOLLOUT
+     * style interest mask. poll waits up to timeout_ms, the same as
+     * epoll_wait, then runs each woken machine with p101_fsm_run until it
+     * pauses again, and returns how many it ran. During that run get_ready
+     * reports the epoll events that woke it.
+     *
+     * A watch wakes its machine once. The callback re-arms it with another
+     * watch before pausing; watching a different descriptor replaces the
+     * previous one. A machine whose run exits, is refused, or fails stops
+     * watching, and get_result reports how its last run ended. Detach a
+     * machine, or watch another descriptor, before closing the one it
+     * watches. Machines cannot be detached and the reactor cannot be polled
+     * from a callback while poll is running machines.
+     */
+    struct p101_fsm_reactor         *p101_fsm_reactor_create(const struct p101_env *env, struct p101_error *err, size_t maximum_events) P101_ATTR_MALLOC P101_ATTR_WARN_UNUSED_RESULT;
+    void                             p101_fsm_reactor_destroy(const struct p101_env *env, struct p101_fsm_reactor **preactor);
+    struct p101_fsm_reactor_machine *p101_fsm_reactor_attach(const struct p101_env *env, struct p101_error *err, struct p101_fsm_reactor *reactor, struct p101_fsm_info *info, void *arg, struct p101_fsm_effect_sink *sink) P101_ATTR_WARN_UNUSED_RESULT;
+    void                             p101_fsm_reactor_detach(const struct p101_env *env, struct p101_error *err, struct p101_fsm_reactor_machine **pmachine);
+    int                              p101_fsm_reactor_watch(const struct p101_env *env, struct p101_error *err, struct p101_fsm_reactor_machine *machine, int fd, uint32_t interest);
+    uint32_t                         p101_fsm_reactor_get_ready(const struct p101_env *env, const struct p101_fsm_reactor_machine *machine);
+    p101_fsm_run_result              p101_fsm_reactor_get_result(const struct p101_env *env, const struct p101_fsm_reactor_machine *machine);
+    int                              p101_fsm_reactor_poll(const struct p101_env *env, struct p101_error *err, struct p101_fsm_reactor *reactor, int timeout_ms);
+#endif
 
     void p101_fsm_exit_immediately(const struct p101_env *env, struct p101_error *err, void *arg, struct p101_fsm_effect_sink *sink, struct p101_fsm_decision *decision);
 
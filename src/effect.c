@@ -16,39 +16,114 @@
 
 #include "p101_fsm/errors.h"
 #include "p101_fsm/fsm.h"
+#include "hot_path.h"
+#include "run_loop.h"
 #include <p101_c/p101_stdlib.h>
 #include <p101_c/p101_string.h>
 #include <p101_env/wrapper.h>
+#include <limits.h>
+#include <stddef.h>
 #include <stdint.h>
 
-struct stored_effect
+/*
+ * A growable batch stages bytes in a chain of chunks. Chunks are kept when the
+ * batch is reset and reused in order; a chunk larger than chunk_size is only
+ * allocated for a single effect that does not fit in one.
+ */
+struct batch_chunk
 {
-    size_t kind_offset;
-    size_t data_offset;
-    size_t data_size;
+    struct batch_chunk                 *next;
+    size_t                              capacity;
+    _Alignas(max_align_t) unsigned char bytes[];
 };
 
+/*
+ * Staged effects point at their kind and payload copies, which live in bytes
+ * for a bounded batch and in the chunk chain for a growable one. A growable
+ * batch grows effects by doubling and bounds both counts only when a ceiling
+ * was given; otherwise maximum_effects and maximum_bytes are SIZE_MAX.
+ * Each payload starts on an alignment boundary, 1 unless one was set. A
+ * batch made by a pool sits at pool_index in the pool's batches and is lent
+ * until returned.
+ */
 struct p101_fsm_effect_batch
 {
-    struct stored_effect           *effects;
-    unsigned char                  *bytes;
-    size_t                          maximum_effects;
-    size_t                          maximum_bytes;
-    size_t                          effect_count;
-    size_t                          byte_count;
-    uint64_t                        generation;
-    struct p101_fsm_step_binding    admitted_binding;
-    struct p101_fsm_step_result     admitted_result;
-    p101_fsm_transition_disposition admitted_disposition;
-    bool                            receipt_available;
+    struct p101_fsm_effect            *effects;
+    unsigned char                     *bytes;
+    size_t                             maximum_effects;
+    size_t                             maximum_bytes;
+    size_t                             effect_count;
+    size_t                             byte_count;
+    struct batch_chunk                *chunks;
+    struct batch_chunk                *chunk;
+    size_t                             chunk_used;
+    size_t                             chunk_size;
+    size_t                             effect_capacity;
+    size_t                             allocated_bytes;
+    size_t                             alignment;
+    unsigned char                     *reserved;
+    size_t                             reserved_size;
+    struct p101_fsm_effect_batch      *pool_next;
+    size_t                             pool_index;
+    bool                               growable;
+    uint64_t                           generation;
+    struct p101_fsm_step_binding       admitted_binding;
+    struct p101_fsm_step_result        admitted_result;
+    p101_fsm_transition_disposition    admitted_disposition;
+    bool                               receipt_available;
+    bool                               run_staged;
+    bool                               lent;
+    bool                               owns_storage;
+};
+
+/*
+ * Interned kind names are copied once and never move, so an effect may borrow
+ * one for as long as the registry lives.
+ */
+struct p101_fsm_effect_kinds
+{
+    char  **names;
+    size_t  count;
+    size_t  capacity;
+};
+
+/*
+ * batches holds every batch the pool has made, lent or idle, so a receipt
+ * can be checked against it and no batch object is freed before the pool.
+ * Idle batches are linked through pool_next, so lending and returning one
+ * never allocates. high_water is the most batches lent at once since the
+ * last trim.
+ */
+struct p101_fsm_effect_batch_pool
+{
+    struct p101_fsm_effect_batch **batches;
+    size_t                         batch_count;
+    size_t                         batch_capacity;
+    struct p101_fsm_effect_batch  *idle;
+    size_t                         idle_count;
+    size_t                         lent_count;
+    size_t                         high_water;
+    size_t                         chunk_size;
+    size_t                         maximum_effects;
+    size_t                         maximum_bytes;
 };
 
 static void                            batch_advance_generation(struct p101_fsm_effect_batch *batch);
+static unsigned char                  *batch_chunk_reserve(const struct p101_env *env, struct p101_error *err, struct p101_fsm_effect_batch *batch, size_t size, size_t alignment);
+static unsigned char                  *batch_claim(const struct p101_env *env, struct p101_error *err, struct p101_fsm_effect_batch *batch, size_t size, size_t alignment);
+static void                            batch_commit(const struct p101_env *env, struct p101_error *err, struct p101_fsm_effect_sink *sink, const char *kind, p101_fsm_effect_kind_id kind_id, size_t data_size);
+static bool                            batch_grow_effects(const struct p101_env *env, struct p101_error *err, struct p101_fsm_effect_batch *batch);
 static void                            batch_bind_receipt(struct p101_fsm_effect_batch *batch, const struct p101_fsm_step_receipt *receipt);
 static void                            batch_effect_handler(const struct p101_env *env, struct p101_error *err, void *context, const struct p101_fsm_effect *effect);
 static bool                            batch_receipt_matches(const struct p101_fsm_effect_batch *batch, const struct p101_fsm_step_receipt *receipt);
 static void                            batch_reset(struct p101_fsm_effect_batch *batch);
+static struct p101_fsm_effect_batch   *pool_find_lent(const struct p101_fsm_effect_batch_pool *pool, const struct p101_fsm_effect_batch *batch);
+static bool                            pool_grow(const struct p101_env *env, struct p101_error *err, struct p101_fsm_effect_batch_pool *pool);
+static void                            pool_return(struct p101_fsm_effect_batch_pool *pool, struct p101_fsm_effect_batch *batch);
+static void                            pool_trim_batch(const struct p101_env *env, struct p101_fsm_effect_batch *batch);
 static p101_fsm_transition_disposition step_disposition(const struct p101_fsm_step_result *result);
+static size_t                          batch_layout(size_t maximum_effects, size_t maximum_bytes, size_t *effects_offset, size_t *bytes_offset);
+static p101_fsm_effect_kind_id         kinds_find(const struct p101_env *env, const struct p101_fsm_effect_kinds *kinds, const char *kind);
 
 struct p101_fsm_effect_batch *p101_fsm_effect_batch_create(const struct p101_env *env, struct p101_error *err, size_t maximum_effects, size_t maximum_bytes)
 {
@@ -73,7 +148,7 @@ struct p101_fsm_effect_batch *p101_fsm_effect_batch_create(const struct p101_env
     }
     effect_storage = p101_calloc(env, err, maximum_effects, sizeof(*batch->effects));
     byte_storage   = p101_calloc(env, err, maximum_bytes, sizeof(*batch->bytes));
-    batch->effects = (struct stored_effect *)effect_storage;
+    batch->effects = (struct p101_fsm_effect *)effect_storage;
     batch->bytes   = (unsigned char *)byte_storage;
     if(batch->effects == NULL || batch->bytes == NULL)
     {
@@ -85,20 +160,119 @@ struct p101_fsm_effect_batch *p101_fsm_effect_batch_create(const struct p101_env
     }
     batch->maximum_effects = maximum_effects;
     batch->maximum_bytes   = maximum_bytes;
+    batch->alignment       = 1U;
+    batch->owns_storage    = true;
+
+done:
+    P101_WRAPPER_DONE(env);
+    return batch;
+}
+
+struct p101_fsm_effect_batch *p101_fsm_effect_batch_create_growable(const struct p101_env *env, struct p101_error *err, size_t chunk_size, size_t maximum_effects, size_t maximum_bytes)
+{
+    struct p101_fsm_effect_batch *batch;
+
+    P101_TRACE(env);
+    P101_WRAPPER_FAULT_RETURN(env, err, batch, NULL);
+    batch = NULL;
+    if(chunk_size == 0U || chunk_size > SIZE_MAX - sizeof(struct batch_chunk))
+    {
+        P101_ERROR_RAISE_USER(err, "Invalid FSM effect-batch chunk size", P101_FSM_ERROR_EFFECT);
+        goto done;
+    }
+    batch = (struct p101_fsm_effect_batch *)p101_calloc(env, err, 1U, sizeof(*batch));
+    if(batch == NULL)
+    {
+        goto done;
+    }
+    batch->chunk_size      = chunk_size;
+    batch->maximum_effects = maximum_effects == 0U ? SIZE_MAX : maximum_effects;
+    batch->maximum_bytes   = maximum_bytes == 0U ? SIZE_MAX : maximum_bytes;
+    batch->alignment       = 1U;
+    batch->growable        = true;
+    batch->owns_storage    = true;
+
+done:
+    P101_WRAPPER_DONE(env);
+    return batch;
+}
+
+struct p101_fsm_effect_batch *p101_fsm_effect_batch_init(const struct p101_env *env, struct p101_error *err, void *storage, size_t storage_size, size_t maximum_effects, size_t maximum_bytes)
+{
+    struct p101_fsm_effect_batch *batch;
+    unsigned char                *base;
+    size_t                        effects_offset;
+    size_t                        bytes_offset;
+    size_t                        required;
+
+    P101_TRACE(env);
+    P101_WRAPPER_FAULT_RETURN(env, err, batch, NULL);
+    batch    = NULL;
+    required = batch_layout(maximum_effects, maximum_bytes, &effects_offset, &bytes_offset);
+    if(required == 0U)
+    {
+        P101_ERROR_RAISE_USER(err, "Invalid FSM effect-batch capacity", P101_FSM_ERROR_EFFECT);
+        goto done;
+    }
+    if(storage == NULL || (uintptr_t)storage % _Alignof(max_align_t) != 0U || storage_size < required)
+    {
+        P101_ERROR_RAISE_USER(err, "FSM effect-batch storage is too small or misaligned", P101_FSM_ERROR_INVALID_ARGUMENT);
+        goto done;
+    }
+
+    base = (unsigned char *)storage;
+    p101_memset(env, base, 0, required);
+    batch                  = (struct p101_fsm_effect_batch *)storage;
+    batch->effects         = (struct p101_fsm_effect *)(void *)(base + effects_offset);
+    batch->bytes           = base + bytes_offset;
+    batch->maximum_effects = maximum_effects;
+    batch->maximum_bytes   = maximum_bytes;
+    batch->alignment       = 1U;
+    batch->owns_storage    = false;
 
 done:
     P101_WRAPPER_DONE(env);
     return batch;
 }
 
+size_t p101_fsm_effect_batch_storage_size(const struct p101_env *env, size_t maximum_effects, size_t maximum_bytes)
+{
+    size_t effects_offset;
+    size_t bytes_offset;
+    size_t size;
+
+    P101_TRACE(env);
+    size = batch_layout(maximum_effects, maximum_bytes, &effects_offset, &bytes_offset);
+    P101_TRACE_EXIT(env);
+    return size;
+}
+
+size_t p101_fsm_effect_batch_storage_align(const struct p101_env *env)
+{
+    P101_TRACE(env);
+    P101_TRACE_EXIT(env);
+    return _Alignof(max_align_t);
+}
+
 void p101_fsm_effect_batch_destroy(const struct p101_env *env, struct p101_fsm_effect_batch **batch)
 {
     P101_TRACE(env);
     if(batch != NULL && *batch != NULL)
     {
-        p101_free(env, (*batch)->bytes);
-        p101_free(env, (*batch)->effects);
-        p101_free(env, *batch);
+        while((*batch)->chunks != NULL)
+        {
+            struct batch_chunk *chunk;
+
+            chunk            = (*batch)->chunks;
+            (*batch)->chunks = chunk->next;
+            p101_free(env, chunk);
+        }
+        if((*batch)->owns_storage)
+        {
+            p101_free(env, (*batch)->bytes);
+            p101_free(env, (*batch)->effects);
+            p101_free(env, *batch);
+        }
         *batch = NULL;
     }
     P101_TRACE_EXIT(env);
@@ -120,6 +294,55 @@ size_t p101_fsm_effect_batch_count(const struct p101_fsm_effect_batch *batch)
     return batch == NULL ? 0U : batch->effect_count;
 }
 
+size_t p101_fsm_effect_batch_get_allocated_bytes(const struct p101_env *env, const struct p101_fsm_effect_batch *batch)
+{
+    size_t allocated;
+
+    P101_TRACE(env);
+    allocated = 0U;
+    if(batch != NULL)
+    {
+        allocated = batch->growable ? batch->allocated_bytes : batch->maximum_bytes;
+    }
+    P101_TRACE_EXIT(env);
+    return allocated;
+}
+
+int p101_fsm_effect_batch_set_alignment(const struct p101_env *env, struct p101_error *err, struct p101_fsm_effect_batch *batch, size_t alignment)
+{
+    int return_value;
+
+    P101_TRACE(env);
+    P101_WRAPPER_FAULT_RETURN(env, err, return_value, -1);
+    return_value = -1;
+    if(batch == NULL || alignment == 0U || (alignment & (alignment - 1U)) != 0U)
+    {
+        P101_ERROR_RAISE_USER(err, "FSM effect-batch alignment must be a power of two", P101_FSM_ERROR_INVALID_ARGUMENT);
+        goto done;
+    }
+    if(batch->effect_count > 0U || batch->reserved != NULL)
+    {
+        P101_ERROR_RAISE_USER(err, "Cannot change the alignment of a staged FSM effect batch", P101_FSM_ERROR_EFFECT);
+        goto done;
+    }
+    batch->alignment = alignment;
+    return_value     = 0;
+
+done:
+    P101_WRAPPER_DONE(env);
+    return return_value;
+}
+
+size_t p101_fsm_effect_batch_get_alignment(const struct p101_env *env, const struct p101_fsm_effect_batch *batch)
+{
+    size_t alignment;
+
+    P101_TRACE(env);
+    alignment = batch == NULL ? 0U : batch->alignment;
+    P101_TRACE_EXIT(env);
+    return alignment;
+}
+
 int p101_fsm_effect_batch_finish_receipt(const struct p101_env *env, struct p101_error *err, struct p101_fsm_effect_batch *batch, const struct p101_fsm_step_receipt *receipt, struct p101_fsm_effect_sink *target)
 {
     int  deliver;
@@ -145,14 +368,7 @@ int p101_fsm_effect_batch_finish_receipt(const struct p101_env *env, struct p101
     {
         for(size_t index = 0U; index < batch->effect_count; ++index)
         {
-            const struct stored_effect *stored;
-            struct p101_fsm_effect      effect;
-
-            stored           = &batch->effects[index];
-            effect.kind      = (const char *)&batch->bytes[stored->kind_offset];
-            effect.data      = stored->data_size == 0U ? NULL : &batch->bytes[stored->data_offset];
-            effect.data_size = stored->data_size;
-            target->handle(env, err, target->context, &effect);
+            target->handle(env, err, target->context, &batch->effects[index]);
             error_present = p101_error_has_error(err);
             if(error_present)
             {
@@ -172,10 +388,50 @@ done:
     return return_value;
 }
 
+int p101_fsm_effect_batch_finish_receipt_span(const struct p101_env *env, struct p101_error *err, struct p101_fsm_effect_batch *batch, const struct p101_fsm_step_receipt *receipt, struct p101_fsm_effect_span_sink *target)
+{
+    int  return_value;
+    bool error_present;
+    bool finish_admitted;
+    bool receipt_admitted;
+
+    P101_TRACE(env);
+    P101_WRAPPER_FAULT_RETURN(env, err, return_value, -1);
+    receipt_admitted = batch_receipt_matches(batch, receipt);
+    finish_admitted  = false;
+    return_value     = -1;
+    if(!receipt_admitted || target == NULL || target->handle == NULL)
+    {
+        P101_ERROR_RAISE_USER(err, "Invalid or stale FSM step receipt", P101_FSM_ERROR_EFFECT);
+        goto done;
+    }
+    finish_admitted = true;
+
+    // The staged records are already one array, so the span is handed over without copying.
+    if(receipt->disposition == P101_FSM_TRANSITION_APPLIED_CHANGED && batch->effect_count > 0U)
+    {
+        target->handle(env, err, target->context, batch->effects, batch->effect_count);
+        error_present = p101_error_has_error(err);
+        if(error_present)
+        {
+            goto done;
+        }
+    }
+    return_value = 0;
+
+done:
+    if(finish_admitted)
+    {
+        batch_reset(batch);
+        batch_advance_generation(batch);
+    }
+    P101_WRAPPER_DONE(env);
+    return return_value;
+}
+
 bool p101_fsm_step_receipt_effect(const struct p101_fsm_step_receipt *receipt, size_t index, struct p101_fsm_effect *effect)
 {
     const struct p101_fsm_effect_batch *batch;
-    const struct stored_effect         *stored;
     bool                                found;
     bool                                receipt_admitted;
 
@@ -191,156 +447,1005 @@ bool p101_fsm_step_receipt_effect(const struct p101_fsm_step_receipt *receipt, s
         goto done;
     }
 
-    stored            = &batch->effects[index];
-    effect->kind      = (const char *)&batch->bytes[stored->kind_offset];
-    effect->data      = stored->data_size == 0U ? NULL : &batch->bytes[stored->data_offset];
-    effect->data_size = stored->data_size;
-    found             = true;
+    *effect = batch->effects[index];
+    found   = true;
 
 done:
     return found;
 }
 
-p101_fsm_step_status p101_fsm_step_with_receipt(struct p101_fsm_info *info, void *arg, struct p101_fsm_effect_batch *batch, struct p101_fsm_step_receipt *receipt)
+struct p101_fsm_effect_kinds *p101_fsm_effect_kinds_create(const struct p101_env *env, struct p101_error *err)
 {
-    struct p101_fsm_effect_sink sink;
-    p101_fsm_step_status        status;
+    struct p101_fsm_effect_kinds *kinds;
 
-    status = P101_FSM_STEP_ERROR;
-    if(batch == NULL || receipt == NULL)
+    P101_TRACE(env);
+    P101_WRAPPER_FAULT_RETURN(env, err, kinds, NULL);
+    kinds = (struct p101_fsm_effect_kinds *)p101_calloc(env, err, 1U, sizeof(*kinds));
+    if(kinds == NULL)
     {
         goto done;
     }
 
-    p101_fsm_effect_batch_sink(batch, &sink);
-    status                           = p101_fsm_step(info, arg, &sink, &receipt->result);
-    receipt->binding.machine         = info;
-    receipt->binding.argument        = arg;
-    receipt->binding.sequence        = receipt->result.sequence;
-    receipt->binding.from_state      = receipt->result.from_state;
-    receipt->binding.attempted_state = receipt->result.attempted_state;
-    receipt->disposition             = step_disposition(&receipt->result);
-    receipt->effect_batch            = batch;
-    receipt->effect_generation       = batch->generation;
-    receipt->effect_count            = batch->effect_count;
-    batch_bind_receipt(batch, receipt);
-
 done:
-    return status;
+    P101_WRAPPER_DONE(env);
+    return kinds;
 }
 
-static void batch_effect_handler(const struct p101_env *env, struct p101_error *err, void *context, const struct p101_fsm_effect *effect)
+void p101_fsm_effect_kinds_destroy(const struct p101_env *env, struct p101_fsm_effect_kinds **kinds)
 {
-    struct p101_fsm_effect_batch *batch;
-    size_t                        kind_length;
-    size_t                        kind_size;
-    size_t                        required;
-    struct stored_effect         *stored;
+    P101_TRACE(env);
+    if(kinds != NULL && *kinds != NULL)
+    {
+        for(size_t index = 0U; index < (*kinds)->count; ++index)
+        {
+            p101_free(env, (*kinds)->names[index]);
+        }
+        p101_free(env, (*kinds)->names);
+        p101_free(env, *kinds);
+        *kinds = NULL;
+    }
+    P101_TRACE_EXIT(env);
+}
 
-    batch = (struct p101_fsm_effect_batch *)context;
-    if(batch == NULL || effect == NULL || effect->kind == NULL || (effect->data == NULL && effect->data_size != 0U))
+p101_fsm_effect_kind_id p101_fsm_effect_kinds_intern(const struct p101_env *env, struct p101_error *err, struct p101_fsm_effect_kinds *kinds, const char *kind)
+{
+    p101_fsm_effect_kind_id id;
+    char                  **names;
+    char                   *name;
+    size_t                  capacity;
+
+    P101_TRACE(env);
+    P101_WRAPPER_FAULT_RETURN(env, err, id, P101_FSM_EFFECT_KIND_NONE);
+    id = P101_FSM_EFFECT_KIND_NONE;
+    if(kinds == NULL || kind == NULL)
     {
-        P101_ERROR_RAISE_USER(err, "Invalid staged FSM effect", P101_FSM_ERROR_EFFECT);
-        goto p101_single_exit_;
+        P101_ERROR_RAISE_USER(err, "Invalid FSM effect kind", P101_FSM_ERROR_EFFECT);
+        goto done;
     }
-    kind_length = p101_strlen(env, effect->kind);
-    kind_size   = kind_length + 1U;
-    if(effect->data_size > SIZE_MAX - kind_size)
+    id = kinds_find(env, kinds, kind);
+    if(id != P101_FSM_EFFECT_KIND_NONE)
     {
-        P101_ERROR_RAISE_USER(err, "FSM effect size is not representable", P101_FSM_ERROR_EFFECT);
-        goto p101_single_exit_;
+        goto done;
     }
-    required = kind_size + effect->data_size;
-    if(batch->effect_count >= batch->maximum_effects || required > batch->maximum_bytes - batch->byte_count)
+    if(kinds->count == (size_t)INT_MAX)
     {
-        P101_ERROR_RAISE_USER(err, "FSM effect batch capacity exceeded", P101_FSM_ERROR_EFFECT_CAPACITY);
-        goto p101_single_exit_;
+        P101_ERROR_RAISE_USER(err, "FSM effect kind registry is full", P101_FSM_ERROR_EFFECT_CAPACITY);
+        goto done;
     }
-
-    stored              = &batch->effects[batch->effect_count];
-    stored->kind_offset = batch->byte_count;
-    p101_memcpy(env, &batch->bytes[batch->byte_count], effect->kind, kind_size);
-    batch->byte_count += kind_size;
-    stored->data_offset = batch->byte_count;
-    stored->data_size   = effect->data_size;
-    if(effect->data_size > 0U)
+    if(kinds->count == kinds->capacity)
     {
-        p101_memcpy(env, &batch->bytes[batch->byte_count], effect->data, effect->data_size);
-        batch->byte_count += effect->data_size;
+        capacity = kinds->capacity == 0U ? 8U : kinds->capacity * 2U;
+        names    = (char **)p101_calloc(env, err, capacity, sizeof(*names));
+        if(names == NULL)
+        {
+            goto done;
+        }
+        if(kinds->count > 0U)
+        {
+            p101_memcpy(env, names, kinds->names, kinds->count * sizeof(*names));
+        }
+        p101_free(env, kinds->names);
+        kinds->names    = names;
+        kinds->capacity = capacity;
     }
-    batch->effect_count++;
+    name = p101_strdup(env, err, kind);
+    if(name == NULL)
+    {
+        goto done;
+    }
+    kinds->names[kinds->count] = name;
+    kinds->count++;
+    id = (p101_fsm_effect_kind_id)kinds->count;
 
-p101_single_exit_:
-    return;
+done:
+    P101_WRAPPER_DONE(env);
+    return id;
 }
 
-static void batch_reset(struct p101_fsm_effect_batch *batch)
+p101_fsm_effect_kind_id p101_fsm_effect_kinds_find(const struct p101_env *env, const struct p101_fsm_effect_kinds *kinds, const char *kind)
 {
-    if(batch != NULL)
+    p101_fsm_effect_kind_id id;
+
+    P101_TRACE(env);
+    id = P101_FSM_EFFECT_KIND_NONE;
+    if(kinds != NULL && kind != NULL)
     {
-        batch->effect_count      = 0U;
-        batch->byte_count        = 0U;
-        batch->receipt_available = false;
+        id = kinds_find(env, kinds, kind);
     }
+    P101_TRACE_EXIT(env);
+    return id;
 }
 
-static void batch_advance_generation(struct p101_fsm_effect_batch *batch)
+const char *p101_fsm_effect_kinds_get_name(const struct p101_env *env, const struct p101_fsm_effect_kinds *kinds, p101_fsm_effect_kind_id id)
 {
-    if(batch != NULL)
+    const char *name;
+
+    P101_TRACE(env);
+    name = NULL;
+    if(kinds != NULL && id > 0 && (size_t)id <= kinds->count)
     {
-        batch->generation++;
-        if(batch->generation == 0U)
-        {
-            batch->generation = 1U;
-        }
+        name = kinds->names[id - 1];
     }
+    P101_TRACE_EXIT(env);
+    return name;
 }
 
-static void batch_bind_receipt(struct p101_fsm_effect_batch *batch, const struct p101_fsm_step_receipt *receipt)
+size_t p101_fsm_effect_kinds_count(const struct p101_env *env, const struct p101_fsm_effect_kinds *kinds)
 {
-    if(batch != NULL && receipt != NULL)
-    {
-        batch->admitted_binding     = receipt->binding;
-        batch->admitted_result      = receipt->result;
-        batch->admitted_disposition = receipt->disposition;
-        batch->receipt_available    = true;
-    }
+    size_t count;
+
+    P101_TRACE(env);
+    count = kinds == NULL ? 0U : kinds->count;
+    P101_TRACE_EXIT(env);
+    return count;
 }
 
-static bool batch_receipt_matches(const struct p101_fsm_effect_batch *batch, const struct p101_fsm_step_receipt *receipt)
+void p101_fsm_emit_effect_id(const struct p101_env *env, struct p101_error *err, struct p101_fsm_effect_sink *sink, const struct p101_fsm_effect_kinds *kinds, p101_fsm_effect_kind_id kind_id, const void *data, size_t data_size)
 {
-    bool matches;
+    struct p101_fsm_effect effect;
 
-    matches = false;
-    if(batch != NULL && receipt != NULL && batch->receipt_available && receipt->effect_batch == batch && receipt->effect_generation == batch->generation && receipt->effect_count == batch->effect_count &&
-       receipt->binding.machine == batch->admitted_binding.machine && receipt->binding.argument == batch->admitted_binding.argument && receipt->binding.sequence == batch->admitted_binding.sequence &&
-       receipt->binding.from_state == batch->admitted_binding.from_state && receipt->binding.attempted_state == batch->admitted_binding.attempted_state && receipt->disposition == batch->admitted_disposition &&
-       receipt->result.status == batch->admitted_result.status && receipt->result.sequence == batch->admitted_result.sequence && receipt->result.from_state == batch->admitted_result.from_state &&
-       receipt->result.attempted_state == batch->admitted_result.attempted_state && receipt->result.next_state == batch->admitted_result.next_state && receipt->result.refusal == batch->admitted_result.refusal)
+    P101_FSM_HOT_TRACE(env);
+    P101_FSM_HOT_FAULT_RETURN_VOID(env, err);
+    if(sink == NULL || sink->handle == NULL)
     {
-        matches = true;
+        goto done;
+    }
+    if(kinds == NULL || kind_id <= 0 || (size_t)kind_id > kinds->count || (data == NULL && data_size != 0U))
+    {
+        P101_ERROR_RAISE_USER(err, "Invalid FSM effect", P101_FSM_ERROR_EFFECT);
+        goto done;
     }
 
-    return matches;
+    effect.kind      = kinds->names[kind_id - 1];
+    effect.data      = data;
+    effect.data_size = data_size;
+    effect.kind_id   = kind_id;
+    sink->handle(env, err, sink->context, &effect);
+
+done:
+    P101_FSM_HOT_DONE(env);
 }
 
-static p101_fsm_transition_disposition step_disposition(const struct p101_fsm_step_result *result)
+void *p101_fsm_effect_reserve(const struct p101_env *env, struct p101_error *err, struct p101_fsm_effect_sink *sink, size_t size)
 {
-    p101_fsm_transition_disposition disposition;
+    struct p101_fsm_effect_batch *batch;
+    unsigned char                *reserved;
 
-    disposition = P101_FSM_TRANSITION_ERROR;
-    if(result == NULL)
+    P101_FSM_HOT_TRACE(env);
+    P101_FSM_HOT_FAULT_RETURN(env, err, reserved, NULL);
+    reserved = NULL;
+    if(sink == NULL || sink->handle == NULL)
     {
         goto done;
     }
-
-#ifdef __clang__
-    #pragma clang diagnostic push
-    #pragma clang diagnostic ignored "-Wcovered-switch-default"
-#endif
-    switch(result->status)    // GCOVR_EXCL_BR_LINE: default protects against an invalid enum representation.
+    if(sink->handle != batch_effect_handler || size == 0U)
     {
-        case P101_FSM_STEP_TRANSITIONED:
+        P101_ERROR_RAISE_USER(err, "FSM effect reservation needs a batch sink and a size", P101_FSM_ERROR_EFFECT);
+        goto done;
+    }
+    batch = (struct p101_fsm_effect_batch *)sink->context;
+    if(batch->effect_count >= batch->maximum_effects)
+    {
+        P101_ERROR_RAISE_USER(err, "FSM effect batch capacity exceeded", P101_FSM_ERROR_EFFECT_CAPACITY);
+        goto done;
+    }
+    reserved = batch_claim(env, err, batch, size, batch->alignment > _Alignof(max_align_t) ? batch->alignment : _Alignof(max_align_t));
+    if(reserved == NULL)
+    {
+        goto done;
+    }
+    batch->reserved      = reserved;
+    batch->reserved_size = size;
+
+done:
+    P101_FSM_HOT_DONE(env);
+    return reserved;
+}
+
+void p101_fsm_effect_commit(const struct p101_env *env, struct p101_error *err, struct p101_fsm_effect_sink *sink, const char *kind, size_t data_size)
+{
+    P101_FSM_HOT_TRACE(env);
+    P101_FSM_HOT_FAULT_RETURN_VOID(env, err);
+    if(kind == NULL)
+    {
+        P101_ERROR_RAISE_USER(err, "Invalid FSM effect", P101_FSM_ERROR_EFFECT);
+        goto done;
+    }
+    batch_commit(env, err, sink, kind, P101_FSM_EFFECT_KIND_NONE, data_size);
+
+done:
+    P101_FSM_HOT_DONE(env);
+}
+
+void p101_fsm_effect_commit_id(const struct p101_env *env, struct p101_error *err, struct p101_fsm_effect_sink *sink, const struct p101_fsm_effect_kinds *kinds, p101_fsm_effect_kind_id kind_id, size_t data_size)
+{
+    P101_FSM_HOT_TRACE(env);
+    P101_FSM_HOT_FAULT_RETURN_VOID(env, err);
+    if(kinds == NULL || kind_id <= 0 || (size_t)kind_id > kinds->count)
+    {
+        P101_ERROR_RAISE_USER(err, "Invalid FSM effect", P101_FSM_ERROR_EFFECT);
+        goto done;
+    }
+    batch_commit(env, err, sink, kinds->names[kind_id - 1], kind_id, data_size);
+
+done:
+    P101_FSM_HOT_DONE(env);
+}
+
+p101_fsm_step_status p101_fsm_step_with_receipt(struct p101_fsm_info *info, void *arg, struct p101_fsm_effect_batch *batch, struct p101_fsm_step_receipt *receipt)
+{
+    struct p101_fsm_effect_sink sink;
+    p101_fsm_step_status        status;
+
+    status = P101_FSM_STEP_ERROR;
+    if(batch == NULL || receipt == NULL)
+    {
+        goto done;
+    }
+
+    p101_fsm_effect_batch_sink(batch, &sink);
+    status                           = p101_fsm_step(info, arg, &sink, &receipt->result);
+    receipt->binding.machine         = info;
+    receipt->binding.argument        = arg;
+    receipt->binding.sequence        = receipt->result.sequence;
+    receipt->binding.from_state      = receipt->result.from_state;
+    receipt->binding.attempted_state = receipt->result.attempted_state;
+    receipt->disposition             = step_disposition(&receipt->result);
+    receipt->effect_batch            = batch;
+    receipt->effect_generation       = batch->generation;
+    receipt->effect_count            = batch->effect_count;
+    batch_bind_receipt(batch, receipt);
+
+done:
+    return status;
+}
+
+p101_fsm_run_result p101_fsm_run_batched(struct p101_fsm_info *info, void *arg, struct p101_fsm_effect_batch *batch, struct p101_fsm_effect_segment segments[], size_t maximum_segments, size_t *segment_count, struct p101_fsm_step_result *last_result)
+{
+    const struct p101_env      *env;
+    struct p101_fsm_effect_sink sink;
+    struct p101_fsm_step_result current;
+    p101_fsm_run_result         run_result;
+    bool                        running;
+
+    env        = p101_fsm_info_run_env(info);
+    run_result = P101_FSM_RUN_ERROR;
+    P101_TRACE(env);
+    if(segment_count != NULL)
+    {
+        *segment_count = 0U;
+    }
+    if(info == NULL || batch == NULL || segments == NULL || maximum_segments == 0U || segment_count == NULL)
+    {
+        goto done;
+    }
+
+    p101_fsm_effect_batch_sink(batch, &sink);
+    batch->run_staged = true;
+    running           = true;
+    while(running)
+    {
+        struct batch_chunk  *chunk;
+        size_t               first;
+        size_t               byte_count;
+        size_t               chunk_used;
+        p101_fsm_step_status status;
+
+        // A committed step must always have a segment to land in, so a full array ends the run before the step.
+        if(*segment_count == maximum_segments)
+        {
+            run_result = P101_FSM_RUN_BUDGET_EXHAUSTED;
+            goto done;
+        }
+
+        first      = batch->effect_count;
+        byte_count = batch->byte_count;
+        chunk      = batch->chunk;
+        chunk_used = batch->chunk_used;
+        status     = p101_fsm_step(info, arg, &sink, &current);
+        if(last_result != NULL)
+        {
+            *last_result = current;
+        }
+        if(step_disposition(&current) != P101_FSM_TRANSITION_APPLIED_CHANGED)
+        {
+            batch->effect_count  = first;
+            batch->byte_count    = byte_count;
+            batch->chunk         = chunk;
+            batch->chunk_used    = chunk_used;
+            batch->reserved      = NULL;
+            batch->reserved_size = 0U;
+        }
+        else if(batch->effect_count > first)
+        {
+            segments[*segment_count].sequence = current.sequence;
+            segments[*segment_count].first    = first;
+            segments[*segment_count].count    = batch->effect_count - first;
+            (*segment_count)++;
+        }
+        running = fsm_run_continues(status, &current, false, &run_result);
+    }
+
+done:
+    P101_TRACE_EXIT(env);
+    return run_result;
+}
+
+int p101_fsm_effect_batch_flush(const struct p101_env *env, struct p101_error *err, struct p101_fsm_effect_batch *batch, struct p101_fsm_effect_span_sink *target)
+{
+    int  return_value;
+    bool error_present;
+    bool flush_admitted;
+
+    P101_TRACE(env);
+    P101_WRAPPER_FAULT_RETURN(env, err, return_value, -1);
+    flush_admitted = false;
+    return_value   = -1;
+    if(batch == NULL || !batch->run_staged || target == NULL || target->handle == NULL)
+    {
+        P101_ERROR_RAISE_USER(err, "FSM effect batch was not staged by a run", P101_FSM_ERROR_EFFECT);
+        goto done;
+    }
+    flush_admitted = true;
+
+    if(batch->effect_count > 0U)
+    {
+        target->handle(env, err, target->context, batch->effects, batch->effect_count);
+        error_present = p101_error_has_error(err);
+        if(error_present)
+        {
+            goto done;
+        }
+    }
+    return_value = 0;
+
+done:
+    if(flush_admitted)
+    {
+        batch_reset(batch);
+        batch_advance_generation(batch);
+    }
+    P101_WRAPPER_DONE(env);
+    return return_value;
+}
+
+struct p101_fsm_effect_batch_pool *p101_fsm_effect_batch_pool_create(const struct p101_env *env, struct p101_error *err, size_t chunk_size, size_t maximum_effects, size_t maximum_bytes)
+{
+    struct p101_fsm_effect_batch_pool *pool;
+
+    P101_TRACE(env);
+    P101_WRAPPER_FAULT_RETURN(env, err, pool, NULL);
+    pool = NULL;
+    if(chunk_size == 0U || chunk_size > SIZE_MAX - sizeof(struct batch_chunk))
+    {
+        P101_ERROR_RAISE_USER(err, "Invalid FSM effect-batch chunk size", P101_FSM_ERROR_EFFECT);
+        goto done;
+    }
+    pool = (struct p101_fsm_effect_batch_pool *)p101_calloc(env, err, 1U, sizeof(*pool));
+    if(pool == NULL)
+    {
+        goto done;
+    }
+    pool->chunk_size      = chunk_size;
+    pool->maximum_effects = maximum_effects;
+    pool->maximum_bytes   = maximum_bytes;
+
+done:
+    P101_WRAPPER_DONE(env);
+    return pool;
+}
+
+void p101_fsm_effect_batch_pool_destroy(const struct p101_env *env, struct p101_fsm_effect_batch_pool **pool)
+{
+    P101_TRACE(env);
+    if(pool != NULL && *pool != NULL)
+    {
+        for(size_t index = 0U; index < (*pool)->batch_count; ++index)
+        {
+            p101_fsm_effect_batch_destroy(env, &(*pool)->batches[index]);
+        }
+        p101_free(env, (*pool)->batches);
+        p101_free(env, *pool);
+        *pool = NULL;
+    }
+    P101_TRACE_EXIT(env);
+}
+
+struct p101_fsm_effect_batch *p101_fsm_effect_batch_pool_acquire(const struct p101_env *env, struct p101_error *err, struct p101_fsm_effect_batch_pool *pool)
+{
+    struct p101_fsm_effect_batch *batch;
+
+    P101_TRACE(env);
+    P101_WRAPPER_FAULT_RETURN(env, err, batch, NULL);
+    batch = NULL;
+    if(pool == NULL)
+    {
+        P101_ERROR_RAISE_USER(err, "FSM effect-batch pool cannot be NULL", P101_FSM_ERROR_INVALID_ARGUMENT);
+        goto done;
+    }
+
+    if(pool->idle != NULL)
+    {
+        batch      = pool->idle;
+        pool->idle = batch->pool_next;
+        pool->idle_count--;
+    }
+    else
+    {
+        if(pool->batch_count == pool->batch_capacity && !pool_grow(env, err, pool))
+        {
+            goto done;
+        }
+        batch = p101_fsm_effect_batch_create_growable(env, err, pool->chunk_size, pool->maximum_effects, pool->maximum_bytes);
+        if(batch == NULL)
+        {
+            goto done;
+        }
+        batch->pool_index                = pool->batch_count;
+        pool->batches[pool->batch_count] = batch;
+        pool->batch_count++;
+    }
+    batch->pool_next = NULL;
+    batch->lent      = true;
+    pool->lent_count++;
+    if(pool->lent_count > pool->high_water)
+    {
+        pool->high_water = pool->lent_count;
+    }
+
+done:
+    P101_WRAPPER_DONE(env);
+    return batch;
+}
+
+int p101_fsm_effect_batch_pool_release(const struct p101_env *env, struct p101_error *err, struct p101_fsm_effect_batch_pool *pool, struct p101_fsm_effect_batch *batch)
+{
+    struct p101_fsm_effect_batch *lent;
+    int                           return_value;
+
+    P101_TRACE(env);
+    P101_WRAPPER_FAULT_RETURN(env, err, return_value, -1);
+    return_value = -1;
+    lent         = pool_find_lent(pool, batch);
+    if(lent == NULL)
+    {
+        P101_ERROR_RAISE_USER(err, "FSM effect batch is not lent by this pool", P101_FSM_ERROR_INVALID_ARGUMENT);
+        goto done;
+    }
+    pool_return(pool, lent);
+    return_value = 0;
+
+done:
+    P101_WRAPPER_DONE(env);
+    return return_value;
+}
+
+int p101_fsm_effect_batch_pool_finish_receipt(const struct p101_env *env, struct p101_error *err, struct p101_fsm_effect_batch_pool *pool, const struct p101_fsm_step_receipt *receipt, struct p101_fsm_effect_sink *target)
+{
+    struct p101_fsm_effect_batch *batch;
+    uint64_t                      generation;
+    int                           return_value;
+
+    P101_TRACE(env);
+    P101_WRAPPER_FAULT_RETURN(env, err, return_value, -1);
+    return_value = -1;
+    batch        = receipt == NULL ? NULL : pool_find_lent(pool, receipt->effect_batch);
+    if(batch == NULL)
+    {
+        P101_ERROR_RAISE_USER(err, "FSM step receipt is not for a batch lent by this pool", P101_FSM_ERROR_INVALID_ARGUMENT);
+        goto done;
+    }
+
+    generation   = batch->generation;
+    return_value = p101_fsm_effect_batch_finish_receipt(env, err, batch, receipt, target);
+
+    // Only a finish that consumed the batch advances its generation, even when a handler failed; after any other failure the receipt stays valid for a retry.
+    if(batch->generation != generation)
+    {
+        pool_return(pool, batch);
+    }
+
+done:
+    P101_WRAPPER_DONE(env);
+    return return_value;
+}
+
+void p101_fsm_effect_batch_pool_trim(const struct p101_env *env, struct p101_fsm_effect_batch_pool *pool)
+{
+    P101_TRACE(env);
+    if(pool != NULL)
+    {
+        size_t warm;
+
+        // The most recently returned batches stay warm; the rest keep only their batch object.
+        warm = pool->high_water > pool->lent_count ? pool->high_water - pool->lent_count : 0U;
+        for(struct p101_fsm_effect_batch *batch = pool->idle; batch != NULL; batch = batch->pool_next)
+        {
+            if(warm > 0U)
+            {
+                warm--;
+            }
+            else
+            {
+                pool_trim_batch(env, batch);
+            }
+        }
+        pool->high_water = pool->lent_count;
+    }
+    P101_TRACE_EXIT(env);
+}
+
+size_t p101_fsm_effect_batch_pool_get_high_water(const struct p101_env *env, const struct p101_fsm_effect_batch_pool *pool)
+{
+    size_t high_water;
+
+    P101_TRACE(env);
+    high_water = pool == NULL ? 0U : pool->high_water;
+    P101_TRACE_EXIT(env);
+    return high_water;
+}
+
+size_t p101_fsm_effect_batch_pool_get_lent(const struct p101_env *env, const struct p101_fsm_effect_batch_pool *pool)
+{
+    size_t lent;
+
+    P101_TRACE(env);
+    lent = pool == NULL ? 0U : pool->lent_count;
+    P101_TRACE_EXIT(env);
+    return lent;
+}
+
+size_t p101_fsm_effect_batch_pool_get_idle(const struct p101_env *env, const struct p101_fsm_effect_batch_pool *pool)
+{
+    size_t idle;
+
+    P101_TRACE(env);
+    idle = pool == NULL ? 0U : pool->idle_count;
+    P101_TRACE_EXIT(env);
+    return idle;
+}
+
+static void batch_effect_handler(const struct p101_env *env, struct p101_error *err, void *context, const struct p101_fsm_effect *effect)
+{
+    struct p101_fsm_effect_batch *batch;
+    size_t                        kind_length;
+    size_t                        kind_size;
+    size_t                        required;
+    unsigned char                *destination;
+    struct p101_fsm_effect       *stored;
+
+    batch = (struct p101_fsm_effect_batch *)context;
+    if(batch == NULL || effect == NULL || effect->kind == NULL || (effect->data == NULL && effect->data_size != 0U))
+    {
+        P101_ERROR_RAISE_USER(err, "Invalid staged FSM effect", P101_FSM_ERROR_EFFECT);
+        goto p101_single_exit_;
+    }
+    // An interned kind is borrowed from its registry, so only its payload is copied.
+    kind_size = 0U;
+    if(effect->kind_id == P101_FSM_EFFECT_KIND_NONE)
+    {
+        kind_length = P101_FSM_HOT_STRLEN(env, effect->kind);
+        kind_size   = kind_length + 1U;
+    }
+    if(effect->data_size > SIZE_MAX - kind_size)
+    {
+        P101_ERROR_RAISE_USER(err, "FSM effect size is not representable", P101_FSM_ERROR_EFFECT);
+        goto p101_single_exit_;
+    }
+    required = kind_size + effect->data_size;
+    if(batch->effect_count >= batch->maximum_effects)
+    {
+        P101_ERROR_RAISE_USER(err, "FSM effect batch capacity exceeded", P101_FSM_ERROR_EFFECT_CAPACITY);
+        goto p101_single_exit_;
+    }
+    if(batch->growable && batch->effect_count == batch->effect_capacity && !batch_grow_effects(env, err, batch))
+    {
+        goto p101_single_exit_;
+    }
+    destination = NULL;
+    if(required > 0U)
+    {
+        destination = batch_claim(env, err, batch, required, batch->alignment);
+        if(destination == NULL)
+        {
+            goto p101_single_exit_;
+        }
+    }
+
+    // The payload comes first so it lands on the alignment boundary; the kind copy follows it, never split across chunks.
+    stored            = &batch->effects[batch->effect_count];
+    stored->kind      = effect->kind;
+    stored->data      = NULL;
+    stored->data_size = effect->data_size;
+    stored->kind_id   = effect->kind_id;
+    if(effect->data_size > 0U)
+    {
+        P101_FSM_HOT_MEMCPY(env, destination, effect->data, effect->data_size);
+        stored->data = destination;
+    }
+    if(kind_size > 0U)
+    {
+        P101_FSM_HOT_MEMCPY(env, destination + effect->data_size, effect->kind, kind_size);
+        stored->kind = (const char *)(destination + effect->data_size);
+    }
+    batch->effect_count++;
+
+p101_single_exit_:
+    return;
+}
+
+/*
+ * Caller storage holds the batch, then its effect records, then the byte
+ * arena. Returns the total size, or 0 for an invalid or unrepresentable
+ * capacity.
+ */
+static size_t batch_layout(size_t maximum_effects, size_t maximum_bytes, size_t *effects_offset, size_t *bytes_offset)
+{
+    size_t total;
+
+    total = 0U;
+    if(maximum_effects == 0U || maximum_bytes == 0U || maximum_effects > (SIZE_MAX - sizeof(struct p101_fsm_effect_batch) - _Alignof(struct p101_fsm_effect)) / sizeof(struct p101_fsm_effect))
+    {
+        goto done;
+    }
+    *effects_offset = sizeof(struct p101_fsm_effect_batch) + ((_Alignof(struct p101_fsm_effect) - (sizeof(struct p101_fsm_effect_batch) % _Alignof(struct p101_fsm_effect))) % _Alignof(struct p101_fsm_effect));
+    *bytes_offset   = *effects_offset + (maximum_effects * sizeof(struct p101_fsm_effect));
+    if(maximum_bytes > SIZE_MAX - *bytes_offset)
+    {
+        goto done;
+    }
+    total = *bytes_offset + maximum_bytes;
+
+done:
+    return total;
+}
+
+// Reset keeps a growable batch's chunks and effect records for the next step.
+static void batch_reset(struct p101_fsm_effect_batch *batch)
+{
+    if(batch != NULL)
+    {
+        batch->effect_count      = 0U;
+        batch->byte_count        = 0U;
+        batch->chunk             = batch->chunks;
+        batch->chunk_used        = 0U;
+        batch->reserved          = NULL;
+        batch->reserved_size     = 0U;
+        batch->receipt_available = false;
+        batch->run_staged        = false;
+    }
+}
+
+/*
+ * Returns size contiguous bytes from the chunk chain, moving to the next kept
+ * chunk when the current one is full. A new chunk is allocated, and linked
+ * after the current one, only when no kept chunk has room. Chunk bytes start
+ * on a max_align_t boundary, so a fresh chunk needs slack for padding only
+ * when alignment is larger than that.
+ */
+static unsigned char *batch_chunk_reserve(const struct p101_env *env, struct p101_error *err, struct p101_fsm_effect_batch *batch, size_t size, size_t alignment)
+{
+    struct batch_chunk *chunk;
+    unsigned char      *reserved;
+    size_t              capacity;
+    size_t              padding;
+    size_t              slack;
+
+    reserved = NULL;
+    slack    = alignment > _Alignof(max_align_t) ? alignment - 1U : 0U;
+    if(batch->chunk != NULL)
+    {
+        padding = (size_t)(-(uintptr_t)&batch->chunk->bytes[batch->chunk_used]) & (alignment - 1U);
+        if(batch->chunk->capacity - batch->chunk_used >= padding && batch->chunk->capacity - batch->chunk_used - padding >= size)
+        {
+            reserved = &batch->chunk->bytes[batch->chunk_used + padding];
+            batch->chunk_used += padding + size;
+            goto done;
+        }
+    }
+
+    if(size > SIZE_MAX - slack)
+    {
+        P101_ERROR_RAISE_USER(err, "FSM effect size is not representable", P101_FSM_ERROR_EFFECT);
+        goto done;
+    }
+    chunk = batch->chunk == NULL ? batch->chunks : batch->chunk->next;
+    if(chunk == NULL || chunk->capacity < size + slack)
+    {
+        capacity = size + slack > batch->chunk_size ? size + slack : batch->chunk_size;
+        if(capacity > SIZE_MAX - sizeof(struct batch_chunk))
+        {
+            P101_ERROR_RAISE_USER(err, "FSM effect size is not representable", P101_FSM_ERROR_EFFECT);
+            goto done;
+        }
+        chunk = (struct batch_chunk *)p101_calloc(env, err, 1U, sizeof(struct batch_chunk) + capacity);
+        if(chunk == NULL)
+        {
+            goto done;
+        }
+        chunk->capacity = capacity;
+        batch->allocated_bytes += capacity;
+        if(batch->chunk == NULL)
+        {
+            chunk->next   = batch->chunks;
+            batch->chunks = chunk;
+        }
+        else
+        {
+            chunk->next        = batch->chunk->next;
+            batch->chunk->next = chunk;
+        }
+    }
+
+    padding           = (size_t)(-(uintptr_t)chunk->bytes) & (alignment - 1U);
+    batch->chunk      = chunk;
+    batch->chunk_used = padding + size;
+    reserved          = &chunk->bytes[padding];
+
+done:
+    return reserved;
+}
+
+/*
+ * Claims size bytes on an alignment boundary for an effect being staged or
+ * built in place. A bounded batch counts the padding against maximum_bytes;
+ * a growable batch counts only the bytes claimed.
+ */
+static unsigned char *batch_claim(const struct p101_env *env, struct p101_error *err, struct p101_fsm_effect_batch *batch, size_t size, size_t alignment)
+{
+    unsigned char *claimed;
+    size_t         padding;
+
+    claimed = NULL;
+    padding = 0U;
+    if(!batch->growable)
+    {
+        padding = (size_t)(-(uintptr_t)&batch->bytes[batch->byte_count]) & (alignment - 1U);
+    }
+    if(padding > batch->maximum_bytes - batch->byte_count || size > batch->maximum_bytes - batch->byte_count - padding)
+    {
+        P101_ERROR_RAISE_USER(err, "FSM effect batch capacity exceeded", P101_FSM_ERROR_EFFECT_CAPACITY);
+        goto done;
+    }
+    if(!batch->growable)
+    {
+        claimed = &batch->bytes[batch->byte_count + padding];
+    }
+    else
+    {
+        claimed = batch_chunk_reserve(env, err, batch, size, alignment);
+        if(claimed == NULL)
+        {
+            goto done;
+        }
+    }
+    batch->byte_count += padding + size;
+
+done:
+    return claimed;
+}
+
+/*
+ * Turns the pending reservation into a staged effect of data_size bytes. A
+ * string kind is copied into the batch after the payload.
+ */
+static void batch_commit(const struct p101_env *env, struct p101_error *err, struct p101_fsm_effect_sink *sink, const char *kind, p101_fsm_effect_kind_id kind_id, size_t data_size)
+{
+    struct p101_fsm_effect_batch *batch;
+    struct p101_fsm_effect       *stored;
+    unsigned char                *kind_copy;
+    size_t                        kind_size;
+
+    if(sink == NULL || sink->handle != batch_effect_handler)
+    {
+        P101_ERROR_RAISE_USER(err, "FSM effect commit needs a batch sink", P101_FSM_ERROR_EFFECT);
+        goto done;
+    }
+    batch = (struct p101_fsm_effect_batch *)sink->context;
+    if(batch->reserved == NULL || data_size > batch->reserved_size)
+    {
+        P101_ERROR_RAISE_USER(err, "FSM effect does not match its reservation", P101_FSM_ERROR_EFFECT);
+        goto done;
+    }
+    if(batch->effect_count >= batch->maximum_effects)
+    {
+        P101_ERROR_RAISE_USER(err, "FSM effect batch capacity exceeded", P101_FSM_ERROR_EFFECT_CAPACITY);
+        goto done;
+    }
+    if(batch->growable && batch->effect_count == batch->effect_capacity && !batch_grow_effects(env, err, batch))
+    {
+        goto done;
+    }
+
+    stored = &batch->effects[batch->effect_count];
+    if(kind_id == P101_FSM_EFFECT_KIND_NONE)
+    {
+        kind_size = P101_FSM_HOT_STRLEN(env, kind) + 1U;
+        kind_copy = batch_claim(env, err, batch, kind_size, 1U);
+        if(kind_copy == NULL)
+        {
+            goto done;
+        }
+        P101_FSM_HOT_MEMCPY(env, kind_copy, kind, kind_size);
+        kind = (const char *)kind_copy;
+    }
+    stored->kind         = kind;
+    stored->data         = data_size == 0U ? NULL : batch->reserved;
+    stored->data_size    = data_size;
+    stored->kind_id      = kind_id;
+    batch->reserved      = NULL;
+    batch->reserved_size = 0U;
+    batch->effect_count++;
+
+done:
+    return;
+}
+
+// Doubles the effect records of a growable batch, keeping the staged ones.
+static bool batch_grow_effects(const struct p101_env *env, struct p101_error *err, struct p101_fsm_effect_batch *batch)
+{
+    struct p101_fsm_effect *effects;
+    size_t                  capacity;
+    bool                    grown;
+
+    grown    = false;
+    capacity = batch->effect_capacity == 0U ? 16U : batch->effect_capacity * 2U;
+    if(capacity > SIZE_MAX / sizeof(*effects) || capacity < batch->effect_capacity)
+    {
+        P101_ERROR_RAISE_USER(err, "FSM effect batch capacity exceeded", P101_FSM_ERROR_EFFECT_CAPACITY);
+        goto done;
+    }
+    effects = (struct p101_fsm_effect *)p101_calloc(env, err, capacity, sizeof(*effects));
+    if(effects == NULL)
+    {
+        goto done;
+    }
+    if(batch->effect_count > 0U)
+    {
+        p101_memcpy(env, effects, batch->effects, batch->effect_count * sizeof(*effects));
+    }
+    p101_free(env, batch->effects);
+    batch->effects         = effects;
+    batch->effect_capacity = capacity;
+    grown                  = true;
+
+done:
+    return grown;
+}
+
+// The batch's own pool_index is only trusted once the pool's slot points back at it.
+static struct p101_fsm_effect_batch *pool_find_lent(const struct p101_fsm_effect_batch_pool *pool, const struct p101_fsm_effect_batch *batch)
+{
+    struct p101_fsm_effect_batch *lent;
+
+    lent = NULL;
+    if(pool != NULL && batch != NULL && batch->pool_index < pool->batch_count && pool->batches[batch->pool_index] == batch && pool->batches[batch->pool_index]->lent)
+    {
+        lent = pool->batches[batch->pool_index];
+    }
+
+    return lent;
+}
+
+static bool pool_grow(const struct p101_env *env, struct p101_error *err, struct p101_fsm_effect_batch_pool *pool)
+{
+    struct p101_fsm_effect_batch **batches;
+    size_t                         capacity;
+    bool                           grown;
+
+    grown    = false;
+    capacity = pool->batch_capacity == 0U ? 4U : pool->batch_capacity * 2U;
+    if(capacity > SIZE_MAX / sizeof(*batches) || capacity < pool->batch_capacity)
+    {
+        P101_ERROR_RAISE_USER(err, "FSM effect-batch pool capacity exceeded", P101_FSM_ERROR_EFFECT_CAPACITY);
+        goto done;
+    }
+    batches = (struct p101_fsm_effect_batch **)p101_calloc(env, err, capacity, sizeof(*batches));
+    if(batches == NULL)
+    {
+        goto done;
+    }
+    if(pool->batch_count > 0U)
+    {
+        p101_memcpy(env, batches, pool->batches, pool->batch_count * sizeof(*batches));
+    }
+    p101_free(env, pool->batches);
+    pool->batches        = batches;
+    pool->batch_capacity = capacity;
+    grown                = true;
+
+done:
+    return grown;
+}
+
+// Resetting and advancing the generation makes every receipt for the batch stale before another borrower gets it.
+static void pool_return(struct p101_fsm_effect_batch_pool *pool, struct p101_fsm_effect_batch *batch)
+{
+    batch_reset(batch);
+    batch_advance_generation(batch);
+    batch->lent      = false;
+    batch->pool_next = pool->idle;
+    pool->idle       = batch;
+    pool->idle_count++;
+    pool->lent_count--;
+}
+
+// An idle batch is already reset, so dropping its storage leaves it as a freshly created growable batch.
+static void pool_trim_batch(const struct p101_env *env, struct p101_fsm_effect_batch *batch)
+{
+    while(batch->chunks != NULL)
+    {
+        struct batch_chunk *chunk;
+
+        chunk         = batch->chunks;
+        batch->chunks = chunk->next;
+        p101_free(env, chunk);
+    }
+    p101_free(env, batch->effects);
+    batch->effects         = NULL;
+    batch->effect_capacity = 0U;
+    batch->chunk           = NULL;
+    batch->chunk_used      = 0U;
+    batch->allocated_bytes = 0U;
+}
+
+static void batch_advance_generation(struct p101_fsm_effect_batch *batch)
+{
+    if(batch != NULL)
+    {
+        batch->generation++;
+        if(batch->generation == 0U)
+        {
+            batch->generation = 1U;
+        }
+    }
+}
+
+static void batch_bind_receipt(struct p101_fsm_effect_batch *batch, const struct p101_fsm_step_receipt *receipt)
+{
+    if(batch != NULL && receipt != NULL)
+    {
+        batch->admitted_binding     = receipt->binding;
+        batch->admitted_result      = receipt->result;
+        batch->admitted_disposition = receipt->disposition;
+        batch->receipt_available    = true;
+    }
+}
+
+static bool batch_receipt_matches(const struct p101_fsm_effect_batch *batch, const struct p101_fsm_step_receipt *receipt)
+{
+    bool matches;
+
+    matches = false;
+    if(batch != NULL && receipt != NULL && batch->receipt_available && receipt->effect_batch == batch && receipt->effect_generation == batch->generation && receipt->effect_count == batch->effect_count &&
+       receipt->binding.machine == batch->admitted_binding.machine && receipt->binding.argument == batch->admitted_binding.argument && receipt->binding.sequence == batch->admitted_binding.sequence &&
+       receipt->binding.from_state == batch->admitted_binding.from_state && receipt->binding.attempted_state == batch->admitted_binding.attempted_state && receipt->disposition == batch->admitted_disposition &&
+       receipt->result.status == batch->admitted_result.status && receipt->result.sequence == batch->admitted_result.sequence && receipt->result.from_state == batch->admitted_result.from_state &&
+       receipt->result.attempted_state == batch->admitted_result.attempted_state && receipt->result.next_state == batch->admitted_result.next_state && receipt->result.refusal == batch->admitted_result.refusal)
+    {
+        matches = true;
+    }
+
+    return matches;
+}
+
+static p101_fsm_transition_disposition step_disposition(const struct p101_fsm_step_result *result)
+{
+    p101_fsm_transition_disposition disposition;
+
+    disposition = P101_FSM_TRANSITION_ERROR;
+    if(result == NULL)
+    {
+        goto done;
+    }
+
+#ifdef __clang__
+    #pragma clang diagnostic push
+    #pragma clang diagnostic ignored "-Wcovered-switch-default"
+#endif
+    switch(result->status)    // GCOVR_EXCL_BR_LINE: default protects against an invalid enum representation.
+    {
+        case P101_FSM_STEP_TRANSITIONED:
             disposition = P101_FSM_TRANSITION_APPLIED_CHANGED;
             break;
         case P101_FSM_STEP_PAUSED:
@@ -371,3 +1476,21 @@ static p101_fsm_transition_disposition step_disposition(const struct p101_fsm_st
 done:
     return disposition;
 }
+
+// Kinds are few and interned up front, so a linear scan is enough. IDs are one past the name's index.
+static p101_fsm_effect_kind_id kinds_find(const struct p101_env *env, const struct p101_fsm_effect_kinds *kinds, const char *kind)
+{
+    p101_fsm_effect_kind_id id;
+
+    id = P101_FSM_EFFECT_KIND_NONE;
+    for(size_t index = 0U; index < kinds->count && id == P101_FSM_EFFECT_KIND_NONE; ++index)
+    {
+        if(p101_strcmp(env, kinds->names[index], kind) == 0)
+        {
+            id = (p101_fsm_effect_kind_id)(index + 1U);
+        }
+    }
+
+    return id;
+}
+
@@ -0,0 +1,349 @@
+/*
+ * Copyright 2021-2026 D'Arcy Smith.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "p101_fsm/errors.h"
+#include "p101_fsm/fsm.h"
+#include <p101_c/p101_stdlib.h>
+#include <p101_c/p101_string.h>
+#include <p101_env/wrapper.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define FSM_EFFECT_RING_LINE_SIZE 64U
+#define FSM_EFFECT_RING_ALIGN _Alignof(max_align_t)
+
+/*
+ * byte_end is the byte position just past this entry's payload and kind, so
+ * releasing the entry frees everything up to it, including any bytes skipped
+ * to keep the copy contiguous at the end of the byte buffer.
+ */
+struct effect_ring_entry
+{
+    struct p101_fsm_effect_ring_entry view;
+    size_t                            byte_end;
+};
+
+/*
+ * Only the publishing thread advances tail and byte_tail; only the consuming
+ * thread advances head and byte_head. Positions grow without wrapping and are
+ * reduced to an index when used. The padding keeps the two sides on separate
+ * cache lines.
+ */
+struct p101_fsm_effect_ring
+{
+    struct effect_ring_entry *entries;
+    unsigned char            *bytes;
+    size_t                    mask;
+    size_t                    byte_capacity;
+    size_t                    byte_tail;
+    char                      tail_padding[FSM_EFFECT_RING_LINE_SIZE];
+    atomic_size_t             tail;
+    char                      head_padding[FSM_EFFECT_RING_LINE_SIZE - sizeof(atomic_size_t)];
+    atomic_size_t             head;
+    atomic_size_t             byte_head;
+};
+
+/*
+ * One publish in progress: the positions it starts from and the consumer's
+ * byte position seen when it started. The consumer only ever frees more, so
+ * a fit computed against that snapshot still holds when the copy is made.
+ */
+struct effect_ring_publication
+{
+    struct p101_fsm_effect_ring *ring;
+    struct p101_fsm_step_binding binding;
+    size_t                       tail;
+    size_t                       byte_tail;
+    size_t                       byte_head;
+};
+
+static bool   ring_fits(const struct p101_env *env, const struct effect_ring_publication *publication, const struct p101_fsm_step_receipt *receipt);
+static void   ring_publish_span(const struct p101_env *env, struct p101_error *err, void *context, const struct p101_fsm_effect effects[], size_t count);
+static bool   ring_reserve(const struct p101_fsm_effect_ring *ring, size_t byte_head, size_t *position, size_t size, unsigned char **reserved);
+static size_t ring_effect_size(const struct p101_env *env, const struct p101_fsm_effect *effect, size_t *kind_size);
+
+struct p101_fsm_effect_ring *p101_fsm_effect_ring_create(const struct p101_env *env, struct p101_error *err, size_t entry_capacity, size_t byte_capacity)
+{
+    struct p101_fsm_effect_ring *ring;
+    size_t                       rounded;
+
+    P101_TRACE(env);
+    P101_WRAPPER_FAULT_RETURN(env, err, ring, NULL);
+    ring = NULL;
+    if(entry_capacity == 0U || entry_capacity > (SIZE_MAX / 2U + 1U) / sizeof(struct effect_ring_entry) || byte_capacity == 0U || byte_capacity > SIZE_MAX / 2U)
+    {
+        P101_ERROR_RAISE_USER(err, "FSM effect ring capacity is out of range", P101_FSM_ERROR_INVALID_ARGUMENT);
+        goto done;
+    }
+
+    rounded = 1U;
+    while(rounded < entry_capacity)
+    {
+        rounded <<= 1U;
+    }
+
+    ring = (struct p101_fsm_effect_ring *)p101_calloc(env, err, 1U, sizeof(*ring));
+    if(ring == NULL)
+    {
+        goto done;
+    }
+    ring->byte_capacity = (byte_capacity + FSM_EFFECT_RING_ALIGN - 1U) & ~(FSM_EFFECT_RING_ALIGN - 1U);
+    ring->entries       = (struct effect_ring_entry *)p101_calloc(env, err, rounded, sizeof(*ring->entries));
+    ring->bytes         = (unsigned char *)p101_calloc(env, err, ring->byte_capacity, 1U);
+    if(ring->entries == NULL || ring->bytes == NULL)
+    {
+        p101_free(env, ring->bytes);
+        p101_free(env, ring->entries);
+        p101_free(env, ring);
+        ring = NULL;
+        goto done;
+    }
+    ring->mask = rounded - 1U;
+    atomic_init(&ring->tail, 0U);
+    atomic_init(&ring->head, 0U);
+    atomic_init(&ring->byte_head, 0U);
+
+done:
+    P101_WRAPPER_DONE(env);
+    return ring;
+}
+
+void p101_fsm_effect_ring_destroy(const struct p101_env *env, struct p101_fsm_effect_ring **ring)
+{
+    P101_TRACE(env);
+    if(ring != NULL && *ring != NULL)
+    {
+        p101_free(env, (*ring)->bytes);
+        p101_free(env, (*ring)->entries);
+        p101_free(env, *ring);
+        *ring = NULL;
+    }
+    P101_TRACE_EXIT(env);
+}
+
+size_t p101_fsm_effect_ring_get_capacity(const struct p101_env *env, const struct p101_fsm_effect_ring *ring)
+{
+    size_t capacity;
+
+    P101_TRACE(env);
+    capacity = ring == NULL ? 0U : ring->mask + 1U;
+    P101_TRACE_EXIT(env);
+    return capacity;
+}
+
+int p101_fsm_effect_ring_publish(const struct p101_env *env, struct p101_error *err, struct p101_fsm_effect_ring *ring, struct p101_fsm_effect_batch *batch, const struct p101_fsm_step_receipt *receipt)
+{
+    struct effect_ring_publication   publication;
+    struct p101_fsm_effect_span_sink target;
+    int                              return_value;
+
+    P101_TRACE(env);
+    P101_WRAPPER_FAULT_RETURN(env, err, return_value, -1);
+    return_value = -1;
+    if(ring == NULL || receipt == NULL)
+    {
+        P101_ERROR_RAISE_USER(err, "FSM effect ring publish needs a ring and a receipt", P101_FSM_ERROR_INVALID_ARGUMENT);
+        goto done;
+    }
+
+    publication.ring      = ring;
+    publication.binding   = receipt->binding;
+    publication.tail      = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    publication.byte_tail = ring->byte_tail;
+    publication.byte_head = atomic_load_explicit(&ring->byte_head, memory_order_acquire);
+
+    // A full ring leaves the batch staged, so the same receipt can be published again once the consumer catches up.
+    if(receipt->disposition == P101_FSM_TRANSITION_APPLIED_CHANGED && !ring_fits(env, &publication, receipt))
+    {
+        P101_ERROR_RAISE_USER(err, "FSM effect ring is full", P101_FSM_ERROR_EFFECT_CAPACITY);
+        goto done;
+    }
+    target.handle  = ring_publish_span;
+    target.context = &publication;
+    return_value   = p101_fsm_effect_batch_finish_receipt_span(env, err, batch, receipt, &target);
+
+done:
+    P101_WRAPPER_DONE(env);
+    return return_value;
+}
+
+bool p101_fsm_effect_ring_peek(struct p101_fsm_effect_ring *ring, struct p101_fsm_effect_ring_entry *entry)
+{
+    size_t head;
+    bool   found;
+
+    found = false;
+    if(ring == NULL || entry == NULL)
+    {
+        goto done;
+    }
+    head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    if(head == atomic_load_explicit(&ring->tail, memory_order_acquire))
+    {
+        goto done;
+    }
+    *entry = ring->entries[head & ring->mask].view;
+    found  = true;
+
+done:
+    return found;
+}
+
+void p101_fsm_effect_ring_release(struct p101_fsm_effect_ring *ring)
+{
+    size_t head;
+
+    if(ring != NULL)
+    {
+        head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        if(head != atomic_load_explicit(&ring->tail, memory_order_acquire))
+        {
+            atomic_store_explicit(&ring->byte_head, ring->entries[head & ring->mask].byte_end, memory_order_release);
+            atomic_store_explicit(&ring->head, head + 1U, memory_order_release);
+        }
+    }
+}
+
+size_t p101_fsm_effect_ring_count(const struct p101_fsm_effect_ring *ring)
+{
+    size_t count;
+
+    count = 0U;
+    if(ring != NULL)
+    {
+        size_t head;
+
+        // Read head first: it never passes tail, so the difference cannot wrap.
+        head  = atomic_load_explicit(&ring->head, memory_order_acquire);
+        count = atomic_load_explicit(&ring->tail, memory_order_acquire) - head;
+    }
+
+    return count;
+}
+
+// Replays the copy against the snapshot without writing: every entry and byte must fit, or nothing is published.
+static bool ring_fits(const struct p101_env *env, const struct effect_ring_publication *publication, const struct p101_fsm_step_receipt *receipt)
+{
+    const struct p101_fsm_effect_ring *ring;
+    struct p101_fsm_effect             effect;
+    size_t                             head;
+    size_t                             position;
+    size_t                             kind_size;
+    bool                               fits;
+
+    ring = publication->ring;
+    head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    fits = receipt->effect_count <= (ring->mask + 1U) - (publication->tail - head);
+
+    // An effect the receipt cannot produce means the receipt is stale; finish_receipt_span reports that.
+    position = publication->byte_tail;
+    for(size_t index = 0U; fits && index < receipt->effect_count && p101_fsm_step_receipt_effect(receipt, index, &effect); ++index)
+    {
+        fits = ring_reserve(ring, publication->byte_head, &position, ring_effect_size(env, &effect, &kind_size), NULL);
+    }
+
+    return fits;
+}
+
+static void ring_publish_span(const struct p101_env *env, struct p101_error *err, void *context, const struct p101_fsm_effect effects[], size_t count)
+{
+    struct effect_ring_publication *publication;
+    struct p101_fsm_effect_ring    *ring;
+    size_t                          position;
+
+    (void)err;
+    publication = (struct effect_ring_publication *)context;
+    ring        = publication->ring;
+    position    = publication->byte_tail;
+    for(size_t index = 0U; index < count; ++index)
+    {
+        struct effect_ring_entry *entry;
+        unsigned char            *reserved;
+        size_t                    kind_size;
+        size_t                    size;
+
+        entry                   = &ring->entries[(publication->tail + index) & ring->mask];
+        entry->view.binding     = publication->binding;
+        entry->view.effect      = effects[index];
+        entry->view.effect.data = NULL;
+        size                    = ring_effect_size(env, &effects[index], &kind_size);
+        reserved                = NULL;
+        (void)ring_reserve(ring, publication->byte_head, &position, size, &reserved);
+        if(effects[index].data_size > 0U)
+        {
+            p101_memcpy(env, reserved, effects[index].data, effects[index].data_size);
+            entry->view.effect.data = reserved;
+        }
+        if(kind_size > 0U)
+        {
+            p101_memcpy(env, reserved + effects[index].data_size, effects[index].kind, kind_size);
+            entry->view.effect.kind = (const char *)(reserved + effects[index].data_size);
+        }
+        entry->byte_end = position;
+    }
+    ring->byte_tail = position;
+    atomic_store_explicit(&ring->tail, publication->tail + count, memory_order_release);
+}
+
+/*
+ * Claims size contiguous bytes at *position, skipping to the start of the
+ * buffer when the end is too short. reserved may be NULL for a dry run.
+ */
+static bool ring_reserve(const struct p101_fsm_effect_ring *ring, size_t byte_head, size_t *position, size_t size, unsigned char **reserved)
+{
+    size_t offset;
+    size_t skip;
+    bool   fits;
+
+    fits = false;
+    if(size > ring->byte_capacity)
+    {
+        goto done;
+    }
+    offset = *position % ring->byte_capacity;
+    skip   = size > ring->byte_capacity - offset ? ring->byte_capacity - offset : 0U;
+    if(skip + size > ring->byte_capacity - (*position - byte_head))
+    {
+        goto done;
+    }
+    *position += skip;
+    if(reserved != NULL)
+    {
+        *reserved = &ring->bytes[*position % ring->byte_capacity];
+    }
+    *position += size;
+    fits = true;
+
+done:
+    return fits;
+}
+
+// Payload first, then the kind unless it is interned, rounded so the next payload stays aligned.
+static size_t ring_effect_size(const struct p101_env *env, const struct p101_fsm_effect *effect, size_t *kind_size)
+{
+    size_t size;
+
+    *kind_size = effect->kind_id == P101_FSM_EFFECT_KIND_NONE ? p101_strlen(env, effect->kind) + 1U : 0U;
+    size       = SIZE_MAX;
+    if(effect->data_size <= SIZE_MAX / 2U - *kind_size)
+    {
+        size = (effect->data_size + *kind_size + FSM_EFFECT_RING_ALIGN - 1U) & ~(FSM_EFFECT_RING_ALIGN - 1U);
+    }
+
+    return size;
+}
@@ -0,0 +1,297 @@
+/*
+ * Copyright 2021-2026 D'Arcy Smith.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "p101_fsm/errors.h"
+#include "p101_fsm/fsm.h"
+#include "run_loop.h"
+#include <p101_c/p101_stdlib.h>
+#include <p101_env/wrapper.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define FSM_INBOX_LINE_SIZE 64U
+
+/*
+ * A cell is free for the producer that claims position p when its sequence
+ * equals p, and holds a published event for the consumer at position p when
+ * its sequence equals p + 1. Taking an event hands the cell to position
+ * p + capacity.
+ */
+struct fsm_inbox_cell
+{
+    atomic_size_t         sequence;
+    struct p101_fsm_event event;
+};
+
+/*
+ * Producers claim positions from tail with a compare-and-swap; only the
+ * stepping thread advances head. The padding keeps the two counters on
+ * separate cache lines.
+ */
+struct p101_fsm_inbox
+{
+    const struct p101_env *env;
+    struct fsm_inbox_cell *cells;
+    size_t                 mask;
+    char                   tail_padding[FSM_INBOX_LINE_SIZE];
+    atomic_size_t          tail;
+    char                   head_padding[FSM_INBOX_LINE_SIZE - sizeof(atomic_size_t)];
+    atomic_size_t          head;
+};
+
+static void inbox_drop(struct p101_fsm_inbox *inbox);
+static void inbox_idle_result(const struct p101_fsm_inbox *inbox, const struct p101_fsm_info *info, struct p101_fsm_step_result *result);
+static bool inbox_peek(const struct p101_fsm_inbox *inbox, struct p101_fsm_event *event);
+
+struct p101_fsm_inbox *p101_fsm_inbox_create(const struct p101_env *env, struct p101_error *err, size_t capacity)
+{
+    struct p101_fsm_inbox *inbox;
+    size_t                 rounded;
+
+    P101_TRACE(env);
+    P101_WRAPPER_FAULT_RETURN(env, err, inbox, NULL);
+    inbox = NULL;
+    if(capacity == 0U || capacity > (SIZE_MAX / 2U + 1U) / sizeof(struct fsm_inbox_cell))
+    {
+        P101_ERROR_RAISE_USER(err, "FSM inbox capacity is out of range", P101_FSM_ERROR_INVALID_ARGUMENT);
+        goto done;
+    }
+
+    // One slot would leave a published event indistinguishable from a free cell one lap ahead.
+    rounded = 2U;
+    while(rounded < capacity)
+    {
+        rounded <<= 1U;
+    }
+
+    inbox = (struct p101_fsm_inbox *)p101_calloc(env, err, 1U, sizeof(*inbox));
+    if(inbox == NULL)
+    {
+        goto done;
+    }
+    inbox->cells = (struct fsm_inbox_cell *)p101_calloc(env, err, rounded, sizeof(*inbox->cells));
+    if(inbox->cells == NULL)
+    {
+        p101_free(env, inbox);
+        inbox = NULL;
+        goto done;
+    }
+
+    inbox->env  = env;
+    inbox->mask = rounded - 1U;
+    atomic_init(&inbox->tail, 0U);
+    atomic_init(&inbox->head, 0U);
+    for(size_t index = 0U; index < rounded; ++index)
+    {
+        atomic_init(&inbox->cells[index].sequence, index);
+    }
+
+done:
+    P101_WRAPPER_DONE(env);
+    return inbox;
+}
+
+void p101_fsm_inbox_destroy(const struct p101_env *env, struct p101_fsm_inbox **pinbox)
+{
+    P101_TRACE(env);
+    if(pinbox != NULL && *pinbox != NULL)
+    {
+        p101_free((*pinbox)->env, (*pinbox)->cells);
+        p101_free((*pinbox)->env, *pinbox);
+        *pinbox = NULL;
+    }
+    P101_TRACE_EXIT(env);
+}
+
+size_t p101_fsm_inbox_get_capacity(const struct p101_env *env, const struct p101_fsm_inbox *inbox)
+{
+    size_t capacity;
+
+    P101_TRACE(env);
+    capacity = inbox == NULL ? 0U : inbox->mask + 1U;
+    P101_TRACE_EXIT(env);
+    return capacity;
+}
+
+size_t p101_fsm_inbox_count(const struct p101_fsm_inbox *inbox)
+{
+    size_t count;
+
+    count = 0U;
+    if(inbox != NULL)
+    {
+        size_t head;
+
+        // Read head first: it never passes tail, so the difference cannot wrap.
+        head  = atomic_load_explicit(&inbox->head, memory_order_acquire);
+        count = atomic_load_explicit(&inbox->tail, memory_order_acquire) - head;
+    }
+
+    return count;
+}
+
+bool p101_fsm_inbox_post(struct p101_fsm_inbox *inbox, const struct p101_fsm_event *event)
+{
+    struct fsm_inbox_cell *cell;
+    size_t                 position;
+    bool                   claimed;
+    bool                   full;
+
+    claimed = false;
+    if(inbox == NULL || event == NULL)
+    {
+        goto done;
+    }
+
+    cell     = NULL;
+    position = atomic_load_explicit(&inbox->tail, memory_order_relaxed);
+    full     = false;
+    while(!claimed && !full)
+    {
+        size_t sequence;
+
+        cell     = &inbox->cells[position & inbox->mask];
+        sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        if(sequence == position)
+        {
+            // On failure position is reloaded with the current tail.
+            claimed = atomic_compare_exchange_weak_explicit(&inbox->tail, &position, position + 1U, memory_order_relaxed, memory_order_relaxed);
+        }
+        else if(sequence < position)
+        {
+            // The cell still holds the event from one lap ago: the inbox is full.
+            full = true;
+        }
+        else
+        {
+            position = atomic_load_explicit(&inbox->tail, memory_order_relaxed);
+        }
+    }
+
+    if(claimed)
+    {
+        cell->event = *event;
+        atomic_store_explicit(&cell->sequence, position + 1U, memory_order_release);
+    }
+
+done:
+    return claimed;
+}
+
+p101_fsm_step_status p101_fsm_step_event(struct p101_fsm_info *info, struct p101_fsm_inbox *inbox, void *arg, struct p101_fsm_effect_sink *sink, struct p101_fsm_step_result *result)
+{
+    struct p101_fsm_event_context context;
+    p101_fsm_step_status          status;
+
+    context.arg = arg;
+    if(inbox == NULL || info == NULL || result == NULL)
+    {
+        // step reports a missing machine or result; a missing inbox is an error without a raise, as a missing batch is.
+        status = p101_fsm_step(inbox == NULL ? NULL : info, &context, sink, result);
+        goto done;
+    }
+    if(!inbox_peek(inbox, &context.event))
+    {
+        inbox_idle_result(inbox, info, result);
+        status = result->status;
+        goto done;
+    }
+
+    status = p101_fsm_step(info, &context, sink, result);
+    // The event is consumed with the step's commit; a refused or failed step, redirect included, leaves it for the next one.
+    if(status == P101_FSM_STEP_TRANSITIONED || status == P101_FSM_STEP_PAUSED || (status == P101_FSM_STEP_EXITED && result->refusal == P101_FSM_REFUSAL_NONE))
+    {
+        inbox_drop(inbox);
+    }
+
+done:
+    return status;
+}
+
+p101_fsm_run_result p101_fsm_run_events(struct p101_fsm_info *info, struct p101_fsm_inbox *inbox, void *arg, struct p101_fsm_effect_sink *sink, struct p101_fsm_step_result *last_result)
+{
+    const struct p101_env      *env;
+    struct p101_fsm_step_result current;
+    p101_fsm_run_result         run_result;
+    bool                        running;
+
+    env        = inbox == NULL ? NULL : inbox->env;
+    run_result = P101_FSM_RUN_ERROR;
+    P101_TRACE(env);
+    running = true;
+    while(running)
+    {
+        p101_fsm_step_status status;
+
+        status = p101_fsm_step_event(info, inbox, arg, sink, &current);
+        if(last_result != NULL)
+        {
+            *last_result = current;
+        }
+        running = fsm_run_continues(status, &current, true, &run_result) && p101_fsm_inbox_count(inbox) > 0U;
+    }
+
+    P101_TRACE_EXIT(env);
+    return run_result;
+}
+
+static void inbox_drop(struct p101_fsm_inbox *inbox)
+{
+    size_t head;
+
+    head = atomic_load_explicit(&inbox->head, memory_order_relaxed);
+    atomic_store_explicit(&inbox->cells[head & inbox->mask].sequence, head + inbox->mask + 1U, memory_order_release);
+    atomic_store_explicit(&inbox->head, head + 1U, memory_order_release);
+}
+
+// An empty inbox runs nothing: the machine reports its current state, or that it has exited, without a new sequence number.
+static void inbox_idle_result(const struct p101_fsm_inbox *inbox, const struct p101_fsm_info *info, struct p101_fsm_step_result *result)
+{
+    p101_fsm_state_id state_id;
+
+    state_id                = p101_fsm_info_get_current_state(inbox->env, info);
+    result->status          = P101_FSM_STEP_PAUSED;
+    result->sequence        = p101_fsm_info_get_step_sequence(inbox->env, info);
+    result->from_state      = state_id;
+    result->attempted_state = state_id;
+    result->next_state      = state_id;
+    result->refusal         = P101_FSM_REFUSAL_NONE;
+    if(p101_fsm_info_is_terminal(inbox->env, info))
+    {
+        result->status     = P101_FSM_STEP_EXITED;
+        result->next_state = P101_FSM_STATE_NONE;
+        result->refusal    = P101_FSM_REFUSAL_TERMINAL_MACHINE;
+    }
+}
+
+static bool inbox_peek(const struct p101_fsm_inbox *inbox, struct p101_fsm_event *event)
+{
+    const struct fsm_inbox_cell *cell;
+    size_t                       head;
+    bool                         available;
+
+    head      = atomic_load_explicit(&inbox->head, memory_order_relaxed);
+    cell      = &inbox->cells[head & inbox->mask];
+    available = atomic_load_explicit(&cell->sequence, memory_order_acquire) == head + 1U;
+    if(available)
+    {
+        *event = cell->event;
+    }
+
+    return available;
+}
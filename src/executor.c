@@ -0,0 +1,548 @@
+/*
+ * Copyright 2021-2026 D'Arcy Smith.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "p101_fsm/errors.h"
+#include "p101_fsm/fsm.h"
+#include <p101_c/p101_stdlib.h>
+#include <p101_env/wrapper.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * A task moves IDLE -> QUEUED when scheduled, QUEUED -> RUNNING when a worker
+ * takes it, and RUNNING -> IDLE when its run returns. Scheduling a running
+ * task marks it RESCHEDULED instead, and the worker queues it again once the
+ * run returns. Only the worker that took a QUEUED task runs it, so a machine
+ * is never stepped by two threads at once.
+ */
+enum fsm_task_state
+{
+    FSM_TASK_IDLE,
+    FSM_TASK_QUEUED,
+    FSM_TASK_RUNNING,
+    FSM_TASK_RESCHEDULED,
+};
+
+struct p101_fsm_task
+{
+    struct p101_fsm_task        *newer;
+    struct p101_fsm_task        *older;
+    struct p101_fsm_info        *info;
+    struct p101_fsm_inbox       *inbox;
+    void                        *arg;
+    struct p101_fsm_effect_sink *sink;
+    const struct p101_env       *env;
+    atomic_int                   state;
+    atomic_int                   result;
+};
+
+/*
+ * Each worker owns a deque of queued tasks linked through the tasks
+ * themselves. The owner pushes and pops at the newest end; other workers
+ * steal from the oldest end.
+ */
+struct fsm_worker
+{
+    pthread_mutex_t           lock;
+    struct p101_fsm_task     *newest;
+    struct p101_fsm_task     *oldest;
+    struct p101_fsm_executor *executor;
+    size_t                    index;
+    pthread_t                 thread;
+};
+
+/*
+ * queued counts tasks sitting in deques and pending counts tasks queued or
+ * running. Idle workers sleep on work and wait() sleeps on idle, both under
+ * lock; sleepers lets a scheduler skip the lock when no worker is asleep.
+ */
+struct p101_fsm_executor
+{
+    const struct p101_env *env;
+    struct fsm_worker     *workers;
+    size_t                 worker_count;
+    size_t                 started;
+    atomic_size_t          next_worker;
+    atomic_size_t          queued;
+    atomic_size_t          pending;
+    atomic_size_t          sleepers;
+    atomic_bool            stopping;
+    pthread_mutex_t        lock;
+    pthread_cond_t         work;
+    pthread_cond_t         idle;
+};
+
+static void                  executor_stop(struct p101_fsm_executor *executor);
+static struct p101_fsm_task *executor_task_create(const struct p101_env *env, struct p101_error *err, struct p101_fsm_info *info, struct p101_fsm_inbox *inbox, void *arg, struct p101_fsm_effect_sink *sink);
+static void                  executor_push(struct p101_fsm_executor *executor, struct fsm_worker *worker, struct p101_fsm_task *task);
+static struct p101_fsm_task *executor_take(struct p101_fsm_executor *executor, const struct fsm_worker *worker);
+static struct p101_fsm_task *worker_pop_newest(struct fsm_worker *worker);
+static struct p101_fsm_task *worker_pop_oldest(struct fsm_worker *worker);
+static void                  worker_run_task(struct fsm_worker *worker, struct p101_fsm_task *task);
+static void                 *worker_main(void *arg);
+
+struct p101_fsm_executor *p101_fsm_executor_create(const struct p101_env *env, struct p101_error *err, size_t worker_count)
+{
+    struct p101_fsm_executor *executor;
+    int                       status;
+
+    P101_TRACE(env);
+    P101_WRAPPER_FAULT_RETURN(env, err, executor, NULL);
+    executor = NULL;
+    if(worker_count == 0U)
+    {
+        P101_ERROR_RAISE_USER(err, "FSM executor requires at least one worker", P101_FSM_ERROR_INVALID_ARGUMENT);
+        goto done;
+    }
+
+    executor = (struct p101_fsm_executor *)p101_calloc(env, err, 1U, sizeof(*executor));
+    if(executor == NULL)
+    {
+        goto done;
+    }
+    executor->workers = (struct fsm_worker *)p101_calloc(env, err, worker_count, sizeof(*executor->workers));
+    if(executor->workers == NULL)
+    {
+        p101_free(env, executor);
+        executor = NULL;
+        goto done;
+    }
+
+    executor->env          = env;
+    executor->worker_count = worker_count;
+    atomic_init(&executor->next_worker, 0U);
+    atomic_init(&executor->queued, 0U);
+    atomic_init(&executor->pending, 0U);
+    atomic_init(&executor->sleepers, 0U);
+    atomic_init(&executor->stopping, false);
+    pthread_mutex_init(&executor->lock, NULL);
+    pthread_cond_init(&executor->work, NULL);
+    pthread_cond_init(&executor->idle, NULL);
+    for(size_t index = 0U; index < worker_count; ++index)
+    {
+        pthread_mutex_init(&executor->workers[index].lock, NULL);
+        executor->workers[index].executor = executor;
+        executor->workers[index].index    = index;
+    }
+
+    for(size_t index = 0U; index < worker_count; ++index)
+    {
+        status = pthread_create(&executor->workers[index].thread, NULL, worker_main, &executor->workers[index]);
+        if(status != 0)
+        {
+            P101_ERROR_RAISE_ERRNO(err, status);
+            executor_stop(executor);
+            executor = NULL;
+            goto done;
+        }
+        executor->started++;
+    }
+
+done:
+    P101_WRAPPER_DONE(env);
+    return executor;
+}
+
+void p101_fsm_executor_destroy(const struct p101_env *env, struct p101_error *err, struct p101_fsm_executor **pexecutor)
+{
+    P101_TRACE(env);
+    P101_WRAPPER_FAULT_RETURN_VOID(env, err);
+    if(pexecutor == NULL || *pexecutor == NULL)
+    {
+        goto done;
+    }
+
+    p101_fsm_executor_wait(env, *pexecutor);
+    executor_stop(*pexecutor);
+    *pexecutor = NULL;
+
+done:
+    P101_WRAPPER_DONE(env);
+}
+
+int p101_fsm_executor_schedule(const struct p101_env *env, struct p101_error *err, struct p101_fsm_executor *executor, struct p101_fsm_task *task)
+{
+    int  result;
+    bool settled;
+
+    P101_TRACE(env);
+    P101_WRAPPER_FAULT_RETURN(env, err, result, -1);
+    result = -1;
+    if(executor == NULL || task == NULL)
+    {
+        P101_ERROR_RAISE_USER(err, "FSM executor and task cannot be NULL", P101_FSM_ERROR_INVALID_ARGUMENT);
+        goto done;
+    }
+
+    // A task driven by an inbox has nothing to run until an event arrives.
+    settled = task->inbox != NULL && p101_fsm_inbox_count(task->inbox) == 0U;
+    while(!settled)
+    {
+        int state;
+
+        state = atomic_load(&task->state);
+        if(state == FSM_TASK_IDLE)
+        {
+            settled = atomic_compare_exchange_weak(&task->state, &state, FSM_TASK_QUEUED);
+            if(settled)
+            {
+                size_t next;
+
+                atomic_fetch_add(&executor->pending, 1U);
+                next = atomic_fetch_add(&executor->next_worker, 1U);
+                executor_push(executor, &executor->workers[next % executor->worker_count], task);
+            }
+        }
+        else if(state == FSM_TASK_RUNNING)
+        {
+            settled = atomic_compare_exchange_weak(&task->state, &state, FSM_TASK_RESCHEDULED);
+        }
+        else
+        {
+            // Already queued or already due to run again: the pending run will see the new work.
+            settled = true;
+        }
+    }
+    result = 0;
+
+done:
+    P101_WRAPPER_DONE(env);
+    return result;
+}
+
+int p101_fsm_executor_post(const struct p101_env *env, struct p101_error *err, struct p101_fsm_executor *executor, struct p101_fsm_task *task, const struct p101_fsm_event *event)
+{
+    int result;
+
+    P101_TRACE(env);
+    P101_WRAPPER_FAULT_RETURN(env, err, result, -1);
+    result = -1;
+    if(executor == NULL || task == NULL || task->inbox == NULL || event == NULL)
+    {
+        P101_ERROR_RAISE_USER(err, "FSM executor post requires an executor, a task with an inbox, and an event", P101_FSM_ERROR_INVALID_ARGUMENT);
+        goto done;
+    }
+    if(!p101_fsm_inbox_post(task->inbox, event))
+    {
+        P101_ERROR_RAISE_USER(err, "FSM task inbox is full", P101_FSM_ERROR_INBOX_FULL);
+        goto done;
+    }
+
+    result = p101_fsm_executor_schedule(env, err, executor, task);
+
+done:
+    P101_WRAPPER_DONE(env);
+    return result;
+}
+
+void p101_fsm_executor_wait(const struct p101_env *env, struct p101_fsm_executor *executor)
+{
+    P101_TRACE(env);
+    if(executor != NULL)
+    {
+        pthread_mutex_lock(&executor->lock);
+        while(atomic_load(&executor->pending) != 0U)
+        {
+            pthread_cond_wait(&executor->idle, &executor->lock);
+        }
+        pthread_mutex_unlock(&executor->lock);
+    }
+    P101_TRACE_EXIT(env);
+}
+
+struct p101_fsm_task *p101_fsm_task_create(const struct p101_env *env, struct p101_error *err, struct p101_fsm_info *info, void *arg, struct p101_fsm_effect_sink *sink)
+{
+    struct p101_fsm_task *task;
+    bool                  error_present;
+
+    P101_TRACE(env);
+    P101_WRAPPER_FAULT_RETURN(env, err, task, NULL);
+    task          = NULL;
+    error_present = p101_error_has_error(err);
+    if(error_present)
+    {
+        goto done;
+    }
+    task = executor_task_create(env, err, info, NULL, arg, sink);
+
+done:
+    P101_WRAPPER_DONE(env);
+    return task;
+}
+
+struct p101_fsm_task *p101_fsm_task_create_with_inbox(const struct p101_env *env, struct p101_error *err, struct p101_fsm_info *info, struct p101_fsm_inbox *inbox, void *arg, struct p101_fsm_effect_sink *sink)
+{
+    struct p101_fsm_task *task;
+    bool                  error_present;
+
+    P101_TRACE(env);
+    P101_WRAPPER_FAULT_RETURN(env, err, task, NULL);
+    task          = NULL;
+    error_present = p101_error_has_error(err);
+    if(error_present)
+    {
+        goto done;
+    }
+    if(inbox == NULL)
+    {
+        P101_ERROR_RAISE_USER(err, "FSM task inbox cannot be NULL", P101_FSM_ERROR_INVALID_ARGUMENT);
+        goto done;
+    }
+    task = executor_task_create(env, err, info, inbox, arg, sink);
+
+done:
+    P101_WRAPPER_DONE(env);
+    return task;
+}
+
+void p101_fsm_task_destroy(const struct p101_env *env, struct p101_error *err, struct p101_fsm_task **ptask)
+{
+    P101_TRACE(env);
+    P101_WRAPPER_FAULT_RETURN_VOID(env, err);
+    if(ptask == NULL || *ptask == NULL)
+    {
+        goto done;
+    }
+    if(atomic_load(&(*ptask)->state) != FSM_TASK_IDLE)
+    {
+        P101_ERROR_RAISE_USER(err, "Cannot destroy a scheduled FSM task", P101_FSM_ERROR_REENTRANT_OPERATION);
+        goto done;
+    }
+
+    p101_free((*ptask)->env, *ptask);
+    *ptask = NULL;
+
+done:
+    P101_WRAPPER_DONE(env);
+}
+
+p101_fsm_run_result p101_fsm_task_get_result(const struct p101_env *env, const struct p101_fsm_task *task)
+{
+    p101_fsm_run_result result;
+
+    P101_TRACE(env);
+    result = task == NULL ? P101_FSM_RUN_ERROR : (p101_fsm_run_result)atomic_load(&task->result);
+    P101_TRACE_EXIT(env);
+    return result;
+}
+
+// Joins every started worker and releases the executor. The caller has already drained it, or no task was ever queued.
+static void executor_stop(struct p101_fsm_executor *executor)
+{
+    pthread_mutex_lock(&executor->lock);
+    atomic_store(&executor->stopping, true);
+    pthread_cond_broadcast(&executor->work);
+    pthread_mutex_unlock(&executor->lock);
+    for(size_t index = 0U; index < executor->started; ++index)
+    {
+        pthread_join(executor->workers[index].thread, NULL);
+    }
+    for(size_t index = 0U; index < executor->worker_count; ++index)
+    {
+        pthread_mutex_destroy(&executor->workers[index].lock);
+    }
+    pthread_cond_destroy(&executor->idle);
+    pthread_cond_destroy(&executor->work);
+    pthread_mutex_destroy(&executor->lock);
+    p101_free(executor->env, executor->workers);
+    p101_free(executor->env, executor);
+}
+
+static struct p101_fsm_task *executor_task_create(const struct p101_env *env, struct p101_error *err, struct p101_fsm_info *info, struct p101_fsm_inbox *inbox, void *arg, struct p101_fsm_effect_sink *sink)
+{
+    struct p101_fsm_task *task;
+
+    task = NULL;
+    if(info == NULL)
+    {
+        P101_ERROR_RAISE_USER(err, "FSM task machine cannot be NULL", P101_FSM_ERROR_INVALID_ARGUMENT);
+        goto done;
+    }
+
+    task = (struct p101_fsm_task *)p101_calloc(env, err, 1U, sizeof(*task));
+    if(task == NULL)
+    {
+        goto done;
+    }
+    task->info  = info;
+    task->inbox = inbox;
+    task->arg   = arg;
+    task->sink  = sink;
+    task->env   = env;
+    atomic_init(&task->state, FSM_TASK_IDLE);
+    atomic_init(&task->result, P101_FSM_RUN_PAUSED);
+
+done:
+    return task;
+}
+
+static void executor_push(struct p101_fsm_executor *executor, struct fsm_worker *worker, struct p101_fsm_task *task)
+{
+    pthread_mutex_lock(&worker->lock);
+    task->older = worker->newest;
+    task->newer = NULL;
+    if(worker->newest != NULL)
+    {
+        worker->newest->newer = task;
+    }
+    else
+    {
+        worker->oldest = task;
+    }
+    worker->newest = task;
+    atomic_fetch_add(&executor->queued, 1U);
+    pthread_mutex_unlock(&worker->lock);
+
+    if(atomic_load(&executor->sleepers) != 0U)
+    {
+        pthread_mutex_lock(&executor->lock);
+        pthread_cond_signal(&executor->work);
+        pthread_mutex_unlock(&executor->lock);
+    }
+}
+
+// Takes the newest task from the worker's own deque, otherwise steals the oldest task of another worker.
+static struct p101_fsm_task *executor_take(struct p101_fsm_executor *executor, const struct fsm_worker *worker)
+{
+    struct p101_fsm_task *task;
+
+    task = worker_pop_newest(&executor->workers[worker->index]);
+    for(size_t offset = 1U; task == NULL && offset < executor->worker_count; ++offset)
+    {
+        task = worker_pop_oldest(&executor->workers[(worker->index + offset) % executor->worker_count]);
+    }
+    if(task != NULL)
+    {
+        atomic_fetch_sub(&executor->queued, 1U);
+    }
+
+    return task;
+}
+
+static struct p101_fsm_task *worker_pop_newest(struct fsm_worker *worker)
+{
+    struct p101_fsm_task *task;
+
+    pthread_mutex_lock(&worker->lock);
+    task = worker->newest;
+    if(task != NULL)
+    {
+        worker->newest = task->older;
+        if(worker->newest != NULL)
+        {
+            worker->newest->newer = NULL;
+        }
+        else
+        {
+            worker->oldest = NULL;
+        }
+    }
+    pthread_mutex_unlock(&worker->lock);
+
+    return task;
+}
+
+static struct p101_fsm_task *worker_pop_oldest(struct fsm_worker *worker)
+{
+    struct p101_fsm_task *task;
+
+    pthread_mutex_lock(&worker->lock);
+    task = worker->oldest;
+    if(task != NULL)
+    {
+        worker->oldest = task->newer;
+        if(worker->oldest != NULL)
+        {
+            worker->oldest->older = NULL;
+        }
+        else
+        {
+            worker->newest = NULL;
+        }
+    }
+    pthread_mutex_unlock(&worker->lock);
+
+    return task;
+}
+
+static void worker_run_task(struct fsm_worker *worker, struct p101_fsm_task *task)
+{
+    struct p101_fsm_executor *executor;
+    p101_fsm_run_result       result;
+    int                       expected;
+
+    executor = worker->executor;
+    atomic_store(&task->state, FSM_TASK_RUNNING);
+    if(task->inbox == NULL)
+    {
+        result = p101_fsm_run(task->info, task->arg, task->sink, NULL);
+    }
+    else
+    {
+        result = p101_fsm_run_events(task->info, task->inbox, task->arg, task->sink, NULL);
+    }
+    atomic_store(&task->result, (int)result);
+
+    expected = FSM_TASK_RUNNING;
+    if(!atomic_compare_exchange_strong(&task->state, &expected, FSM_TASK_IDLE))
+    {
+        // Scheduled while running: it stays pending and runs again, from this worker's deque.
+        atomic_store(&task->state, FSM_TASK_QUEUED);
+        executor_push(executor, worker, task);
+    }
+    else if(atomic_fetch_sub(&executor->pending, 1U) == 1U)
+    {
+        pthread_mutex_lock(&executor->lock);
+        pthread_cond_broadcast(&executor->idle);
+        pthread_mutex_unlock(&executor->lock);
+    }
+}
+
+static void *worker_main(void *arg)
+{
+    struct fsm_worker        *worker;
+    struct p101_fsm_executor *executor;
+    bool                      stopping;
+
+    worker   = (struct fsm_worker *)arg;
+    executor = worker->executor;
+    stopping = false;
+    while(!stopping)
+    {
+        struct p101_fsm_task *task;
+
+        task = executor_take(executor, worker);
+        if(task != NULL)
+        {
+            worker_run_task(worker, task);
+            continue;
+        }
+
+        pthread_mutex_lock(&executor->lock);
+        atomic_fetch_add(&executor->sleepers, 1U);
+        while(atomic_load(&executor->queued) == 0U && !atomic_load(&executor->stopping))
+        {
+            pthread_cond_wait(&executor->work, &executor->lock);
+        }
+        atomic_fetch_sub(&executor->sleepers, 1U);
+        stopping = atomic_load(&executor->stopping) && atomic_load(&executor->queued) == 0U;
+        pthread_mutex_unlock(&executor->lock);
+    }
+
+    return NULL;
+}
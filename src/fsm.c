@@ -16,6 +16,8 @@
 
 #include "p101_fsm/fsm.h"
 #include "p101_fsm/errors.h"
+#include "hot_path.h"
+#include "run_loop.h"
 #include <p101_c/p101_stdio.h>
 #include <p101_c/p101_stdlib.h>
 #include <p101_c/p101_string.h>
@@ -30,75 +32,280 @@
 #include <p101_text/p101_wctype.h>
 #include <p101_text/p101_wordexp.h>
 #include <p101_transition/transition.h>
+#include <stdatomic.h>
+#include <stddef.h>
 #include <stdint.h>
+#include <time.h>
+
+static void                 fsm_complete_step(struct p101_fsm_info *info, struct p101_fsm_step_result *result, bool started);
+static bool                 fsm_deadline_passed(const struct timespec *deadline);
+static bool                 fsm_has_error(const struct p101_error *app_err, const struct p101_error *fsm_err);
+static const char          *fsm_info_name_or_default(const struct p101_fsm_info *info);
+static void                 fsm_prepare_result(struct p101_fsm_step_result *result);
+static p101_fsm_step_status fsm_step(struct p101_fsm_info *info, void *arg, struct p101_fsm_effect_sink *sink, struct p101_fsm_step_result *result);
+static p101_fsm_step_status fsm_step_plain(struct p101_fsm_info *info, void *arg, struct p101_fsm_effect_sink *sink, struct p101_fsm_step_result *result);
+static void                 fsm_step_prefetch(const struct p101_fsm_info *info);
+
+struct fsm_csr_edge
+{
+    p101_fsm_state_id   to_id;
+    p101_fsm_state_func perform;
+};
 
-static void                fsm_complete_step(struct p101_fsm_info *info, struct p101_fsm_step_result *result, bool started);
-static bool                fsm_has_error(const struct p101_error *app_err, const struct p101_error *fsm_err);
-static const char         *fsm_info_name_or_default(const struct p101_fsm_info *info);
-static void                fsm_prepare_result(struct p101_fsm_step_result *result);
-static p101_fsm_state_func fsm_transition(const struct p101_fsm_info *info, p101_fsm_state_id from_id, p101_fsm_state_id to_id);
+struct fsm_perfect_slot
+{
+    p101_fsm_state_id   from_id;
+    p101_fsm_state_id   to_id;
+    p101_fsm_state_func perform;
+};
 
+/*
+ * Exactly one index is populated: dense holds a dense_span x dense_span
+ * performer matrix indexed by [from][to]; csr_offsets holds csr_span + 1 row
+ * bounds into csr_edges, indexed by source state; perfect_seeds holds one
+ * displacement per bucket selecting each key's unique perfect_slots entry;
+ * otherwise rules, performers, and slots back the open-addressed table.
+ */
 struct p101_fsm_transition_map
 {
+    p101_fsm_transition_index    index;
+    size_t                       transition_count;
+    size_t                       dense_span;
+    p101_fsm_state_func         *dense;
+    size_t                       csr_span;
+    size_t                      *csr_offsets;
+    struct fsm_csr_edge         *csr_edges;
+    uint32_t                    *perfect_seeds;
+    struct fsm_perfect_slot     *perfect_slots;
     struct p101_transition_rule *rules;
     p101_fsm_state_func         *performers;
     struct p101_transition_slot *slots;
     struct p101_transition_table table;
 };
 
-static int                    fsm_transition_map_create(const struct p101_env *env, struct p101_error *err, const struct p101_fsm_transition transitions[], size_t transition_count, struct p101_fsm_transition_map *map, p101_fsm_state_id *initial_state);
-static void                   fsm_transition_map_destroy(const struct p101_env *env, struct p101_fsm_transition_map *map);
-static p101_transition_status fsm_transition_map_lookup(const struct p101_fsm_info *info, p101_fsm_state_id from_id, p101_fsm_state_id to_id, struct p101_transition_result *result);
+/*
+ * Caller-provided storage that objects are carved from in allocation order.
+ * A NULL storage pointer means every allocation goes to the heap instead.
+ */
+struct fsm_storage
+{
+    unsigned char *base;
+    size_t         size;
+    size_t         used;
+};
+
+struct fsm_table_summary
+{
+    size_t            initial_count;
+    p101_fsm_state_id initial_state;
+    size_t            invalid_index;
+    size_t            span;
+    size_t            from_span;
+};
+
+static const size_t   FSM_DENSE_MAXIMUM_SPAN         = 64U;
+static const size_t   FSM_DENSE_CELLS_PER_TRANSITION = 16U;
+static const size_t   FSM_CSR_ROWS_PER_TRANSITION    = 4U;
+static const uint32_t FSM_PERFECT_HASH_MAXIMUM_SEED  = UINT32_C(1) << 20U;
+
+static void *fsm_storage_allocate(const struct p101_env *env, struct p101_error *err, struct fsm_storage *storage, size_t count, size_t size, size_t align);
+static void  fsm_storage_free(const struct p101_env *env, const struct fsm_storage *storage, void *memory);
+static bool  fsm_storage_reserve(size_t *total, size_t count, size_t size, size_t align);
+
+static int                       fsm_transition_map_create(const struct p101_env *env, struct p101_error *err, struct fsm_storage *storage, const struct p101_fsm_transition transitions[], size_t transition_count, p101_fsm_transition_index index,
+                                                           struct p101_fsm_transition_map *map, p101_fsm_state_id *initial_state);
+static bool                      fsm_transition_table_scan(const struct p101_fsm_transition transitions[], size_t transition_count, struct fsm_table_summary *summary);
+static p101_fsm_transition_index fsm_transition_map_select(p101_fsm_transition_index index, size_t transition_count, const struct fsm_table_summary *summary);
+static size_t                    fsm_transition_map_storage_size(const struct p101_fsm_transition transitions[], size_t transition_count, size_t offset);
+static int                       fsm_transition_map_build_dense(const struct p101_env *env, struct p101_error *err, struct fsm_storage *storage, const struct p101_fsm_transition transitions[], size_t span, struct p101_fsm_transition_map *map);
+static int                       fsm_transition_map_build_csr(const struct p101_env *env, struct p101_error *err, struct fsm_storage *storage, const struct p101_fsm_transition transitions[], size_t span, struct p101_fsm_transition_map *map);
+static int                       fsm_transition_map_build_perfect(const struct p101_env *env, struct p101_error *err, struct fsm_storage *storage, const struct p101_fsm_transition transitions[], struct p101_fsm_transition_map *map);
+static uint64_t                  fsm_perfect_hash(p101_fsm_state_id from_id, p101_fsm_state_id to_id, uint32_t seed);
+static size_t                    fsm_transition_map_find_perfect(const struct p101_fsm_transition_map *map, p101_fsm_state_id from_id, p101_fsm_state_id to_id);
+static size_t                    fsm_transition_map_find_csr(const struct p101_fsm_transition_map *map, p101_fsm_state_id from_id, p101_fsm_state_id to_id, size_t *scanned);
+static int                       fsm_transition_map_build_hash(const struct p101_env *env, struct p101_error *err, struct fsm_storage *storage, const struct p101_fsm_transition transitions[], struct p101_fsm_transition_map *map);
+static void                      fsm_transition_map_destroy(const struct p101_env *env, const struct fsm_storage *storage, struct p101_fsm_transition_map *map);
+static p101_fsm_state_func       fsm_transition(const struct p101_fsm_transition_map *map, p101_fsm_state_id from_id, p101_fsm_state_id to_id);
+static p101_transition_status    fsm_transition_map_lookup(const struct p101_fsm_transition_map *map, p101_fsm_state_id from_id, p101_fsm_state_id to_id, struct p101_transition_result *result);
+
+/*
+ * The immutable part of a machine. Every machine created from a definition
+ * holds one reference; the definition is freed with the env that created it
+ * when the last reference is released, unless it lives in caller storage.
+ * Only the reference count is written after construction, so definitions
+ * may be shared between threads.
+ */
+struct p101_fsm_definition
+{
+    struct p101_fsm_transition_map transitions;
+    p101_fsm_state_id              initial_state;
+    bool                           owns_storage;
+    const struct p101_env         *env;
+    char                          *name;
+    atomic_size_t                  references;
+};
+
+static struct p101_fsm_definition *fsm_definition_create(const struct p101_env *env, struct p101_error *err, struct fsm_storage *storage, const char *name, const struct p101_fsm_transition transitions[], size_t transition_count,
+                                                         p101_fsm_transition_index index);
+static size_t                      fsm_definition_storage_size(const struct p101_env *env, const char *name, const struct p101_fsm_transition transitions[], size_t transition_count, size_t offset);
+static void                        fsm_definition_retain(struct p101_fsm_definition *definition);
+static void                        fsm_definition_release(struct p101_fsm_definition *definition);
+
+typedef p101_fsm_step_status (*fsm_step_func)(struct p101_fsm_info *info, void *arg, struct p101_fsm_effect_sink *sink, struct p101_fsm_step_result *result);
 
+/*
+ * current_perform is the performer for (from_state_id, current_state_id). It
+ * is resolved whenever that pair changes, so a step, including a retry after
+ * a pause, dispatches without a transition lookup. step is the step body for
+ * the hooks currently set; see fsm_info_select_step(). Fields read on every
+ * step come first; hooks and borrowed contexts used only on slower paths
+ * follow.
+ */
 struct p101_fsm_info
 {
-    const struct p101_env                        *app_env;
-    struct p101_error                            *app_err;
-    char                                         *name;
-    const struct p101_env                        *fsm_env;
-    struct p101_error                            *fsm_err;
-    struct p101_fsm_transition_map                transitions;
+    p101_fsm_state_func                           current_perform;
+    fsm_step_func                                 step;
     p101_fsm_state_id                             from_state_id;
     p101_fsm_state_id                             current_state_id;
     size_t                                        sequence;
     size_t                                        redirect_count;
+    bool                                          terminal;
+    bool                                          operating;
+    bool                                          notifying;
+    bool                                          owns_storage;
+    struct p101_error                            *app_err;
+    struct p101_error                            *fsm_err;
+    struct p101_fsm_definition                   *definition;
+    const struct p101_env                        *app_env;
+    const struct p101_env                        *fsm_env;
     p101_fsm_info_will_change_state_notifier_func will_change_state_notifier;
     p101_fsm_info_did_change_state_notifier_func  did_change_state_notifier;
     p101_fsm_info_bad_change_state_notifier_func  bad_change_state_notifier;
     p101_fsm_info_bad_change_state_handler_func   bad_change_state_handler;
     p101_fsm_step_observer_func                   step_observer;
     void                                         *step_observer_data;
-    bool                                          terminal;
-    bool                                          operating;
-    bool                                          notifying;
 };
 
+/*
+ * Session state is stored column-wise so a sweep reads each array front to
+ * back. flags packs FSM_POOL_TERMINAL and FSM_POOL_OPERATING per session;
+ * operating counts sessions inside a callback so destroy can refuse.
+ */
+struct p101_fsm_pool
+{
+    size_t                      capacity;
+    p101_fsm_state_id          *current_states;
+    p101_fsm_state_id          *from_states;
+    size_t                     *sequences;
+    unsigned char              *flags;
+    size_t                      operating;
+    struct p101_fsm_definition *definition;
+    struct p101_error          *app_err;
+    struct p101_error          *fsm_err;
+    const struct p101_env      *app_env;
+    const struct p101_env      *fsm_env;
+};
+
+static const unsigned char FSM_POOL_TERMINAL  = 0x01U;
+static const unsigned char FSM_POOL_OPERATING = 0x02U;
+
+static p101_fsm_step_status fsm_pool_step(struct p101_fsm_pool *pool, size_t session, void *arg, struct p101_fsm_effect_sink *sink, struct p101_fsm_step_result *result);
+static bool                 fsm_pool_layout(size_t capacity, size_t *size);
+
+static struct p101_fsm_info *fsm_info_create(const struct p101_env *env, struct p101_error *err, struct fsm_storage *storage, struct p101_fsm_definition *definition, const struct p101_env *fsm_env, struct p101_error *fsm_err,
+                                             p101_fsm_info_bad_change_state_handler_func handler);
+static void                  fsm_info_select_step(struct p101_fsm_info *info);
+static bool                  fsm_storage_open(struct p101_error *err, struct fsm_storage *storage, void *memory, size_t size);
+
+struct p101_fsm_definition *p101_fsm_definition_create(const struct p101_env *env, struct p101_error *err, const char *name, const struct p101_fsm_transition transitions[], size_t transition_count)
+{
+    struct p101_fsm_definition *definition;
+    bool                        error_present;
+
+    P101_TRACE(env);
+    P101_WRAPPER_FAULT_RETURN(env, err, definition, NULL);
+    definition    = NULL;
+    error_present = p101_error_has_error(err);
+    if(error_present)
+    {
+        goto done;
+    }
+    definition = fsm_definition_create(env, err, NULL, name, transitions, transition_count, P101_FSM_TRANSITION_INDEX_AUTOMATIC);
+
+done:
+    P101_WRAPPER_DONE(env);
+    return definition;
+}
+
+struct p101_fsm_definition *p101_fsm_definition_create_with_index(const struct p101_env *env, struct p101_error *err, const char *name, const struct p101_fsm_transition transitions[], size_t transition_count, p101_fsm_transition_index index)
+{
+    struct p101_fsm_definition *definition;
+    bool                        error_present;
+
+    P101_TRACE(env);
+    P101_WRAPPER_FAULT_RETURN(env, err, definition, NULL);
+    definition    = NULL;
+    error_present = p101_error_has_error(err);
+    if(error_present)
+    {
+        goto done;
+    }
+    definition = fsm_definition_create(env, err, NULL, name, transitions, transition_count, index);
+
+done:
+    P101_WRAPPER_DONE(env);
+    return definition;
+}
+
+void p101_fsm_definition_destroy(const struct p101_env *env, struct p101_fsm_definition **pdefinition)
+{
+    P101_TRACE(env);
+    if(pdefinition != NULL && *pdefinition != NULL)
+    {
+        fsm_definition_release(*pdefinition);
+        *pdefinition = NULL;
+    }
+    P101_TRACE_EXIT(env);
+}
+
+const char *p101_fsm_definition_get_name(const struct p101_env *env, const struct p101_fsm_definition *definition)
+{
+    const char *name;
+
+    P101_TRACE(env);
+    name = definition == NULL ? NULL : definition->name;
+    P101_TRACE_EXIT(env);
+    return name;
+}
+
+p101_fsm_transition_index p101_fsm_definition_get_transition_index(const struct p101_env *env, const struct p101_fsm_definition *definition)
+{
+    p101_fsm_transition_index index;
+
+    P101_TRACE(env);
+    index = definition == NULL ? P101_FSM_TRANSITION_INDEX_HASH : definition->transitions.index;
+    P101_TRACE_EXIT(env);
+    return index;
+}
+
 struct p101_fsm_info *p101_fsm_info_create(const struct p101_env *env, struct p101_error *err, const char *name, const struct p101_env *fsm_env, struct p101_error *fsm_err, const struct p101_fsm_transition transitions[], size_t transition_count,
                                            p101_fsm_info_bad_change_state_handler_func handler)
 {
-    const struct p101_env         *target_env;
-    struct p101_error             *target_err;
-    struct p101_fsm_info          *info;
-    struct p101_fsm_transition_map transition_map;
-    p101_fsm_state_id              initial_state;
-    bool                           primary_error_present;
-    bool                           target_error_present;
-    int                            map_created;
-    void                          *info_storage;
+    const struct p101_env      *target_env;
+    struct p101_error          *target_err;
+    struct p101_fsm_info       *info;
+    struct p101_fsm_definition *definition;
+    struct fsm_storage          region;
+    void                       *block;
+    size_t                      size;
+    bool                        primary_error_present;
+    bool                        target_error_present;
 
     P101_TRACE(env);
     P101_WRAPPER_FAULT_RETURN(env, err, info, NULL);
-    target_env                      = fsm_env == NULL ? env : fsm_env;
-    target_err                      = fsm_err == NULL ? err : fsm_err;
-    info                            = NULL;
-    transition_map.rules            = NULL;
-    transition_map.performers       = NULL;
-    transition_map.slots            = NULL;
-    transition_map.table.rules      = NULL;
-    transition_map.table.slots      = NULL;
-    transition_map.table.rule_count = 0U;
-    transition_map.table.capacity   = 0U;
-    initial_state                   = P101_FSM_STATE_NONE;
+    target_env = fsm_env == NULL ? env : fsm_env;
+    target_err = fsm_err == NULL ? err : fsm_err;
+    info       = NULL;
 
     primary_error_present = p101_error_has_error(err);
     target_error_present  = p101_error_has_error(target_err);
@@ -107,49 +314,191 @@ struct p101_fsm_info *p101_fsm_info_create(const struct p101_env *env, struct p1
         goto done;
     }
 
-    if(name == NULL)
+    /*
+     * The machine, its private definition, the name, and the index arrays
+     * share one block laid out in that order, so the step path stays within
+     * one allocation. A table that cannot be sized is invalid; building it on
+     * the heap reports why.
+     */
+    size = fsm_definition_storage_size(target_env, name, transitions, transition_count, sizeof(struct p101_fsm_info));
+    if(size == 0U)
     {
-        P101_ERROR_RAISE_USER(target_err, "FSM name cannot be NULL", P101_FSM_ERROR_INVALID_ARGUMENT);
+        definition = fsm_definition_create(target_env, target_err, NULL, name, transitions, transition_count, P101_FSM_TRANSITION_INDEX_AUTOMATIC);
+        if(definition == NULL)
+        {
+            goto done;
+        }
+        info = fsm_info_create(env, err, NULL, definition, target_env, target_err, handler);
+        fsm_definition_release(definition);
         goto done;
     }
 
-    map_created = fsm_transition_map_create(target_env, target_err, transitions, transition_count, &transition_map, &initial_state);
-    if(!map_created)
+    block = p101_calloc(target_env, target_err, 1U, size);
+    if(block == NULL)
+    {
+        goto done;
+    }
+    region.base = (unsigned char *)block;
+    region.size = size;
+    region.used = sizeof(struct p101_fsm_info);
+    definition  = fsm_definition_create(target_env, target_err, &region, name, transitions, transition_count, P101_FSM_TRANSITION_INDEX_AUTOMATIC);
+    if(definition == NULL)
     {
+        p101_free(target_env, block);
         goto done;
     }
 
-    info_storage = p101_calloc(target_env, target_err, 1U, sizeof(*info));
-    info         = (struct p101_fsm_info *)info_storage;
+    // Rewind so the machine takes the front of the block; it then owns the block and the only lasting reference.
+    region.used = 0U;
+    info        = fsm_info_create(env, err, &region, definition, target_env, target_err, handler);
+    fsm_definition_release(definition);
     if(info == NULL)
     {
-        fsm_transition_map_destroy(target_env, &transition_map);
+        p101_free(target_env, block);
+        goto done;
+    }
+    info->owns_storage = true;
+
+done:
+    P101_WRAPPER_DONE(env);
+    return info;
+}
+
+struct p101_fsm_info *p101_fsm_info_create_from_definition(const struct p101_env *env, struct p101_error *err, struct p101_fsm_definition *definition, const struct p101_env *fsm_env, struct p101_error *fsm_err,
+                                                           p101_fsm_info_bad_change_state_handler_func handler)
+{
+    const struct p101_env *target_env;
+    struct p101_error     *target_err;
+    struct p101_fsm_info  *info;
+    bool                   primary_error_present;
+    bool                   target_error_present;
+
+    P101_TRACE(env);
+    P101_WRAPPER_FAULT_RETURN(env, err, info, NULL);
+    target_env = fsm_env == NULL ? env : fsm_env;
+    target_err = fsm_err == NULL ? err : fsm_err;
+    info       = NULL;
+
+    primary_error_present = p101_error_has_error(err);
+    target_error_present  = p101_error_has_error(target_err);
+    if(primary_error_present || target_error_present)
+    {
         goto done;
     }
 
-    info->name = p101_strdup(target_env, target_err, name);
-    if(info->name == NULL)
+    if(definition == NULL)
     {
-        fsm_transition_map_destroy(target_env, &transition_map);
-        p101_free(target_env, info);
-        info = NULL;
+        P101_ERROR_RAISE_USER(target_err, "FSM definition cannot be NULL", P101_FSM_ERROR_INVALID_ARGUMENT);
         goto done;
     }
 
-    info->transitions              = transition_map;
-    info->from_state_id            = P101_FSM_INIT;
-    info->current_state_id         = initial_state;
-    info->app_env                  = env;
-    info->app_err                  = err;
-    info->fsm_env                  = target_env;
-    info->fsm_err                  = target_err;
-    info->bad_change_state_handler = handler == NULL ? p101_fsm_info_default_bad_change_state_handler : handler;
+    info = fsm_info_create(env, err, NULL, definition, target_env, target_err, handler);
+
+done:
+    P101_WRAPPER_DONE(env);
+    return info;
+}
+
+struct p101_fsm_definition *p101_fsm_definition_init(const struct p101_env *env, struct p101_error *err, void *storage, size_t storage_size, const char *name, const struct p101_fsm_transition transitions[], size_t transition_count)
+{
+    struct p101_fsm_definition *definition;
+    struct fsm_storage          region;
+    bool                        error_present;
+    bool                        opened;
+
+    P101_TRACE(env);
+    P101_WRAPPER_FAULT_RETURN(env, err, definition, NULL);
+    definition    = NULL;
+    error_present = p101_error_has_error(err);
+    if(error_present)
+    {
+        goto done;
+    }
+    opened = fsm_storage_open(err, &region, storage, storage_size);
+    if(!opened)
+    {
+        goto done;
+    }
+    definition = fsm_definition_create(env, err, &region, name, transitions, transition_count, P101_FSM_TRANSITION_INDEX_AUTOMATIC);
+
+done:
+    P101_WRAPPER_DONE(env);
+    return definition;
+}
+
+size_t p101_fsm_definition_storage_size(const struct p101_env *env, const char *name, const struct p101_fsm_transition transitions[], size_t transition_count)
+{
+    size_t size;
+
+    P101_TRACE(env);
+    size = fsm_definition_storage_size(env, name, transitions, transition_count, 0U);
+    P101_TRACE_EXIT(env);
+    return size;
+}
+
+size_t p101_fsm_definition_storage_align(const struct p101_env *env)
+{
+    P101_TRACE(env);
+    P101_TRACE_EXIT(env);
+    return _Alignof(max_align_t);
+}
+
+struct p101_fsm_info *p101_fsm_info_init(const struct p101_env *env, struct p101_error *err, void *storage, size_t storage_size, struct p101_fsm_definition *definition, const struct p101_env *fsm_env, struct p101_error *fsm_err,
+                                         p101_fsm_info_bad_change_state_handler_func handler)
+{
+    const struct p101_env *target_env;
+    struct p101_error     *target_err;
+    struct p101_fsm_info  *info;
+    struct fsm_storage     region;
+    bool                   primary_error_present;
+    bool                   target_error_present;
+    bool                   opened;
+
+    P101_TRACE(env);
+    P101_WRAPPER_FAULT_RETURN(env, err, info, NULL);
+    target_env = fsm_env == NULL ? env : fsm_env;
+    target_err = fsm_err == NULL ? err : fsm_err;
+    info       = NULL;
+
+    primary_error_present = p101_error_has_error(err);
+    target_error_present  = p101_error_has_error(target_err);
+    if(primary_error_present || target_error_present)
+    {
+        goto done;
+    }
+
+    if(definition == NULL)
+    {
+        P101_ERROR_RAISE_USER(target_err, "FSM definition cannot be NULL", P101_FSM_ERROR_INVALID_ARGUMENT);
+        goto done;
+    }
+    opened = fsm_storage_open(target_err, &region, storage, storage_size);
+    if(!opened)
+    {
+        goto done;
+    }
+
+    info = fsm_info_create(env, err, &region, definition, target_env, target_err, handler);
 
 done:
     P101_WRAPPER_DONE(env);
     return info;
 }
 
+size_t p101_fsm_info_storage_size(const struct p101_env *env)
+{
+    P101_TRACE(env);
+    P101_TRACE_EXIT(env);
+    return sizeof(struct p101_fsm_info);
+}
+
+size_t p101_fsm_info_storage_align(const struct p101_env *env)
+{
+    P101_TRACE(env);
+    P101_TRACE_EXIT(env);
+    return _Alignof(max_align_t);
+}
+
 void p101_fsm_info_destroy(const struct p101_env *env, struct p101_error *fsm_err, struct p101_fsm_info **pinfo)
 {
     const struct p101_env *free_env;
@@ -170,9 +519,11 @@ void p101_fsm_info_destroy(const struct p101_env *env, struct p101_error *fsm_er
     }
 
     free_env = info->fsm_env == NULL ? env : info->fsm_env;
-    fsm_transition_map_destroy(free_env, &info->transitions);
-    p101_free(free_env, info->name);
-    p101_free(free_env, info);
+    fsm_definition_release(info->definition);
+    if(info->owns_storage)
+    {
+        p101_free(free_env, info);
+    }
     *pinfo = NULL;
 
 done:
@@ -184,11 +535,21 @@ const char *p101_fsm_info_get_name(const struct p101_env *env, const struct p101
     const char *name;
 
     P101_TRACE(env);
-    name = info == NULL ? NULL : info->name;
+    name = info == NULL ? NULL : info->definition->name;
     P101_TRACE_EXIT(env);
     return name;
 }
 
+const struct p101_fsm_definition *p101_fsm_info_get_definition(const struct p101_env *env, const struct p101_fsm_info *info)
+{
+    const struct p101_fsm_definition *definition;
+
+    P101_TRACE(env);
+    definition = info == NULL ? NULL : info->definition;
+    P101_TRACE_EXIT(env);
+    return definition;
+}
+
 p101_fsm_state_id p101_fsm_info_get_current_state(const struct p101_env *env, const struct p101_fsm_info *info)
 {
     p101_fsm_state_id state_id;
@@ -229,6 +590,7 @@ void p101_fsm_info_set_will_change_state_notifier(const struct p101_env *env, st
     if(info != NULL)
     {
         info->will_change_state_notifier = notifier;
+        fsm_info_select_step(info);
     }
     P101_TRACE_EXIT(env);
 }
@@ -239,6 +601,7 @@ void p101_fsm_info_set_did_change_state_notifier(const struct p101_env *env, str
     if(info != NULL)
     {
         info->did_change_state_notifier = notifier;
+        fsm_info_select_step(info);
     }
     P101_TRACE_EXIT(env);
 }
@@ -271,6 +634,7 @@ void p101_fsm_info_set_step_observer(const struct p101_env *env, struct p101_fsm
     {
         info->step_observer      = observer;
         info->step_observer_data = user_data;
+        fsm_info_select_step(info);
     }
     P101_TRACE_EXIT(env);
 }
@@ -402,8 +766,8 @@ void p101_fsm_emit_effect(const struct p101_env *env, struct p101_error *err, st
 {
     struct p101_fsm_effect effect;
 
-    P101_TRACE(env);
-    P101_WRAPPER_FAULT_RETURN_VOID(env, err);
+    P101_FSM_HOT_TRACE(env);
+    P101_FSM_HOT_FAULT_RETURN_VOID(env, err);
     if(sink == NULL || sink->handle == NULL)
     {
         goto done;
@@ -417,23 +781,17 @@ void p101_fsm_emit_effect(const struct p101_env *env, struct p101_error *err, st
     effect.kind      = kind;
     effect.data      = data;
     effect.data_size = data_size;
+    effect.kind_id   = P101_FSM_EFFECT_KIND_NONE;
     sink->handle(env, err, sink->context, &effect);
 
 done:
-    P101_WRAPPER_DONE(env);
+    P101_FSM_HOT_DONE(env);
 }
 
 p101_fsm_step_status p101_fsm_step(struct p101_fsm_info *info, void *arg, struct p101_fsm_effect_sink *sink, struct p101_fsm_step_result *result)
 {
-    p101_fsm_step_status     p101_single_result_;
-    const struct p101_env   *env;
-    struct p101_error       *err;
-    p101_fsm_state_func      perform;
-    struct p101_fsm_decision decision;
-    bool                     started;
-    bool                     has_error;
-    bool                     app_effect_capacity_error;
-    bool                     fsm_effect_capacity_error;
+    p101_fsm_step_status   p101_single_result_;
+    const struct p101_env *env;
 
     fsm_prepare_result(result);
     if(info == NULL)
@@ -442,75 +800,712 @@ p101_fsm_step_status p101_fsm_step(struct p101_fsm_info *info, void *arg, struct
         goto p101_single_exit_;
     }
 
-    env     = info->fsm_env;
-    err     = info->fsm_err;
-    started = false;
-    P101_TRACE(env);
+    env = info->fsm_env;
+    P101_FSM_HOT_TRACE(env);
     if(result == NULL)
     {
-        P101_ERROR_RAISE_USER(err, "FSM step result cannot be NULL", P101_FSM_ERROR_INVALID_ARGUMENT);
-        P101_TRACE_EXIT(env);
+        P101_ERROR_RAISE_USER(info->fsm_err, "FSM step result cannot be NULL", P101_FSM_ERROR_INVALID_ARGUMENT);
+        P101_FSM_HOT_TRACE_EXIT(env);
         p101_single_result_ = P101_FSM_STEP_ERROR;
         goto p101_single_exit_;
     }
 
-    if(info->sequence == SIZE_MAX)
-    {
-        result->status   = P101_FSM_STEP_REFUSED;
-        result->sequence = SIZE_MAX;
-        result->refusal  = P101_FSM_REFUSAL_SEQUENCE_EXHAUSTED;
-        P101_ERROR_RAISE_USER(err, "FSM step sequence is exhausted", P101_FSM_ERROR_SEQUENCE_EXHAUSTED);
-        goto done;
-    }
-    info->sequence++;
-    result->sequence        = info->sequence;
-    result->from_state      = info->from_state_id;
-    result->attempted_state = info->current_state_id;
-    result->next_state      = info->current_state_id;
+    p101_single_result_ = info->step(info, arg, sink, result);
+    P101_FSM_HOT_TRACE_EXIT(env);
+    goto p101_single_exit_;
 
-    has_error = fsm_has_error(info->app_err, info->fsm_err);
-    if(has_error)
-    {
-        result->status = P101_FSM_STEP_ERROR;
-        goto done;
-    }
-    if(info->operating || info->notifying)
+p101_single_exit_:
+    return p101_single_result_;
+}
+
+size_t p101_fsm_step_many(struct p101_fsm_info *const infos[], void *const args[], struct p101_fsm_effect_sink *sink, struct p101_fsm_step_result results[], size_t count)
+{
+    const struct p101_env *env;
+    size_t                 stepped;
+
+    env     = NULL;
+    stepped = 0U;
+    if(infos != NULL && count > 0U && infos[0] != NULL)
     {
-        result->status  = P101_FSM_STEP_REFUSED;
-        result->refusal = P101_FSM_REFUSAL_REENTRANT_INVOCATION;
-        P101_ERROR_RAISE_USER(err, "Cannot operate an FSM recursively", P101_FSM_ERROR_REENTRANT_OPERATION);
-        goto done;
+        env = infos[0]->fsm_env;
     }
-    if(info->terminal)
+    P101_FSM_HOT_TRACE(env);
+    if(infos == NULL || results == NULL)
     {
-        result->status     = P101_FSM_STEP_EXITED;
-        result->next_state = P101_FSM_STATE_NONE;
-        result->refusal    = P101_FSM_REFUSAL_TERMINAL_MACHINE;
         goto done;
     }
 
-    info->operating = true;
-    started         = true;
-    perform         = fsm_transition(info, info->from_state_id, info->current_state_id);
-    if(perform == NULL)
+    for(size_t index = 0U; index < count; ++index)
     {
-        if(info->bad_change_state_notifier != NULL)
+        struct p101_fsm_info *info;
+        void                 *arg;
+        p101_fsm_step_status  status;
+
+        info = infos[index];
+        arg  = args == NULL ? NULL : args[index];
+        if(index + 1U < count && infos[index + 1U] != NULL)
         {
-            info->bad_change_state_notifier(info->fsm_env, info->fsm_err, info, info->from_state_id, info->current_state_id);
+            fsm_step_prefetch(infos[index + 1U]);
         }
-        has_error = fsm_has_error(info->app_err, info->fsm_err);
-        if(has_error)
+        fsm_prepare_result(&results[index]);
+        if(info == NULL)
         {
-            result->status  = P101_FSM_STEP_ERROR;
-            result->refusal = P101_FSM_REFUSAL_UNKNOWN_TRANSITION;
-            goto done;
+            continue;
         }
-
-        decision.kind       = P101_FSM_DECISION_INVALID;
-        decision.next_state = P101_FSM_STATE_NONE;
-        info->bad_change_state_handler(info->fsm_env, info->fsm_err, info, info->from_state_id, info->current_state_id, sink, &decision);
-        has_error = fsm_has_error(info->app_err, info->fsm_err);
-        if(has_error)
+        status = info->step(info, arg, sink, &results[index]);
+        if(status != P101_FSM_STEP_ERROR)
+        {
+            stepped++;
+        }
+    }
+
+done:
+    P101_FSM_HOT_TRACE_EXIT(env);
+
+    return stepped;
+}
+
+p101_fsm_run_result p101_fsm_run(struct p101_fsm_info *info, void *arg, struct p101_fsm_effect_sink *sink, struct p101_fsm_step_result *last_result)
+{
+    const struct p101_env      *env;
+    struct p101_fsm_step_result current;
+    p101_fsm_run_result         run_result;
+    bool                        running;
+
+    env        = info == NULL ? NULL : info->fsm_env;
+    run_result = P101_FSM_RUN_ERROR;
+    P101_TRACE(env);
+    running = true;
+    while(running)
+    {
+        p101_fsm_step_status status;
+
+        status = p101_fsm_step(info, arg, sink, &current);
+        if(last_result != NULL)
+        {
+            *last_result = current;
+        }
+        running = info != NULL && fsm_run_continues(status, &current, false, &run_result);
+    }
+
+    P101_TRACE_EXIT(env);
+    return run_result;
+}
+
+p101_fsm_run_result p101_fsm_run_bounded(struct p101_fsm_info *info, void *arg, struct p101_fsm_effect_sink *sink, size_t maximum_steps, const struct timespec *deadline, struct p101_fsm_step_result *last_result)
+{
+    const struct p101_env      *env;
+    struct p101_fsm_step_result current;
+    p101_fsm_run_result         run_result;
+    bool                        running;
+
+    env        = info == NULL ? NULL : info->fsm_env;
+    run_result = P101_FSM_RUN_ERROR;
+    P101_TRACE(env);
+
+    // A run that starts no step still writes last_result, with the prepared values.
+    fsm_prepare_result(last_result);
+    if(info == NULL)
+    {
+        goto done;
+    }
+
+    running = true;
+    while(running)
+    {
+        p101_fsm_step_status status;
+
+        if(maximum_steps == 0U || fsm_deadline_passed(deadline))
+        {
+            run_result = P101_FSM_RUN_BUDGET_EXHAUSTED;
+            goto done;
+        }
+        maximum_steps--;
+        status = p101_fsm_step(info, arg, sink, &current);
+        if(last_result != NULL)
+        {
+            *last_result = current;
+        }
+        running = fsm_run_continues(status, &current, false, &run_result);
+    }
+
+done:
+    P101_TRACE_EXIT(env);
+    return run_result;
+}
+
+void p101_fsm_exit_immediately(const struct p101_env *env, struct p101_error *err, void *arg, struct p101_fsm_effect_sink *sink, struct p101_fsm_decision *decision)
+{
+    P101_TRACE(env);
+    P101_WRAPPER_FAULT_RETURN_VOID(env, err);
+    (void)arg;
+    (void)sink;
+    p101_fsm_decide_exit(decision);
+    P101_WRAPPER_DONE(env);
+}
+
+struct p101_fsm_pool *p101_fsm_pool_create(const struct p101_env *env, struct p101_error *err, struct p101_fsm_definition *definition, size_t capacity, const struct p101_env *fsm_env, struct p101_error *fsm_err)
+{
+    const struct p101_env *target_env;
+    struct p101_error     *target_err;
+    struct p101_fsm_pool  *pool;
+    struct fsm_storage     region;
+    void                  *block;
+    size_t                 size;
+    bool                   primary_error_present;
+    bool                   target_error_present;
+
+    P101_TRACE(env);
+    P101_WRAPPER_FAULT_RETURN(env, err, pool, NULL);
+    target_env = fsm_env == NULL ? env : fsm_env;
+    target_err = fsm_err == NULL ? err : fsm_err;
+    pool       = NULL;
+
+    primary_error_present = p101_error_has_error(err);
+    target_error_present  = p101_error_has_error(target_err);
+    if(primary_error_present || target_error_present)
+    {
+        goto done;
+    }
+
+    if(definition == NULL || capacity == 0U)
+    {
+        P101_ERROR_RAISE_USER(target_err, "FSM pool requires a definition and a non-zero capacity", P101_FSM_ERROR_INVALID_ARGUMENT);
+        goto done;
+    }
+    if(!fsm_pool_layout(capacity, &size))
+    {
+        P101_ERROR_RAISE_USER(target_err, "FSM pool capacity is too large", P101_FSM_ERROR_INVALID_ARGUMENT);
+        goto done;
+    }
+
+    // The pool header and its four columns share one block laid out by fsm_pool_layout().
+    block = p101_calloc(target_env, target_err, 1U, size);
+    if(block == NULL)
+    {
+        goto done;
+    }
+    region.base          = (unsigned char *)block;
+    region.size          = size;
+    region.used          = 0U;
+    pool                 = (struct p101_fsm_pool *)fsm_storage_allocate(target_env, target_err, &region, 1U, sizeof(*pool), _Alignof(struct p101_fsm_pool));
+    pool->current_states = (p101_fsm_state_id *)fsm_storage_allocate(target_env, target_err, &region, capacity, sizeof(p101_fsm_state_id), _Alignof(p101_fsm_state_id));
+    pool->from_states    = (p101_fsm_state_id *)fsm_storage_allocate(target_env, target_err, &region, capacity, sizeof(p101_fsm_state_id), _Alignof(p101_fsm_state_id));
+    pool->sequences      = (size_t *)fsm_storage_allocate(target_env, target_err, &region, capacity, sizeof(size_t), _Alignof(size_t));
+    pool->flags          = (unsigned char *)fsm_storage_allocate(target_env, target_err, &region, capacity, sizeof(unsigned char), 1U);
+    pool->capacity       = capacity;
+    pool->app_env        = env;
+    pool->app_err        = err;
+    pool->fsm_env        = target_env;
+    pool->fsm_err        = target_err;
+    fsm_definition_retain(definition);
+    pool->definition = definition;
+    for(size_t session = 0U; session < capacity; ++session)
+    {
+        pool->current_states[session] = definition->initial_state;
+        pool->from_states[session]    = P101_FSM_INIT;
+    }
+
+done:
+    P101_WRAPPER_DONE(env);
+    return pool;
+}
+
+void p101_fsm_pool_destroy(const struct p101_env *env, struct p101_error *fsm_err, struct p101_fsm_pool **ppool)
+{
+    const struct p101_env *free_env;
+    struct p101_fsm_pool  *pool;
+
+    P101_TRACE(env);
+    P101_WRAPPER_FAULT_RETURN_VOID(env, fsm_err);
+    if(ppool == NULL || *ppool == NULL)
+    {
+        goto done;
+    }
+
+    pool = *ppool;
+    if(pool->operating != 0U)
+    {
+        P101_ERROR_RAISE_USER(fsm_err, "Cannot destroy an FSM pool during a state operation", P101_FSM_ERROR_REENTRANT_OPERATION);
+        goto done;
+    }
+
+    free_env = pool->fsm_env == NULL ? env : pool->fsm_env;
+    fsm_definition_release(pool->definition);
+    p101_free(free_env, pool);
+    *ppool = NULL;
+
+done:
+    P101_WRAPPER_DONE(env);
+}
+
+size_t p101_fsm_pool_get_capacity(const struct p101_env *env, const struct p101_fsm_pool *pool)
+{
+    size_t capacity;
+
+    P101_TRACE(env);
+    capacity = pool == NULL ? 0U : pool->capacity;
+    P101_TRACE_EXIT(env);
+    return capacity;
+}
+
+p101_fsm_state_id p101_fsm_pool_get_current_state(const struct p101_env *env, const struct p101_fsm_pool *pool, size_t session)
+{
+    p101_fsm_state_id state_id;
+
+    P101_TRACE(env);
+    state_id = pool == NULL || session >= pool->capacity ? P101_FSM_STATE_NONE : pool->current_states[session];
+    P101_TRACE_EXIT(env);
+    return state_id;
+}
+
+size_t p101_fsm_pool_get_step_sequence(const struct p101_env *env, const struct p101_fsm_pool *pool, size_t session)
+{
+    size_t sequence;
+
+    P101_TRACE(env);
+    sequence = pool == NULL || session >= pool->capacity ? 0U : pool->sequences[session];
+    P101_TRACE_EXIT(env);
+    return sequence;
+}
+
+bool p101_fsm_pool_is_terminal(const struct p101_env *env, const struct p101_fsm_pool *pool, size_t session)
+{
+    bool terminal;
+
+    P101_TRACE(env);
+    terminal = false;
+    if(pool != NULL && session < pool->capacity)
+    {
+        terminal = (pool->flags[session] & FSM_POOL_TERMINAL) != 0U;
+    }
+    P101_TRACE_EXIT(env);
+    return terminal;
+}
+
+size_t p101_fsm_pool_count_in_state(const struct p101_env *env, const struct p101_fsm_pool *pool, p101_fsm_state_id state_id)
+{
+    size_t count;
+
+    P101_TRACE(env);
+    count = 0U;
+    if(pool != NULL)
+    {
+        for(size_t session = 0U; session < pool->capacity; ++session)
+        {
+            if(pool->current_states[session] == state_id && (pool->flags[session] & FSM_POOL_TERMINAL) == 0U)
+            {
+                count++;
+            }
+        }
+    }
+    P101_TRACE_EXIT(env);
+    return count;
+}
+
+void p101_fsm_pool_reset_session(const struct p101_env *env, struct p101_fsm_pool *pool, size_t session)
+{
+    P101_TRACE(env);
+    if(pool == NULL)
+    {
+        goto done;
+    }
+    if(session >= pool->capacity)
+    {
+        P101_ERROR_RAISE_USER(pool->fsm_err, "FSM pool session is out of range", P101_FSM_ERROR_INVALID_ARGUMENT);
+        goto done;
+    }
+    if((pool->flags[session] & FSM_POOL_OPERATING) != 0U)
+    {
+        P101_ERROR_RAISE_USER(pool->fsm_err, "Cannot reset an FSM pool session during its state operation", P101_FSM_ERROR_REENTRANT_OPERATION);
+        goto done;
+    }
+
+    pool->current_states[session] = pool->definition->initial_state;
+    pool->from_states[session]    = P101_FSM_INIT;
+    pool->sequences[session]      = 0U;
+    pool->flags[session]          = 0U;
+
+done:
+    P101_TRACE_EXIT(env);
+}
+
+p101_fsm_step_status p101_fsm_pool_step(struct p101_fsm_pool *pool, size_t session, void *arg, struct p101_fsm_effect_sink *sink, struct p101_fsm_step_result *result)
+{
+    p101_fsm_step_status   p101_single_result_;
+    const struct p101_env *env;
+
+    fsm_prepare_result(result);
+    if(pool == NULL)
+    {
+        p101_single_result_ = P101_FSM_STEP_ERROR;
+        goto p101_single_exit_;
+    }
+
+    env = pool->fsm_env;
+    P101_FSM_HOT_TRACE(env);
+    if(result == NULL)
+    {
+        P101_ERROR_RAISE_USER(pool->fsm_err, "FSM step result cannot be NULL", P101_FSM_ERROR_INVALID_ARGUMENT);
+        P101_FSM_HOT_TRACE_EXIT(env);
+        p101_single_result_ = P101_FSM_STEP_ERROR;
+        goto p101_single_exit_;
+    }
+
+    p101_single_result_ = fsm_pool_step(pool, session, arg, sink, result);
+    P101_FSM_HOT_TRACE_EXIT(env);
+    goto p101_single_exit_;
+
+p101_single_exit_:
+    return p101_single_result_;
+}
+
+size_t p101_fsm_pool_step_range(struct p101_fsm_pool *pool, size_t first, size_t count, void *const args[], struct p101_fsm_effect_sink *sink, struct p101_fsm_step_result results[])
+{
+    const struct p101_env *env;
+    size_t                 stepped;
+
+    env     = pool == NULL ? NULL : pool->fsm_env;
+    stepped = 0U;
+    P101_FSM_HOT_TRACE(env);
+    if(pool == NULL || results == NULL)
+    {
+        goto done;
+    }
+
+    for(size_t index = 0U; index < count; ++index)
+    {
+        fsm_prepare_result(&results[index]);
+    }
+    if(first > pool->capacity || count > pool->capacity - first)
+    {
+        P101_ERROR_RAISE_USER(pool->fsm_err, "FSM pool session range is out of bounds", P101_FSM_ERROR_INVALID_ARGUMENT);
+        goto done;
+    }
+
+    for(size_t index = 0U; index < count; ++index)
+    {
+        p101_fsm_step_status status;
+
+        status = fsm_pool_step(pool, first + index, args == NULL ? NULL : args[index], sink, &results[index]);
+        if(status != P101_FSM_STEP_ERROR)
+        {
+            stepped++;
+        }
+    }
+
+done:
+    P101_FSM_HOT_TRACE_EXIT(env);
+
+    return stepped;
+}
+
+static struct p101_fsm_definition *fsm_definition_create(const struct p101_env *env, struct p101_error *err, struct fsm_storage *storage, const char *name, const struct p101_fsm_transition transitions[], size_t transition_count,
+                                                         p101_fsm_transition_index index)
+{
+    struct p101_fsm_definition *definition;
+    void                       *definition_storage;
+    void                       *name_storage;
+    size_t                      name_size;
+    int                         map_created;
+
+    definition = NULL;
+    if(name == NULL)
+    {
+        P101_ERROR_RAISE_USER(err, "FSM name cannot be NULL", P101_FSM_ERROR_INVALID_ARGUMENT);
+        goto done;
+    }
+
+    definition_storage = fsm_storage_allocate(env, err, storage, 1U, sizeof(*definition), _Alignof(struct p101_fsm_definition));
+    definition         = (struct p101_fsm_definition *)definition_storage;
+    if(definition == NULL)
+    {
+        goto done;
+    }
+
+    if(storage == NULL)
+    {
+        definition->name = p101_strdup(env, err, name);
+    }
+    else
+    {
+        name_size        = p101_strlen(env, name) + 1U;
+        name_storage     = fsm_storage_allocate(env, err, storage, name_size, sizeof(char), _Alignof(char));
+        definition->name = (char *)name_storage;
+        if(definition->name != NULL)
+        {
+            p101_memcpy(env, definition->name, name, name_size);
+        }
+    }
+    if(definition->name == NULL)
+    {
+        fsm_storage_free(env, storage, definition);
+        definition = NULL;
+        goto done;
+    }
+
+    map_created = fsm_transition_map_create(env, err, storage, transitions, transition_count, index, &definition->transitions, &definition->initial_state);
+    if(!map_created)
+    {
+        fsm_storage_free(env, storage, definition->name);
+        fsm_storage_free(env, storage, definition);
+        definition = NULL;
+        goto done;
+    }
+
+    definition->env          = env;
+    definition->owns_storage = storage == NULL;
+    atomic_init(&definition->references, 1U);
+
+done:
+    return definition;
+}
+
+static size_t fsm_definition_storage_size(const struct p101_env *env, const char *name, const struct p101_fsm_transition transitions[], size_t transition_count, size_t offset)
+{
+    size_t total;
+    size_t name_size;
+
+    total = offset;
+    if(name == NULL)
+    {
+        total = 0U;
+        goto done;
+    }
+    name_size = p101_strlen(env, name) + 1U;
+    if(!fsm_storage_reserve(&total, 1U, sizeof(struct p101_fsm_definition), _Alignof(struct p101_fsm_definition)) || !fsm_storage_reserve(&total, name_size, sizeof(char), _Alignof(char)))
+    {
+        total = 0U;
+        goto done;
+    }
+    total = fsm_transition_map_storage_size(transitions, transition_count, total);
+
+done:
+    return total;
+}
+
+static void fsm_definition_retain(struct p101_fsm_definition *definition)
+{
+    atomic_fetch_add_explicit(&definition->references, 1U, memory_order_relaxed);
+}
+
+static void fsm_definition_release(struct p101_fsm_definition *definition)
+{
+    size_t previous;
+
+    previous = atomic_fetch_sub_explicit(&definition->references, 1U, memory_order_acq_rel);
+    if(previous == 1U && definition->owns_storage)
+    {
+        fsm_transition_map_destroy(definition->env, NULL, &definition->transitions);
+        p101_free(definition->env, definition->name);
+        p101_free(definition->env, definition);
+    }
+}
+
+static struct p101_fsm_info *fsm_info_create(const struct p101_env *env, struct p101_error *err, struct fsm_storage *storage, struct p101_fsm_definition *definition, const struct p101_env *fsm_env, struct p101_error *fsm_err,
+                                             p101_fsm_info_bad_change_state_handler_func handler)
+{
+    struct p101_fsm_info *info;
+    void                 *info_storage;
+
+    info_storage = fsm_storage_allocate(fsm_env, fsm_err, storage, 1U, sizeof(*info), _Alignof(struct p101_fsm_info));
+    info         = (struct p101_fsm_info *)info_storage;
+    if(info == NULL)
+    {
+        goto done;
+    }
+
+    fsm_definition_retain(definition);
+    info->definition               = definition;
+    info->from_state_id            = P101_FSM_INIT;
+    info->current_state_id         = definition->initial_state;
+    info->app_env                  = env;
+    info->app_err                  = err;
+    info->fsm_env                  = fsm_env;
+    info->fsm_err                  = fsm_err;
+    info->bad_change_state_handler = handler == NULL ? p101_fsm_info_default_bad_change_state_handler : handler;
+    info->current_perform          = fsm_transition(&info->definition->transitions, info->from_state_id, info->current_state_id);
+    info->owns_storage             = storage == NULL;
+    fsm_info_select_step(info);
+
+done:
+    return info;
+}
+
+/*
+ * A machine with no will-change or did-change notifier and no step observer
+ * steps through fsm_step_plain(). The bad-transition notifier and handler
+ * are reached only for an unknown edge, which the plain path hands to
+ * fsm_step(), so they do not affect the choice.
+ */
+static void fsm_info_select_step(struct p101_fsm_info *info)
+{
+    if(info->will_change_state_notifier == NULL && info->did_change_state_notifier == NULL && info->step_observer == NULL)
+    {
+        info->step = fsm_step_plain;
+    }
+    else
+    {
+        info->step = fsm_step;
+    }
+}
+
+static bool fsm_storage_open(struct p101_error *err, struct fsm_storage *storage, void *memory, size_t size)
+{
+    bool p101_single_result_;
+
+    p101_single_result_ = false;
+    if(memory == NULL || (uintptr_t)memory % _Alignof(max_align_t) != 0U)
+    {
+        P101_ERROR_RAISE_USER(err, "FSM storage must be non-NULL and suitably aligned", P101_FSM_ERROR_INVALID_ARGUMENT);
+        goto p101_single_exit_;
+    }
+    storage->base       = (unsigned char *)memory;
+    storage->size       = size;
+    storage->used       = 0U;
+    p101_single_result_ = true;
+
+p101_single_exit_:
+    return p101_single_result_;
+}
+
+static void fsm_complete_step(struct p101_fsm_info *info, struct p101_fsm_step_result *result, bool started)
+{
+    if(started)
+    {
+        info->operating = false;
+    }
+    if(info->step_observer != NULL && !info->notifying)
+    {
+        info->notifying = true;
+        info->step_observer(info->fsm_env, info, result, info->step_observer_data);
+        info->notifying = false;
+    }
+}
+
+static bool fsm_has_error(const struct p101_error *app_err, const struct p101_error *fsm_err)
+{
+    bool result;
+    bool app_error_present;
+    bool fsm_error_present;
+
+    app_error_present = p101_error_has_error(app_err);
+    fsm_error_present = p101_error_has_error(fsm_err);
+    result            = false;
+    if(app_error_present || fsm_error_present)
+    {
+        result = true;
+    }
+
+    return result;
+}
+
+static const char *fsm_info_name_or_default(const struct p101_fsm_info *info)
+{
+    return info == NULL ? "<unnamed>" : info->definition->name;
+}
+
+static bool fsm_deadline_passed(const struct timespec *deadline)
+{
+    struct timespec now;
+    bool            passed;
+
+    passed = false;
+    if(deadline != NULL)
+    {
+        // CLOCK_MONOTONIC cannot fail on the supported platforms; an unreadable clock leaves now at zero.
+        now.tv_sec  = 0;
+        now.tv_nsec = 0;
+        (void)clock_gettime(CLOCK_MONOTONIC, &now);
+        passed = now.tv_sec > deadline->tv_sec || (now.tv_sec == deadline->tv_sec && now.tv_nsec >= deadline->tv_nsec);
+    }
+
+    return passed;
+}
+
+static void fsm_prepare_result(struct p101_fsm_step_result *result)
+{
+    if(result != NULL)
+    {
+        result->status          = P101_FSM_STEP_ERROR;
+        result->sequence        = 0U;
+        result->from_state      = P101_FSM_STATE_NONE;
+        result->attempted_state = P101_FSM_STATE_NONE;
+        result->next_state      = P101_FSM_STATE_NONE;
+        result->refusal         = P101_FSM_REFUSAL_NONE;
+    }
+}
+
+static p101_fsm_step_status fsm_step(struct p101_fsm_info *info, void *arg, struct p101_fsm_effect_sink *sink, struct p101_fsm_step_result *result)
+{
+    struct p101_error       *err;
+    p101_fsm_state_func      perform;
+    struct p101_fsm_decision decision;
+    bool                     started;
+    bool                     has_error;
+    bool                     app_effect_capacity_error;
+    bool                     fsm_effect_capacity_error;
+
+    err     = info->fsm_err;
+    started = false;
+
+    if(info->sequence == SIZE_MAX)
+    {
+        result->status   = P101_FSM_STEP_REFUSED;
+        result->sequence = SIZE_MAX;
+        result->refusal  = P101_FSM_REFUSAL_SEQUENCE_EXHAUSTED;
+        P101_ERROR_RAISE_USER(err, "FSM step sequence is exhausted", P101_FSM_ERROR_SEQUENCE_EXHAUSTED);
+        goto done;
+    }
+    info->sequence++;
+    result->sequence        = info->sequence;
+    result->from_state      = info->from_state_id;
+    result->attempted_state = info->current_state_id;
+    result->next_state      = info->current_state_id;
+
+    has_error = fsm_has_error(info->app_err, info->fsm_err);
+    if(has_error)
+    {
+        result->status = P101_FSM_STEP_ERROR;
+        goto done;
+    }
+    if(info->operating || info->notifying)
+    {
+        result->status  = P101_FSM_STEP_REFUSED;
+        result->refusal = P101_FSM_REFUSAL_REENTRANT_INVOCATION;
+        P101_ERROR_RAISE_USER(err, "Cannot operate an FSM recursively", P101_FSM_ERROR_REENTRANT_OPERATION);
+        goto done;
+    }
+    if(info->terminal)
+    {
+        result->status     = P101_FSM_STEP_EXITED;
+        result->next_state = P101_FSM_STATE_NONE;
+        result->refusal    = P101_FSM_REFUSAL_TERMINAL_MACHINE;
+        goto done;
+    }
+
+    info->operating = true;
+    started         = true;
+    perform         = info->current_perform;
+    if(perform == NULL)
+    {
+        if(info->bad_change_state_notifier != NULL)
+        {
+            info->bad_change_state_notifier(info->fsm_env, info->fsm_err, info, info->from_state_id, info->current_state_id);
+        }
+        has_error = fsm_has_error(info->app_err, info->fsm_err);
+        if(has_error)
+        {
+            result->status  = P101_FSM_STEP_ERROR;
+            result->refusal = P101_FSM_REFUSAL_UNKNOWN_TRANSITION;
+            goto done;
+        }
+
+        decision.kind       = P101_FSM_DECISION_INVALID;
+        decision.next_state = P101_FSM_STATE_NONE;
+        info->bad_change_state_handler(info->fsm_env, info->fsm_err, info, info->from_state_id, info->current_state_id, sink, &decision);
+        has_error = fsm_has_error(info->app_err, info->fsm_err);
+        if(has_error)
         {
             result->status  = P101_FSM_STEP_ERROR;
             result->refusal = P101_FSM_REFUSAL_UNKNOWN_TRANSITION;
@@ -532,7 +1527,7 @@ p101_fsm_step_status p101_fsm_step(struct p101_fsm_info *info, void *arg, struct
                     P101_ERROR_RAISE_USER(err, "Bad-transition handler selected an invalid state", P101_FSM_ERROR_INVALID_DECISION);
                     break;
                 }
-                if(decision.next_state == info->current_state_id || info->redirect_count >= info->transitions.table.rule_count)
+                if(decision.next_state == info->current_state_id || info->redirect_count >= info->definition->transitions.transition_count)
                 {
                     result->refusal = P101_FSM_REFUSAL_REDIRECT_CYCLE;
                     P101_ERROR_RAISE_USER(err, "Bad-transition handler entered a redirect cycle", P101_FSM_ERROR_HANDLER_LOOP);
@@ -540,6 +1535,7 @@ p101_fsm_step_status p101_fsm_step(struct p101_fsm_info *info, void *arg, struct
                 }
                 info->redirect_count++;
                 info->current_state_id = decision.next_state;
+                info->current_perform  = fsm_transition(&info->definition->transitions, info->from_state_id, info->current_state_id);
                 result->next_state     = decision.next_state;
                 break;
             case P101_FSM_DECISION_PAUSE:
@@ -575,7 +1571,148 @@ p101_fsm_step_status p101_fsm_step(struct p101_fsm_info *info, void *arg, struct
     decision.kind       = P101_FSM_DECISION_INVALID;
     decision.next_state = P101_FSM_STATE_NONE;
     perform(info->app_env, info->app_err, arg, sink, &decision);
-    has_error = fsm_has_error(info->app_err, info->fsm_err);
+    has_error = fsm_has_error(info->app_err, info->fsm_err);
+    if(has_error)
+    {
+        app_effect_capacity_error = p101_error_is_error(info->app_err, P101_ERROR_USER, P101_FSM_ERROR_EFFECT_CAPACITY);
+        fsm_effect_capacity_error = p101_error_is_error(info->fsm_err, P101_ERROR_USER, P101_FSM_ERROR_EFFECT_CAPACITY);
+        if(app_effect_capacity_error || fsm_effect_capacity_error)
+        {
+            result->status  = P101_FSM_STEP_REFUSED;
+            result->refusal = P101_FSM_REFUSAL_EFFECT_CAPACITY;
+        }
+        else
+        {
+            result->status = P101_FSM_STEP_ERROR;
+        }
+        goto done;
+    }
+
+#ifdef __clang__
+    #pragma clang diagnostic push
+    #pragma clang diagnostic ignored "-Wcovered-switch-default"
+#endif
+    switch(decision.kind)    // GCOVR_EXCL_BR_LINE: default protects against an invalid enum representation.
+    {
+        case P101_FSM_DECISION_TRANSITION:
+            if(decision.next_state < P101_FSM_USER_START)
+            {
+                result->status  = P101_FSM_STEP_REFUSED;
+                result->refusal = P101_FSM_REFUSAL_INVALID_CALLBACK_DECISION;
+                P101_ERROR_RAISE_USER(info->app_err, "FSM callback selected an invalid state", P101_FSM_ERROR_INVALID_DECISION);
+                break;
+            }
+            if(info->did_change_state_notifier != NULL)
+            {
+                info->did_change_state_notifier(info->fsm_env, info->fsm_err, info, info->from_state_id, info->current_state_id, decision.next_state);
+            }
+            has_error = fsm_has_error(info->app_err, info->fsm_err);
+            if(has_error)
+            {
+                result->status = P101_FSM_STEP_ERROR;
+                break;
+            }
+            info->from_state_id    = info->current_state_id;
+            info->current_state_id = decision.next_state;
+            info->current_perform  = fsm_transition(&info->definition->transitions, info->from_state_id, info->current_state_id);
+            info->redirect_count   = 0U;
+            result->status         = P101_FSM_STEP_TRANSITIONED;
+            result->next_state     = decision.next_state;
+            break;
+        case P101_FSM_DECISION_PAUSE:
+            result->status = P101_FSM_STEP_PAUSED;
+            break;
+        case P101_FSM_DECISION_EXIT:
+            if(info->did_change_state_notifier != NULL)
+            {
+                info->did_change_state_notifier(info->fsm_env, info->fsm_err, info, info->from_state_id, info->current_state_id, P101_FSM_STATE_NONE);
+            }
+            has_error = fsm_has_error(info->app_err, info->fsm_err);
+            if(has_error)
+            {
+                result->status = P101_FSM_STEP_ERROR;
+                break;
+            }
+            info->from_state_id   = info->current_state_id;
+            info->current_perform = NULL;
+            info->redirect_count  = 0U;
+            info->terminal        = true;
+            result->status        = P101_FSM_STEP_EXITED;
+            result->next_state    = P101_FSM_STATE_NONE;
+            break;
+        case P101_FSM_DECISION_INVALID:
+        default:
+            result->status  = P101_FSM_STEP_REFUSED;
+            result->refusal = P101_FSM_REFUSAL_INVALID_CALLBACK_DECISION;
+            P101_ERROR_RAISE_USER(info->app_err, "FSM callback did not produce a valid decision", P101_FSM_ERROR_INVALID_DECISION);
+            break;
+    }
+#ifdef __clang__
+    #pragma clang diagnostic pop
+#endif
+
+done:
+    fsm_complete_step(info, result, started);
+
+    return result->status;
+}
+
+/*
+ * fsm_step() for a machine without notifiers or an observer: the same
+ * checks and commit in the same order, with one error check before and one
+ * after the callback. A machine without a cached performer is either
+ * terminal or facing an unknown edge, and takes the general path.
+ */
+static p101_fsm_step_status fsm_step_plain(struct p101_fsm_info *info, void *arg, struct p101_fsm_effect_sink *sink, struct p101_fsm_step_result *result)
+{
+    struct p101_error       *err;
+    p101_fsm_state_func      perform;
+    struct p101_fsm_decision decision;
+    bool                     has_error;
+    bool                     app_effect_capacity_error;
+    bool                     fsm_effect_capacity_error;
+
+    err     = info->fsm_err;
+    perform = info->current_perform;
+    if(perform == NULL)
+    {
+        result->status = fsm_step(info, arg, sink, result);
+        goto done;
+    }
+    if(info->sequence == SIZE_MAX)
+    {
+        result->status   = P101_FSM_STEP_REFUSED;
+        result->sequence = SIZE_MAX;
+        result->refusal  = P101_FSM_REFUSAL_SEQUENCE_EXHAUSTED;
+        P101_ERROR_RAISE_USER(err, "FSM step sequence is exhausted", P101_FSM_ERROR_SEQUENCE_EXHAUSTED);
+        goto done;
+    }
+    info->sequence++;
+    result->sequence        = info->sequence;
+    result->from_state      = info->from_state_id;
+    result->attempted_state = info->current_state_id;
+    result->next_state      = info->current_state_id;
+
+    has_error = fsm_has_error(info->app_err, info->fsm_err);
+    if(has_error)
+    {
+        result->status = P101_FSM_STEP_ERROR;
+        goto done;
+    }
+    if(info->operating || info->notifying)
+    {
+        result->status  = P101_FSM_STEP_REFUSED;
+        result->refusal = P101_FSM_REFUSAL_REENTRANT_INVOCATION;
+        P101_ERROR_RAISE_USER(err, "Cannot operate an FSM recursively", P101_FSM_ERROR_REENTRANT_OPERATION);
+        goto done;
+    }
+
+    decision.kind       = P101_FSM_DECISION_INVALID;
+    decision.next_state = P101_FSM_STATE_NONE;
+    info->operating     = true;
+    perform(info->app_env, info->app_err, arg, sink, &decision);
+    info->operating = false;
+    has_error       = fsm_has_error(info->app_err, info->fsm_err);
     if(has_error)
     {
         app_effect_capacity_error = p101_error_is_error(info->app_err, P101_ERROR_USER, P101_FSM_ERROR_EFFECT_CAPACITY);
@@ -606,18 +1743,9 @@ p101_fsm_step_status p101_fsm_step(struct p101_fsm_info *info, void *arg, struct
                 P101_ERROR_RAISE_USER(info->app_err, "FSM callback selected an invalid state", P101_FSM_ERROR_INVALID_DECISION);
                 break;
             }
-            if(info->did_change_state_notifier != NULL)
-            {
-                info->did_change_state_notifier(info->fsm_env, info->fsm_err, info, info->from_state_id, info->current_state_id, decision.next_state);
-            }
-            has_error = fsm_has_error(info->app_err, info->fsm_err);
-            if(has_error)
-            {
-                result->status = P101_FSM_STEP_ERROR;
-                break;
-            }
             info->from_state_id    = info->current_state_id;
             info->current_state_id = decision.next_state;
+            info->current_perform  = fsm_transition(&info->definition->transitions, info->from_state_id, info->current_state_id);
             info->redirect_count   = 0U;
             result->status         = P101_FSM_STEP_TRANSITIONED;
             result->next_state     = decision.next_state;
@@ -626,235 +1754,835 @@ p101_fsm_step_status p101_fsm_step(struct p101_fsm_info *info, void *arg, struct
             result->status = P101_FSM_STEP_PAUSED;
             break;
         case P101_FSM_DECISION_EXIT:
-            if(info->did_change_state_notifier != NULL)
-            {
-                info->did_change_state_notifier(info->fsm_env, info->fsm_err, info, info->from_state_id, info->current_state_id, P101_FSM_STATE_NONE);
-            }
-            has_error = fsm_has_error(info->app_err, info->fsm_err);
-            if(has_error)
+            info->from_state_id   = info->current_state_id;
+            info->current_perform = NULL;
+            info->redirect_count  = 0U;
+            info->terminal        = true;
+            result->status        = P101_FSM_STEP_EXITED;
+            result->next_state    = P101_FSM_STATE_NONE;
+            break;
+        case P101_FSM_DECISION_INVALID:
+        default:
+            result->status  = P101_FSM_STEP_REFUSED;
+            result->refusal = P101_FSM_REFUSAL_INVALID_CALLBACK_DECISION;
+            P101_ERROR_RAISE_USER(info->app_err, "FSM callback did not produce a valid decision", P101_FSM_ERROR_INVALID_DECISION);
+            break;
+    }
+#ifdef __clang__
+    #pragma clang diagnostic pop
+#endif
+
+done:
+    return result->status;
+}
+
+/*
+ * Touches the row the machine's next commit will search. Dense rows and CSR
+ * edge runs are keyed only by the current state, so they can be fetched
+ * before the callback chooses its target; the hashed indexes cannot.
+ */
+static void fsm_step_prefetch(const struct p101_fsm_info *info)
+{
+    const struct p101_fsm_transition_map *map;
+    const void                           *address;
+    size_t                                row;
+
+    address = info;
+    map     = &info->definition->transitions;
+    row     = (size_t)info->current_state_id;
+    if(map->index == P101_FSM_TRANSITION_INDEX_DENSE && row < map->dense_span)
+    {
+        address = &map->dense[row * map->dense_span];
+    }
+    else if(map->index == P101_FSM_TRANSITION_INDEX_CSR && row < map->csr_span)
+    {
+        address = &map->csr_edges[map->csr_offsets[row]];
+    }
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(address, 0, 1);
+#else
+    (void)address;
+#endif
+}
+
+/*
+ * Mirrors fsm_step() for one pool session. A pool has no notifiers,
+ * observer, or bad-transition handler, so an unknown edge is reported the
+ * way the default handler reports it.
+ */
+static p101_fsm_step_status fsm_pool_step(struct p101_fsm_pool *pool, size_t session, void *arg, struct p101_fsm_effect_sink *sink, struct p101_fsm_step_result *result)
+{
+    struct p101_error       *err;
+    p101_fsm_state_func      perform;
+    struct p101_fsm_decision decision;
+    p101_fsm_state_id        current_state;
+    bool                     has_error;
+    bool                     app_effect_capacity_error;
+    bool                     fsm_effect_capacity_error;
+
+    err = pool->fsm_err;
+    if(session >= pool->capacity)
+    {
+        P101_ERROR_RAISE_USER(err, "FSM pool session is out of range", P101_FSM_ERROR_INVALID_ARGUMENT);
+        goto done;
+    }
+    if(pool->sequences[session] == SIZE_MAX)
+    {
+        result->status   = P101_FSM_STEP_REFUSED;
+        result->sequence = SIZE_MAX;
+        result->refusal  = P101_FSM_REFUSAL_SEQUENCE_EXHAUSTED;
+        P101_ERROR_RAISE_USER(err, "FSM step sequence is exhausted", P101_FSM_ERROR_SEQUENCE_EXHAUSTED);
+        goto done;
+    }
+    pool->sequences[session]++;
+    current_state           = pool->current_states[session];
+    result->sequence        = pool->sequences[session];
+    result->from_state      = pool->from_states[session];
+    result->attempted_state = current_state;
+    result->next_state      = current_state;
+
+    has_error = fsm_has_error(pool->app_err, pool->fsm_err);
+    if(has_error)
+    {
+        goto done;
+    }
+    if((pool->flags[session] & FSM_POOL_OPERATING) != 0U)
+    {
+        result->status  = P101_FSM_STEP_REFUSED;
+        result->refusal = P101_FSM_REFUSAL_REENTRANT_INVOCATION;
+        P101_ERROR_RAISE_USER(err, "Cannot operate an FSM recursively", P101_FSM_ERROR_REENTRANT_OPERATION);
+        goto done;
+    }
+    if((pool->flags[session] & FSM_POOL_TERMINAL) != 0U)
+    {
+        result->status     = P101_FSM_STEP_EXITED;
+        result->next_state = P101_FSM_STATE_NONE;
+        result->refusal    = P101_FSM_REFUSAL_TERMINAL_MACHINE;
+        goto done;
+    }
+
+    perform = fsm_transition(&pool->definition->transitions, pool->from_states[session], current_state);
+    if(perform == NULL)
+    {
+        result->refusal = P101_FSM_REFUSAL_UNKNOWN_TRANSITION;
+        P101_ERROR_RAISE_USER_PRINTF(err, P101_FSM_ERROR_UNKNOWN_TRANSITION, "Unknown FSM state transition: %d -> %d", pool->from_states[session], current_state);
+        goto done;
+    }
+
+    decision.kind        = P101_FSM_DECISION_INVALID;
+    decision.next_state  = P101_FSM_STATE_NONE;
+    pool->flags[session] = (unsigned char)(pool->flags[session] | FSM_POOL_OPERATING);
+    pool->operating++;
+    perform(pool->app_env, pool->app_err, arg, sink, &decision);
+    pool->operating--;
+    pool->flags[session] = (unsigned char)(pool->flags[session] & ~FSM_POOL_OPERATING);
+    has_error            = fsm_has_error(pool->app_err, pool->fsm_err);
+    if(has_error)
+    {
+        app_effect_capacity_error = p101_error_is_error(pool->app_err, P101_ERROR_USER, P101_FSM_ERROR_EFFECT_CAPACITY);
+        fsm_effect_capacity_error = p101_error_is_error(pool->fsm_err, P101_ERROR_USER, P101_FSM_ERROR_EFFECT_CAPACITY);
+        if(app_effect_capacity_error || fsm_effect_capacity_error)
+        {
+            result->status  = P101_FSM_STEP_REFUSED;
+            result->refusal = P101_FSM_REFUSAL_EFFECT_CAPACITY;
+        }
+        goto done;
+    }
+
+#ifdef __clang__
+    #pragma clang diagnostic push
+    #pragma clang diagnostic ignored "-Wcovered-switch-default"
+#endif
+    switch(decision.kind)    // GCOVR_EXCL_BR_LINE: default protects against an invalid enum representation.
+    {
+        case P101_FSM_DECISION_TRANSITION:
+            if(decision.next_state < P101_FSM_USER_START)
             {
-                result->status = P101_FSM_STEP_ERROR;
+                result->status  = P101_FSM_STEP_REFUSED;
+                result->refusal = P101_FSM_REFUSAL_INVALID_CALLBACK_DECISION;
+                P101_ERROR_RAISE_USER(pool->app_err, "FSM callback selected an invalid state", P101_FSM_ERROR_INVALID_DECISION);
                 break;
             }
-            info->from_state_id  = info->current_state_id;
-            info->redirect_count = 0U;
-            info->terminal       = true;
-            result->status       = P101_FSM_STEP_EXITED;
-            result->next_state   = P101_FSM_STATE_NONE;
+            pool->from_states[session]    = current_state;
+            pool->current_states[session] = decision.next_state;
+            result->status                = P101_FSM_STEP_TRANSITIONED;
+            result->next_state            = decision.next_state;
+            break;
+        case P101_FSM_DECISION_PAUSE:
+            result->status = P101_FSM_STEP_PAUSED;
+            break;
+        case P101_FSM_DECISION_EXIT:
+            pool->from_states[session] = current_state;
+            pool->flags[session]       = (unsigned char)(pool->flags[session] | FSM_POOL_TERMINAL);
+            result->status             = P101_FSM_STEP_EXITED;
+            result->next_state         = P101_FSM_STATE_NONE;
             break;
         case P101_FSM_DECISION_INVALID:
         default:
             result->status  = P101_FSM_STEP_REFUSED;
             result->refusal = P101_FSM_REFUSAL_INVALID_CALLBACK_DECISION;
-            P101_ERROR_RAISE_USER(info->app_err, "FSM callback did not produce a valid decision", P101_FSM_ERROR_INVALID_DECISION);
+            P101_ERROR_RAISE_USER(pool->app_err, "FSM callback did not produce a valid decision", P101_FSM_ERROR_INVALID_DECISION);
             break;
     }
-#ifdef __clang__
-    #pragma clang diagnostic pop
-#endif
-
-done:
-    fsm_complete_step(info, result, started);
-    P101_TRACE_EXIT(env);
-    p101_single_result_ = result->status;
-    goto p101_single_exit_;
+#ifdef __clang__
+    #pragma clang diagnostic pop
+#endif
+
+done:
+    return result->status;
+}
+
+// The header and columns in allocation order; fsm_storage_allocate() pads each the same way.
+static bool fsm_pool_layout(size_t capacity, size_t *size)
+{
+    bool fits;
+
+    *size = 0U;
+    fits  = fsm_storage_reserve(size, 1U, sizeof(struct p101_fsm_pool), _Alignof(struct p101_fsm_pool));
+    fits  = fits && fsm_storage_reserve(size, capacity, sizeof(p101_fsm_state_id), _Alignof(p101_fsm_state_id));
+    fits  = fits && fsm_storage_reserve(size, capacity, sizeof(p101_fsm_state_id), _Alignof(p101_fsm_state_id));
+    fits  = fits && fsm_storage_reserve(size, capacity, sizeof(size_t), _Alignof(size_t));
+    fits  = fits && fsm_storage_reserve(size, capacity, sizeof(unsigned char), 1U);
+
+    return fits;
+}
+
+static p101_fsm_state_func fsm_transition(const struct p101_fsm_transition_map *map, p101_fsm_state_id from_id, p101_fsm_state_id to_id)
+{
+    p101_fsm_state_func           p101_single_result_;
+    struct p101_transition_result result;
+    p101_transition_status        status;
+    size_t                        from_index;
+    size_t                        to_index;
+    size_t                        edge;
+
+    p101_single_result_ = NULL;
+    if(map->index == P101_FSM_TRANSITION_INDEX_DENSE)
+    {
+        // Negative IDs wrap to values above the span and are rejected by the same comparison.
+        from_index = (unsigned int)from_id;
+        to_index   = (unsigned int)to_id;
+        if(from_index < map->dense_span && to_index < map->dense_span)
+        {
+            p101_single_result_ = map->dense[(from_index * map->dense_span) + to_index];
+        }
+        goto p101_single_exit_;
+    }
+    if(map->index == P101_FSM_TRANSITION_INDEX_CSR)
+    {
+        edge = fsm_transition_map_find_csr(map, from_id, to_id, NULL);
+        if(edge < map->transition_count)
+        {
+            p101_single_result_ = map->csr_edges[edge].perform;
+        }
+        goto p101_single_exit_;
+    }
+    if(map->index == P101_FSM_TRANSITION_INDEX_PERFECT_HASH)
+    {
+        edge = fsm_transition_map_find_perfect(map, from_id, to_id);
+        if(edge < map->transition_count)
+        {
+            p101_single_result_ = map->perfect_slots[edge].perform;
+        }
+        goto p101_single_exit_;
+    }
+
+    status = fsm_transition_map_lookup(map, from_id, to_id, &result);
+    if(status == P101_TRANSITION_OK && result.rule_index < map->table.rule_count)
+    {
+        p101_single_result_ = map->performers[result.rule_index];
+    }
+
+p101_single_exit_:
+    return p101_single_result_;
+}
+
+static int fsm_transition_map_create(const struct p101_env *env, struct p101_error *err, struct fsm_storage *storage, const struct p101_fsm_transition transitions[], size_t transition_count, p101_fsm_transition_index index,
+                                     struct p101_fsm_transition_map *map, p101_fsm_state_id *initial_state)
+{
+    int                      p101_single_result_;
+    struct fsm_table_summary summary;
+    bool                     valid;
+
+    P101_TRACE(env);
+    p101_single_result_ = 0;
+    if(transitions == NULL || transition_count == 0U || transition_count > SIZE_MAX / sizeof(*transitions) || map == NULL || initial_state == NULL)
+    {
+        P101_ERROR_RAISE_USER(err, "FSM transition table cannot be empty", P101_FSM_ERROR_INVALID_TRANSITION_TABLE);
+        goto p101_single_exit_;
+    }
+
+    map->index            = P101_FSM_TRANSITION_INDEX_HASH;
+    map->transition_count = transition_count;
+    map->dense_span       = 0U;
+    map->dense            = NULL;
+    map->csr_span         = 0U;
+    map->csr_offsets      = NULL;
+    map->csr_edges        = NULL;
+    map->perfect_seeds    = NULL;
+    map->perfect_slots    = NULL;
+    map->rules            = NULL;
+    map->performers       = NULL;
+    map->slots            = NULL;
+    map->table.rules      = NULL;
+    map->table.slots      = NULL;
+    map->table.rule_count = 0U;
+    map->table.capacity   = 0U;
+
+    valid = fsm_transition_table_scan(transitions, transition_count, &summary);
+    if(!valid)
+    {
+        P101_ERROR_RAISE_USER_PRINTF(err, P101_FSM_ERROR_INVALID_TRANSITION_TABLE, "Invalid FSM transition table entry at index %zu", summary.invalid_index);
+        goto p101_single_exit_;
+    }
+    if(summary.initial_count != 1U)
+    {
+        P101_ERROR_RAISE_USER(err, "FSM transition table must contain exactly one initial transition", P101_FSM_ERROR_INVALID_TRANSITION_TABLE);
+        goto p101_single_exit_;
+    }
+    *initial_state = summary.initial_state;
+
+    index = fsm_transition_map_select(index, transition_count, &summary);
+    if(index == P101_FSM_TRANSITION_INDEX_DENSE)
+    {
+        p101_single_result_ = fsm_transition_map_build_dense(env, err, storage, transitions, summary.span, map);
+    }
+    else if(index == P101_FSM_TRANSITION_INDEX_CSR)
+    {
+        p101_single_result_ = fsm_transition_map_build_csr(env, err, storage, transitions, summary.from_span, map);
+    }
+    else if(index == P101_FSM_TRANSITION_INDEX_PERFECT_HASH)
+    {
+        p101_single_result_ = fsm_transition_map_build_perfect(env, err, storage, transitions, map);
+    }
+    else if(index == P101_FSM_TRANSITION_INDEX_HASH)
+    {
+        p101_single_result_ = fsm_transition_map_build_hash(env, err, storage, transitions, map);
+    }
+    else
+    {
+        P101_ERROR_RAISE_USER(err, "FSM transition index cannot represent the transition table", P101_FSM_ERROR_INVALID_ARGUMENT);
+    }
+
+p101_single_exit_:
+    P101_TRACE_EXIT(env);
+    return p101_single_result_;
+}
+
+static bool fsm_transition_table_scan(const struct p101_fsm_transition transitions[], size_t transition_count, struct fsm_table_summary *summary)
+{
+    bool              p101_single_result_;
+    p101_fsm_state_id maximum_id;
+    p101_fsm_state_id maximum_from_id;
+
+    p101_single_result_    = false;
+    summary->initial_count = 0U;
+    summary->initial_state = P101_FSM_STATE_NONE;
+    summary->invalid_index = 0U;
+    maximum_id             = P101_FSM_INIT;
+    maximum_from_id        = P101_FSM_INIT;
+    for(size_t i = 0U; i < transition_count; ++i)
+    {
+        if((transitions[i].from_id != P101_FSM_INIT && transitions[i].from_id < P101_FSM_USER_START) || transitions[i].to_id < P101_FSM_USER_START || transitions[i].perform == NULL)
+        {
+            summary->invalid_index = i;
+            goto p101_single_exit_;
+        }
+        if(transitions[i].from_id == P101_FSM_INIT)
+        {
+            summary->initial_count++;
+            summary->initial_state = transitions[i].to_id;
+        }
+        if(transitions[i].from_id > maximum_from_id)
+        {
+            maximum_from_id = transitions[i].from_id;
+        }
+        if(transitions[i].to_id > maximum_id)
+        {
+            maximum_id = transitions[i].to_id;
+        }
+    }
+    if(maximum_from_id > maximum_id)
+    {
+        maximum_id = maximum_from_id;
+    }
+
+    // Every validated ID is in [P101_FSM_INIT, maximum_id], so both spans are exact row counts.
+    summary->span       = (size_t)maximum_id + 1U;
+    summary->from_span  = (size_t)maximum_from_id + 1U;
+    p101_single_result_ = true;
+
+p101_single_exit_:
+    return p101_single_result_;
+}
+
+/*
+ * A compact range is indexed directly by [from][to]; the matrix is only
+ * chosen while it stays within a small multiple of the table size. Failing
+ * that, compact source IDs get one CSR row per state, and anything else falls
+ * back to hashing. A requested index is honoured only when its range limit
+ * holds; P101_FSM_TRANSITION_INDEX_AUTOMATIC is returned when it does not.
+ */
+static p101_fsm_transition_index fsm_transition_map_select(p101_fsm_transition_index index, size_t transition_count, const struct fsm_table_summary *summary)
+{
+    bool dense_fits;
+    bool csr_fits;
+
+    dense_fits = summary->span <= FSM_DENSE_MAXIMUM_SPAN;
+    csr_fits   = summary->from_span / FSM_CSR_ROWS_PER_TRANSITION <= transition_count;
+    if(index == P101_FSM_TRANSITION_INDEX_AUTOMATIC)
+    {
+        if(dense_fits && (summary->span * summary->span) / FSM_DENSE_CELLS_PER_TRANSITION <= transition_count)
+        {
+            index = P101_FSM_TRANSITION_INDEX_DENSE;
+        }
+        else if(csr_fits)
+        {
+            index = P101_FSM_TRANSITION_INDEX_CSR;
+        }
+        else
+        {
+            index = P101_FSM_TRANSITION_INDEX_HASH;
+        }
+    }
+    else if((index == P101_FSM_TRANSITION_INDEX_DENSE && !dense_fits) || (index == P101_FSM_TRANSITION_INDEX_CSR && !csr_fits) ||
+            (index != P101_FSM_TRANSITION_INDEX_DENSE && index != P101_FSM_TRANSITION_INDEX_CSR && index != P101_FSM_TRANSITION_INDEX_PERFECT_HASH && index != P101_FSM_TRANSITION_INDEX_HASH))
+    {
+        index = P101_FSM_TRANSITION_INDEX_AUTOMATIC;
+    }
+
+    return index;
+}
+
+/*
+ * Mirrors the allocations made by the builders for the automatically chosen
+ * index, in order, so that storage aligned to max_align_t and at least this
+ * size always fits the map. Returns 0 for a table that cannot be indexed.
+ */
+static size_t fsm_transition_map_storage_size(const struct p101_fsm_transition transitions[], size_t transition_count, size_t offset)
+{
+    size_t                    p101_single_result_;
+    struct fsm_table_summary  summary;
+    p101_fsm_transition_index index;
+    bool                      valid;
+    size_t                    total;
+
+    p101_single_result_ = 0U;
+    if(transitions == NULL || transition_count == 0U || transition_count > SIZE_MAX / sizeof(*transitions))
+    {
+        goto p101_single_exit_;
+    }
+    valid = fsm_transition_table_scan(transitions, transition_count, &summary);
+    if(!valid || summary.initial_count != 1U)
+    {
+        goto p101_single_exit_;
+    }
+
+    total = offset;
+    index = fsm_transition_map_select(P101_FSM_TRANSITION_INDEX_AUTOMATIC, transition_count, &summary);
+    if(index == P101_FSM_TRANSITION_INDEX_DENSE)
+    {
+        valid = fsm_storage_reserve(&total, summary.span * summary.span, sizeof(p101_fsm_state_func), _Alignof(p101_fsm_state_func));
+    }
+    else if(index == P101_FSM_TRANSITION_INDEX_CSR)
+    {
+        valid = fsm_storage_reserve(&total, summary.from_span + 1U, sizeof(size_t), _Alignof(size_t)) && fsm_storage_reserve(&total, transition_count, sizeof(struct fsm_csr_edge), _Alignof(struct fsm_csr_edge));
+    }
+    else if(index == P101_FSM_TRANSITION_INDEX_HASH)
+    {
+        valid = fsm_storage_reserve(&total, transition_count, sizeof(struct p101_transition_rule), _Alignof(struct p101_transition_rule)) &&
+                fsm_storage_reserve(&total, transition_count, sizeof(p101_fsm_state_func), _Alignof(p101_fsm_state_func)) &&
+                fsm_storage_reserve(&total, p101_transition_table_capacity(transition_count), sizeof(struct p101_transition_slot), _Alignof(struct p101_transition_slot));
+    }
+    else
+    {
+        valid = false;
+    }
+    if(valid)
+    {
+        p101_single_result_ = total;
+    }
 
 p101_single_exit_:
     return p101_single_result_;
 }
 
-p101_fsm_run_result p101_fsm_run(struct p101_fsm_info *info, void *arg, struct p101_fsm_effect_sink *sink, struct p101_fsm_step_result *last_result)
+static int fsm_transition_map_build_dense(const struct p101_env *env, struct p101_error *err, struct fsm_storage *storage, const struct p101_fsm_transition transitions[], size_t span, struct p101_fsm_transition_map *map)
 {
-    const struct p101_env      *env;
-    struct p101_fsm_step_result current;
-    p101_fsm_run_result         run_result;
+    int    p101_single_result_;
+    void  *dense_storage;
+    size_t cell;
 
-    env        = info == NULL ? NULL : info->fsm_env;
-    run_result = P101_FSM_RUN_ERROR;
-    P101_TRACE(env);
-    for(;;)    // GCOVR_EXCL_BR_LINE: the loop exits through the typed step outcomes below.
+    p101_single_result_ = 0;
+    dense_storage       = fsm_storage_allocate(env, err, storage, span * span, sizeof(*map->dense), _Alignof(p101_fsm_state_func));
+    map->dense          = (p101_fsm_state_func *)dense_storage;
+    if(map->dense == NULL)
     {
-        p101_fsm_step_status status;
+        goto p101_single_exit_;
+    }
 
-        status = p101_fsm_step(info, arg, sink, &current);
-        if(last_result != NULL)
-        {
-            *last_result = current;
-        }
-        if(info == NULL)
+    for(size_t i = 0U; i < map->transition_count; ++i)
+    {
+        cell = ((size_t)transitions[i].from_id * span) + (size_t)transitions[i].to_id;
+        if(map->dense[cell] != NULL)
         {
-            break;
+            P101_ERROR_RAISE_USER(err, "FSM transition table contains a duplicate transition", P101_FSM_ERROR_INVALID_TRANSITION_TABLE);
+            fsm_transition_map_destroy(env, storage, map);
+            goto p101_single_exit_;
         }
+        map->dense[cell] = transitions[i].perform;
+    }
 
-#ifdef __clang__
-    #pragma clang diagnostic push
-    #pragma clang diagnostic ignored "-Wcovered-switch-default"
-#endif
-        // GCOVR_EXCL_BR_START: p101_fsm_step returns only declared status values.
-        switch(status)
+    map->index          = P101_FSM_TRANSITION_INDEX_DENSE;
+    map->dense_span     = span;
+    p101_single_result_ = 1;
+
+p101_single_exit_:
+    return p101_single_result_;
+}
+
+static int fsm_transition_map_build_csr(const struct p101_env *env, struct p101_error *err, struct fsm_storage *storage, const struct p101_fsm_transition transitions[], size_t span, struct p101_fsm_transition_map *map)
+{
+    int    p101_single_result_;
+    void  *offset_storage;
+    void  *edge_storage;
+    size_t row;
+    size_t edge;
+
+    p101_single_result_ = 0;
+    offset_storage      = fsm_storage_allocate(env, err, storage, span + 1U, sizeof(*map->csr_offsets), _Alignof(size_t));
+    map->csr_offsets    = (size_t *)offset_storage;
+    if(map->csr_offsets == NULL)
+    {
+        goto p101_single_exit_;
+    }
+    edge_storage   = fsm_storage_allocate(env, err, storage, map->transition_count, sizeof(*map->csr_edges), _Alignof(struct fsm_csr_edge));
+    map->csr_edges = (struct fsm_csr_edge *)edge_storage;
+    if(map->csr_edges == NULL)
+    {
+        goto invalid;
+    }
+
+    // Count each row into the slot after it, turn the counts into row starts,
+    // then use each start as that row's insertion cursor.
+    for(size_t i = 0U; i < map->transition_count; ++i)
+    {
+        map->csr_offsets[(size_t)transitions[i].from_id + 1U]++;
+    }
+    for(row = 1U; row <= span; ++row)
+    {
+        map->csr_offsets[row] += map->csr_offsets[row - 1U];
+    }
+    for(size_t i = 0U; i < map->transition_count; ++i)
+    {
+        row                          = (size_t)transitions[i].from_id;
+        edge                         = map->csr_offsets[row]++;
+        map->csr_edges[edge].to_id   = transitions[i].to_id;
+        map->csr_edges[edge].perform = transitions[i].perform;
+    }
+    // Each cursor now sits on the next row's start; shift them back into place.
+    for(row = span; row > 0U; --row)
+    {
+        map->csr_offsets[row] = map->csr_offsets[row - 1U];
+    }
+    map->csr_offsets[0] = 0U;
+
+    for(row = 0U; row < span; ++row)
+    {
+        for(size_t i = map->csr_offsets[row]; i < map->csr_offsets[row + 1U]; ++i)
         {
-            case P101_FSM_STEP_TRANSITIONED:
-                break;
-            case P101_FSM_STEP_PAUSED:
-                run_result = P101_FSM_RUN_PAUSED;
-                goto done;
-            case P101_FSM_STEP_EXITED:
-                run_result = P101_FSM_RUN_EXITED;
-                goto done;
-            case P101_FSM_STEP_REFUSED:
-                if(current.refusal != P101_FSM_REFUSAL_UNKNOWN_TRANSITION || current.next_state == current.attempted_state)
+            for(size_t j = i + 1U; j < map->csr_offsets[row + 1U]; ++j)
+            {
+                if(map->csr_edges[i].to_id == map->csr_edges[j].to_id)
                 {
-                    run_result = P101_FSM_RUN_REFUSED;
-                    goto done;
+                    P101_ERROR_RAISE_USER(err, "FSM transition table contains a duplicate transition", P101_FSM_ERROR_INVALID_TRANSITION_TABLE);
+                    goto invalid;
                 }
-                break;
-            case P101_FSM_STEP_ERROR:
-            default:
-                goto done;
+            }
         }
-            // GCOVR_EXCL_BR_STOP
-#ifdef __clang__
-    #pragma clang diagnostic pop
-#endif
     }
 
-done:
-    P101_TRACE_EXIT(env);
-    return run_result;
-}
+    map->index          = P101_FSM_TRANSITION_INDEX_CSR;
+    map->csr_span       = span;
+    p101_single_result_ = 1;
+    goto p101_single_exit_;
 
-void p101_fsm_exit_immediately(const struct p101_env *env, struct p101_error *err, void *arg, struct p101_fsm_effect_sink *sink, struct p101_fsm_decision *decision)
-{
-    P101_TRACE(env);
-    P101_WRAPPER_FAULT_RETURN_VOID(env, err);
-    (void)arg;
-    (void)sink;
-    p101_fsm_decide_exit(decision);
-    P101_WRAPPER_DONE(env);
+invalid:
+    fsm_transition_map_destroy(env, storage, map);
+
+p101_single_exit_:
+    return p101_single_result_;
 }
 
-static void fsm_complete_step(struct p101_fsm_info *info, struct p101_fsm_step_result *result, bool started)
+static size_t fsm_transition_map_find_csr(const struct p101_fsm_transition_map *map, p101_fsm_state_id from_id, p101_fsm_state_id to_id, size_t *scanned)
 {
-    if(started)
+    size_t p101_single_result_;
+    size_t row;
+    size_t count;
+
+    p101_single_result_ = SIZE_MAX;
+    count               = 0U;
+    row                 = (unsigned int)from_id;
+    if(row < map->csr_span)
     {
-        info->operating = false;
+        for(size_t i = map->csr_offsets[row]; i < map->csr_offsets[row + 1U]; ++i)
+        {
+            count++;
+            if(map->csr_edges[i].to_id == to_id)
+            {
+                p101_single_result_ = i;
+                break;
+            }
+        }
     }
-    if(info->step_observer != NULL && !info->notifying)
+    if(scanned != NULL)
     {
-        info->notifying = true;
-        info->step_observer(info->fsm_env, info, result, info->step_observer_data);
-        info->notifying = false;
+        *scanned = count;
     }
+
+    return p101_single_result_;
 }
 
-static bool fsm_has_error(const struct p101_error *app_err, const struct p101_error *fsm_err)
+/*
+ * CHD-style construction: keys are split into buckets by one hash, then the
+ * largest buckets first search for a seed that sends all of their keys to
+ * distinct free slots of a table with exactly one slot per transition.
+ */
+static int fsm_transition_map_build_perfect(const struct p101_env *env, struct p101_error *err, struct fsm_storage *storage, const struct p101_fsm_transition transitions[], struct p101_fsm_transition_map *map)
 {
-    bool result;
-    bool app_error_present;
-    bool fsm_error_present;
+    int      p101_single_result_;
+    size_t   count;
+    size_t  *bucket_offsets;
+    size_t  *bucket_members;
+    size_t  *candidates;
+    void    *memory;
+    size_t   bucket;
+    size_t   size;
+    size_t   maximum_size;
+    size_t   member;
+    size_t   slot;
+    uint32_t seed;
+    bool     placed;
 
-    app_error_present = p101_error_has_error(app_err);
-    fsm_error_present = p101_error_has_error(fsm_err);
-    result            = false;
-    if(app_error_present || fsm_error_present)
+    p101_single_result_ = 0;
+    count               = map->transition_count;
+    bucket_offsets      = NULL;
+    bucket_members      = NULL;
+    candidates          = NULL;
+    if(count > SIZE_MAX / sizeof(*map->perfect_slots) || count > SIZE_MAX / sizeof(*bucket_members))
     {
-        result = true;
+        P101_ERROR_RAISE_USER(err, "FSM transition table is too large", P101_FSM_ERROR_INVALID_TRANSITION_TABLE);
+        goto p101_single_exit_;
     }
 
-    return result;
-}
+    memory             = fsm_storage_allocate(env, err, storage, count, sizeof(*map->perfect_seeds), _Alignof(uint32_t));
+    map->perfect_seeds = (uint32_t *)memory;
+    if(map->perfect_seeds == NULL)
+    {
+        goto p101_single_exit_;
+    }
+    memory             = fsm_storage_allocate(env, err, storage, count, sizeof(*map->perfect_slots), _Alignof(struct fsm_perfect_slot));
+    map->perfect_slots = (struct fsm_perfect_slot *)memory;
+    if(map->perfect_slots == NULL)
+    {
+        goto invalid;
+    }
+    memory         = fsm_storage_allocate(env, err, storage, count + 1U, sizeof(*bucket_offsets), _Alignof(size_t));
+    bucket_offsets = (size_t *)memory;
+    if(bucket_offsets == NULL)
+    {
+        goto invalid;
+    }
+    memory         = fsm_storage_allocate(env, err, storage, count, sizeof(*bucket_members), _Alignof(size_t));
+    bucket_members = (size_t *)memory;
+    if(bucket_members == NULL)
+    {
+        goto invalid;
+    }
+    memory     = fsm_storage_allocate(env, err, storage, count, sizeof(*candidates), _Alignof(size_t));
+    candidates = (size_t *)memory;
+    if(candidates == NULL)
+    {
+        goto invalid;
+    }
 
-static const char *fsm_info_name_or_default(const struct p101_fsm_info *info)
-{
-    return info == NULL ? "<unnamed>" : info->name;
-}
+    // Group transition indices by bucket with the same counting pass as CSR.
+    for(size_t i = 0U; i < count; ++i)
+    {
+        bucket = (size_t)(fsm_perfect_hash(transitions[i].from_id, transitions[i].to_id, 0U) % count);
+        bucket_offsets[bucket + 1U]++;
+    }
+    maximum_size = 0U;
+    for(bucket = 1U; bucket <= count; ++bucket)
+    {
+        if(bucket_offsets[bucket] > maximum_size)
+        {
+            maximum_size = bucket_offsets[bucket];
+        }
+        bucket_offsets[bucket] += bucket_offsets[bucket - 1U];
+    }
+    for(size_t i = 0U; i < count; ++i)
+    {
+        bucket                 = (size_t)(fsm_perfect_hash(transitions[i].from_id, transitions[i].to_id, 0U) % count);
+        member                 = bucket_offsets[bucket]++;
+        bucket_members[member] = i;
+    }
+    for(bucket = count; bucket > 0U; --bucket)
+    {
+        bucket_offsets[bucket] = bucket_offsets[bucket - 1U];
+    }
+    bucket_offsets[0] = 0U;
 
-static void fsm_prepare_result(struct p101_fsm_step_result *result)
-{
-    if(result != NULL)
+    // Equal keys always share a bucket, so duplicates are found here and never reach the seed search.
+    for(bucket = 0U; bucket < count; ++bucket)
     {
-        result->status          = P101_FSM_STEP_ERROR;
-        result->sequence        = 0U;
-        result->from_state      = P101_FSM_STATE_NONE;
-        result->attempted_state = P101_FSM_STATE_NONE;
-        result->next_state      = P101_FSM_STATE_NONE;
-        result->refusal         = P101_FSM_REFUSAL_NONE;
+        for(size_t i = bucket_offsets[bucket]; i < bucket_offsets[bucket + 1U]; ++i)
+        {
+            for(size_t j = i + 1U; j < bucket_offsets[bucket + 1U]; ++j)
+            {
+                if(transitions[bucket_members[i]].from_id == transitions[bucket_members[j]].from_id && transitions[bucket_members[i]].to_id == transitions[bucket_members[j]].to_id)
+                {
+                    P101_ERROR_RAISE_USER(err, "FSM transition table contains a duplicate transition", P101_FSM_ERROR_INVALID_TRANSITION_TABLE);
+                    goto invalid;
+                }
+            }
+        }
+    }
+
+    for(size = maximum_size; size > 0U; --size)
+    {
+        for(bucket = 0U; bucket < count; ++bucket)
+        {
+            if(bucket_offsets[bucket + 1U] - bucket_offsets[bucket] != size)
+            {
+                continue;
+            }
+
+            placed = false;
+            for(seed = 1U; seed <= FSM_PERFECT_HASH_MAXIMUM_SEED && !placed; ++seed)
+            {
+                placed = true;
+                for(size_t i = 0U; i < size && placed; ++i)
+                {
+                    member        = bucket_members[bucket_offsets[bucket] + i];
+                    candidates[i] = (size_t)(fsm_perfect_hash(transitions[member].from_id, transitions[member].to_id, seed) % count);
+                    placed        = map->perfect_slots[candidates[i]].perform == NULL;
+                    for(size_t j = 0U; j < i && placed; ++j)
+                    {
+                        placed = candidates[j] != candidates[i];
+                    }
+                }
+                if(placed)
+                {
+                    map->perfect_seeds[bucket] = seed;
+                }
+            }
+            if(!placed)
+            {
+                P101_ERROR_RAISE_USER(err, "FSM transition table has no perfect hash within the seed limit", P101_FSM_ERROR_INVALID_TRANSITION_TABLE);
+                goto invalid;
+            }
+
+            for(size_t i = 0U; i < size; ++i)
+            {
+                member                           = bucket_members[bucket_offsets[bucket] + i];
+                slot                             = candidates[i];
+                map->perfect_slots[slot].from_id = transitions[member].from_id;
+                map->perfect_slots[slot].to_id   = transitions[member].to_id;
+                map->perfect_slots[slot].perform = transitions[member].perform;
+            }
+        }
     }
+
+    map->index          = P101_FSM_TRANSITION_INDEX_PERFECT_HASH;
+    p101_single_result_ = 1;
+    goto cleanup;
+
+invalid:
+    fsm_transition_map_destroy(env, storage, map);
+
+cleanup:
+    fsm_storage_free(env, storage, candidates);
+    fsm_storage_free(env, storage, bucket_members);
+    fsm_storage_free(env, storage, bucket_offsets);
+
+p101_single_exit_:
+    return p101_single_result_;
 }
 
-static p101_fsm_state_func fsm_transition(const struct p101_fsm_info *info, p101_fsm_state_id from_id, p101_fsm_state_id to_id)
+static uint64_t fsm_perfect_hash(p101_fsm_state_id from_id, p101_fsm_state_id to_id, uint32_t seed)
 {
-    p101_fsm_state_func           p101_single_result_;
-    struct p101_transition_result result;
-    p101_transition_status        status;
+    uint64_t key;
+
+    // splitmix64 finalizer over the packed pair; the seed perturbs the key before mixing.
+    key = ((uint64_t)(uint32_t)from_id << 32U) | (uint64_t)(uint32_t)to_id;
+    key ^= (uint64_t)seed * UINT64_C(0x9E3779B97F4A7C15);
+    key ^= key >> 30U;
+    key *= UINT64_C(0xBF58476D1CE4E5B9);
+    key ^= key >> 27U;
+    key *= UINT64_C(0x94D049BB133111EB);
+    key ^= key >> 31U;
+
+    return key;
+}
 
-    p101_single_result_ = NULL;
-    status              = fsm_transition_map_lookup(info, from_id, to_id, &result);
-    if(status == P101_TRANSITION_OK && result.rule_index < info->transitions.table.rule_count)
+static size_t fsm_transition_map_find_perfect(const struct p101_fsm_transition_map *map, p101_fsm_state_id from_id, p101_fsm_state_id to_id)
+{
+    size_t p101_single_result_;
+    size_t bucket;
+    size_t slot;
+
+    bucket              = (size_t)(fsm_perfect_hash(from_id, to_id, 0U) % map->transition_count);
+    slot                = (size_t)(fsm_perfect_hash(from_id, to_id, map->perfect_seeds[bucket]) % map->transition_count);
+    p101_single_result_ = SIZE_MAX;
+    if(map->perfect_slots[slot].from_id == from_id && map->perfect_slots[slot].to_id == to_id)
     {
-        p101_single_result_ = info->transitions.performers[result.rule_index];
+        p101_single_result_ = slot;
     }
 
     return p101_single_result_;
 }
 
-static int fsm_transition_map_create(const struct p101_env *env, struct p101_error *err, const struct p101_fsm_transition transitions[], size_t transition_count, struct p101_fsm_transition_map *map, p101_fsm_state_id *initial_state)
+static int fsm_transition_map_build_hash(const struct p101_env *env, struct p101_error *err, struct fsm_storage *storage, const struct p101_fsm_transition transitions[], struct p101_fsm_transition_map *map)
 {
     int                    p101_single_result_;
     size_t                 capacity;
-    size_t                 initial_count;
+    size_t                 transition_count;
     void                  *rule_storage;
     void                  *performer_storage;
     void                  *slot_storage;
     p101_transition_status transition_status;
 
-    P101_TRACE(env);
     p101_single_result_ = 0;
-    if(transitions == NULL || transition_count == 0U || transition_count > SIZE_MAX / sizeof(*transitions) || map == NULL || initial_state == NULL)
-    {
-        P101_ERROR_RAISE_USER(err, "FSM transition table cannot be empty", P101_FSM_ERROR_INVALID_TRANSITION_TABLE);
-        goto p101_single_exit_;
-    }
-
-    capacity = p101_transition_table_capacity(transition_count);
+    transition_count    = map->transition_count;
+    capacity            = p101_transition_table_capacity(transition_count);
     if(capacity == 0U || capacity > SIZE_MAX / sizeof(*map->slots) || transition_count > SIZE_MAX / sizeof(*map->rules) || transition_count > SIZE_MAX / sizeof(*map->performers))
     {
         P101_ERROR_RAISE_USER(err, "FSM transition table is too large", P101_FSM_ERROR_INVALID_TRANSITION_TABLE);
         goto p101_single_exit_;
     }
 
-    rule_storage = p101_calloc(env, err, transition_count, sizeof(*map->rules));
+    rule_storage = fsm_storage_allocate(env, err, storage, transition_count, sizeof(*map->rules), _Alignof(struct p101_transition_rule));
     map->rules   = (struct p101_transition_rule *)rule_storage;
     if(map->rules == NULL)
     {
         goto p101_single_exit_;
     }
-    performer_storage = p101_calloc(env, err, transition_count, sizeof(*map->performers));
+    performer_storage = fsm_storage_allocate(env, err, storage, transition_count, sizeof(*map->performers), _Alignof(p101_fsm_state_func));
     map->performers   = (p101_fsm_state_func *)performer_storage;
     if(map->performers == NULL)
     {
         goto invalid;
     }
-    slot_storage = p101_calloc(env, err, capacity, sizeof(*map->slots));
+    slot_storage = fsm_storage_allocate(env, err, storage, capacity, sizeof(*map->slots), _Alignof(struct p101_transition_slot));
     map->slots   = (struct p101_transition_slot *)slot_storage;
     if(map->slots == NULL)
     {
         goto invalid;
     }
 
-    initial_count = 0U;
     for(size_t i = 0U; i < transition_count; ++i)
     {
-        if((transitions[i].from_id != P101_FSM_INIT && transitions[i].from_id < P101_FSM_USER_START) || transitions[i].to_id < P101_FSM_USER_START || transitions[i].perform == NULL)
-        {
-            P101_ERROR_RAISE_USER_PRINTF(err, P101_FSM_ERROR_INVALID_TRANSITION_TABLE, "Invalid FSM transition table entry at index %zu", i);
-            goto invalid;
-        }
-        if(transitions[i].from_id == P101_FSM_INIT)
-        {
-            initial_count++;
-            *initial_state = transitions[i].to_id;
-        }
         map->rules[i].state      = transitions[i].from_id;
         map->rules[i].event      = transitions[i].to_id;
         map->rules[i].next_state = transitions[i].to_id;
@@ -862,12 +2590,6 @@ static int fsm_transition_map_create(const struct p101_env *env, struct p101_err
         map->performers[i]       = transitions[i].perform;
     }
 
-    if(initial_count != 1U)
-    {
-        P101_ERROR_RAISE_USER(err, "FSM transition table must contain exactly one initial transition", P101_FSM_ERROR_INVALID_TRANSITION_TABLE);
-        goto invalid;
-    }
-
     transition_status = p101_transition_table_initialize(&map->table, map->rules, transition_count, map->slots, capacity);
     if(transition_status != P101_TRANSITION_OK)
     {
@@ -878,20 +2600,31 @@ static int fsm_transition_map_create(const struct p101_env *env, struct p101_err
     goto p101_single_exit_;
 
 invalid:
-    fsm_transition_map_destroy(env, map);
+    fsm_transition_map_destroy(env, storage, map);
 
 p101_single_exit_:
-    P101_TRACE_EXIT(env);
     return p101_single_result_;
 }
 
-static void fsm_transition_map_destroy(const struct p101_env *env, struct p101_fsm_transition_map *map)
+static void fsm_transition_map_destroy(const struct p101_env *env, const struct fsm_storage *storage, struct p101_fsm_transition_map *map)
 {
     if(map != NULL)
     {
-        p101_free(env, map->slots);
-        p101_free(env, (void *)map->performers);
-        p101_free(env, map->rules);
+        fsm_storage_free(env, storage, (void *)map->dense);
+        fsm_storage_free(env, storage, map->csr_edges);
+        fsm_storage_free(env, storage, map->csr_offsets);
+        fsm_storage_free(env, storage, map->perfect_slots);
+        fsm_storage_free(env, storage, map->perfect_seeds);
+        fsm_storage_free(env, storage, map->slots);
+        fsm_storage_free(env, storage, (void *)map->performers);
+        fsm_storage_free(env, storage, map->rules);
+        map->dense            = NULL;
+        map->dense_span       = 0U;
+        map->csr_edges        = NULL;
+        map->csr_offsets      = NULL;
+        map->csr_span         = 0U;
+        map->perfect_slots    = NULL;
+        map->perfect_seeds    = NULL;
         map->slots            = NULL;
         map->performers       = NULL;
         map->rules            = NULL;
@@ -902,19 +2635,81 @@ static void fsm_transition_map_destroy(const struct p101_env *env, struct p101_f
     }
 }
 
-static p101_transition_status fsm_transition_map_lookup(const struct p101_fsm_info *info, p101_fsm_state_id from_id, p101_fsm_state_id to_id, struct p101_transition_result *result)
+static void *fsm_storage_allocate(const struct p101_env *env, struct p101_error *err, struct fsm_storage *storage, size_t count, size_t size, size_t align)
+{
+    void     *p101_single_result_;
+    uintptr_t address;
+    size_t    padding;
+    size_t    available;
+
+    if(storage == NULL)
+    {
+        p101_single_result_ = p101_calloc(env, err, count, size);
+        goto p101_single_exit_;
+    }
+
+    p101_single_result_ = NULL;
+    address             = (uintptr_t)(storage->base + storage->used);
+    padding             = (size_t)((align - (address % align)) % align);
+    available           = storage->size - storage->used;
+    if(padding > available || (count != 0U && size > (available - padding) / count))
+    {
+        P101_ERROR_RAISE_USER(err, "FSM storage is too small", P101_FSM_ERROR_INVALID_ARGUMENT);
+        goto p101_single_exit_;
+    }
+    p101_single_result_ = storage->base + storage->used + padding;
+    storage->used += padding + (count * size);
+    p101_memset(env, p101_single_result_, 0, count * size);
+
+p101_single_exit_:
+    return p101_single_result_;
+}
+
+static void fsm_storage_free(const struct p101_env *env, const struct fsm_storage *storage, void *memory)
+{
+    // Caller storage is released by its owner as a whole.
+    if(storage == NULL)
+    {
+        p101_free(env, memory);
+    }
+}
+
+static bool fsm_storage_reserve(size_t *total, size_t count, size_t size, size_t align)
+{
+    bool   p101_single_result_;
+    size_t padding;
+
+    p101_single_result_ = false;
+    padding             = (align - (*total % align)) % align;
+    if(padding > SIZE_MAX - *total || (count != 0U && size > (SIZE_MAX - *total - padding) / count))
+    {
+        goto p101_single_exit_;
+    }
+    *total += padding + (count * size);
+    p101_single_result_ = true;
+
+p101_single_exit_:
+    return p101_single_result_;
+}
+
+static p101_transition_status fsm_transition_map_lookup(const struct p101_fsm_transition_map *map, p101_fsm_state_id from_id, p101_fsm_state_id to_id, struct p101_transition_result *result)
 {
     p101_transition_status p101_single_result_;
 
     p101_single_result_ = P101_TRANSITION_INVALID_ARGUMENT;
-    if(info != NULL)
+    if(map != NULL)
     {
-        p101_single_result_ = p101_transition_table_find(&info->transitions.table, from_id, to_id, result);
+        p101_single_result_ = p101_transition_table_find(&map->table, from_id, to_id, result);
     }
 
     return p101_single_result_;
 }
 
+const struct p101_env *p101_fsm_info_run_env(const struct p101_fsm_info *info)
+{
+    return info == NULL ? NULL : info->fsm_env;
+}
+
 #ifdef P101_FSM_TESTING
 void p101_fsm_test_set_step_sequence(struct p101_fsm_info *info, size_t sequence)
 {
@@ -924,6 +2719,16 @@ void p101_fsm_test_set_step_sequence(struct p101_fsm_info *info, size_t sequence
     }
 }
 
+bool p101_fsm_test_uses_plain_step(const struct p101_fsm_info *info)
+{
+    return info != NULL && info->step == fsm_step_plain;
+}
+
+p101_fsm_state_func p101_fsm_test_cached_perform(const struct p101_fsm_info *info)
+{
+    return info == NULL ? NULL : info->current_perform;
+}
+
 size_t p101_fsm_test_transition_probe_count(const struct p101_fsm_info *info, p101_fsm_state_id from_id, p101_fsm_state_id to_id)
 {
     size_t                        p101_single_result_;
@@ -935,7 +2740,17 @@ size_t p101_fsm_test_transition_probe_count(const struct p101_fsm_info *info, p1
     {
         goto p101_single_exit_;
     }
-    status = fsm_transition_map_lookup(info, from_id, to_id, &result);
+    if(info->definition->transitions.index == P101_FSM_TRANSITION_INDEX_DENSE || info->definition->transitions.index == P101_FSM_TRANSITION_INDEX_PERFECT_HASH)
+    {
+        p101_single_result_ = 1U;
+        goto p101_single_exit_;
+    }
+    if(info->definition->transitions.index == P101_FSM_TRANSITION_INDEX_CSR)
+    {
+        (void)fsm_transition_map_find_csr(&info->definition->transitions, from_id, to_id, &p101_single_result_);
+        goto p101_single_exit_;
+    }
+    status = fsm_transition_map_lookup(&info->definition->transitions, from_id, to_id, &result);
     (void)status;
     p101_single_result_ = result.probes;
 
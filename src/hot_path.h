@@ -0,0 +1,48 @@
+#ifndef LIBP101_FSM_HOT_PATH_H
+#define LIBP101_FSM_HOT_PATH_H
+
+/*
+ * Copyright 2021-2026 D'Arcy Smith.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <p101_c/p101_string.h>
+#include <p101_env/wrapper.h>
+#include <string.h>
+
+/*
+ * Hooks on the per-step and per-effect paths. The instrumented build traces
+ * and fault-checks them like every other entry point. Building with
+ * P101_FSM_LEAN (the p101_fsm_fast target) compiles them out and calls libc
+ * directly; argument checks and raised FSM errors are unchanged.
+ */
+#ifdef P101_FSM_LEAN
+    #define P101_FSM_HOT_TRACE(env) (void)(env)
+    #define P101_FSM_HOT_TRACE_EXIT(env) (void)(env)
+    #define P101_FSM_HOT_FAULT_RETURN(env, err, var, val) (void)(err)
+    #define P101_FSM_HOT_FAULT_RETURN_VOID(env, err) (void)(err)
+    #define P101_FSM_HOT_DONE(env) (void)(env)
+    #define P101_FSM_HOT_STRLEN(env, s) ((void)(env), strlen(s))
+    #define P101_FSM_HOT_MEMCPY(env, dest, src, n) ((void)(env), memcpy((dest), (src), (n)))
+#else
+    #define P101_FSM_HOT_TRACE(env) P101_TRACE(env)
+    #define P101_FSM_HOT_TRACE_EXIT(env) P101_TRACE_EXIT(env)
+    #define P101_FSM_HOT_FAULT_RETURN(env, err, var, val) P101_WRAPPER_FAULT_RETURN(env, err, var, val)
+    #define P101_FSM_HOT_FAULT_RETURN_VOID(env, err) P101_WRAPPER_FAULT_RETURN_VOID(env, err)
+    #define P101_FSM_HOT_DONE(env) P101_WRAPPER_DONE(env)
+    #define P101_FSM_HOT_STRLEN(env, s) p101_strlen((env), (s))
+    #define P101_FSM_HOT_MEMCPY(env, dest, src, n) p101_memcpy((env), (dest), (src), (n))
+#endif
+
+#endif    // LIBP101_FSM_HOT_PATH_H
@@ -0,0 +1,681 @@
+/*
+ * Copyright 2021-2026 D'Arcy Smith.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "p101_fsm/errors.h"
+#include "p101_fsm/fsm.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <p101_c/p101_stdlib.h>
+#include <p101_c/p101_string.h>
+#include <p101_env/wrapper.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * Every record is a header of the body length, the CRC-32 of the length and
+ * the CRC-32 of the body, then the body: sequence, the three states and the
+ * effect count, then each effect as its kind size, data size, NUL-terminated
+ * kind and data. All integers are little-endian; the machine and argument
+ * are process-local and are not written.
+ */
+#define FSM_JOURNAL_HEADER_SIZE 12U
+#define FSM_JOURNAL_FIXED_SIZE 24U
+#define FSM_JOURNAL_EFFECT_SIZE 8U
+
+struct p101_fsm_journal
+{
+    unsigned char  *buffer;
+    size_t          capacity;
+    size_t          used;
+    size_t          sync_bytes;
+    unsigned int    sync_interval_ms;
+    size_t          unsynced_bytes;
+    struct timespec last_sync;
+    uint64_t        record_count;
+    uint64_t        durable_count;
+    uint64_t        sync_count;
+    int             fd;
+    int             failed_errno;
+};
+
+// The effects of one append are serialised into the journal buffer at out.
+struct journal_append
+{
+    unsigned char *out;
+};
+
+static void     journal_append_span(const struct p101_env *env, struct p101_error *err, void *context, const struct p101_fsm_effect effects[], size_t count);
+static size_t   journal_record_size(const struct p101_env *env, const struct p101_fsm_step_receipt *receipt);
+static int      journal_make_room(const struct p101_env *env, struct p101_error *err, struct p101_fsm_journal *journal, size_t size);
+static int      journal_write(const struct p101_env *env, struct p101_error *err, struct p101_fsm_journal *journal);
+static bool     journal_sync_due(const struct p101_fsm_journal *journal);
+static int      journal_read(int fd, unsigned char *buffer, size_t size, size_t *read_size);
+static uint32_t journal_crc32(const unsigned char *bytes, size_t size);
+static void     journal_put_u32(unsigned char *out, uint32_t value);
+static void     journal_put_u64(unsigned char *out, uint64_t value);
+static uint32_t journal_get_u32(const unsigned char *in);
+static uint64_t journal_get_u64(const unsigned char *in);
+
+struct p101_fsm_journal *p101_fsm_journal_open(const struct p101_env *env, struct p101_error *err, const char *path, size_t buffer_size, size_t sync_bytes, unsigned int sync_interval_ms)
+{
+    struct p101_fsm_journal *journal;
+
+    P101_TRACE(env);
+    P101_WRAPPER_FAULT_RETURN(env, err, journal, NULL);
+    journal = NULL;
+    if(path == NULL || buffer_size < FSM_JOURNAL_HEADER_SIZE + FSM_JOURNAL_FIXED_SIZE)
+    {
+        P101_ERROR_RAISE_USER(err, "FSM journal needs a path and a buffer that holds a record", P101_FSM_ERROR_INVALID_ARGUMENT);
+        goto done;
+    }
+
+    journal = (struct p101_fsm_journal *)p101_calloc(env, err, 1U, sizeof(*journal));
+    if(journal == NULL)
+    {
+        goto done;
+    }
+    journal->buffer = (unsigned char *)p101_calloc(env, err, buffer_size, 1U);
+    if(journal->buffer == NULL)
+    {
+        p101_free(env, journal);
+        journal = NULL;
+        goto done;
+    }
+    journal->fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    if(journal->fd == -1)
+    {
+        P101_ERROR_RAISE_ERRNO(err, errno);
+        p101_free(env, journal->buffer);
+        p101_free(env, journal);
+        journal = NULL;
+        goto done;
+    }
+    journal->capacity         = buffer_size;
+    journal->sync_bytes       = sync_bytes;
+    journal->sync_interval_ms = sync_interval_ms;
+    (void)clock_gettime(CLOCK_MONOTONIC, &journal->last_sync);
+
+done:
+    P101_WRAPPER_DONE(env);
+    return journal;
+}
+
+int p101_fsm_journal_close(const struct p101_env *env, struct p101_error *err, struct p101_fsm_journal **journal)
+{
+    int return_value;
+
+    P101_TRACE(env);
+    return_value = 0;
+    if(journal != NULL && *journal != NULL)
+    {
+        // The descriptor and buffer are released even when the final sync fails.
+        return_value = p101_fsm_journal_sync(env, err, *journal);
+        if(close((*journal)->fd) == -1 && return_value == 0)
+        {
+            P101_ERROR_RAISE_ERRNO(err, errno);
+            return_value = -1;
+        }
+        p101_free(env, (*journal)->buffer);
+        p101_free(env, *journal);
+        *journal = NULL;
+    }
+    P101_TRACE_EXIT(env);
+    return return_value;
+}
+
+int p101_fsm_journal_append(const struct p101_env *env, struct p101_error *err, struct p101_fsm_journal *journal, struct p101_fsm_effect_batch *batch, const struct p101_fsm_step_receipt *receipt)
+{
+    struct journal_append            append;
+    struct p101_fsm_effect_span_sink target;
+    unsigned char                   *record;
+    size_t                           size;
+    uint32_t                         body_size;
+    int                              return_value;
+
+    P101_TRACE(env);
+    P101_WRAPPER_FAULT_RETURN(env, err, return_value, -1);
+    return_value = -1;
+    record       = NULL;
+    size         = 0U;
+    if(journal == NULL || receipt == NULL)
+    {
+        P101_ERROR_RAISE_USER(err, "FSM journal append needs a journal and a receipt", P101_FSM_ERROR_INVALID_ARGUMENT);
+        goto done;
+    }
+    if(journal->failed_errno != 0)
+    {
+        P101_ERROR_RAISE_ERRNO(err, journal->failed_errno);
+        goto done;
+    }
+
+    // Room is made before the batch is consumed, so a record that cannot be written leaves the batch staged.
+    if(receipt->disposition == P101_FSM_TRANSITION_APPLIED_CHANGED)
+    {
+        size = journal_record_size(env, receipt);
+        if(size > UINT32_MAX)
+        {
+            P101_ERROR_RAISE_USER(err, "FSM journal record is too large", P101_FSM_ERROR_EFFECT_CAPACITY);
+            goto done;
+        }
+        if(journal_make_room(env, err, journal, size) != 0)
+        {
+            goto done;
+        }
+        record = &journal->buffer[journal->used];
+    }
+
+    append.out     = record == NULL ? NULL : record + FSM_JOURNAL_HEADER_SIZE + FSM_JOURNAL_FIXED_SIZE;
+    target.handle  = journal_append_span;
+    target.context = &append;
+    if(p101_fsm_effect_batch_finish_receipt_span(env, err, batch, receipt, &target) != 0)
+    {
+        goto done;
+    }
+
+    return_value = 0;
+    if(record != NULL)
+    {
+        body_size = (uint32_t)(size - FSM_JOURNAL_HEADER_SIZE);
+        journal_put_u64(record + FSM_JOURNAL_HEADER_SIZE, (uint64_t)receipt->result.sequence);
+        journal_put_u32(record + FSM_JOURNAL_HEADER_SIZE + 8U, (uint32_t)receipt->result.from_state);
+        journal_put_u32(record + FSM_JOURNAL_HEADER_SIZE + 12U, (uint32_t)receipt->result.attempted_state);
+        journal_put_u32(record + FSM_JOURNAL_HEADER_SIZE + 16U, (uint32_t)receipt->result.next_state);
+        journal_put_u32(record + FSM_JOURNAL_HEADER_SIZE + 20U, (uint32_t)receipt->effect_count);
+        journal_put_u32(record, body_size);
+        journal_put_u32(record + 4U, journal_crc32(record, 4U));
+        journal_put_u32(record + 8U, journal_crc32(record + FSM_JOURNAL_HEADER_SIZE, body_size));
+        journal->used += size;
+        journal->unsynced_bytes += size;
+        journal->record_count++;
+
+        // The record is buffered either way; a failed sync fails the journal for every later call.
+        if(journal_sync_due(journal))
+        {
+            return_value = p101_fsm_journal_sync(env, err, journal);
+        }
+    }
+
+done:
+    P101_WRAPPER_DONE(env);
+    return return_value;
+}
+
+int p101_fsm_journal_sync(const struct p101_env *env, struct p101_error *err, struct p101_fsm_journal *journal)
+{
+    int return_value;
+
+    P101_TRACE(env);
+    P101_WRAPPER_FAULT_RETURN(env, err, return_value, -1);
+    return_value = -1;
+    if(journal == NULL)
+    {
+        P101_ERROR_RAISE_USER(err, "FSM journal cannot be NULL", P101_FSM_ERROR_INVALID_ARGUMENT);
+        goto done;
+    }
+
+    // After a failed fsync the kernel may have dropped the dirty pages and a retry can succeed, so the failure is never retried.
+    if(journal->failed_errno != 0)
+    {
+        P101_ERROR_RAISE_ERRNO(err, journal->failed_errno);
+        goto done;
+    }
+    if(journal->unsynced_bytes > 0U)
+    {
+        if(journal_write(env, err, journal) != 0)
+        {
+            goto done;
+        }
+        if(fsync(journal->fd) == -1)
+        {
+            journal->failed_errno = errno;
+            P101_ERROR_RAISE_ERRNO(err, journal->failed_errno);
+            goto done;
+        }
+        journal->unsynced_bytes = 0U;
+        journal->durable_count  = journal->record_count;
+        journal->sync_count++;
+    }
+    (void)clock_gettime(CLOCK_MONOTONIC, &journal->last_sync);
+    return_value = 0;
+
+done:
+    P101_WRAPPER_DONE(env);
+    return return_value;
+}
+
+uint64_t p101_fsm_journal_get_records(const struct p101_env *env, const struct p101_fsm_journal *journal)
+{
+    uint64_t records;
+
+    P101_TRACE(env);
+    records = journal == NULL ? 0U : journal->record_count;
+    P101_TRACE_EXIT(env);
+    return records;
+}
+
+uint64_t p101_fsm_journal_get_durable_records(const struct p101_env *env, const struct p101_fsm_journal *journal)
+{
+    uint64_t records;
+
+    P101_TRACE(env);
+    records = journal == NULL ? 0U : journal->durable_count;
+    P101_TRACE_EXIT(env);
+    return records;
+}
+
+uint64_t p101_fsm_journal_get_syncs(const struct p101_env *env, const struct p101_fsm_journal *journal)
+{
+    uint64_t syncs;
+
+    P101_TRACE(env);
+    syncs = journal == NULL ? 0U : journal->sync_count;
+    P101_TRACE_EXIT(env);
+    return syncs;
+}
+
+int p101_fsm_journal_replay(const struct p101_env *env, struct p101_error *err, const char *path, p101_fsm_journal_replay_func handler, void *context)
+{
+    struct p101_fsm_journal_record record;
+    struct stat                    file_status;
+    struct p101_fsm_effect        *effects;
+    unsigned char                  header[FSM_JOURNAL_HEADER_SIZE];
+    unsigned char                 *body;
+    size_t                         body_capacity;
+    size_t                         effect_capacity;
+    size_t                         read_size;
+    off_t                          remaining;
+    int                            fd;
+    int                            return_value;
+
+    P101_TRACE(env);
+    P101_WRAPPER_FAULT_RETURN(env, err, return_value, -1);
+    return_value    = -1;
+    body            = NULL;
+    body_capacity   = 0U;
+    effects         = NULL;
+    effect_capacity = 0U;
+    fd              = -1;
+    if(path == NULL || handler == NULL)
+    {
+        P101_ERROR_RAISE_USER(err, "FSM journal replay needs a path and a handler", P101_FSM_ERROR_INVALID_ARGUMENT);
+        goto done;
+    }
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if(fd == -1 || fstat(fd, &file_status) == -1)
+    {
+        P101_ERROR_RAISE_ERRNO(err, errno);
+        goto done;
+    }
+    remaining = file_status.st_size;
+
+    // A record cut short at the end of the file is a write the crash interrupted, so replay stops cleanly before it.
+    if(journal_read(fd, header, sizeof(header), &read_size) != 0)
+    {
+        P101_ERROR_RAISE_ERRNO(err, errno);
+        goto done;
+    }
+    while(read_size == sizeof(header))
+    {
+        const unsigned char *cursor;
+        const unsigned char *end;
+        size_t               body_size;
+
+        remaining -= (off_t)sizeof(header);
+        body_size = journal_get_u32(header);
+        if(journal_crc32(header, 4U) != journal_get_u32(header + 4U) || body_size < FSM_JOURNAL_FIXED_SIZE)
+        {
+            P101_ERROR_RAISE_USER(err, "FSM journal record is corrupt", P101_FSM_ERROR_JOURNAL_CORRUPT);
+            goto done;
+        }
+
+        // The length is checked, so a body that runs past the end of the file is the torn tail and nothing is allocated for it.
+        if((off_t)body_size > remaining)
+        {
+            return_value = 0;
+            goto done;
+        }
+        if(body_size > body_capacity)
+        {
+            unsigned char *grown;
+
+            grown = (unsigned char *)p101_realloc(env, err, body, body_size);
+            if(grown == NULL)
+            {
+                goto done;
+            }
+            body          = grown;
+            body_capacity = body_size;
+        }
+        if(journal_read(fd, body, body_size, &read_size) != 0)
+        {
+            P101_ERROR_RAISE_ERRNO(err, errno);
+            goto done;
+        }
+        if(read_size < body_size)
+        {
+            return_value = 0;
+            goto done;
+        }
+        remaining -= (off_t)body_size;
+        if(journal_crc32(body, body_size) != journal_get_u32(header + 8U))
+        {
+            P101_ERROR_RAISE_USER(err, "FSM journal record is corrupt", P101_FSM_ERROR_JOURNAL_CORRUPT);
+            goto done;
+        }
+
+        record.sequence        = (size_t)journal_get_u64(body);
+        record.from_state      = (p101_fsm_state_id)journal_get_u32(body + 8U);
+        record.attempted_state = (p101_fsm_state_id)journal_get_u32(body + 12U);
+        record.next_state      = (p101_fsm_state_id)journal_get_u32(body + 16U);
+        record.effect_count    = journal_get_u32(body + 20U);
+        if(record.effect_count > (body_size - FSM_JOURNAL_FIXED_SIZE) / FSM_JOURNAL_EFFECT_SIZE)
+        {
+            P101_ERROR_RAISE_USER(err, "FSM journal record is corrupt", P101_FSM_ERROR_JOURNAL_CORRUPT);
+            goto done;
+        }
+        if(record.effect_count > effect_capacity)
+        {
+            struct p101_fsm_effect *grown;
+
+            grown = (struct p101_fsm_effect *)p101_realloc(env, err, effects, record.effect_count * sizeof(*effects));
+            if(grown == NULL)
+            {
+                goto done;
+            }
+            effects         = grown;
+            effect_capacity = record.effect_count;
+        }
+
+        // The checksum matched, so a size that overruns the body was written that way and is corrupt, not torn.
+        cursor = body + FSM_JOURNAL_FIXED_SIZE;
+        end    = body + body_size;
+        for(size_t index = 0U; index < record.effect_count; ++index)
+        {
+            size_t kind_size;
+            size_t data_size;
+
+            if((size_t)(end - cursor) < FSM_JOURNAL_EFFECT_SIZE)
+            {
+                P101_ERROR_RAISE_USER(err, "FSM journal record is corrupt", P101_FSM_ERROR_JOURNAL_CORRUPT);
+                goto done;
+            }
+            kind_size = journal_get_u32(cursor);
+            data_size = journal_get_u32(cursor + 4U);
+            cursor += FSM_JOURNAL_EFFECT_SIZE;
+            if(kind_size == 0U || kind_size > (size_t)(end - cursor) || data_size > (size_t)(end - cursor) - kind_size || cursor[kind_size - 1U] != '\0')
+            {
+                P101_ERROR_RAISE_USER(err, "FSM journal record is corrupt", P101_FSM_ERROR_JOURNAL_CORRUPT);
+                goto done;
+            }
+            effects[index].kind      = (const char *)cursor;
+            effects[index].data      = data_size == 0U ? NULL : cursor + kind_size;
+            effects[index].data_size = data_size;
+            effects[index].kind_id   = P101_FSM_EFFECT_KIND_NONE;
+            cursor += kind_size + data_size;
+        }
+
+        handler(env, err, context, &record, effects);
+        if(p101_error_has_error(err))
+        {
+            goto done;
+        }
+        if(journal_read(fd, header, sizeof(header), &read_size) != 0)
+        {
+            P101_ERROR_RAISE_ERRNO(err, errno);
+            goto done;
+        }
+    }
+    return_value = 0;
+
+done:
+    if(fd != -1)
+    {
+        (void)close(fd);
+    }
+    p101_free(env, effects);
+    p101_free(env, body);
+    P101_WRAPPER_DONE(env);
+    return return_value;
+}
+
+static void journal_append_span(const struct p101_env *env, struct p101_error *err, void *context, const struct p101_fsm_effect effects[], size_t count)
+{
+    struct journal_append *append;
+    unsigned char         *out;
+
+    (void)err;
+    append = (struct journal_append *)context;
+    out    = append->out;
+    for(size_t index = 0U; index < count; ++index)
+    {
+        size_t kind_size;
+
+        kind_size = p101_strlen(env, effects[index].kind) + 1U;
+        journal_put_u32(out, (uint32_t)kind_size);
+        journal_put_u32(out + 4U, (uint32_t)effects[index].data_size);
+        out += FSM_JOURNAL_EFFECT_SIZE;
+        p101_memcpy(env, out, effects[index].kind, kind_size);
+        out += kind_size;
+        if(effects[index].data_size > 0U)
+        {
+            p101_memcpy(env, out, effects[index].data, effects[index].data_size);
+            out += effects[index].data_size;
+        }
+    }
+}
+
+// SIZE_MAX when the record cannot be written; an effect the receipt cannot produce is left for finish_receipt_span to report.
+static size_t journal_record_size(const struct p101_env *env, const struct p101_fsm_step_receipt *receipt)
+{
+    struct p101_fsm_effect effect;
+    size_t                 size;
+
+    size = FSM_JOURNAL_HEADER_SIZE + FSM_JOURNAL_FIXED_SIZE;
+    for(size_t index = 0U; size <= UINT32_MAX && index < receipt->effect_count && p101_fsm_step_receipt_effect(receipt, index, &effect); ++index)
+    {
+        size_t kind_size;
+
+        kind_size = p101_strlen(env, effect.kind) + 1U;
+        if(kind_size > UINT32_MAX || effect.data_size > UINT32_MAX)
+        {
+            size = SIZE_MAX;
+        }
+        else
+        {
+            size += FSM_JOURNAL_EFFECT_SIZE + kind_size + effect.data_size;
+        }
+    }
+
+    return size;
+}
+
+// Writes out what is buffered when the record does not fit behind it, and grows the buffer for a record larger than it.
+static int journal_make_room(const struct p101_env *env, struct p101_error *err, struct p101_fsm_journal *journal, size_t size)
+{
+    int return_value;
+
+    return_value = -1;
+    if(size > journal->capacity - journal->used && journal_write(env, err, journal) != 0)
+    {
+        goto done;
+    }
+    if(size > journal->capacity)
+    {
+        unsigned char *grown;
+
+        grown = (unsigned char *)p101_realloc(env, err, journal->buffer, size);
+        if(grown == NULL)
+        {
+            goto done;
+        }
+        journal->buffer   = grown;
+        journal->capacity = size;
+    }
+    return_value = 0;
+
+done:
+    return return_value;
+}
+
+// Bytes that reached the file are dropped from the buffer even when a later write fails; the failure is kept for the journal.
+static int journal_write(const struct p101_env *env, struct p101_error *err, struct p101_fsm_journal *journal)
+{
+    size_t  written;
+    ssize_t result;
+    int     return_value;
+
+    return_value = -1;
+    written      = 0U;
+    while(written < journal->used)
+    {
+        result = write(journal->fd, journal->buffer + written, journal->used - written);
+        if(result == -1 && errno != EINTR)
+        {
+            journal->failed_errno = errno;
+            P101_ERROR_RAISE_ERRNO(err, journal->failed_errno);
+            goto done;
+        }
+        if(result > 0)
+        {
+            written += (size_t)result;
+        }
+    }
+    return_value = 0;
+
+done:
+    if(written > 0U)
+    {
+        p101_memmove(env, journal->buffer, journal->buffer + written, journal->used - written);
+        journal->used -= written;
+    }
+    return return_value;
+}
+
+/*
+ * Group commit: a sync is due once sync_bytes are unsynced or the interval
+ * has passed since the last sync. With neither set every append syncs.
+ */
+static bool journal_sync_due(const struct p101_fsm_journal *journal)
+{
+    struct timespec now;
+    long long       elapsed_ms;
+    bool            due;
+
+    due = journal->sync_bytes == 0U && journal->sync_interval_ms == 0U;
+    if(journal->sync_bytes > 0U && journal->unsynced_bytes >= journal->sync_bytes)
+    {
+        due = true;
+    }
+    if(!due && journal->sync_interval_ms > 0U)
+    {
+        now.tv_sec  = 0;
+        now.tv_nsec = 0;
+        (void)clock_gettime(CLOCK_MONOTONIC, &now);
+        elapsed_ms = ((long long)now.tv_sec - (long long)journal->last_sync.tv_sec) * 1000LL + ((long long)now.tv_nsec - (long long)journal->last_sync.tv_nsec) / 1000000LL;
+        due        = elapsed_ms >= (long long)journal->sync_interval_ms;
+    }
+
+    return due;
+}
+
+// Reads until size bytes or the end of the file; *read_size is short only at the end.
+static int journal_read(int fd, unsigned char *buffer, size_t size, size_t *read_size)
+{
+    ssize_t result;
+    int     return_value;
+
+    return_value = -1;
+    *read_size   = 0U;
+    result       = 1;
+    while(*read_size < size && result != 0)
+    {
+        result = read(fd, buffer + *read_size, size - *read_size);
+        if(result == -1 && errno != EINTR)
+        {
+            goto done;
+        }
+        if(result > 0)
+        {
+            *read_size += (size_t)result;
+        }
+    }
+    return_value = 0;
+
+done:
+    return return_value;
+}
+
+// CRC-32 (IEEE, reflected) a nibble at a time, trading some speed for a 16-entry table.
+static uint32_t journal_crc32(const unsigned char *bytes, size_t size)
+{
+    static const uint32_t table[16] = {
+        0x00000000U,
+        0x1DB71064U,
+        0x3B6E20C8U,
+        0x26D930ACU,
+        0x76DC4190U,
+        0x6B6B51F4U,
+        0x4DB26158U,
+        0x5005713CU,
+        0xEDB88320U,
+        0xF00F9344U,
+        0xD6D6A3E8U,
+        0xCB61B38CU,
+        0x9B64C2B0U,
+        0x86D3D2D4U,
+        0xA00AE278U,
+        0xBDBDF21CU,
+    };
+    uint32_t crc;
+
+    crc = 0xFFFFFFFFU;
+    for(size_t index = 0U; index < size; ++index)
+    {
+        crc ^= bytes[index];
+        crc = (crc >> 4U) ^ table[crc & 0x0FU];
+        crc = (crc >> 4U) ^ table[crc & 0x0FU];
+    }
+
+    return crc ^ 0xFFFFFFFFU;
+}
+
+static void journal_put_u32(unsigned char *out, uint32_t value)
+{
+    for(size_t index = 0U; index < 4U; ++index)
+    {
+        out[index] = (unsigned char)(value >> (index * 8U));
+    }
+}
+
+static void journal_put_u64(unsigned char *out, uint64_t value)
+{
+    journal_put_u32(out, (uint32_t)value);
+    journal_put_u32(out + 4U, (uint32_t)(value >> 32U));
+}
+
+static uint32_t journal_get_u32(const unsigned char *in)
+{
+    return (uint32_t)in[0] | (uint32_t)in[1] << 8U | (uint32_t)in[2] << 16U | (uint32_t)in[3] << 24U;
+}
+
+static uint64_t journal_get_u64(const unsigned char *in)
+{
+    return (uint64_t)journal_get_u32(in) | (uint64_t)journal_get_u32(in + 4U) << 32U;
+}
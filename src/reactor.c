@@ -0,0 +1,329 @@
+/*
+ * Copyright 2021-2026 D'Arcy Smith.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "p101_fsm/errors.h"
+#include "p101_fsm/fsm.h"
+#include <errno.h>
+#include <p101_c/p101_stdlib.h>
+#include <p101_env/wrapper.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+/*
+ * One attached machine. fd is the descriptor it currently watches, or -1;
+ * each watch is armed one-shot, so a machine is woken once per watch and
+ * re-arms from its callback before it pauses again.
+ */
+struct p101_fsm_reactor_machine
+{
+    struct p101_fsm_reactor_machine *prev;
+    struct p101_fsm_reactor_machine *next;
+    struct p101_fsm_reactor         *reactor;
+    struct p101_fsm_info            *info;
+    void                            *arg;
+    struct p101_fsm_effect_sink     *sink;
+    int                              fd;
+    uint32_t                         ready;
+    p101_fsm_run_result              result;
+};
+
+/*
+ * machines links every attached machine so destroy can release them.
+ * running is the machine poll is running; while it is set no machine can be
+ * detached, because later ready events may still point at it.
+ */
+struct p101_fsm_reactor
+{
+    const struct p101_env           *env;
+    struct p101_fsm_reactor_machine *machines;
+    struct p101_fsm_reactor_machine *running;
+    struct epoll_event              *events;
+    size_t                           maximum_events;
+    int                              epoll_fd;
+};
+
+static void reactor_forget(struct p101_fsm_reactor_machine *machine);
+static void reactor_run(struct p101_fsm_reactor *reactor, struct p101_fsm_reactor_machine *machine, uint32_t ready);
+
+struct p101_fsm_reactor *p101_fsm_reactor_create(const struct p101_env *env, struct p101_error *err, size_t maximum_events)
+{
+    struct p101_fsm_reactor *reactor;
+
+    P101_TRACE(env);
+    P101_WRAPPER_FAULT_RETURN(env, err, reactor, NULL);
+    reactor = NULL;
+    if(maximum_events == 0U || maximum_events > (size_t)INT32_MAX)
+    {
+        P101_ERROR_RAISE_USER(err, "FSM reactor event count is out of range", P101_FSM_ERROR_INVALID_ARGUMENT);
+        goto done;
+    }
+
+    reactor = (struct p101_fsm_reactor *)p101_calloc(env, err, 1U, sizeof(*reactor));
+    if(reactor == NULL)
+    {
+        goto done;
+    }
+    reactor->events = (struct epoll_event *)p101_calloc(env, err, maximum_events, sizeof(*reactor->events));
+    if(reactor->events == NULL)
+    {
+        p101_free(env, reactor);
+        reactor = NULL;
+        goto done;
+    }
+    reactor->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if(reactor->epoll_fd == -1)
+    {
+        P101_ERROR_RAISE_ERRNO(err, errno);
+        p101_free(env, reactor->events);
+        p101_free(env, reactor);
+        reactor = NULL;
+        goto done;
+    }
+    reactor->env            = env;
+    reactor->maximum_events = maximum_events;
+
+done:
+    P101_WRAPPER_DONE(env);
+    return reactor;
+}
+
+void p101_fsm_reactor_destroy(const struct p101_env *env, struct p101_fsm_reactor **preactor)
+{
+    P101_TRACE(env);
+    if(preactor != NULL && *preactor != NULL)
+    {
+        struct p101_fsm_reactor *reactor;
+
+        reactor = *preactor;
+        while(reactor->machines != NULL)
+        {
+            struct p101_fsm_reactor_machine *machine;
+
+            machine           = reactor->machines;
+            reactor->machines = machine->next;
+            p101_free(reactor->env, machine);
+        }
+        close(reactor->epoll_fd);
+        p101_free(reactor->env, reactor->events);
+        p101_free(reactor->env, reactor);
+        *preactor = NULL;
+    }
+    P101_TRACE_EXIT(env);
+}
+
+struct p101_fsm_reactor_machine *p101_fsm_reactor_attach(const struct p101_env *env, struct p101_error *err, struct p101_fsm_reactor *reactor, struct p101_fsm_info *info, void *arg, struct p101_fsm_effect_sink *sink)
+{
+    struct p101_fsm_reactor_machine *machine;
+
+    P101_TRACE(env);
+    P101_WRAPPER_FAULT_RETURN(env, err, machine, NULL);
+    machine = NULL;
+    if(reactor == NULL || info == NULL)
+    {
+        P101_ERROR_RAISE_USER(err, "FSM reactor and machine cannot be NULL", P101_FSM_ERROR_INVALID_ARGUMENT);
+        goto done;
+    }
+
+    machine = (struct p101_fsm_reactor_machine *)p101_calloc(reactor->env, err, 1U, sizeof(*machine));
+    if(machine == NULL)
+    {
+        goto done;
+    }
+    machine->reactor = reactor;
+    machine->info    = info;
+    machine->arg     = arg;
+    machine->sink    = sink;
+    machine->fd      = -1;
+    machine->result  = P101_FSM_RUN_PAUSED;
+    machine->next    = reactor->machines;
+    if(reactor->machines != NULL)
+    {
+        reactor->machines->prev = machine;
+    }
+    reactor->machines = machine;
+
+done:
+    P101_WRAPPER_DONE(env);
+    return machine;
+}
+
+void p101_fsm_reactor_detach(const struct p101_env *env, struct p101_error *err, struct p101_fsm_reactor_machine **pmachine)
+{
+    struct p101_fsm_reactor_machine *machine;
+
+    P101_TRACE(env);
+    P101_WRAPPER_FAULT_RETURN_VOID(env, err);
+    if(pmachine == NULL || *pmachine == NULL)
+    {
+        goto done;
+    }
+
+    machine = *pmachine;
+    if(machine->reactor->running != NULL)
+    {
+        P101_ERROR_RAISE_USER(err, "Cannot detach an FSM while its reactor is running machines", P101_FSM_ERROR_REENTRANT_OPERATION);
+        goto done;
+    }
+
+    reactor_forget(machine);
+    if(machine->prev != NULL)
+    {
+        machine->prev->next = machine->next;
+    }
+    else
+    {
+        machine->reactor->machines = machine->next;
+    }
+    if(machine->next != NULL)
+    {
+        machine->next->prev = machine->prev;
+    }
+    p101_free(machine->reactor->env, machine);
+    *pmachine = NULL;
+
+done:
+    P101_WRAPPER_DONE(env);
+}
+
+int p101_fsm_reactor_watch(const struct p101_env *env, struct p101_error *err, struct p101_fsm_reactor_machine *machine, int fd, uint32_t interest)
+{
+    struct epoll_event event;
+    int                operation;
+    int                result;
+
+    P101_TRACE(env);
+    P101_WRAPPER_FAULT_RETURN(env, err, result, -1);
+    result = -1;
+    if(machine == NULL || fd < 0)
+    {
+        P101_ERROR_RAISE_USER(err, "FSM reactor watch requires a machine and a descriptor", P101_FSM_ERROR_INVALID_ARGUMENT);
+        goto done;
+    }
+
+    // A different descriptor replaces the current one; the same one is re-armed in place.
+    if(machine->fd != fd)
+    {
+        reactor_forget(machine);
+    }
+    operation      = machine->fd == fd ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+    event.events   = interest | EPOLLONESHOT;
+    event.data.ptr = machine;
+    if(epoll_ctl(machine->reactor->epoll_fd, operation, fd, &event) == -1)
+    {
+        P101_ERROR_RAISE_ERRNO(err, errno);
+        goto done;
+    }
+    machine->fd = fd;
+    result      = 0;
+
+done:
+    P101_WRAPPER_DONE(env);
+    return result;
+}
+
+uint32_t p101_fsm_reactor_get_ready(const struct p101_env *env, const struct p101_fsm_reactor_machine *machine)
+{
+    uint32_t ready;
+
+    P101_TRACE(env);
+    ready = machine == NULL ? 0U : machine->ready;
+    P101_TRACE_EXIT(env);
+    return ready;
+}
+
+p101_fsm_run_result p101_fsm_reactor_get_result(const struct p101_env *env, const struct p101_fsm_reactor_machine *machine)
+{
+    p101_fsm_run_result result;
+
+    P101_TRACE(env);
+    result = machine == NULL ? P101_FSM_RUN_ERROR : machine->result;
+    P101_TRACE_EXIT(env);
+    return result;
+}
+
+int p101_fsm_reactor_poll(const struct p101_env *env, struct p101_error *err, struct p101_fsm_reactor *reactor, int timeout_ms)
+{
+    int result;
+    int ready_count;
+
+    P101_TRACE(env);
+    P101_WRAPPER_FAULT_RETURN(env, err, result, -1);
+    result = -1;
+    if(reactor == NULL)
+    {
+        P101_ERROR_RAISE_USER(err, "FSM reactor cannot be NULL", P101_FSM_ERROR_INVALID_ARGUMENT);
+        goto done;
+    }
+    if(reactor->running != NULL)
+    {
+        P101_ERROR_RAISE_USER(err, "Cannot poll an FSM reactor from one of its machines", P101_FSM_ERROR_REENTRANT_OPERATION);
+        goto done;
+    }
+
+    ready_count = epoll_wait(reactor->epoll_fd, reactor->events, (int)reactor->maximum_events, timeout_ms);
+    if(ready_count == -1)
+    {
+        // A signal ends the wait early without anything becoming ready.
+        if(errno == EINTR)
+        {
+            result = 0;
+            goto done;
+        }
+        P101_ERROR_RAISE_ERRNO(err, errno);
+        goto done;
+    }
+
+    for(int index = 0; index < ready_count; ++index)
+    {
+        reactor_run(reactor, (struct p101_fsm_reactor_machine *)reactor->events[index].data.ptr, reactor->events[index].events);
+    }
+    result = ready_count;
+
+done:
+    P101_WRAPPER_DONE(env);
+    return result;
+}
+
+// Removes the machine's descriptor from the epoll set, if it has one.
+static void reactor_forget(struct p101_fsm_reactor_machine *machine)
+{
+    if(machine->fd != -1)
+    {
+        epoll_ctl(machine->reactor->epoll_fd, EPOLL_CTL_DEL, machine->fd, NULL);
+        machine->fd = -1;
+    }
+}
+
+/*
+ * Runs a woken machine until it pauses again. A machine that exits, is
+ * refused, or fails stops watching its descriptor, since nothing will
+ * re-arm it.
+ */
+static void reactor_run(struct p101_fsm_reactor *reactor, struct p101_fsm_reactor_machine *machine, uint32_t ready)
+{
+    reactor->running = machine;
+    machine->ready   = ready;
+    machine->result  = p101_fsm_run(machine->info, machine->arg, machine->sink, NULL);
+    machine->ready   = 0U;
+    reactor->running = NULL;
+    if(machine->result != P101_FSM_RUN_PAUSED)
+    {
+        reactor_forget(machine);
+    }
+}
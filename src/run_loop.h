@@ -0,0 +1,84 @@
+#ifndef LIBP101_FSM_RUN_LOOP_H
+#define LIBP101_FSM_RUN_LOOP_H
+
+/*
+ * Copyright 2021-2026 D'Arcy Smith.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "p101_fsm/fsm.h"
+#include <stdbool.h>
+
+/*
+ * The one continuation rule behind run, run_bounded, run_batched and
+ * run_events. fsm.c owns the machine, so the other loops ask it for the
+ * env the machine traces with.
+ */
+const struct p101_env *p101_fsm_info_run_env(const struct p101_fsm_info *info);
+
+/*
+ * Maps one step of a run loop to the run outcome. Returns true while the
+ * machine keeps transitioning, including through a bad-transition redirect.
+ * An event loop also goes on after a pause, which ends only that event, and
+ * stops at a redirect, which leaves its event queued; it reports
+ * P101_FSM_RUN_PAUSED for an event that transitioned or paused.
+ */
+static inline bool fsm_run_continues(p101_fsm_step_status status, const struct p101_fsm_step_result *current, bool event_loop, p101_fsm_run_result *run_result)
+{
+    bool continues;
+
+    continues = false;
+#ifdef __clang__
+    #pragma clang diagnostic push
+    #pragma clang diagnostic ignored "-Wcovered-switch-default"
+#endif
+    // GCOVR_EXCL_BR_START: p101_fsm_step returns only declared status values.
+    switch(status)
+    {
+        case P101_FSM_STEP_TRANSITIONED:
+            if(event_loop)
+            {
+                *run_result = P101_FSM_RUN_PAUSED;
+            }
+            continues = true;
+            break;
+        case P101_FSM_STEP_PAUSED:
+            *run_result = P101_FSM_RUN_PAUSED;
+            continues   = event_loop;
+            break;
+        case P101_FSM_STEP_EXITED:
+            *run_result = P101_FSM_RUN_EXITED;
+            break;
+        case P101_FSM_STEP_REFUSED:
+            if(event_loop || current->refusal != P101_FSM_REFUSAL_UNKNOWN_TRANSITION || current->next_state == current->attempted_state)
+            {
+                *run_result = P101_FSM_RUN_REFUSED;
+                break;
+            }
+            continues = true;
+            break;
+        case P101_FSM_STEP_ERROR:
+        default:
+            *run_result = P101_FSM_RUN_ERROR;
+            break;
+    }
+        // GCOVR_EXCL_BR_STOP
+#ifdef __clang__
+    #pragma clang diagnostic pop
+#endif
+
+    return continues;
+}
+
+#endif    // LIBP101_FSM_RUN_LOOP_H
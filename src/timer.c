@@ -0,0 +1,401 @@
+/*
+ * Copyright 2021-2026 D'Arcy Smith.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "p101_fsm/errors.h"
+#include "p101_fsm/fsm.h"
+#include <p101_c/p101_stdlib.h>
+#include <p101_env/wrapper.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define TIMER_LEVEL_BITS 8U
+#define TIMER_LEVEL_SLOTS (1U << TIMER_LEVEL_BITS)
+#define TIMER_LEVEL_MASK (TIMER_LEVEL_SLOTS - 1U)
+#define TIMER_LEVELS 4U
+#define TIMER_RANGE (UINT64_C(1) << (TIMER_LEVEL_BITS * TIMER_LEVELS))
+
+/*
+ * Timers sit on circular lists with a sentinel head, so unlinking one needs
+ * no knowledge of the slot that holds it.
+ */
+struct timer_link
+{
+    struct timer_link *prev;
+    struct timer_link *next;
+};
+
+/*
+ * link must stay first: a list node is converted back to its timer by a
+ * cast. expires is the absolute tick the timer fires on.
+ */
+struct p101_fsm_timer
+{
+    struct timer_link           link;
+    struct p101_fsm_timer_wheel *wheel;
+    struct p101_fsm_info        *info;
+    void                        *arg;
+    struct p101_fsm_effect_sink *sink;
+    uint64_t                     expires;
+    bool                         armed;
+    bool                         expired;
+    p101_fsm_run_result          result;
+};
+
+/*
+ * Level n holds timers due within 2^(8(n + 1)) ticks, in the slot selected
+ * by bits 8n to 8n + 7 of their expiry. When the low bits of the current
+ * tick wrap to zero, the matching slot one level up is cascaded: its timers
+ * are placed again, which moves each one down a level. Timers due beyond the
+ * top level wait in its furthest slot and are placed again when it cascades.
+ */
+struct p101_fsm_timer_wheel
+{
+    const struct p101_env *env;
+    struct timer_link      slots[TIMER_LEVELS][TIMER_LEVEL_SLOTS];
+    uint64_t               now;
+    size_t                 armed;
+    size_t                 attached;
+    bool                   running;
+};
+
+static void timer_cascade(struct p101_fsm_timer_wheel *wheel, size_t level);
+static void timer_expire(struct p101_fsm_timer_wheel *wheel, struct p101_fsm_timer *timer);
+static void timer_link_append(struct timer_link *head, struct timer_link *link);
+static void timer_link_unlink(struct timer_link *link);
+static void timer_place(struct p101_fsm_timer_wheel *wheel, struct p101_fsm_timer *timer);
+
+struct p101_fsm_timer_wheel *p101_fsm_timer_wheel_create(const struct p101_env *env, struct p101_error *err)
+{
+    struct p101_fsm_timer_wheel *wheel;
+
+    P101_TRACE(env);
+    P101_WRAPPER_FAULT_RETURN(env, err, wheel, NULL);
+    wheel = (struct p101_fsm_timer_wheel *)p101_calloc(env, err, 1U, sizeof(*wheel));
+    if(wheel == NULL)
+    {
+        goto done;
+    }
+
+    wheel->env = env;
+    for(size_t level = 0U; level < TIMER_LEVELS; ++level)
+    {
+        for(size_t slot = 0U; slot < TIMER_LEVEL_SLOTS; ++slot)
+        {
+            wheel->slots[level][slot].prev = &wheel->slots[level][slot];
+            wheel->slots[level][slot].next = &wheel->slots[level][slot];
+        }
+    }
+
+done:
+    P101_WRAPPER_DONE(env);
+    return wheel;
+}
+
+void p101_fsm_timer_wheel_destroy(const struct p101_env *env, struct p101_error *err, struct p101_fsm_timer_wheel **pwheel)
+{
+    P101_TRACE(env);
+    P101_WRAPPER_FAULT_RETURN_VOID(env, err);
+    if(pwheel == NULL || *pwheel == NULL)
+    {
+        goto done;
+    }
+    if((*pwheel)->attached != 0U)
+    {
+        P101_ERROR_RAISE_USER(err, "Cannot destroy an FSM timer wheel with attached timers", P101_FSM_ERROR_INVALID_ARGUMENT);
+        goto done;
+    }
+
+    p101_free((*pwheel)->env, *pwheel);
+    *pwheel = NULL;
+
+done:
+    P101_WRAPPER_DONE(env);
+}
+
+uint64_t p101_fsm_timer_wheel_get_time(const struct p101_env *env, const struct p101_fsm_timer_wheel *wheel)
+{
+    uint64_t now;
+
+    P101_TRACE(env);
+    now = wheel == NULL ? 0U : wheel->now;
+    P101_TRACE_EXIT(env);
+    return now;
+}
+
+size_t p101_fsm_timer_wheel_get_armed(const struct p101_env *env, const struct p101_fsm_timer_wheel *wheel)
+{
+    size_t armed;
+
+    P101_TRACE(env);
+    armed = wheel == NULL ? 0U : wheel->armed;
+    P101_TRACE_EXIT(env);
+    return armed;
+}
+
+size_t p101_fsm_timer_wheel_advance(const struct p101_env *env, struct p101_error *err, struct p101_fsm_timer_wheel *wheel, uint64_t ticks)
+{
+    size_t expired;
+
+    P101_TRACE(env);
+    P101_WRAPPER_FAULT_RETURN(env, err, expired, 0U);
+    expired = 0U;
+    if(wheel == NULL)
+    {
+        P101_ERROR_RAISE_USER(err, "FSM timer wheel cannot be NULL", P101_FSM_ERROR_INVALID_ARGUMENT);
+        goto done;
+    }
+    if(wheel->running)
+    {
+        P101_ERROR_RAISE_USER(err, "Cannot advance an FSM timer wheel from one of its machines", P101_FSM_ERROR_REENTRANT_OPERATION);
+        goto done;
+    }
+
+    wheel->running = true;
+    while(ticks > 0U)
+    {
+        struct timer_link due;
+        size_t            slot;
+
+        // With nothing armed there is nothing to cascade or expire, so the clock just moves.
+        if(wheel->armed == 0U)
+        {
+            wheel->now += ticks;
+            break;
+        }
+
+        ticks--;
+        wheel->now++;
+        slot = (size_t)(wheel->now & TIMER_LEVEL_MASK);
+        for(size_t level = 1U; level < TIMER_LEVELS && ((wheel->now >> (TIMER_LEVEL_BITS * (level - 1U))) & TIMER_LEVEL_MASK) == 0U; ++level)
+        {
+            timer_cascade(wheel, level);
+        }
+
+        // Move the due timers aside first: a callback may arm or cancel any timer, including these.
+        due.prev = &due;
+        due.next = &due;
+        if(wheel->slots[0][slot].next != &wheel->slots[0][slot])
+        {
+            due.next       = wheel->slots[0][slot].next;
+            due.prev       = wheel->slots[0][slot].prev;
+            due.next->prev = &due;
+            due.prev->next = &due;
+
+            wheel->slots[0][slot].prev = &wheel->slots[0][slot];
+            wheel->slots[0][slot].next = &wheel->slots[0][slot];
+        }
+        while(due.next != &due)
+        {
+            timer_expire(wheel, (struct p101_fsm_timer *)(void *)due.next);
+            expired++;
+        }
+    }
+    wheel->running = false;
+
+done:
+    P101_WRAPPER_DONE(env);
+    return expired;
+}
+
+struct p101_fsm_timer *p101_fsm_timer_attach(const struct p101_env *env, struct p101_error *err, struct p101_fsm_timer_wheel *wheel, struct p101_fsm_info *info, void *arg, struct p101_fsm_effect_sink *sink)
+{
+    struct p101_fsm_timer *timer;
+
+    P101_TRACE(env);
+    P101_WRAPPER_FAULT_RETURN(env, err, timer, NULL);
+    timer = NULL;
+    if(wheel == NULL || info == NULL)
+    {
+        P101_ERROR_RAISE_USER(err, "FSM timer wheel and machine cannot be NULL", P101_FSM_ERROR_INVALID_ARGUMENT);
+        goto done;
+    }
+
+    timer = (struct p101_fsm_timer *)p101_calloc(wheel->env, err, 1U, sizeof(*timer));
+    if(timer == NULL)
+    {
+        goto done;
+    }
+    timer->wheel  = wheel;
+    timer->info   = info;
+    timer->arg    = arg;
+    timer->sink   = sink;
+    timer->result = P101_FSM_RUN_PAUSED;
+    wheel->attached++;
+
+done:
+    P101_WRAPPER_DONE(env);
+    return timer;
+}
+
+void p101_fsm_timer_detach(const struct p101_env *env, struct p101_error *err, struct p101_fsm_timer **ptimer)
+{
+    struct p101_fsm_timer *timer;
+
+    P101_TRACE(env);
+    P101_WRAPPER_FAULT_RETURN_VOID(env, err);
+    if(ptimer == NULL || *ptimer == NULL)
+    {
+        goto done;
+    }
+
+    timer = *ptimer;
+    if(timer->expired)
+    {
+        P101_ERROR_RAISE_USER(err, "Cannot detach an FSM timer from its own expiry", P101_FSM_ERROR_REENTRANT_OPERATION);
+        goto done;
+    }
+    p101_fsm_timer_cancel(env, timer);
+    timer->wheel->attached--;
+    p101_free(timer->wheel->env, timer);
+    *ptimer = NULL;
+
+done:
+    P101_WRAPPER_DONE(env);
+}
+
+int p101_fsm_timer_arm(const struct p101_env *env, struct p101_error *err, struct p101_fsm_timer *timer, uint64_t ticks)
+{
+    int result;
+
+    P101_TRACE(env);
+    P101_WRAPPER_FAULT_RETURN(env, err, result, -1);
+    result = -1;
+    if(timer == NULL || ticks == 0U || ticks > UINT64_MAX - timer->wheel->now)
+    {
+        P101_ERROR_RAISE_USER(err, "FSM timer requires a timer and a timeout of at least one tick", P101_FSM_ERROR_INVALID_ARGUMENT);
+        goto done;
+    }
+
+    p101_fsm_timer_cancel(env, timer);
+    timer->expires = timer->wheel->now + ticks;
+    timer->armed   = true;
+    timer->wheel->armed++;
+    timer_place(timer->wheel, timer);
+    result = 0;
+
+done:
+    P101_WRAPPER_DONE(env);
+    return result;
+}
+
+void p101_fsm_timer_cancel(const struct p101_env *env, struct p101_fsm_timer *timer)
+{
+    P101_TRACE(env);
+    if(timer != NULL && timer->armed)
+    {
+        timer_link_unlink(&timer->link);
+        timer->armed = false;
+        timer->wheel->armed--;
+    }
+    P101_TRACE_EXIT(env);
+}
+
+bool p101_fsm_timer_is_armed(const struct p101_env *env, const struct p101_fsm_timer *timer)
+{
+    bool armed;
+
+    P101_TRACE(env);
+    armed = timer != NULL && timer->armed;
+    P101_TRACE_EXIT(env);
+    return armed;
+}
+
+bool p101_fsm_timer_has_expired(const struct p101_env *env, const struct p101_fsm_timer *timer)
+{
+    bool expired;
+
+    P101_TRACE(env);
+    expired = timer != NULL && timer->expired;
+    P101_TRACE_EXIT(env);
+    return expired;
+}
+
+p101_fsm_run_result p101_fsm_timer_get_result(const struct p101_env *env, const struct p101_fsm_timer *timer)
+{
+    p101_fsm_run_result result;
+
+    P101_TRACE(env);
+    result = timer == NULL ? P101_FSM_RUN_ERROR : timer->result;
+    P101_TRACE_EXIT(env);
+    return result;
+}
+
+// Empties one slot of the given level and places each timer again for the current tick.
+static void timer_cascade(struct p101_fsm_timer_wheel *wheel, size_t level)
+{
+    struct timer_link *head;
+    size_t             slot;
+
+    slot = (size_t)((wheel->now >> (TIMER_LEVEL_BITS * level)) & TIMER_LEVEL_MASK);
+    head = &wheel->slots[level][slot];
+    while(head->next != head)
+    {
+        struct p101_fsm_timer *timer;
+
+        timer = (struct p101_fsm_timer *)(void *)head->next;
+        timer_link_unlink(&timer->link);
+        timer_place(wheel, timer);
+    }
+}
+
+static void timer_expire(struct p101_fsm_timer_wheel *wheel, struct p101_fsm_timer *timer)
+{
+    timer_link_unlink(&timer->link);
+    timer->armed   = false;
+    timer->expired = true;
+    wheel->armed--;
+    timer->result  = p101_fsm_run(timer->info, timer->arg, timer->sink, NULL);
+    timer->expired = false;
+}
+
+static void timer_link_append(struct timer_link *head, struct timer_link *link)
+{
+    link->prev       = head->prev;
+    link->next       = head;
+    head->prev->next = link;
+    head->prev       = link;
+}
+
+static void timer_link_unlink(struct timer_link *link)
+{
+    link->prev->next = link->next;
+    link->next->prev = link->prev;
+    link->prev       = link;
+    link->next       = link;
+}
+
+static void timer_place(struct p101_fsm_timer_wheel *wheel, struct p101_fsm_timer *timer)
+{
+    uint64_t delta;
+    uint64_t expires;
+    size_t   level;
+
+    expires = timer->expires;
+    delta   = expires - wheel->now;
+    if(delta >= TIMER_RANGE)
+    {
+        expires = wheel->now + TIMER_RANGE - 1U;
+        delta   = TIMER_RANGE - 1U;
+    }
+
+    level = 0U;
+    while(delta >> (TIMER_LEVEL_BITS * (level + 1U)) != 0U)
+    {
+        level++;
+    }
+    timer_link_append(&wheel->slots[level][(size_t)((expires >> (TIMER_LEVEL_BITS * level)) & TIMER_LEVEL_MASK)], &timer->link);
+}
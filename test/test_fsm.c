@@ -3,9 +3,20 @@
 #include <errno.h>
 #include <p101_env/env.h>
 #include <p101_error/error.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+    #include <sys/epoll.h>
+#endif
 
 enum test_states
 {
@@ -40,6 +51,96 @@ struct callback_context
     int                         effect_value;
 };
 
+struct executor_context
+{
+    atomic_int running;
+    atomic_int runs;
+    atomic_int overlaps;
+};
+
+struct producer_context
+{
+    struct p101_fsm_inbox *inbox;
+    int                    first_kind;
+    int                    count;
+};
+
+struct reactor_context
+{
+    struct p101_fsm_reactor_machine *machine;
+    int                              fd;
+    int                              reads;
+    int                              watch_status;
+};
+
+struct timer_context
+{
+    struct p101_fsm_timer_wheel *wheel;
+    struct p101_fsm_timer       *timer;
+    struct p101_fsm_timer       *cancel;
+    uint64_t                     rearm;
+    uint64_t                     fired_at;
+    int                          timeouts;
+    int                          steps;
+};
+
+struct burst_context
+{
+    int         count;
+    const void *data;
+    size_t      data_size;
+};
+
+struct kind_context
+{
+    struct p101_fsm_effect_kinds *kinds;
+    p101_fsm_effect_kind_id       ids[2];
+    int                           routed[3];
+    int                           value;
+};
+
+struct reserve_context
+{
+    struct p101_fsm_effect_kinds *kinds;
+    p101_fsm_effect_kind_id       id;
+    size_t                        size;
+    bool                          aligned;
+};
+
+struct span_context
+{
+    int    calls;
+    size_t count;
+    size_t bytes;
+    bool   fail;
+};
+
+struct ring_consumer
+{
+    struct p101_fsm_effect_ring *ring;
+    int                          expected;
+    int                          received;
+    int                          last_value;
+    size_t                       last_sequence;
+    int                          disorders;
+};
+
+struct journal_replay_context
+{
+    size_t records;
+    size_t effects;
+    int    next_value;
+    size_t last_sequence;
+    int    disorders;
+    bool   fail;
+};
+
+struct aligned_payload
+{
+    uint64_t tag;
+    uint64_t square;
+};
+
 struct fault_context
 {
     const char *call_name;
@@ -57,8 +158,10 @@ static int               bad_calls;
 static p101_fsm_state_id redirect_state;
 static int               redirect_calls;
 
-void   p101_fsm_test_set_step_sequence(struct p101_fsm_info *info, size_t sequence);
-size_t p101_fsm_test_transition_probe_count(const struct p101_fsm_info *info, p101_fsm_state_id from_id, p101_fsm_state_id to_id);
+void                p101_fsm_test_set_step_sequence(struct p101_fsm_info *info, size_t sequence);
+size_t              p101_fsm_test_transition_probe_count(const struct p101_fsm_info *info, p101_fsm_state_id from_id, p101_fsm_state_id to_id);
+p101_fsm_state_func p101_fsm_test_cached_perform(const struct p101_fsm_info *info);
+bool                p101_fsm_test_uses_plain_step(const struct p101_fsm_info *info);
 
 #define EXPECT(condition)                                                                                                                                                                                                                                          \
     do                                                                                                                                                                                                                                                             \
@@ -488,6 +591,8 @@ static void test_transition_hash_map(void)
     struct fixture                          fixture;
     struct callback_context                 context;
     struct p101_fsm_step_result             result;
+    struct p101_fsm_definition             *definition;
+    struct p101_fsm_info                   *machine;
     static const struct p101_fsm_transition transitions[] = {
         {P101_FSM_INIT, STATE_A,      state_to_selected},
         {STATE_A,       STATE_B,      state_exit       },
@@ -496,148 +601,2316 @@ static void test_transition_hash_map(void)
     };
     static const p101_fsm_state_id targets[] = {STATE_B, STATE_C, STATE_SPARSE};
 
+    // The automatic choice for this table is CSR, so the hash index is requested.
+    fixture_create(&fixture, "unused", basic_transitions, 2U, NULL);
+    definition = p101_fsm_definition_create_with_index(fixture.fsm_env, fixture.fsm_err, "hash-map", transitions, sizeof(transitions) / sizeof(transitions[0]), P101_FSM_TRANSITION_INDEX_HASH);
+    EXPECT(definition != NULL);
+    EXPECT(p101_fsm_definition_get_transition_index(fixture.fsm_env, definition) == P101_FSM_TRANSITION_INDEX_HASH);
     for(size_t i = 0U; i < sizeof(targets) / sizeof(targets[0]); i++)
     {
         memset(&context, 0, sizeof(context));
         context.selected_state = targets[i];
-        fixture_create(&fixture, "hash-map", transitions, sizeof(transitions) / sizeof(transitions[0]), NULL);
-        EXPECT(fixture.fsm != NULL);
-        EXPECT(p101_fsm_run(fixture.fsm, &context, NULL, &result) == P101_FSM_RUN_EXITED);
+        machine                = p101_fsm_info_create_from_definition(fixture.app_env, fixture.app_err, definition, fixture.fsm_env, fixture.fsm_err, NULL);
+        EXPECT(machine != NULL);
+        EXPECT(p101_fsm_run(machine, &context, NULL, &result) == P101_FSM_RUN_EXITED);
         EXPECT(context.calls == 2);
-        fixture_destroy(&fixture);
+        p101_fsm_info_destroy(fixture.app_env, fixture.fsm_err, &machine);
     }
 
-    fixture_create(&fixture, "hash-collision", transitions, sizeof(transitions) / sizeof(transitions[0]), NULL);
+    machine = p101_fsm_info_create_from_definition(fixture.app_env, fixture.app_err, definition, fixture.fsm_env, fixture.fsm_err, NULL);
+    EXPECT(machine != NULL);
+    EXPECT(p101_fsm_test_transition_probe_count(machine, STATE_A, STATE_C) > 1U);
+    p101_fsm_info_destroy(fixture.app_env, fixture.fsm_err, &machine);
+    p101_fsm_definition_destroy(fixture.fsm_env, &definition);
+    fixture_destroy(&fixture);
+}
+
+static void test_shared_definition(void)
+{
+    struct fixture                    fixture;
+    struct callback_context           context = {0};
+    struct p101_fsm_step_result       result;
+    struct p101_fsm_definition       *definition;
+    struct p101_fsm_info             *second;
+    const struct p101_fsm_definition *shared;
+    const char                       *name;
+    bool                              error_present;
+
+    fixture_create(&fixture, "unused", basic_transitions, 2U, NULL);
+    definition = p101_fsm_definition_create(fixture.fsm_env, fixture.fsm_err, "shared", basic_transitions, 2U);
+    EXPECT(definition != NULL);
+    name = p101_fsm_definition_get_name(fixture.fsm_env, definition);
+    EXPECT(strcmp(name, "shared") == 0);
+
+    second = p101_fsm_info_create_from_definition(fixture.app_env, fixture.app_err, definition, fixture.fsm_env, fixture.fsm_err, NULL);
+    EXPECT(second != NULL);
+    shared = p101_fsm_info_get_definition(fixture.app_env, second);
+    EXPECT(shared == definition);
+    name = p101_fsm_info_get_name(fixture.app_env, second);
+    EXPECT(strcmp(name, "shared") == 0);
+
+    p101_fsm_info_destroy(fixture.app_env, fixture.fsm_err, &fixture.fsm);
+    fixture.fsm = p101_fsm_info_create_from_definition(fixture.app_env, fixture.app_err, definition, fixture.fsm_env, fixture.fsm_err, NULL);
     EXPECT(fixture.fsm != NULL);
-    EXPECT(p101_fsm_test_transition_probe_count(fixture.fsm, STATE_A, STATE_C) > 1U);
+    p101_fsm_definition_destroy(fixture.fsm_env, &definition);
+    EXPECT(definition == NULL);
+
+    EXPECT(p101_fsm_step(second, &context, NULL, &result) == P101_FSM_STEP_TRANSITIONED);
+    EXPECT(p101_fsm_info_get_current_state(fixture.app_env, second) == STATE_B);
+    EXPECT(p101_fsm_info_get_current_state(fixture.app_env, fixture.fsm) == STATE_A);
+    EXPECT(p101_fsm_run(fixture.fsm, &context, NULL, &result) == P101_FSM_RUN_EXITED);
+    EXPECT(p101_fsm_info_get_step_sequence(fixture.app_env, second) == 1U);
+    EXPECT(context.calls == 3);
+    p101_fsm_info_destroy(fixture.app_env, fixture.fsm_err, &second);
+
+    second = p101_fsm_info_create_from_definition(fixture.app_env, fixture.app_err, NULL, fixture.fsm_env, fixture.fsm_err, NULL);
+    EXPECT(second == NULL);
+    error_present = p101_error_is_error(fixture.fsm_err, P101_ERROR_USER, P101_FSM_ERROR_INVALID_ARGUMENT);
+    EXPECT(error_present);
+    p101_error_reset(fixture.fsm_err);
+    definition = p101_fsm_definition_create(fixture.fsm_env, fixture.fsm_err, NULL, basic_transitions, 2U);
+    EXPECT(definition == NULL);
+    error_present = p101_error_is_error(fixture.fsm_err, P101_ERROR_USER, P101_FSM_ERROR_INVALID_ARGUMENT);
+    EXPECT(error_present);
+    p101_error_reset(fixture.fsm_err);
+    definition = p101_fsm_definition_create(fixture.fsm_env, fixture.fsm_err, "empty", NULL, 0U);
+    EXPECT(definition == NULL);
+    error_present = p101_error_is_error(fixture.fsm_err, P101_ERROR_USER, P101_FSM_ERROR_INVALID_TRANSITION_TABLE);
+    EXPECT(error_present);
+    p101_error_reset(fixture.fsm_err);
+    EXPECT(p101_fsm_definition_get_name(NULL, NULL) == NULL);
+    EXPECT(p101_fsm_info_get_definition(NULL, NULL) == NULL);
+    p101_fsm_definition_destroy(NULL, NULL);
+    p101_fsm_definition_destroy(NULL, &definition);
     fixture_destroy(&fixture);
 }
 
-static void test_invalid_create(void)
+static void test_transition_index_selection(void)
 {
     struct fixture                          fixture;
-    static const struct p101_fsm_transition multiple_initial[] = {
-        {P101_FSM_INIT, STATE_A, state_exit},
-        {P101_FSM_INIT, STATE_B, state_exit},
-    };
-    static const struct p101_fsm_transition duplicate[] = {
-        {P101_FSM_INIT, STATE_A, state_exit},
-        {P101_FSM_INIT, STATE_A, state_to_b},
+    struct callback_context                 context = {0};
+    struct p101_fsm_step_result             result;
+    struct p101_fsm_definition             *definition;
+    bool                                    error_present;
+    static const struct p101_fsm_transition sparse_target[] = {
+        {P101_FSM_INIT, STATE_A,      state_to_selected},
+        {STATE_A,       STATE_B,      state_exit       },
+        {STATE_A,       STATE_SPARSE, state_exit       },
     };
-    static const struct p101_fsm_transition null_callback[] = {
-        {P101_FSM_INIT, STATE_A, NULL},
+    static const struct p101_fsm_transition sparse_source[] = {
+        {P101_FSM_INIT, STATE_SPARSE, state_to_selected},
+        {STATE_SPARSE,  STATE_A,      state_exit       },
     };
-    static const struct p101_fsm_transition invalid_from[] = {
-        {P101_FSM_STATE_NONE, STATE_A, state_exit},
+    static const struct p101_fsm_transition csr_duplicate[] = {
+        {P101_FSM_INIT, STATE_A,      state_exit},
+        {STATE_A,       STATE_SPARSE, state_exit},
+        {STATE_A,       STATE_SPARSE, state_exit},
     };
-    static const struct p101_fsm_transition invalid_to[] = {
-        {P101_FSM_INIT, P101_FSM_STATE_NONE, state_exit},
+    static const struct p101_fsm_transition hash_duplicate[] = {
+        {P101_FSM_INIT, STATE_SPARSE, state_exit},
+        {STATE_SPARSE,  STATE_A,      state_exit},
+        {STATE_SPARSE,  STATE_A,      state_exit},
     };
 
-    fixture_create(&fixture, NULL, basic_transitions, 2U, NULL);
-    EXPECT(fixture.fsm == NULL);
-    EXPECT(p101_error_is_error(fixture.fsm_err, P101_ERROR_USER, P101_FSM_ERROR_INVALID_ARGUMENT));
+    fixture_create(&fixture, "dense", basic_transitions, 2U, NULL);
+    EXPECT(p101_fsm_definition_get_transition_index(fixture.app_env, p101_fsm_info_get_definition(fixture.app_env, fixture.fsm)) == P101_FSM_TRANSITION_INDEX_DENSE);
+    EXPECT(p101_fsm_test_transition_probe_count(fixture.fsm, STATE_A, STATE_B) == 1U);
+    EXPECT(p101_fsm_run(fixture.fsm, &context, NULL, &result) == P101_FSM_RUN_EXITED);
+    EXPECT(context.calls == 2);
     fixture_destroy(&fixture);
 
-    fixture_create(&fixture, "empty", NULL, 0U, NULL);
-    EXPECT(fixture.fsm == NULL);
-    EXPECT(p101_error_is_error(fixture.fsm_err, P101_ERROR_USER, P101_FSM_ERROR_INVALID_TRANSITION_TABLE));
+    memset(&context, 0, sizeof(context));
+    context.selected_state = STATE_SPARSE;
+    fixture_create(&fixture, "csr", sparse_target, sizeof(sparse_target) / sizeof(sparse_target[0]), NULL);
+    EXPECT(p101_fsm_definition_get_transition_index(fixture.app_env, p101_fsm_info_get_definition(fixture.app_env, fixture.fsm)) == P101_FSM_TRANSITION_INDEX_CSR);
+    EXPECT(p101_fsm_test_transition_probe_count(fixture.fsm, STATE_A, STATE_B) == 1U);
+    EXPECT(p101_fsm_test_transition_probe_count(fixture.fsm, STATE_A, STATE_SPARSE) == 2U);
+    EXPECT(p101_fsm_test_transition_probe_count(fixture.fsm, STATE_SPARSE, STATE_A) == 0U);
+    EXPECT(p101_fsm_run(fixture.fsm, &context, NULL, &result) == P101_FSM_RUN_EXITED);
+    EXPECT(context.calls == 2);
     fixture_destroy(&fixture);
 
-    fixture_create(&fixture, "zero-count", basic_transitions, 0U, NULL);
-    EXPECT(fixture.fsm == NULL);
-    EXPECT(p101_error_is_error(fixture.fsm_err, P101_ERROR_USER, P101_FSM_ERROR_INVALID_TRANSITION_TABLE));
-    fixture_destroy(&fixture);
+    memset(&context, 0, sizeof(context));
+    context.selected_state = STATE_A;
+    fixture_create(&fixture, "hash", sparse_source, sizeof(sparse_source) / sizeof(sparse_source[0]), NULL);
+    EXPECT(p101_fsm_definition_get_transition_index(fixture.app_env, p101_fsm_info_get_definition(fixture.app_env, fixture.fsm)) == P101_FSM_TRANSITION_INDEX_HASH);
+    EXPECT(p101_fsm_run(fixture.fsm, &context, NULL, &result) == P101_FSM_RUN_EXITED);
+    EXPECT(context.calls == 2);
 
-    fixture_create(&fixture, "oversized", basic_transitions, SIZE_MAX, NULL);
-    EXPECT(fixture.fsm == NULL);
-    EXPECT(p101_error_is_error(fixture.fsm_err, P101_ERROR_USER, P101_FSM_ERROR_INVALID_TRANSITION_TABLE));
+    definition = p101_fsm_definition_create(fixture.fsm_env, fixture.fsm_err, "csr-duplicate", csr_duplicate, sizeof(csr_duplicate) / sizeof(csr_duplicate[0]));
+    EXPECT(definition == NULL);
+    error_present = p101_error_is_error(fixture.fsm_err, P101_ERROR_USER, P101_FSM_ERROR_INVALID_TRANSITION_TABLE);
+    EXPECT(error_present);
+    p101_error_reset(fixture.fsm_err);
+    definition = p101_fsm_definition_create(fixture.fsm_env, fixture.fsm_err, "hash-duplicate", hash_duplicate, sizeof(hash_duplicate) / sizeof(hash_duplicate[0]));
+    EXPECT(definition == NULL);
+    error_present = p101_error_is_error(fixture.fsm_err, P101_ERROR_USER, P101_FSM_ERROR_INVALID_TRANSITION_TABLE);
+    EXPECT(error_present);
+    p101_error_reset(fixture.fsm_err);
+    EXPECT(p101_fsm_definition_get_transition_index(NULL, NULL) == P101_FSM_TRANSITION_INDEX_HASH);
     fixture_destroy(&fixture);
+}
 
-    fixture_create(&fixture, "multiple", multiple_initial, 2U, NULL);
-    EXPECT(fixture.fsm == NULL);
-    EXPECT(p101_error_is_error(fixture.fsm_err, P101_ERROR_USER, P101_FSM_ERROR_INVALID_TRANSITION_TABLE));
-    fixture_destroy(&fixture);
+static void test_perfect_hash_index(void)
+{
+    struct fixture                          fixture;
+    struct callback_context                 context;
+    struct p101_fsm_step_result             result;
+    struct p101_fsm_definition             *definition;
+    struct p101_fsm_info                   *machine;
+    struct p101_fsm_transition              wide[40];
+    bool                                    error_present;
+    static const struct p101_fsm_transition duplicate[] = {
+        {P101_FSM_INIT, STATE_A,      state_exit},
+        {STATE_A,       STATE_SPARSE, state_exit},
+        {STATE_A,       STATE_SPARSE, state_exit},
+    };
 
-    fixture_create(&fixture, "duplicate", duplicate, 2U, NULL);
-    EXPECT(fixture.fsm == NULL);
-    EXPECT(p101_error_is_error(fixture.fsm_err, P101_ERROR_USER, P101_FSM_ERROR_INVALID_TRANSITION_TABLE));
-    fixture_destroy(&fixture);
+    wide[0].from_id = P101_FSM_INIT;
+    wide[0].to_id   = STATE_A;
+    wide[0].perform = state_to_selected;
+    for(size_t i = 1U; i < sizeof(wide) / sizeof(wide[0]); i++)
+    {
+        wide[i].from_id = STATE_A;
+        wide[i].to_id   = STATE_SPARSE + (p101_fsm_state_id)(i * 7U);
+        wide[i].perform = state_exit;
+    }
 
-    fixture_create(&fixture, "null", null_callback, 1U, NULL);
-    EXPECT(fixture.fsm == NULL);
-    EXPECT(p101_error_is_error(fixture.fsm_err, P101_ERROR_USER, P101_FSM_ERROR_INVALID_TRANSITION_TABLE));
-    fixture_destroy(&fixture);
+    fixture_create(&fixture, "unused", basic_transitions, 2U, NULL);
+    definition = p101_fsm_definition_create_with_index(fixture.fsm_env, fixture.fsm_err, "perfect", wide, sizeof(wide) / sizeof(wide[0]), P101_FSM_TRANSITION_INDEX_PERFECT_HASH);
+    EXPECT(definition != NULL);
+    EXPECT(p101_fsm_definition_get_transition_index(fixture.fsm_env, definition) == P101_FSM_TRANSITION_INDEX_PERFECT_HASH);
+    machine = p101_fsm_info_create_from_definition(fixture.app_env, fixture.app_err, definition, fixture.fsm_env, fixture.fsm_err, NULL);
+    EXPECT(machine != NULL);
+    for(size_t i = 0U; i < sizeof(wide) / sizeof(wide[0]); i++)
+    {
+        EXPECT(p101_fsm_test_transition_probe_count(machine, wide[i].from_id, wide[i].to_id) == 1U);
+    }
+    memset(&context, 0, sizeof(context));
+    context.selected_state = wide[23].to_id;
+    EXPECT(p101_fsm_run(machine, &context, NULL, &result) == P101_FSM_RUN_EXITED);
+    EXPECT(context.calls == 2);
+    p101_fsm_info_destroy(fixture.app_env, fixture.fsm_err, &machine);
+    p101_fsm_definition_destroy(fixture.fsm_env, &definition);
 
-    fixture_create(&fixture, "invalid-from", invalid_from, 1U, NULL);
-    EXPECT(fixture.fsm == NULL);
-    EXPECT(p101_error_is_error(fixture.fsm_err, P101_ERROR_USER, P101_FSM_ERROR_INVALID_TRANSITION_TABLE));
+    memset(&context, 0, sizeof(context));
+    context.selected_state = STATE_B;
+    definition             = p101_fsm_definition_create_with_index(fixture.fsm_env, fixture.fsm_err, "unknown", wide, 2U, P101_FSM_TRANSITION_INDEX_PERFECT_HASH);
+    EXPECT(definition != NULL);
+    machine = p101_fsm_info_create_from_definition(fixture.app_env, fixture.app_err, definition, fixture.fsm_env, fixture.fsm_err, NULL);
+    EXPECT(machine != NULL);
+    EXPECT(p101_fsm_step(machine, &context, NULL, &result) == P101_FSM_STEP_TRANSITIONED);
+    EXPECT(p101_fsm_step(machine, &context, NULL, &result) == P101_FSM_STEP_ERROR);
+    EXPECT(result.refusal == P101_FSM_REFUSAL_UNKNOWN_TRANSITION);
+    p101_error_reset(fixture.fsm_err);
+    p101_error_reset(fixture.app_err);
+    p101_fsm_info_destroy(fixture.app_env, fixture.fsm_err, &machine);
+    p101_fsm_definition_destroy(fixture.fsm_env, &definition);
+
+    definition = p101_fsm_definition_create_with_index(fixture.fsm_env, fixture.fsm_err, "hash", basic_transitions, 2U, P101_FSM_TRANSITION_INDEX_HASH);
+    EXPECT(p101_fsm_definition_get_transition_index(fixture.fsm_env, definition) == P101_FSM_TRANSITION_INDEX_HASH);
+    p101_fsm_definition_destroy(fixture.fsm_env, &definition);
+    definition = p101_fsm_definition_create_with_index(fixture.fsm_env, fixture.fsm_err, "automatic", basic_transitions, 2U, P101_FSM_TRANSITION_INDEX_AUTOMATIC);
+    EXPECT(p101_fsm_definition_get_transition_index(fixture.fsm_env, definition) == P101_FSM_TRANSITION_INDEX_DENSE);
+    p101_fsm_definition_destroy(fixture.fsm_env, &definition);
+
+    definition = p101_fsm_definition_create_with_index(fixture.fsm_env, fixture.fsm_err, "dense", wide, sizeof(wide) / sizeof(wide[0]), P101_FSM_TRANSITION_INDEX_DENSE);
+    EXPECT(definition == NULL);
+    error_present = p101_error_is_error(fixture.fsm_err, P101_ERROR_USER, P101_FSM_ERROR_INVALID_ARGUMENT);
+    EXPECT(error_present);
+    p101_error_reset(fixture.fsm_err);
+    definition = p101_fsm_definition_create_with_index(fixture.fsm_env, fixture.fsm_err, "duplicate", duplicate, sizeof(duplicate) / sizeof(duplicate[0]), P101_FSM_TRANSITION_INDEX_PERFECT_HASH);
+    EXPECT(definition == NULL);
+    error_present = p101_error_is_error(fixture.fsm_err, P101_ERROR_USER, P101_FSM_ERROR_INVALID_TRANSITION_TABLE);
+    EXPECT(error_present);
+    p101_error_reset(fixture.fsm_err);
     fixture_destroy(&fixture);
+}
 
-    fixture_create(&fixture, "invalid-to", invalid_to, 1U, NULL);
-    EXPECT(fixture.fsm == NULL);
-    EXPECT(p101_error_is_error(fixture.fsm_err, P101_ERROR_USER, P101_FSM_ERROR_INVALID_TRANSITION_TABLE));
+static void test_cached_perform(void)
+{
+    struct fixture                          fixture;
+    struct callback_context                 context = {0};
+    struct p101_fsm_step_result             result;
+    static const struct p101_fsm_transition transitions[] = {
+        {P101_FSM_INIT, STATE_A, state_to_b      },
+        {STATE_A,       STATE_B, state_pause_once},
+    };
+
+    pause_calls = 0;
+    fixture_create(&fixture, "cached-perform", transitions, 2U, NULL);
+    EXPECT(p101_fsm_test_cached_perform(fixture.fsm) == state_to_b);
+    EXPECT(p101_fsm_step(fixture.fsm, &context, NULL, &result) == P101_FSM_STEP_TRANSITIONED);
+    EXPECT(p101_fsm_test_cached_perform(fixture.fsm) == state_pause_once);
+    EXPECT(p101_fsm_step(fixture.fsm, &context, NULL, &result) == P101_FSM_STEP_PAUSED);
+    EXPECT(p101_fsm_test_cached_perform(fixture.fsm) == state_pause_once);
+    EXPECT(p101_fsm_step(fixture.fsm, &context, NULL, &result) == P101_FSM_STEP_EXITED);
+    EXPECT(p101_fsm_test_cached_perform(fixture.fsm) == NULL);
+    EXPECT(p101_fsm_test_cached_perform(NULL) == NULL);
     fixture_destroy(&fixture);
 }
 
-P101_ATTR_SEMANTIC_ROLE("p101:boundary-case:boundary:fsm-transition:resource_limit")
-
-static void test_create_error_paths(void)
+static void test_specialised_step(void)
 {
-    struct fixture        fixture;
-    struct fault_context  fault;
-    struct p101_fsm_info *fsm;
-    struct p101_error    *err;
+    struct fixture              fixture;
+    struct callback_context     context = {0};
+    struct p101_fsm_step_result result;
 
-    memset(&fixture, 0, sizeof(fixture));
-    fixture.app_err = p101_error_create(false);
-    fixture.app_env = p101_env_create(fixture.app_err, NULL);
-    fixture.fsm_err = p101_error_create(false);
-    fixture.fsm_env = p101_env_create(fixture.fsm_err, NULL);
-    P101_ERROR_RAISE_USER(fixture.app_err, "pre-existing", P101_FSM_ERROR_INVALID_ARGUMENT);
-    fixture.fsm = p101_fsm_info_create(fixture.app_env, fixture.app_err, "error", fixture.fsm_env, fixture.fsm_err, basic_transitions, 2U, NULL);
-    EXPECT(fixture.fsm == NULL);
+    will_calls = 0;
+    did_calls  = 0;
+    fixture_create(&fixture, "specialised", basic_transitions, 2U, NULL);
+    EXPECT(p101_fsm_test_uses_plain_step(fixture.fsm));
+    p101_fsm_info_set_bad_change_state_notifier(fixture.app_env, fixture.fsm, bad_notifier);
+    EXPECT(p101_fsm_test_uses_plain_step(fixture.fsm));
+    p101_fsm_info_set_will_change_state_notifier(fixture.app_env, fixture.fsm, will_notifier);
+    EXPECT(!p101_fsm_test_uses_plain_step(fixture.fsm));
+    p101_fsm_info_set_did_change_state_notifier(fixture.app_env, fixture.fsm, did_notifier);
+    EXPECT(p101_fsm_step(fixture.fsm, &context, NULL, &result) == P101_FSM_STEP_TRANSITIONED);
+    EXPECT(will_calls == 1 && did_calls == 1);
+    p101_fsm_info_set_will_change_state_notifier(fixture.app_env, fixture.fsm, NULL);
+    EXPECT(!p101_fsm_test_uses_plain_step(fixture.fsm));
+    p101_fsm_info_set_did_change_state_notifier(fixture.app_env, fixture.fsm, NULL);
+    EXPECT(p101_fsm_test_uses_plain_step(fixture.fsm));
+    p101_fsm_info_set_step_observer(fixture.app_env, fixture.fsm, step_observer, &context);
+    EXPECT(!p101_fsm_test_uses_plain_step(fixture.fsm));
+    p101_fsm_info_set_step_observer(fixture.app_env, fixture.fsm, NULL, NULL);
+    EXPECT(p101_fsm_test_uses_plain_step(fixture.fsm));
+    EXPECT(p101_fsm_step(fixture.fsm, &context, NULL, &result) == P101_FSM_STEP_EXITED);
+    EXPECT(will_calls == 1 && did_calls == 1 && context.observations == 0);
+    EXPECT(result.from_state == STATE_A && result.attempted_state == STATE_B && result.sequence == 2U);
+    EXPECT(p101_fsm_step(fixture.fsm, &context, NULL, &result) == P101_FSM_STEP_EXITED);
+    EXPECT(result.refusal == P101_FSM_REFUSAL_TERMINAL_MACHINE);
+    EXPECT(!p101_fsm_test_uses_plain_step(NULL));
     fixture_destroy(&fixture);
+}
 
-    memset(&fixture, 0, sizeof(fixture));
-    fixture.app_err = p101_error_create(false);
-    fixture.app_env = p101_env_create(fixture.app_err, NULL);
-    fixture.fsm_err = p101_error_create(false);
-    P101_ERROR_RAISE_USER(fixture.fsm_err, "pre-existing", P101_FSM_ERROR_INVALID_ARGUMENT);
-    fixture.fsm = p101_fsm_info_create(fixture.app_env, fixture.app_err, "error", NULL, fixture.fsm_err, basic_transitions, 2U, NULL);
-    EXPECT(fixture.fsm == NULL);
+static void test_run_bounded(void)
+{
+    struct fixture                          fixture;
+    struct callback_context                 context = {0};
+    struct p101_fsm_step_result             result;
+    struct timespec                         deadline;
+    struct p101_fsm_definition             *definition;
+    struct p101_fsm_info                   *machine;
+    static const struct p101_fsm_transition cycle[] = {
+        {P101_FSM_INIT, STATE_A, state_to_b       },
+        {STATE_A,       STATE_B, state_to_selected},
+        {STATE_B,       STATE_A, state_to_b       },
+    };
+
+    fixture_create(&fixture, "bounded", basic_transitions, 2U, NULL);
+    definition = p101_fsm_definition_create(fixture.fsm_env, fixture.fsm_err, "cycle", cycle, 3U);
+    machine    = p101_fsm_info_create_from_definition(fixture.app_env, fixture.app_err, definition, fixture.fsm_env, fixture.fsm_err, NULL);
+    EXPECT(machine != NULL);
+    context.selected_state = STATE_A;
+
+    EXPECT(p101_fsm_run_bounded(machine, &context, NULL, 5U, NULL, &result) == P101_FSM_RUN_BUDGET_EXHAUSTED);
+    EXPECT(context.calls == 5 && result.status == P101_FSM_STEP_TRANSITIONED && result.sequence == 5U);
+    EXPECT(p101_fsm_run_bounded(machine, &context, NULL, 0U, NULL, &result) == P101_FSM_RUN_BUDGET_EXHAUSTED);
+    EXPECT(context.calls == 5);
+    EXPECT(result.status == P101_FSM_STEP_ERROR && result.sequence == 0U && result.next_state == P101_FSM_STATE_NONE);
+
+    deadline.tv_sec  = 0;
+    deadline.tv_nsec = 0;
+    result.status    = P101_FSM_STEP_TRANSITIONED;
+    EXPECT(p101_fsm_run_bounded(machine, &context, NULL, 5U, &deadline, &result) == P101_FSM_RUN_BUDGET_EXHAUSTED);
+    EXPECT(context.calls == 5);
+    EXPECT(result.status == P101_FSM_STEP_ERROR && result.sequence == 0U);
+    EXPECT(clock_gettime(CLOCK_MONOTONIC, &deadline) == 0);
+    deadline.tv_sec += 3600;
+    EXPECT(p101_fsm_run_bounded(machine, &context, NULL, 3U, &deadline, NULL) == P101_FSM_RUN_BUDGET_EXHAUSTED);
+    EXPECT(context.calls == 8);
+    EXPECT(p101_fsm_info_get_step_sequence(fixture.fsm_env, machine) == 8U);
+
+    EXPECT(p101_fsm_run_bounded(fixture.fsm, NULL, NULL, 10U, &deadline, &result) == P101_FSM_RUN_EXITED);
+    EXPECT(result.status == P101_FSM_STEP_EXITED && result.sequence == 2U);
+    EXPECT(p101_fsm_run_bounded(NULL, NULL, NULL, 10U, NULL, &result) == P101_FSM_RUN_ERROR);
+    EXPECT(result.status == P101_FSM_STEP_ERROR);
+
+    p101_fsm_info_destroy(fixture.app_env, fixture.fsm_err, &machine);
+    p101_fsm_definition_destroy(fixture.fsm_env, &definition);
     fixture_destroy(&fixture);
+}
 
-    memset(&fixture, 0, sizeof(fixture));
-    fixture.app_err = p101_error_create(false);
-    fixture.app_env = p101_env_create(fixture.app_err, NULL);
-    fixture.fsm     = p101_fsm_info_create(fixture.app_env, fixture.app_err, "default-env", NULL, NULL, basic_transitions, 2U, NULL);
-    EXPECT(fixture.fsm != NULL);
-    p101_fsm_info_destroy(fixture.app_env, fixture.app_err, &fixture.fsm);
+static void test_step_many(void)
+{
+    struct fixture               fixture;
+    struct callback_context      first  = {0};
+    struct callback_context      second = {0};
+    struct p101_fsm_step_result  results[3];
+    struct p101_fsm_definition  *definition;
+    struct p101_fsm_info        *machine;
+    struct p101_fsm_info        *machines[3];
+    void                        *args[3];
+
+    fixture_create(&fixture, "many", basic_transitions, 2U, NULL);
+    definition = p101_fsm_definition_create_with_index(fixture.fsm_env, fixture.fsm_err, "many-csr", basic_transitions, 2U, P101_FSM_TRANSITION_INDEX_CSR);
+    EXPECT(definition != NULL);
+    machine = p101_fsm_info_create_from_definition(fixture.app_env, fixture.app_err, definition, fixture.fsm_env, fixture.fsm_err, NULL);
+    EXPECT(machine != NULL);
+    machines[0] = fixture.fsm;
+    machines[1] = NULL;
+    machines[2] = machine;
+    args[0]     = &first;
+    args[1]     = NULL;
+    args[2]     = &second;
+
+    EXPECT(p101_fsm_step_many(machines, args, NULL, results, 3U) == 2U);
+    EXPECT(results[0].status == P101_FSM_STEP_TRANSITIONED && results[0].next_state == STATE_B);
+    EXPECT(results[1].status == P101_FSM_STEP_ERROR && results[1].sequence == 0U);
+    EXPECT(results[2].status == P101_FSM_STEP_TRANSITIONED && results[2].sequence == 1U);
+    EXPECT(first.calls == 1 && second.calls == 1);
+    EXPECT(p101_fsm_step_many(machines, NULL, NULL, results, 3U) == 2U);
+    EXPECT(results[0].status == P101_FSM_STEP_EXITED && results[2].status == P101_FSM_STEP_EXITED);
+    EXPECT(first.calls == 1 && second.calls == 1);
+    EXPECT(p101_fsm_step_many(machines, args, NULL, results, 3U) == 2U);
+    EXPECT(results[0].refusal == P101_FSM_REFUSAL_TERMINAL_MACHINE && results[2].refusal == P101_FSM_REFUSAL_TERMINAL_MACHINE);
+    EXPECT(p101_fsm_step_many(machines, args, NULL, results, 0U) == 0U);
+    EXPECT(p101_fsm_step_many(NULL, args, NULL, results, 3U) == 0U);
+    EXPECT(p101_fsm_step_many(machines, args, NULL, NULL, 3U) == 0U);
+
+    p101_fsm_info_destroy(fixture.app_env, fixture.fsm_err, &machine);
+    p101_fsm_definition_destroy(fixture.fsm_env, &definition);
     fixture_destroy(&fixture);
+}
 
-    err = p101_error_create(false);
-    fsm = p101_fsm_info_create(NULL, err, "null-env", NULL, NULL, basic_transitions, 2U, NULL);
-    EXPECT(fsm != NULL);
-    p101_fsm_info_destroy(NULL, err, &fsm);
-    EXPECT(fsm == NULL);
-    p101_error_destroy(err);
+static void test_pool(void)
+{
+    struct fixture                          fixture;
+    struct fault_context                    fault;
+    struct callback_context                 contexts[4];
+    struct p101_fsm_step_result             results[4];
+    struct p101_fsm_step_result             result;
+    struct p101_fsm_definition             *definition;
+    struct p101_fsm_pool                   *pool;
+    void                                   *args[4];
+    bool                                    error_present;
+    static const struct p101_fsm_transition transitions[] = {
+        {P101_FSM_INIT, STATE_A, state_to_selected},
+        {STATE_A,       STATE_B, state_exit       },
+    };
 
-    fault = (struct fault_context){"calloc", 1, 0};
-    fixture_create_with_fault(&fixture, &fault);
-    EXPECT(fixture.fsm == NULL);
-    EXPECT(p101_error_is_error(fixture.fsm_err, P101_ERROR_ERRNO, ENOMEM));
+    fixture_create(&fixture, "unused", basic_transitions, 2U, NULL);
+    definition = p101_fsm_definition_create(fixture.fsm_env, fixture.fsm_err, "pool", transitions, 2U);
+    EXPECT(definition != NULL);
+    pool = p101_fsm_pool_create(fixture.app_env, fixture.app_err, definition, 4U, fixture.fsm_env, fixture.fsm_err);
+    EXPECT(pool != NULL);
+    p101_fsm_definition_destroy(fixture.fsm_env, &definition);
+    EXPECT(p101_fsm_pool_get_capacity(fixture.fsm_env, pool) == 4U);
+    EXPECT(p101_fsm_pool_count_in_state(fixture.fsm_env, pool, STATE_A) == 4U);
+    for(size_t i = 0U; i < 4U; i++)
+    {
+        memset(&contexts[i], 0, sizeof(contexts[i]));
+        contexts[i].selected_state = i == 3U ? STATE_SPARSE : STATE_B;
+        args[i]                    = &contexts[i];
+    }
+
+    EXPECT(p101_fsm_pool_step_range(pool, 0U, 4U, args, NULL, results) == 4U);
+    EXPECT(results[0].status == P101_FSM_STEP_TRANSITIONED && results[0].from_state == P101_FSM_INIT && results[0].next_state == STATE_B);
+    EXPECT(results[3].status == P101_FSM_STEP_TRANSITIONED && results[3].next_state == STATE_SPARSE);
+    EXPECT(contexts[0].calls == 1 && contexts[3].calls == 1);
+    EXPECT(p101_fsm_pool_count_in_state(fixture.fsm_env, pool, STATE_B) == 3U);
+    EXPECT(p101_fsm_pool_get_step_sequence(fixture.fsm_env, pool, 2U) == 1U);
+
+    EXPECT(p101_fsm_pool_step(pool, 3U, args[3], NULL, &result) == P101_FSM_STEP_ERROR);
+    EXPECT(result.refusal == P101_FSM_REFUSAL_UNKNOWN_TRANSITION && result.from_state == STATE_A && result.attempted_state == STATE_SPARSE);
+    error_present = p101_error_is_error(fixture.fsm_err, P101_ERROR_USER, P101_FSM_ERROR_UNKNOWN_TRANSITION);
+    EXPECT(error_present);
+    EXPECT(p101_fsm_pool_step(pool, 0U, NULL, NULL, &result) == P101_FSM_STEP_ERROR);
+    EXPECT(p101_fsm_pool_get_current_state(fixture.fsm_env, pool, 0U) == STATE_B);
+    p101_error_reset(fixture.fsm_err);
+
+    EXPECT(p101_fsm_pool_step_range(pool, 0U, 3U, NULL, NULL, results) == 3U);
+    EXPECT(results[1].status == P101_FSM_STEP_EXITED && results[1].next_state == P101_FSM_STATE_NONE);
+    EXPECT(p101_fsm_pool_is_terminal(fixture.fsm_env, pool, 1U));
+    EXPECT(p101_fsm_pool_count_in_state(fixture.fsm_env, pool, STATE_B) == 0U);
+    EXPECT(p101_fsm_pool_step(pool, 1U, NULL, NULL, &result) == P101_FSM_STEP_EXITED);
+    EXPECT(result.refusal == P101_FSM_REFUSAL_TERMINAL_MACHINE);
+
+    p101_fsm_pool_reset_session(fixture.fsm_env, pool, 1U);
+    EXPECT(!p101_fsm_pool_is_terminal(fixture.fsm_env, pool, 1U));
+    EXPECT(p101_fsm_pool_get_current_state(fixture.fsm_env, pool, 1U) == STATE_A);
+    EXPECT(p101_fsm_pool_get_step_sequence(fixture.fsm_env, pool, 1U) == 0U);
+    EXPECT(p101_fsm_pool_step(pool, 1U, args[1], NULL, &result) == P101_FSM_STEP_TRANSITIONED);
+    EXPECT(result.sequence == 1U);
+
+    EXPECT(p101_fsm_pool_step_range(pool, 3U, 2U, args, NULL, results) == 0U);
+    EXPECT(results[1].status == P101_FSM_STEP_ERROR && results[1].sequence == 0U);
+    error_present = p101_error_is_error(fixture.fsm_err, P101_ERROR_USER, P101_FSM_ERROR_INVALID_ARGUMENT);
+    EXPECT(error_present);
+    p101_error_reset(fixture.fsm_err);
+    EXPECT(p101_fsm_pool_step(pool, 4U, NULL, NULL, &result) == P101_FSM_STEP_ERROR);
+    p101_error_reset(fixture.fsm_err);
+    p101_fsm_pool_reset_session(fixture.fsm_env, pool, 4U);
+    p101_error_reset(fixture.fsm_err);
+    EXPECT(p101_fsm_pool_step(pool, 0U, NULL, NULL, NULL) == P101_FSM_STEP_ERROR);
+    p101_error_reset(fixture.fsm_err);
+    EXPECT(p101_fsm_pool_step(NULL, 0U, NULL, NULL, &result) == P101_FSM_STEP_ERROR);
+    EXPECT(p101_fsm_pool_step_range(NULL, 0U, 1U, NULL, NULL, results) == 0U);
+    EXPECT(p101_fsm_pool_get_current_state(fixture.fsm_env, pool, 4U) == P101_FSM_STATE_NONE);
+    EXPECT(p101_fsm_pool_get_step_sequence(fixture.fsm_env, NULL, 0U) == 0U);
+    EXPECT(!p101_fsm_pool_is_terminal(fixture.fsm_env, pool, 4U));
+    EXPECT(p101_fsm_pool_get_capacity(fixture.fsm_env, NULL) == 0U);
+    EXPECT(p101_fsm_pool_count_in_state(fixture.fsm_env, NULL, STATE_A) == 0U);
+    p101_fsm_pool_destroy(fixture.fsm_env, fixture.fsm_err, &pool);
+    EXPECT(pool == NULL);
+
+    definition = p101_fsm_definition_create(fixture.fsm_env, fixture.fsm_err, "pool", transitions, 2U);
+    pool       = p101_fsm_pool_create(fixture.app_env, fixture.app_err, definition, 0U, fixture.fsm_env, fixture.fsm_err);
+    EXPECT(pool == NULL);
+    error_present = p101_error_is_error(fixture.fsm_err, P101_ERROR_USER, P101_FSM_ERROR_INVALID_ARGUMENT);
+    EXPECT(error_present);
+    p101_error_reset(fixture.fsm_err);
+    pool = p101_fsm_pool_create(fixture.app_env, fixture.app_err, definition, SIZE_MAX, fixture.fsm_env, fixture.fsm_err);
+    EXPECT(pool == NULL);
+    p101_error_reset(fixture.fsm_err);
+    pool = p101_fsm_pool_create(fixture.app_env, fixture.app_err, NULL, 4U, fixture.fsm_env, fixture.fsm_err);
+    EXPECT(pool == NULL);
+    p101_error_reset(fixture.fsm_err);
+    p101_fsm_definition_destroy(fixture.fsm_env, &definition);
     fixture_destroy(&fixture);
 
-    fault = (struct fault_context){"p101_strdup", 1, 0};
+    fault = (struct fault_context){"calloc", 4, 0};
     fixture_create_with_fault(&fixture, &fault);
-    EXPECT(fixture.fsm == NULL);
+    definition = p101_fsm_definition_create(fixture.fsm_env, fixture.fsm_err, "pool", transitions, 2U);
+    EXPECT(definition != NULL);
+    pool = p101_fsm_pool_create(fixture.app_env, fixture.app_err, definition, 4U, fixture.fsm_env, fixture.fsm_err);
+    EXPECT(pool == NULL);
     EXPECT(p101_error_is_error(fixture.fsm_err, P101_ERROR_ERRNO, ENOMEM));
+    p101_fsm_definition_destroy(fixture.fsm_env, &definition);
     fixture_destroy(&fixture);
+}
 
-    fault = (struct fault_context){"calloc", 2, 0};
-    fixture_create_with_fault(&fixture, &fault);
-    EXPECT(fixture.fsm == NULL);
+static void state_pause_exclusive(const struct p101_env *env, struct p101_error *err, void *arg, struct p101_fsm_effect_sink *sink, struct p101_fsm_decision *decision)
+{
+    struct executor_context *context = (struct executor_context *)arg;
+
+    (void)env;
+    (void)err;
+    (void)sink;
+    if(atomic_fetch_add(&context->running, 1) != 0)
+    {
+        atomic_fetch_add(&context->overlaps, 1);
+    }
+    atomic_fetch_add(&context->runs, 1);
+    atomic_fetch_sub(&context->running, 1);
+    p101_fsm_decide_pause(decision);
+}
+
+static void test_executor(void)
+{
+    enum
+    {
+        MACHINE_COUNT = 8,
+        RESCHEDULES   = 200,
+    };
+    struct fixture                          fixtures[MACHINE_COUNT];
+    struct callback_context                 contexts[MACHINE_COUNT];
+    struct p101_fsm_task                   *tasks[MACHINE_COUNT];
+    struct fixture                          fixture;
+    struct fault_context                    fault;
+    struct executor_context                 exclusive;
+    struct p101_fsm_executor               *executor;
+    struct p101_fsm_task                   *task;
+    bool                                    error_present;
+    static const struct p101_fsm_transition pausing[] = {
+        {P101_FSM_INIT, STATE_A, state_pause_exclusive},
+    };
+
+    fixture_create(&fixture, "executor", pausing, 1U, NULL);
+    executor = p101_fsm_executor_create(fixture.app_env, fixture.app_err, 3U);
+    EXPECT(executor != NULL);
+    for(size_t i = 0U; i < MACHINE_COUNT; ++i)
+    {
+        memset(&contexts[i], 0, sizeof(contexts[i]));
+        fixture_create(&fixtures[i], "worker", basic_transitions, 2U, NULL);
+        tasks[i] = p101_fsm_task_create(fixture.app_env, fixture.app_err, fixtures[i].fsm, &contexts[i], NULL);
+        EXPECT(tasks[i] != NULL);
+        EXPECT(p101_fsm_task_get_result(fixture.app_env, tasks[i]) == P101_FSM_RUN_PAUSED);
+    }
+    for(size_t i = 0U; i < MACHINE_COUNT; ++i)
+    {
+        EXPECT(p101_fsm_executor_schedule(fixture.app_env, fixture.app_err, executor, tasks[i]) == 0);
+    }
+    p101_fsm_executor_wait(fixture.app_env, executor);
+    for(size_t i = 0U; i < MACHINE_COUNT; ++i)
+    {
+        EXPECT(p101_fsm_task_get_result(fixture.app_env, tasks[i]) == P101_FSM_RUN_EXITED);
+        EXPECT(contexts[i].calls == 2);
+        EXPECT(p101_fsm_info_get_current_state(fixtures[i].fsm_env, fixtures[i].fsm) == STATE_B);
+        p101_fsm_task_destroy(fixture.app_env, fixture.app_err, &tasks[i]);
+        EXPECT(tasks[i] == NULL);
+        fixture_destroy(&fixtures[i]);
+    }
+
+    // Scheduling a queued or running task must never start a second, concurrent run of its machine.
+    atomic_init(&exclusive.running, 0);
+    atomic_init(&exclusive.runs, 0);
+    atomic_init(&exclusive.overlaps, 0);
+    task = p101_fsm_task_create(fixture.app_env, fixture.app_err, fixture.fsm, &exclusive, NULL);
+    EXPECT(task != NULL);
+    for(int i = 0; i < RESCHEDULES; ++i)
+    {
+        EXPECT(p101_fsm_executor_schedule(fixture.app_env, fixture.app_err, executor, task) == 0);
+    }
+    p101_fsm_executor_wait(fixture.app_env, executor);
+    EXPECT(atomic_load(&exclusive.overlaps) == 0);
+    EXPECT(atomic_load(&exclusive.runs) >= 1 && atomic_load(&exclusive.runs) <= RESCHEDULES);
+    EXPECT(p101_fsm_task_get_result(fixture.app_env, task) == P101_FSM_RUN_PAUSED);
+
+    EXPECT(p101_fsm_executor_schedule(fixture.app_env, fixture.app_err, executor, NULL) == -1);
+    error_present = p101_error_is_error(fixture.app_err, P101_ERROR_USER, P101_FSM_ERROR_INVALID_ARGUMENT);
+    EXPECT(error_present);
+    p101_error_reset(fixture.app_err);
+    EXPECT(p101_fsm_executor_schedule(fixture.app_env, fixture.app_err, NULL, task) == -1);
+    p101_error_reset(fixture.app_err);
+    EXPECT(p101_fsm_task_create(fixture.app_env, fixture.app_err, NULL, NULL, NULL) == NULL);
+    p101_error_reset(fixture.app_err);
+    EXPECT(p101_fsm_task_get_result(fixture.app_env, NULL) == P101_FSM_RUN_ERROR);
+    p101_fsm_executor_wait(fixture.app_env, NULL);
+    p101_fsm_task_destroy(fixture.app_env, fixture.app_err, &task);
+    p101_fsm_task_destroy(fixture.app_env, fixture.app_err, NULL);
+    p101_fsm_executor_destroy(fixture.app_env, fixture.app_err, &executor);
+    EXPECT(executor == NULL);
+    p101_fsm_executor_destroy(fixture.app_env, fixture.app_err, &executor);
+    EXPECT(p101_fsm_executor_create(fixture.app_env, fixture.app_err, 0U) == NULL);
+    error_present = p101_error_is_error(fixture.app_err, P101_ERROR_USER, P101_FSM_ERROR_INVALID_ARGUMENT);
+    EXPECT(error_present);
+    p101_error_reset(fixture.app_err);
+    fixture_destroy(&fixture);
+
+    fault = (struct fault_context){"calloc", 0, 0};
+    fixture_create_with_fault(&fixture, &fault);
+    fault.seen       = 0;
+    fault.occurrence = 2;
+    executor         = p101_fsm_executor_create(fixture.fsm_env, fixture.fsm_err, 2U);
+    EXPECT(executor == NULL);
+    EXPECT(p101_error_is_error(fixture.fsm_err, P101_ERROR_ERRNO, ENOMEM));
+    p101_error_reset(fixture.fsm_err);
+    fault.seen       = 0;
+    fault.occurrence = 1;
+    EXPECT(p101_fsm_task_create(fixture.fsm_env, fixture.fsm_err, fixture.fsm, NULL, NULL) == NULL);
+    EXPECT(p101_error_is_error(fixture.fsm_err, P101_ERROR_ERRNO, ENOMEM));
+    p101_error_reset(fixture.fsm_err);
+    fixture_destroy(&fixture);
+}
+
+static void state_on_event(const struct p101_env *env, struct p101_error *err, void *arg, struct p101_fsm_effect_sink *sink, struct p101_fsm_decision *decision)
+{
+    const struct p101_fsm_event_context *event_context = (const struct p101_fsm_event_context *)arg;
+    struct callback_context             *context       = (struct callback_context *)event_context->arg;
+
+    (void)env;
+    (void)err;
+    (void)sink;
+    context->calls++;
+    context->effect_value += event_context->event.kind;
+    if(event_context->event.kind == 1)
+    {
+        p101_fsm_decide_transition(decision, context->selected_state);
+    }
+    else if(event_context->event.kind == 2)
+    {
+        p101_fsm_decide_exit(decision);
+    }
+    else if(event_context->event.kind != 3)
+    {
+        p101_fsm_decide_pause(decision);
+    }
+}
+
+static void *event_producer(void *arg)
+{
+    struct producer_context *context = (struct producer_context *)arg;
+
+    for(int i = 0; i < context->count; ++i)
+    {
+        struct p101_fsm_event event = {context->first_kind + i, NULL};
+
+        while(!p101_fsm_inbox_post(context->inbox, &event))
+        {
+        }
+    }
+
+    return NULL;
+}
+
+static void test_event_inbox(void)
+{
+    enum
+    {
+        PRODUCERS         = 4,
+        EVENTS_PER_THREAD = 1000,
+    };
+    struct fixture                          fixture;
+    struct callback_context                 context = {0};
+    struct p101_fsm_step_result             result;
+    struct p101_fsm_inbox                  *inbox;
+    struct p101_fsm_inbox                  *shared;
+    struct p101_fsm_executor               *executor;
+    struct p101_fsm_task                   *task;
+    struct producer_context                 producers[PRODUCERS];
+    pthread_t                               threads[PRODUCERS];
+    int                                     expected_sum;
+    bool                                    error_present;
+    static const struct p101_fsm_event      pause_event = {0, NULL};
+    static const struct p101_fsm_event      move_event  = {1, NULL};
+    static const struct p101_fsm_event      exit_event  = {2, NULL};
+    static const struct p101_fsm_event      stray_event = {3, NULL};
+    static const struct p101_fsm_transition transitions[] = {
+        {P101_FSM_INIT, STATE_A, state_on_event},
+        {STATE_A,       STATE_B, state_on_event},
+        {STATE_B,       STATE_A, state_on_event},
+    };
+
+    fixture_create(&fixture, "events", transitions, 3U, NULL);
+    inbox = p101_fsm_inbox_create(fixture.app_env, fixture.app_err, 3U);
+    EXPECT(inbox != NULL);
+    EXPECT(p101_fsm_inbox_get_capacity(fixture.app_env, inbox) == 4U);
+    context.selected_state = STATE_B;
+
+    EXPECT(p101_fsm_step_event(fixture.fsm, inbox, &context, NULL, &result) == P101_FSM_STEP_PAUSED);
+    EXPECT(context.calls == 0 && result.sequence == 0U && result.attempted_state == STATE_A);
+    EXPECT(p101_fsm_inbox_post(inbox, &pause_event));
+    EXPECT(p101_fsm_inbox_post(inbox, &stray_event));
+    EXPECT(p101_fsm_inbox_count(inbox) == 2U);
+    EXPECT(p101_fsm_step_event(fixture.fsm, inbox, &context, NULL, &result) == P101_FSM_STEP_PAUSED);
+    EXPECT(context.calls == 1 && result.sequence == 1U && p101_fsm_inbox_count(inbox) == 1U);
+
+    // A refused step does not commit, so its event stays at the head of the inbox.
+    EXPECT(p101_fsm_step_event(fixture.fsm, inbox, &context, NULL, &result) == P101_FSM_STEP_REFUSED);
+    EXPECT(result.refusal == P101_FSM_REFUSAL_INVALID_CALLBACK_DECISION && p101_fsm_inbox_count(inbox) == 1U);
+    p101_error_reset(fixture.app_err);
+    EXPECT(p101_fsm_run_events(fixture.fsm, inbox, &context, NULL, &result) == P101_FSM_RUN_REFUSED);
+    EXPECT(context.calls == 3 && p101_fsm_inbox_count(inbox) == 1U);
+    p101_error_reset(fixture.app_err);
+    p101_fsm_inbox_destroy(fixture.app_env, &inbox);
+    inbox = p101_fsm_inbox_create(fixture.app_env, fixture.app_err, 4U);
+    EXPECT(p101_fsm_inbox_post(inbox, &move_event));
+    EXPECT(p101_fsm_step_event(fixture.fsm, inbox, &context, NULL, &result) == P101_FSM_STEP_TRANSITIONED);
+    EXPECT(result.next_state == STATE_B && p101_fsm_inbox_count(inbox) == 0U);
+
+    context.selected_state = STATE_A;
+    EXPECT(p101_fsm_inbox_post(inbox, &move_event));
+    EXPECT(p101_fsm_inbox_post(inbox, &pause_event));
+    EXPECT(p101_fsm_inbox_post(inbox, &pause_event));
+    EXPECT(p101_fsm_inbox_post(inbox, &pause_event));
+    EXPECT(!p101_fsm_inbox_post(inbox, &pause_event));
+    EXPECT(p101_fsm_run_events(fixture.fsm, inbox, &context, NULL, &result) == P101_FSM_RUN_PAUSED);
+    EXPECT(context.calls == 8 && p101_fsm_inbox_count(inbox) == 0U);
+    EXPECT(p101_fsm_info_get_current_state(fixture.fsm_env, fixture.fsm) == STATE_A);
+
+    EXPECT(p101_fsm_inbox_post(inbox, &exit_event));
+    EXPECT(p101_fsm_inbox_post(inbox, &pause_event));
+    EXPECT(p101_fsm_run_events(fixture.fsm, inbox, &context, NULL, &result) == P101_FSM_RUN_EXITED);
+    EXPECT(context.calls == 9 && p101_fsm_inbox_count(inbox) == 1U);
+    EXPECT(p101_fsm_step_event(fixture.fsm, inbox, &context, NULL, &result) == P101_FSM_STEP_EXITED);
+    EXPECT(result.refusal == P101_FSM_REFUSAL_TERMINAL_MACHINE && p101_fsm_inbox_count(inbox) == 1U);
+
+    EXPECT(p101_fsm_step_event(NULL, inbox, &context, NULL, &result) == P101_FSM_STEP_ERROR);
+    EXPECT(p101_fsm_step_event(fixture.fsm, NULL, &context, NULL, &result) == P101_FSM_STEP_ERROR);
+    EXPECT(result.status == P101_FSM_STEP_ERROR);
+    EXPECT(p101_fsm_run_events(fixture.fsm, NULL, &context, NULL, NULL) == P101_FSM_RUN_ERROR);
+    EXPECT(!p101_fsm_inbox_post(NULL, &pause_event));
+    EXPECT(!p101_fsm_inbox_post(inbox, NULL));
+    EXPECT(p101_fsm_inbox_count(NULL) == 0U);
+    EXPECT(p101_fsm_inbox_get_capacity(fixture.app_env, NULL) == 0U);
+    EXPECT(p101_fsm_inbox_create(fixture.app_env, fixture.app_err, 0U) == NULL);
+    error_present = p101_error_is_error(fixture.app_err, P101_ERROR_USER, P101_FSM_ERROR_INVALID_ARGUMENT);
+    EXPECT(error_present);
+    p101_error_reset(fixture.app_err);
+    EXPECT(p101_fsm_inbox_create(fixture.app_env, fixture.app_err, SIZE_MAX) == NULL);
+    p101_error_reset(fixture.app_err);
+    p101_fsm_inbox_destroy(fixture.app_env, &inbox);
+    EXPECT(inbox == NULL);
+    p101_fsm_inbox_destroy(fixture.app_env, &inbox);
+    fixture_destroy(&fixture);
+
+    // A redirect runs no callback, so its event is kept for the redirected state and delivered once.
+    fixture_create(&fixture, "events-redirect", transitions, 3U, redirect_handler);
+    memset(&context, 0, sizeof(context));
+    inbox                  = p101_fsm_inbox_create(fixture.app_env, fixture.app_err, 4U);
+    context.selected_state = STATE_C;
+    redirect_state         = STATE_B;
+    EXPECT(p101_fsm_inbox_post(inbox, &move_event));
+    EXPECT(p101_fsm_step_event(fixture.fsm, inbox, &context, NULL, &result) == P101_FSM_STEP_TRANSITIONED);
+    EXPECT(p101_fsm_inbox_post(inbox, &move_event));
+    EXPECT(p101_fsm_inbox_post(inbox, &pause_event));
+    EXPECT(p101_fsm_run_events(fixture.fsm, inbox, &context, NULL, &result) == P101_FSM_RUN_REFUSED);
+    EXPECT(result.refusal == P101_FSM_REFUSAL_UNKNOWN_TRANSITION && result.next_state == STATE_B);
+    EXPECT(context.calls == 1 && p101_fsm_inbox_count(inbox) == 2U);
+    redirect_state = STATE_A;
+    EXPECT(p101_fsm_step_event(fixture.fsm, inbox, &context, NULL, &result) == P101_FSM_STEP_TRANSITIONED);
+    EXPECT(result.attempted_state == STATE_B && context.calls == 2 && p101_fsm_inbox_count(inbox) == 1U);
+    EXPECT(p101_fsm_step_event(fixture.fsm, inbox, &context, NULL, &result) == P101_FSM_STEP_REFUSED);
+    EXPECT(result.next_state == STATE_A && context.calls == 2 && p101_fsm_inbox_count(inbox) == 1U);
+    EXPECT(p101_fsm_run_events(fixture.fsm, inbox, &context, NULL, &result) == P101_FSM_RUN_PAUSED);
+    EXPECT(context.calls == 3 && context.effect_value == 2 && p101_fsm_inbox_count(inbox) == 0U);
+    p101_fsm_inbox_destroy(fixture.app_env, &inbox);
+    fixture_destroy(&fixture);
+
+    // Producers on several threads post into one inbox while the machine drains it.
+    fixture_create(&fixture, "producers", transitions, 3U, NULL);
+    memset(&context, 0, sizeof(context));
+    shared       = p101_fsm_inbox_create(fixture.app_env, fixture.app_err, 64U);
+    expected_sum = 0;
+    for(int i = 0; i < PRODUCERS; ++i)
+    {
+        producers[i] = (struct producer_context){shared, 4 + i * EVENTS_PER_THREAD, EVENTS_PER_THREAD};
+        for(int j = 0; j < EVENTS_PER_THREAD; ++j)
+        {
+            expected_sum += producers[i].first_kind + j;
+        }
+        EXPECT(pthread_create(&threads[i], NULL, event_producer, &producers[i]) == 0);
+    }
+    while(context.calls < PRODUCERS * EVENTS_PER_THREAD)
+    {
+        EXPECT(p101_fsm_run_events(fixture.fsm, shared, &context, NULL, NULL) == P101_FSM_RUN_PAUSED);
+    }
+    for(int i = 0; i < PRODUCERS; ++i)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    EXPECT(context.calls == PRODUCERS * EVENTS_PER_THREAD && context.effect_value == expected_sum);
+    EXPECT(p101_fsm_inbox_count(shared) == 0U);
+    p101_fsm_inbox_destroy(fixture.app_env, &shared);
+    fixture_destroy(&fixture);
+
+    // An executor task with an inbox is only queued while it holds events.
+    fixture_create(&fixture, "scheduled", transitions, 3U, NULL);
+    memset(&context, 0, sizeof(context));
+    context.selected_state = STATE_B;
+    inbox                  = p101_fsm_inbox_create(fixture.app_env, fixture.app_err, 1U);
+    executor               = p101_fsm_executor_create(fixture.app_env, fixture.app_err, 2U);
+    task                   = p101_fsm_task_create_with_inbox(fixture.app_env, fixture.app_err, fixture.fsm, inbox, &context, NULL);
+    EXPECT(task != NULL);
+    EXPECT(p101_fsm_executor_schedule(fixture.app_env, fixture.app_err, executor, task) == 0);
+    p101_fsm_executor_wait(fixture.app_env, executor);
+    EXPECT(context.calls == 0);
+    EXPECT(p101_fsm_executor_post(fixture.app_env, fixture.app_err, executor, task, &move_event) == 0);
+    p101_fsm_executor_wait(fixture.app_env, executor);
+    EXPECT(context.calls == 1 && p101_fsm_task_get_result(fixture.app_env, task) == P101_FSM_RUN_PAUSED);
+    EXPECT(p101_fsm_executor_post(fixture.app_env, fixture.app_err, executor, task, &exit_event) == 0);
+    p101_fsm_executor_wait(fixture.app_env, executor);
+    EXPECT(context.calls == 2 && p101_fsm_task_get_result(fixture.app_env, task) == P101_FSM_RUN_EXITED);
+    EXPECT(p101_fsm_executor_post(fixture.app_env, fixture.app_err, executor, task, &pause_event) == 0);
+    p101_fsm_executor_wait(fixture.app_env, executor);
+    EXPECT(context.calls == 2 && p101_fsm_inbox_count(inbox) == 1U);
+    EXPECT(p101_fsm_inbox_get_capacity(fixture.app_env, inbox) == 2U);
+    EXPECT(p101_fsm_executor_post(fixture.app_env, fixture.app_err, executor, task, &pause_event) == 0);
+    p101_fsm_executor_wait(fixture.app_env, executor);
+    EXPECT(p101_fsm_executor_post(fixture.app_env, fixture.app_err, executor, task, &pause_event) == -1);
+    error_present = p101_error_is_error(fixture.app_err, P101_ERROR_USER, P101_FSM_ERROR_INBOX_FULL);
+    EXPECT(error_present);
+    p101_error_reset(fixture.app_err);
+    EXPECT(p101_fsm_executor_post(fixture.app_env, fixture.app_err, executor, task, NULL) == -1);
+    p101_error_reset(fixture.app_err);
+    EXPECT(p101_fsm_task_create_with_inbox(fixture.app_env, fixture.app_err, fixture.fsm, NULL, &context, NULL) == NULL);
+    error_present = p101_error_is_error(fixture.app_err, P101_ERROR_USER, P101_FSM_ERROR_INVALID_ARGUMENT);
+    EXPECT(error_present);
+
+    // An error already set stops creation, as it does for p101_fsm_task_create.
+    EXPECT(p101_fsm_task_create_with_inbox(fixture.app_env, fixture.app_err, fixture.fsm, inbox, &context, NULL) == NULL);
+    p101_error_reset(fixture.app_err);
+    p101_fsm_task_destroy(fixture.app_env, fixture.app_err, &task);
+    p101_fsm_executor_destroy(fixture.app_env, fixture.app_err, &executor);
+    p101_fsm_inbox_destroy(fixture.app_env, &inbox);
+    fixture_destroy(&fixture);
+}
+
+#if defined(__linux__)
+static void state_read_ready(const struct p101_env *env, struct p101_error *err, void *arg, struct p101_fsm_effect_sink *sink, struct p101_fsm_decision *decision)
+{
+    struct reactor_context *context = (struct reactor_context *)arg;
+    char                    byte;
+
+    (void)sink;
+    if((p101_fsm_reactor_get_ready(env, context->machine) & EPOLLIN) != 0U && read(context->fd, &byte, 1U) == 1)
+    {
+        context->reads++;
+    }
+    if(context->reads == 2)
+    {
+        p101_fsm_decide_exit(decision);
+    }
+    else
+    {
+        context->watch_status = p101_fsm_reactor_watch(env, err, context->machine, context->fd, EPOLLIN);
+        p101_fsm_decide_pause(decision);
+    }
+}
+
+static void test_reactor(void)
+{
+    struct fixture                          fixture;
+    struct reactor_context                  context = {0};
+    struct p101_fsm_reactor                *reactor;
+    struct p101_fsm_reactor_machine        *machine;
+    int                                     fds[2];
+    bool                                    error_present;
+    static const struct p101_fsm_transition transitions[] = {
+        {P101_FSM_INIT, STATE_A, state_read_ready},
+    };
+
+    fixture_create(&fixture, "reactor", transitions, 1U, NULL);
+    EXPECT(pipe(fds) == 0);
+    reactor = p101_fsm_reactor_create(fixture.app_env, fixture.app_err, 16U);
+    EXPECT(reactor != NULL);
+    machine = p101_fsm_reactor_attach(fixture.app_env, fixture.app_err, reactor, fixture.fsm, &context, NULL);
+    EXPECT(machine != NULL);
+    EXPECT(p101_fsm_reactor_get_result(fixture.app_env, machine) == P101_FSM_RUN_PAUSED);
+    context.machine = machine;
+    context.fd      = fds[0];
+
+    // The first run arms the watch; nothing is stepped until the pipe is readable.
+    EXPECT(p101_fsm_run(fixture.fsm, &context, NULL, NULL) == P101_FSM_RUN_PAUSED);
+    EXPECT(context.watch_status == 0 && context.reads == 0);
+    EXPECT(p101_fsm_reactor_poll(fixture.app_env, fixture.app_err, reactor, 0) == 0);
+    EXPECT(p101_fsm_info_get_step_sequence(fixture.fsm_env, fixture.fsm) == 1U);
+    EXPECT(write(fds[1], "x", 1U) == 1);
+    EXPECT(p101_fsm_reactor_poll(fixture.app_env, fixture.app_err, reactor, 1000) == 1);
+    EXPECT(context.reads == 1 && context.watch_status == 0);
+    EXPECT(p101_fsm_reactor_get_ready(fixture.app_env, machine) == 0U);
+    EXPECT(p101_fsm_reactor_poll(fixture.app_env, fixture.app_err, reactor, 0) == 0);
+    EXPECT(write(fds[1], "y", 1U) == 1);
+    EXPECT(p101_fsm_reactor_poll(fixture.app_env, fixture.app_err, reactor, 1000) == 1);
+    EXPECT(context.reads == 2);
+    EXPECT(p101_fsm_reactor_get_result(fixture.app_env, machine) == P101_FSM_RUN_EXITED);
+    EXPECT(write(fds[1], "z", 1U) == 1);
+    EXPECT(p101_fsm_reactor_poll(fixture.app_env, fixture.app_err, reactor, 0) == 0);
+
+    EXPECT(p101_fsm_reactor_watch(fixture.app_env, fixture.app_err, machine, -1, EPOLLIN) == -1);
+    error_present = p101_error_is_error(fixture.app_err, P101_ERROR_USER, P101_FSM_ERROR_INVALID_ARGUMENT);
+    EXPECT(error_present);
+    p101_error_reset(fixture.app_err);
+    EXPECT(p101_fsm_reactor_watch(fixture.app_env, fixture.app_err, machine, 1000000, EPOLLIN) == -1);
+    EXPECT(p101_error_is_error(fixture.app_err, P101_ERROR_ERRNO, EBADF));
+    p101_error_reset(fixture.app_err);
+    EXPECT(p101_fsm_reactor_watch(fixture.app_env, fixture.app_err, machine, fds[1], EPOLLOUT) == 0);
+    EXPECT(p101_fsm_reactor_poll(NULL, fixture.app_err, NULL, 0) == -1);
+    p101_error_reset(fixture.app_err);
+    EXPECT(p101_fsm_reactor_attach(fixture.app_env, fixture.app_err, reactor, NULL, NULL, NULL) == NULL);
+    p101_error_reset(fixture.app_err);
+    EXPECT(p101_fsm_reactor_create(fixture.app_env, fixture.app_err, 0U) == NULL);
+    p101_error_reset(fixture.app_err);
+    EXPECT(p101_fsm_reactor_get_ready(fixture.app_env, NULL) == 0U);
+    EXPECT(p101_fsm_reactor_get_result(fixture.app_env, NULL) == P101_FSM_RUN_ERROR);
+    p101_fsm_reactor_detach(fixture.app_env, fixture.app_err, &machine);
+    EXPECT(machine == NULL);
+    p101_fsm_reactor_detach(fixture.app_env, fixture.app_err, &machine);
+
+    // Destroy releases machines that are still attached.
+    machine = p101_fsm_reactor_attach(fixture.app_env, fixture.app_err, reactor, fixture.fsm, &context, NULL);
+    EXPECT(machine != NULL);
+    p101_fsm_reactor_destroy(fixture.app_env, &reactor);
+    EXPECT(reactor == NULL);
+    p101_fsm_reactor_destroy(fixture.app_env, &reactor);
+    close(fds[0]);
+    close(fds[1]);
+    fixture_destroy(&fixture);
+}
+#endif
+
+static void state_timeout(const struct p101_env *env, struct p101_error *err, void *arg, struct p101_fsm_effect_sink *sink, struct p101_fsm_decision *decision)
+{
+    struct timer_context *context = (struct timer_context *)arg;
+
+    (void)sink;
+    context->steps++;
+    if(p101_fsm_timer_has_expired(env, context->timer))
+    {
+        context->timeouts++;
+        context->fired_at = p101_fsm_timer_wheel_get_time(env, context->wheel);
+        p101_fsm_timer_cancel(env, context->cancel);
+    }
+    if(context->timeouts == 3)
+    {
+        p101_fsm_decide_exit(decision);
+    }
+    else
+    {
+        if(context->rearm != 0U)
+        {
+            EXPECT(p101_fsm_timer_arm(env, err, context->timer, context->rearm) == 0);
+        }
+        p101_fsm_decide_pause(decision);
+    }
+}
+
+static void test_timer_wheel(void)
+{
+    enum
+    {
+        DELAY_COUNT = 9,
+    };
+    struct fixture                          fixture;
+    struct timer_context                    context;
+    struct timer_context                    contexts[DELAY_COUNT];
+    struct p101_fsm_info                   *machines[DELAY_COUNT];
+    struct p101_fsm_definition             *definition;
+    struct p101_fsm_timer_wheel            *wheel;
+    struct p101_fsm_timer                  *timer;
+    uint64_t                                start;
+    bool                                    error_present;
+    static const uint64_t                   delays[DELAY_COUNT] = {1U, 255U, 256U, 257U, 65535U, 65536U, 70000U, (UINT64_C(1) << 24) + 3U, 3U};
+    static const struct p101_fsm_transition transitions[]       = {
+        {P101_FSM_INIT, STATE_A, state_timeout},
+    };
+
+    fixture_create(&fixture, "timer", transitions, 1U, NULL);
+    wheel = p101_fsm_timer_wheel_create(fixture.app_env, fixture.app_err);
+    EXPECT(wheel != NULL);
+    memset(&context, 0, sizeof(context));
+    context.wheel = wheel;
+    context.rearm = 5U;
+    context.timer = p101_fsm_timer_attach(fixture.app_env, fixture.app_err, wheel, fixture.fsm, &context, NULL);
+    EXPECT(context.timer != NULL);
+    EXPECT(p101_fsm_timer_get_result(fixture.app_env, context.timer) == P101_FSM_RUN_PAUSED);
+
+    // An ordinary step arms the timeout; only the expiry re-steps the machine.
+    EXPECT(p101_fsm_run(fixture.fsm, &context, NULL, NULL) == P101_FSM_RUN_PAUSED);
+    EXPECT(p101_fsm_timer_is_armed(fixture.app_env, context.timer));
+    EXPECT(!p101_fsm_timer_has_expired(fixture.app_env, context.timer));
+    EXPECT(p101_fsm_timer_wheel_advance(fixture.app_env, fixture.app_err, wheel, 4U) == 0U);
+    EXPECT(context.steps == 1);
+    EXPECT(p101_fsm_timer_wheel_advance(fixture.app_env, fixture.app_err, wheel, 1U) == 1U);
+    EXPECT(context.steps == 2 && context.timeouts == 1 && context.fired_at == 5U);
+    EXPECT(p101_fsm_timer_is_armed(fixture.app_env, context.timer));
+    EXPECT(p101_fsm_timer_wheel_advance(fixture.app_env, fixture.app_err, wheel, 12U) == 2U);
+    EXPECT(context.timeouts == 3 && context.fired_at == 15U);
+    EXPECT(p101_fsm_timer_get_result(fixture.app_env, context.timer) == P101_FSM_RUN_EXITED);
+    EXPECT(!p101_fsm_timer_is_armed(fixture.app_env, context.timer));
+    EXPECT(p101_fsm_timer_wheel_get_time(fixture.app_env, wheel) == 17U);
+
+    // Timeouts at every level fire on exactly their tick, across cascades and after cancels.
+    definition = p101_fsm_definition_create(fixture.fsm_env, fixture.fsm_err, "timer", transitions, 1U);
+    start      = p101_fsm_timer_wheel_get_time(fixture.app_env, wheel);
+    for(size_t i = 0U; i < DELAY_COUNT; ++i)
+    {
+        memset(&contexts[i], 0, sizeof(contexts[i]));
+        machines[i]        = p101_fsm_info_create_from_definition(fixture.app_env, fixture.app_err, definition, fixture.fsm_env, fixture.fsm_err, NULL);
+        contexts[i].wheel  = wheel;
+        contexts[i].timer  = p101_fsm_timer_attach(fixture.app_env, fixture.app_err, wheel, machines[i], &contexts[i], NULL);
+        EXPECT(p101_fsm_timer_arm(fixture.app_env, fixture.app_err, contexts[i].timer, delays[i] + 10U) == 0);
+        EXPECT(p101_fsm_timer_arm(fixture.app_env, fixture.app_err, contexts[i].timer, delays[i]) == 0);
+    }
+    EXPECT(p101_fsm_timer_wheel_get_armed(fixture.app_env, wheel) == DELAY_COUNT);
+    contexts[0].cancel = contexts[8].timer;
+    EXPECT(p101_fsm_timer_arm(fixture.app_env, fixture.app_err, contexts[8].timer, 1U) == 0);
+    EXPECT(p101_fsm_timer_wheel_advance(fixture.app_env, fixture.app_err, wheel, 1U) == 1U);
+    EXPECT(contexts[8].timeouts == 0 && !p101_fsm_timer_is_armed(fixture.app_env, contexts[8].timer));
+    EXPECT(p101_fsm_timer_wheel_advance(fixture.app_env, fixture.app_err, wheel, 65534U) == 4U);
+    EXPECT(p101_fsm_timer_wheel_advance(fixture.app_env, fixture.app_err, wheel, UINT64_C(1) << 24) == 3U);
+    EXPECT(p101_fsm_timer_wheel_advance(fixture.app_env, fixture.app_err, wheel, 1000U) == 0U);
+    EXPECT(p101_fsm_timer_wheel_get_armed(fixture.app_env, wheel) == 0U);
+    for(size_t i = 0U; i < DELAY_COUNT - 1U; ++i)
+    {
+        EXPECT(contexts[i].timeouts == 1 && contexts[i].fired_at == start + delays[i]);
+        p101_fsm_timer_detach(fixture.app_env, fixture.app_err, &contexts[i].timer);
+        p101_fsm_info_destroy(fixture.app_env, fixture.fsm_err, &machines[i]);
+    }
+    p101_fsm_timer_detach(fixture.app_env, fixture.app_err, &contexts[8].timer);
+    p101_fsm_info_destroy(fixture.app_env, fixture.fsm_err, &machines[8]);
+    p101_fsm_definition_destroy(fixture.fsm_env, &definition);
+
+    // An empty wheel moves its clock in one step.
+    start = p101_fsm_timer_wheel_get_time(fixture.app_env, wheel);
+    EXPECT(p101_fsm_timer_wheel_advance(fixture.app_env, fixture.app_err, wheel, UINT64_C(1) << 40) == 0U);
+    EXPECT(p101_fsm_timer_wheel_get_time(fixture.app_env, wheel) == start + (UINT64_C(1) << 40));
+
+    EXPECT(p101_fsm_timer_arm(fixture.app_env, fixture.app_err, context.timer, 0U) == -1);
+    error_present = p101_error_is_error(fixture.app_err, P101_ERROR_USER, P101_FSM_ERROR_INVALID_ARGUMENT);
+    EXPECT(error_present);
+    p101_error_reset(fixture.app_err);
+    EXPECT(p101_fsm_timer_arm(fixture.app_env, fixture.app_err, NULL, 1U) == -1);
+    p101_error_reset(fixture.app_err);
+    EXPECT(p101_fsm_timer_wheel_advance(fixture.app_env, fixture.app_err, NULL, 1U) == 0U);
+    p101_error_reset(fixture.app_err);
+    EXPECT(p101_fsm_timer_attach(fixture.app_env, fixture.app_err, wheel, NULL, NULL, NULL) == NULL);
+    p101_error_reset(fixture.app_err);
+    p101_fsm_timer_wheel_destroy(fixture.app_env, fixture.app_err, &wheel);
+    EXPECT(wheel != NULL);
+    p101_error_reset(fixture.app_err);
+    p101_fsm_timer_cancel(fixture.app_env, NULL);
+    EXPECT(!p101_fsm_timer_is_armed(fixture.app_env, NULL));
+    EXPECT(!p101_fsm_timer_has_expired(fixture.app_env, NULL));
+    EXPECT(p101_fsm_timer_get_result(fixture.app_env, NULL) == P101_FSM_RUN_ERROR);
+    EXPECT(p101_fsm_timer_wheel_get_time(fixture.app_env, NULL) == 0U);
+    EXPECT(p101_fsm_timer_wheel_get_armed(fixture.app_env, NULL) == 0U);
+    timer = context.timer;
+    p101_fsm_timer_detach(fixture.app_env, fixture.app_err, &timer);
+    EXPECT(timer == NULL);
+    p101_fsm_timer_detach(fixture.app_env, fixture.app_err, &timer);
+    p101_fsm_timer_wheel_destroy(fixture.app_env, fixture.app_err, &wheel);
+    EXPECT(wheel == NULL);
+    fixture_destroy(&fixture);
+}
+
+static void state_effect_burst(const struct p101_env *env, struct p101_error *err, void *arg, struct p101_fsm_effect_sink *sink, struct p101_fsm_decision *decision)
+{
+    const struct burst_context *context = (const struct burst_context *)arg;
+
+    for(int i = 0; i < context->count; ++i)
+    {
+        p101_fsm_emit_effect(env, err, sink, "burst", context->data, context->data_size);
+    }
+    p101_fsm_decide_exit(decision);
+}
+
+static void test_growable_effect_batch(void)
+{
+    struct fixture                          fixture;
+    struct callback_context                 context = {0};
+    struct burst_context                    burst;
+    struct p101_fsm_effect_batch           *batch;
+    struct p101_fsm_effect_sink             target;
+    struct p101_fsm_step_receipt            receipt;
+    struct p101_fsm_effect                  effect;
+    unsigned char                           large[200];
+    p101_fsm_step_status                    status;
+    bool                                    error_present;
+    static const int                        value          = 9;
+    static const struct p101_fsm_transition transitions[] = {
+        {P101_FSM_INIT, STATE_A, state_effect_burst},
+    };
+
+    target.handle  = effect_handler;
+    target.context = &context;
+    burst.count     = 20;
+    burst.data      = &value;
+    burst.data_size = sizeof(value);
+
+    // Twenty 10-byte effects fill four 64-byte chunks; the records grow past their first 16.
+    fixture_create(&fixture, "growable-effect", transitions, 1U, NULL);
+    batch = p101_fsm_effect_batch_create_growable(fixture.fsm_env, fixture.fsm_err, 64U, 0U, 0U);
+    EXPECT(batch != NULL);
+    EXPECT(p101_fsm_effect_batch_get_allocated_bytes(fixture.fsm_env, batch) == 0U);
+    status = p101_fsm_step_with_receipt(fixture.fsm, &burst, batch, &receipt);
+    EXPECT(status == P101_FSM_STEP_EXITED);
+    EXPECT(p101_fsm_effect_batch_count(batch) == 20U);
+    EXPECT(p101_fsm_effect_batch_get_allocated_bytes(fixture.fsm_env, batch) == 256U);
+    EXPECT(p101_fsm_effect_batch_finish_receipt(fixture.fsm_env, fixture.fsm_err, batch, &receipt, &target) == 0);
+    EXPECT(context.effects == 20 && context.effect_value == 9);
+    fixture_destroy(&fixture);
+
+    // A later step reuses the kept chunks; one oversized effect gets a chunk of its own.
+    memset(large, 0x5a, sizeof(large));
+    burst.count     = 1;
+    burst.data      = large;
+    burst.data_size = sizeof(large);
+    fixture_create(&fixture, "growable-reuse", transitions, 1U, NULL);
+    status = p101_fsm_step_with_receipt(fixture.fsm, &burst, batch, &receipt);
+    EXPECT(status == P101_FSM_STEP_EXITED);
+    EXPECT(p101_fsm_effect_batch_get_allocated_bytes(fixture.fsm_env, batch) == 256U + 206U);
+    EXPECT(p101_fsm_step_receipt_effect(&receipt, 0U, &effect));
+    EXPECT(effect.data_size == sizeof(large) && memcmp(effect.data, large, sizeof(large)) == 0 && strcmp(effect.kind, "burst") == 0);
+    p101_fsm_effect_batch_destroy(fixture.fsm_env, &batch);
+    EXPECT(batch == NULL);
+    fixture_destroy(&fixture);
+
+    // A ceiling still refuses the step.
+    burst.count     = 4;
+    burst.data      = &value;
+    burst.data_size = sizeof(value);
+    fixture_create(&fixture, "growable-ceiling", transitions, 1U, NULL);
+    batch  = p101_fsm_effect_batch_create_growable(fixture.fsm_env, fixture.fsm_err, 16U, 3U, 0U);
+    status = p101_fsm_step_with_receipt(fixture.fsm, &burst, batch, &receipt);
+    EXPECT(status == P101_FSM_STEP_REFUSED);
+    EXPECT(receipt.result.refusal == P101_FSM_REFUSAL_EFFECT_CAPACITY);
+    error_present = p101_error_is_error(fixture.app_err, P101_ERROR_USER, P101_FSM_ERROR_EFFECT_CAPACITY);
+    EXPECT(error_present);
+    p101_fsm_effect_batch_destroy(fixture.fsm_env, &batch);
+
+    batch = p101_fsm_effect_batch_create_growable(fixture.fsm_env, fixture.fsm_err, 0U, 0U, 0U);
+    EXPECT(batch == NULL);
+    error_present = p101_error_is_error(fixture.fsm_err, P101_ERROR_USER, P101_FSM_ERROR_EFFECT);
+    EXPECT(error_present);
+    p101_error_reset(fixture.fsm_err);
+    batch = p101_fsm_effect_batch_create(fixture.fsm_env, fixture.fsm_err, 2U, 64U);
+    EXPECT(p101_fsm_effect_batch_get_allocated_bytes(fixture.fsm_env, batch) == 64U);
+    p101_fsm_effect_batch_destroy(fixture.fsm_env, &batch);
+    EXPECT(p101_fsm_effect_batch_get_allocated_bytes(fixture.fsm_env, NULL) == 0U);
+    fixture_destroy(&fixture);
+}
+
+static void state_effect_interned(const struct p101_env *env, struct p101_error *err, void *arg, struct p101_fsm_effect_sink *sink, struct p101_fsm_decision *decision)
+{
+    const struct kind_context *context = (const struct kind_context *)arg;
+    static const int           value   = 11;
+
+    p101_fsm_emit_effect_id(env, err, sink, context->kinds, context->ids[1], &value, sizeof(value));
+    p101_fsm_emit_effect_id(env, err, sink, context->kinds, context->ids[0], NULL, 0U);
+    p101_fsm_emit_effect(env, err, sink, "plain", NULL, 0U);
+    p101_fsm_decide_exit(decision);
+}
+
+static void kind_route_handler(const struct p101_env *env, struct p101_error *err, void *arg, const struct p101_fsm_effect *effect)
+{
+    struct kind_context *context = (struct kind_context *)arg;
+
+    (void)env;
+    (void)err;
+    if(effect->kind_id != P101_FSM_EFFECT_KIND_NONE)
+    {
+        context->routed[effect->kind_id]++;
+    }
+    if(effect->data_size == sizeof(context->value))
+    {
+        memcpy(&context->value, effect->data, sizeof(context->value));
+    }
+}
+
+static void state_effect_zeroed(const struct p101_env *env, struct p101_error *err, void *arg, struct p101_fsm_effect_sink *sink, struct p101_fsm_decision *decision)
+{
+    struct p101_fsm_effect effect = {0};
+    char                   kind[8];
+
+    (void)arg;
+    // An effect built by hand never sets kind_id, so the batch must copy the scoped kind.
+    snprintf(kind, sizeof(kind), "%s", "scoped");
+    effect.kind = kind;
+    sink->handle(env, err, sink->context, &effect);
+    memset(kind, 'x', sizeof(kind));
+    p101_fsm_decide_exit(decision);
+}
+
+static void test_interned_effect_kinds(void)
+{
+    struct fixture                          fixture;
+    struct kind_context                     context;
+    struct p101_fsm_effect_batch           *batch;
+    struct p101_fsm_effect_sink             target;
+    struct p101_fsm_effect_sink             sink;
+    struct p101_fsm_step_receipt            receipt;
+    struct p101_fsm_effect                  effect;
+    p101_fsm_step_status                    status;
+    bool                                    error_present;
+    static const struct p101_fsm_transition transitions[] = {
+        {P101_FSM_INIT, STATE_A, state_effect_interned},
+    };
+    static const struct p101_fsm_transition zeroed[] = {
+        {P101_FSM_INIT, STATE_A, state_effect_zeroed},
+    };
+
+    fixture_create(&fixture, "interned-kind", transitions, 1U, NULL);
+    memset(&context, 0, sizeof(context));
+    context.kinds = p101_fsm_effect_kinds_create(fixture.app_env, fixture.app_err);
+    EXPECT(context.kinds != NULL);
+    context.ids[0] = p101_fsm_effect_kinds_intern(fixture.app_env, fixture.app_err, context.kinds, "open");
+    context.ids[1] = p101_fsm_effect_kinds_intern(fixture.app_env, fixture.app_err, context.kinds, "close");
+    EXPECT(context.ids[0] == 1 && context.ids[1] == 2);
+    EXPECT(p101_fsm_effect_kinds_intern(fixture.app_env, fixture.app_err, context.kinds, "open") == 1);
+    EXPECT(p101_fsm_effect_kinds_find(fixture.app_env, context.kinds, "close") == 2);
+    EXPECT(p101_fsm_effect_kinds_find(fixture.app_env, context.kinds, "missing") == P101_FSM_EFFECT_KIND_NONE);
+    EXPECT(strcmp(p101_fsm_effect_kinds_get_name(fixture.app_env, context.kinds, 2), "close") == 0);
+    EXPECT(p101_fsm_effect_kinds_get_name(fixture.app_env, context.kinds, 3) == NULL);
+    EXPECT(p101_fsm_effect_kinds_get_name(fixture.app_env, context.kinds, P101_FSM_EFFECT_KIND_NONE) == NULL);
+    EXPECT(p101_fsm_effect_kinds_count(fixture.app_env, context.kinds) == 2U);
+
+    // Interned kinds take no arena bytes; a string kind beside them is still copied.
+    batch = p101_fsm_effect_batch_create(fixture.fsm_env, fixture.fsm_err, 3U, sizeof(int) + sizeof("plain"));
+    EXPECT(batch != NULL);
+    status = p101_fsm_step_with_receipt(fixture.fsm, &context, batch, &receipt);
+    EXPECT(status == P101_FSM_STEP_EXITED);
+    EXPECT(p101_fsm_step_receipt_effect(&receipt, 0U, &effect));
+    EXPECT(effect.kind_id == 2 && strcmp(effect.kind, "close") == 0);
+    EXPECT(p101_fsm_step_receipt_effect(&receipt, 2U, &effect));
+    EXPECT(effect.kind_id == P101_FSM_EFFECT_KIND_NONE && strcmp(effect.kind, "plain") == 0);
+    target.handle  = kind_route_handler;
+    target.context = &context;
+    EXPECT(p101_fsm_effect_batch_finish_receipt(fixture.fsm_env, fixture.fsm_err, batch, &receipt, &target) == 0);
+    EXPECT(context.routed[1] == 1 && context.routed[2] == 1 && context.value == 11);
+    p101_fsm_effect_batch_destroy(fixture.fsm_env, &batch);
+
+    sink.handle  = kind_route_handler;
+    sink.context = &context;
+    p101_fsm_emit_effect_id(fixture.app_env, fixture.app_err, &sink, context.kinds, 3, NULL, 0U);
+    error_present = p101_error_is_error(fixture.app_err, P101_ERROR_USER, P101_FSM_ERROR_EFFECT);
+    EXPECT(error_present);
+    p101_error_reset(fixture.app_err);
+    p101_fsm_emit_effect_id(fixture.app_env, fixture.app_err, &sink, context.kinds, P101_FSM_EFFECT_KIND_NONE, NULL, 0U);
+    error_present = p101_error_is_error(fixture.app_err, P101_ERROR_USER, P101_FSM_ERROR_EFFECT);
+    EXPECT(error_present);
+    p101_error_reset(fixture.app_err);
+    p101_fsm_emit_effect_id(fixture.app_env, fixture.app_err, &sink, NULL, 0, NULL, 0U);
+    error_present = p101_error_is_error(fixture.app_err, P101_ERROR_USER, P101_FSM_ERROR_EFFECT);
+    EXPECT(error_present);
+    p101_error_reset(fixture.app_err);
+    EXPECT(p101_fsm_effect_kinds_intern(fixture.app_env, fixture.app_err, context.kinds, NULL) == P101_FSM_EFFECT_KIND_NONE);
+    p101_error_reset(fixture.app_err);
+    EXPECT(p101_fsm_effect_kinds_count(fixture.app_env, NULL) == 0U);
+    p101_fsm_effect_kinds_destroy(fixture.app_env, &context.kinds);
+    EXPECT(context.kinds == NULL);
+    p101_fsm_effect_kinds_destroy(fixture.app_env, &context.kinds);
+    fixture_destroy(&fixture);
+
+    // A zero-initialised effect staged straight through the sink is not interned.
+    fixture_create(&fixture, "zeroed-kind", zeroed, 1U, NULL);
+    batch  = p101_fsm_effect_batch_create(fixture.fsm_env, fixture.fsm_err, 1U, 16U);
+    status = p101_fsm_step_with_receipt(fixture.fsm, NULL, batch, &receipt);
+    EXPECT(status == P101_FSM_STEP_EXITED);
+    EXPECT(p101_fsm_step_receipt_effect(&receipt, 0U, &effect));
+    EXPECT(effect.kind_id == P101_FSM_EFFECT_KIND_NONE && strcmp(effect.kind, "scoped") == 0);
+    p101_fsm_effect_batch_destroy(fixture.fsm_env, &batch);
+    fixture_destroy(&fixture);
+}
+
+static void state_effect_in_place(const struct p101_env *env, struct p101_error *err, void *arg, struct p101_fsm_effect_sink *sink, struct p101_fsm_decision *decision)
+{
+    struct reserve_context *context = (struct reserve_context *)arg;
+    unsigned char          *frame;
+
+    // A plain emit between reserve and commit leaves the reserved bytes alone.
+    p101_fsm_emit_effect(env, err, sink, "odd", "x", 1U);
+    frame = (unsigned char *)p101_fsm_effect_reserve(env, err, sink, context->size);
+    if(frame != NULL)
+    {
+        context->aligned = ((uintptr_t)frame % _Alignof(max_align_t)) == 0U;
+        memset(frame, 0xa5, context->size);
+        p101_fsm_emit_effect(env, err, sink, "between", NULL, 0U);
+        p101_fsm_effect_commit(env, err, sink, "frame", context->size - 16U);
+        frame = (unsigned char *)p101_fsm_effect_reserve(env, err, sink, sizeof(int));
+    }
+    if(frame != NULL)
+    {
+        frame[0] = 3;
+        p101_fsm_effect_commit_id(env, err, sink, context->kinds, context->id, 1U);
+    }
+    p101_fsm_decide_exit(decision);
+}
+
+static void test_in_place_effects(void)
+{
+    struct fixture                          fixture;
+    struct reserve_context                  context;
+    struct callback_context                 direct = {0};
+    struct p101_fsm_effect_batch           *batches[2];
+    struct p101_fsm_effect_sink             sink;
+    struct p101_fsm_step_receipt            receipt;
+    struct p101_fsm_effect                  effect;
+    p101_fsm_step_status                    status;
+    bool                                    error_present;
+    static const struct p101_fsm_transition transitions[] = {
+        {P101_FSM_INIT, STATE_A, state_effect_in_place},
+    };
+
+    memset(&context, 0, sizeof(context));
+    context.size = 96U;
+    for(size_t i = 0U; i < 2U; ++i)
+    {
+        fixture_create(&fixture, "in-place-effect", transitions, 1U, NULL);
+        context.kinds   = p101_fsm_effect_kinds_create(fixture.app_env, fixture.app_err);
+        context.id      = p101_fsm_effect_kinds_intern(fixture.app_env, fixture.app_err, context.kinds, "tick");
+        context.aligned = false;
+        batches[i]      = i == 0U ? p101_fsm_effect_batch_create(fixture.fsm_env, fixture.fsm_err, 4U, 256U) : p101_fsm_effect_batch_create_growable(fixture.fsm_env, fixture.fsm_err, 64U, 0U, 0U);
+        status          = p101_fsm_step_with_receipt(fixture.fsm, &context, batches[i], &receipt);
+        EXPECT(status == P101_FSM_STEP_EXITED);
+        EXPECT(context.aligned);
+        EXPECT(p101_fsm_effect_batch_count(batches[i]) == 4U);
+        EXPECT(p101_fsm_step_receipt_effect(&receipt, 2U, &effect));
+        EXPECT(strcmp(effect.kind, "frame") == 0 && effect.data_size == 80U && ((const unsigned char *)effect.data)[79] == 0xa5);
+        EXPECT(p101_fsm_step_receipt_effect(&receipt, 3U, &effect));
+        EXPECT(effect.kind_id == context.id && effect.data_size == 1U && ((const unsigned char *)effect.data)[0] == 3);
+        EXPECT(p101_fsm_step_receipt_effect(&receipt, 1U, &effect));
+        EXPECT(strcmp(effect.kind, "between") == 0);
+        p101_fsm_effect_batch_destroy(fixture.fsm_env, &batches[i]);
+        p101_fsm_effect_kinds_destroy(fixture.app_env, &context.kinds);
+        fixture_destroy(&fixture);
+    }
+
+    fixture_create(&fixture, "in-place-errors", transitions, 1U, NULL);
+    batches[0] = p101_fsm_effect_batch_create(fixture.fsm_env, fixture.fsm_err, 4U, 32U);
+    p101_fsm_effect_batch_sink(batches[0], &sink);
+    p101_fsm_effect_commit(fixture.app_env, fixture.app_err, &sink, "frame", 0U);
+    error_present = p101_error_is_error(fixture.app_err, P101_ERROR_USER, P101_FSM_ERROR_EFFECT);
+    EXPECT(error_present);
+    p101_error_reset(fixture.app_err);
+    EXPECT(p101_fsm_effect_reserve(fixture.app_env, fixture.app_err, &sink, 64U) == NULL);
+    error_present = p101_error_is_error(fixture.app_err, P101_ERROR_USER, P101_FSM_ERROR_EFFECT_CAPACITY);
+    EXPECT(error_present);
+    p101_error_reset(fixture.app_err);
+    EXPECT(p101_fsm_effect_reserve(fixture.app_env, fixture.app_err, &sink, 8U) != NULL);
+    p101_fsm_effect_commit(fixture.app_env, fixture.app_err, &sink, "frame", 9U);
+    error_present = p101_error_is_error(fixture.app_err, P101_ERROR_USER, P101_FSM_ERROR_EFFECT);
+    EXPECT(error_present);
+    p101_error_reset(fixture.app_err);
+    EXPECT(p101_fsm_effect_batch_count(batches[0]) == 0U);
+    p101_fsm_effect_batch_destroy(fixture.fsm_env, &batches[0]);
+    EXPECT(p101_fsm_effect_reserve(fixture.app_env, fixture.app_err, NULL, 8U) == NULL);
+    error_present = p101_error_has_error(fixture.app_err);
+    EXPECT(!error_present);
+    sink.handle  = effect_handler;
+    sink.context = &direct;
+    EXPECT(p101_fsm_effect_reserve(fixture.app_env, fixture.app_err, &sink, 8U) == NULL);
+    error_present = p101_error_is_error(fixture.app_err, P101_ERROR_USER, P101_FSM_ERROR_EFFECT);
+    EXPECT(error_present);
+    p101_error_reset(fixture.app_err);
+    fixture_destroy(&fixture);
+}
+
+static void span_handler(const struct p101_env *env, struct p101_error *err, void *arg, const struct p101_fsm_effect effects[], size_t count)
+{
+    struct span_context *context = (struct span_context *)arg;
+
+    (void)env;
+    context->calls++;
+    context->count += count;
+    for(size_t i = 0U; i < count; ++i)
+    {
+        context->bytes += effects[i].data_size;
+    }
+    if(context->fail)
+    {
+        P101_ERROR_RAISE_USER(err, "span delivery failed", 1);
+    }
+}
+
+static void test_span_delivery(void)
+{
+    struct fixture                          fixture;
+    struct span_context                     context;
+    struct burst_context                    burst;
+    struct p101_fsm_effect_batch           *batch;
+    struct p101_fsm_effect_span_sink        target;
+    struct p101_fsm_step_receipt            receipt;
+    struct p101_fsm_step_receipt            stale;
+    p101_fsm_step_status                    status;
+    bool                                    error_present;
+    static const int                        value          = 5;
+    static const struct p101_fsm_transition transitions[] = {
+        {P101_FSM_INIT, STATE_A, state_effect_burst},
+    };
+    static const struct p101_fsm_transition paused[] = {
+        {P101_FSM_INIT, STATE_A, state_effect_then_pause},
+    };
+
+    memset(&context, 0, sizeof(context));
+    target.handle   = span_handler;
+    target.context  = &context;
+    burst.count     = 5;
+    burst.data      = &value;
+    burst.data_size = sizeof(value);
+
+    // Five committed effects arrive in one call.
+    fixture_create(&fixture, "span-effect", transitions, 1U, NULL);
+    batch  = p101_fsm_effect_batch_create(fixture.fsm_env, fixture.fsm_err, 8U, 128U);
+    status = p101_fsm_step_with_receipt(fixture.fsm, &burst, batch, &receipt);
+    EXPECT(status == P101_FSM_STEP_EXITED);
+    stale = receipt;
+    EXPECT(p101_fsm_effect_batch_finish_receipt_span(fixture.fsm_env, fixture.fsm_err, batch, &receipt, &target) == 0);
+    EXPECT(context.calls == 1 && context.count == 5U && context.bytes == 5U * sizeof(int));
+    EXPECT(p101_fsm_effect_batch_count(batch) == 0U);
+    EXPECT(p101_fsm_effect_batch_finish_receipt_span(fixture.fsm_env, fixture.fsm_err, batch, &stale, &target) == -1);
+    error_present = p101_error_is_error(fixture.fsm_err, P101_ERROR_USER, P101_FSM_ERROR_EFFECT);
+    EXPECT(error_present);
+    p101_error_reset(fixture.fsm_err);
+    fixture_destroy(&fixture);
+
+    // A handler error still consumes the batch.
+    context.fail = true;
+    fixture_create(&fixture, "span-failure", transitions, 1U, NULL);
+    status = p101_fsm_step_with_receipt(fixture.fsm, &burst, batch, &receipt);
+    EXPECT(status == P101_FSM_STEP_EXITED);
+    EXPECT(p101_fsm_effect_batch_finish_receipt_span(fixture.fsm_env, fixture.fsm_err, batch, &receipt, &target) == -1);
+    EXPECT(context.calls == 2 && p101_fsm_effect_batch_count(batch) == 0U);
+    p101_error_reset(fixture.fsm_err);
+    fixture_destroy(&fixture);
+
+    // A paused step delivers nothing.
+    context.fail = false;
+    fixture_create(&fixture, "span-paused", paused, 1U, NULL);
+    status = p101_fsm_step_with_receipt(fixture.fsm, NULL, batch, &receipt);
+    EXPECT(status == P101_FSM_STEP_PAUSED);
+    EXPECT(p101_fsm_effect_batch_finish_receipt_span(fixture.fsm_env, fixture.fsm_err, batch, &receipt, &target) == 0);
+    EXPECT(context.calls == 2);
+    EXPECT(p101_fsm_effect_batch_finish_receipt_span(fixture.fsm_env, fixture.fsm_err, batch, &receipt, NULL) == -1);
+    p101_error_reset(fixture.fsm_err);
+    p101_fsm_effect_batch_destroy(fixture.fsm_env, &batch);
+    fixture_destroy(&fixture);
+}
+
+static void state_segmented(const struct p101_env *env, struct p101_error *err, void *arg, struct p101_fsm_effect_sink *sink, struct p101_fsm_decision *decision)
+{
+    int *calls = (int *)arg;
+
+    p101_fsm_emit_effect(env, err, sink, "step", calls, sizeof(*calls));
+    if(*calls == 0)
+    {
+        p101_fsm_emit_effect(env, err, sink, "step", calls, sizeof(*calls));
+        p101_fsm_decide_transition(decision, STATE_B);
+    }
+    else if(*calls == 1)
+    {
+        p101_fsm_decide_transition(decision, STATE_C);
+    }
+    else if(*calls == 2)
+    {
+        p101_fsm_decide_pause(decision);
+    }
+    else
+    {
+        p101_fsm_decide_exit(decision);
+    }
+    (*calls)++;
+}
+
+static void test_batched_run(void)
+{
+    struct fixture                          fixture;
+    struct span_context                     context;
+    struct p101_fsm_effect_batch           *batch;
+    struct p101_fsm_effect_span_sink        target;
+    struct p101_fsm_effect_segment          segments[4];
+    struct p101_fsm_step_result             last;
+    p101_fsm_run_result                     run_result;
+    size_t                                  segment_count;
+    int                                     calls;
+    bool                                    error_present;
+    static const struct p101_fsm_transition transitions[] = {
+        {P101_FSM_INIT, STATE_A, state_segmented},
+        {STATE_A,       STATE_B, state_segmented},
+        {STATE_B,       STATE_C, state_segmented},
+    };
+
+    memset(&context, 0, sizeof(context));
+    target.handle  = span_handler;
+    target.context = &context;
+    calls          = 0;
+    fixture_create(&fixture, "batched-run", transitions, 3U, NULL);
+    batch = p101_fsm_effect_batch_create_growable(fixture.fsm_env, fixture.fsm_err, 64U, 0U, 0U);
+
+    // Two committed steps keep their effects; the pausing step's effect is discarded.
+    run_result = p101_fsm_run_batched(fixture.fsm, &calls, batch, segments, 4U, &segment_count, &last);
+    EXPECT(run_result == P101_FSM_RUN_PAUSED && last.status == P101_FSM_STEP_PAUSED);
+    EXPECT(segment_count == 2U);
+    EXPECT(segments[0].first == 0U && segments[0].count == 2U);
+    EXPECT(segments[1].first == 2U && segments[1].count == 1U && segments[1].sequence > segments[0].sequence);
+    EXPECT(p101_fsm_effect_batch_count(batch) == 3U);
+    EXPECT(p101_fsm_effect_batch_flush(fixture.fsm_env, fixture.fsm_err, batch, &target) == 0);
+    EXPECT(context.calls == 1 && context.count == 3U);
+    EXPECT(p101_fsm_effect_batch_count(batch) == 0U);
+    EXPECT(p101_fsm_effect_batch_flush(fixture.fsm_env, fixture.fsm_err, batch, &target) == -1);
+    error_present = p101_error_is_error(fixture.fsm_err, P101_ERROR_USER, P101_FSM_ERROR_EFFECT);
+    EXPECT(error_present);
+    p101_error_reset(fixture.fsm_err);
+
+    run_result = p101_fsm_run_batched(fixture.fsm, &calls, batch, segments, 4U, &segment_count, NULL);
+    EXPECT(run_result == P101_FSM_RUN_EXITED && segment_count == 1U);
+    EXPECT(p101_fsm_effect_batch_flush(fixture.fsm_env, fixture.fsm_err, batch, &target) == 0);
+    EXPECT(context.calls == 2 && context.count == 4U);
+    fixture_destroy(&fixture);
+
+    // A full segment array stops the run between steps, keeping what was committed.
+    calls = 0;
+    fixture_create(&fixture, "batched-budget", transitions, 3U, NULL);
+    run_result = p101_fsm_run_batched(fixture.fsm, &calls, batch, segments, 1U, &segment_count, NULL);
+    EXPECT(run_result == P101_FSM_RUN_BUDGET_EXHAUSTED && segment_count == 1U);
+    EXPECT(p101_fsm_info_get_current_state(fixture.app_env, fixture.fsm) == STATE_B);
+    EXPECT(p101_fsm_effect_batch_count(batch) == 2U);
+    EXPECT(p101_fsm_run_batched(fixture.fsm, &calls, batch, NULL, 1U, &segment_count, NULL) == P101_FSM_RUN_ERROR);
+    EXPECT(segment_count == 0U);
+    EXPECT(p101_fsm_run_batched(NULL, &calls, batch, segments, 1U, &segment_count, NULL) == P101_FSM_RUN_ERROR);
+    p101_fsm_effect_batch_destroy(fixture.fsm_env, &batch);
+    fixture_destroy(&fixture);
+}
+
+static void state_ring_step(const struct p101_env *env, struct p101_error *err, void *arg, struct p101_fsm_effect_sink *sink, struct p101_fsm_decision *decision)
+{
+    int *counter = (int *)arg;
+
+    for(int i = 0; i <= *counter % 3; ++i)
+    {
+        p101_fsm_emit_effect(env, err, sink, "ring", counter, sizeof(*counter));
+    }
+    (*counter)++;
+    p101_fsm_decide_transition(decision, STATE_A);
+}
+
+static void *ring_consume(void *arg)
+{
+    struct ring_consumer             *consumer = (struct ring_consumer *)arg;
+    struct p101_fsm_effect_ring_entry entry;
+
+    while(consumer->received < consumer->expected)
+    {
+        if(p101_fsm_effect_ring_peek(consumer->ring, &entry))
+        {
+            int value;
+
+            memcpy(&value, entry.effect.data, sizeof(value));
+            if(value < consumer->last_value || entry.binding.sequence < consumer->last_sequence || strcmp(entry.effect.kind, "ring") != 0 || ((uintptr_t)entry.effect.data % _Alignof(max_align_t)) != 0U)
+            {
+                consumer->disorders++;
+            }
+            consumer->last_value    = value;
+            consumer->last_sequence = entry.binding.sequence;
+            consumer->received++;
+            p101_fsm_effect_ring_release(consumer->ring);
+        }
+        else
+        {
+            sched_yield();
+        }
+    }
+
+    return NULL;
+}
+
+static void test_effect_ring(void)
+{
+    struct fixture                          fixture;
+    struct ring_consumer                    consumer;
+    struct burst_context                    burst;
+    struct p101_fsm_effect_ring            *ring;
+    struct p101_fsm_effect_batch           *batch;
+    struct p101_fsm_step_receipt            receipt;
+    struct p101_fsm_effect_ring_entry       entry;
+    pthread_t                               thread;
+    unsigned char                           large[200];
+    p101_fsm_step_status                    status;
+    int                                     counter;
+    bool                                    error_present;
+    static const struct p101_fsm_transition transitions[] = {
+        {P101_FSM_INIT, STATE_A, state_ring_step},
+        {STATE_A,       STATE_A, state_ring_step},
+    };
+    static const struct p101_fsm_transition oversized[] = {
+        {P101_FSM_INIT, STATE_A, state_effect_burst},
+    };
+    static const struct p101_fsm_transition paused[] = {
+        {P101_FSM_INIT, STATE_A, state_effect_then_pause},
+    };
+
+    // A small ring wraps its bytes and fills often, so the publisher must retry.
+    fixture_create(&fixture, "effect-ring", transitions, 2U, NULL);
+    ring = p101_fsm_effect_ring_create(fixture.fsm_env, fixture.fsm_err, 3U, 100U);
+    EXPECT(ring != NULL);
+    EXPECT(p101_fsm_effect_ring_get_capacity(fixture.fsm_env, ring) == 4U);
+    batch = p101_fsm_effect_batch_create(fixture.fsm_env, fixture.fsm_err, 4U, 64U);
+    memset(&consumer, 0, sizeof(consumer));
+    consumer.ring = ring;
+    for(int i = 0; i < 300; ++i)
+    {
+        consumer.expected += 1 + i % 3;
+    }
+    EXPECT(pthread_create(&thread, NULL, ring_consume, &consumer) == 0);
+    counter = 0;
+    for(int i = 0; i < 300; ++i)
+    {
+        status = p101_fsm_step_with_receipt(fixture.fsm, &counter, batch, &receipt);
+        EXPECT(status == P101_FSM_STEP_TRANSITIONED);
+        while(p101_fsm_effect_ring_publish(fixture.fsm_env, fixture.fsm_err, ring, batch, &receipt) != 0)
+        {
+            error_present = p101_error_is_error(fixture.fsm_err, P101_ERROR_USER, P101_FSM_ERROR_EFFECT_CAPACITY);
+            EXPECT(error_present);
+            p101_error_reset(fixture.fsm_err);
+            sched_yield();
+        }
+    }
+    pthread_join(thread, NULL);
+    EXPECT(consumer.received == consumer.expected && consumer.disorders == 0);
+    EXPECT(p101_fsm_effect_ring_count(ring) == 0U);
+    p101_fsm_effect_batch_destroy(fixture.fsm_env, &batch);
+    fixture_destroy(&fixture);
+
+    // An effect larger than the ring can never fit; the batch stays staged.
+    memset(large, 1, sizeof(large));
+    burst.count     = 1;
+    burst.data      = large;
+    burst.data_size = sizeof(large);
+    fixture_create(&fixture, "effect-ring-oversized", oversized, 1U, NULL);
+    batch  = p101_fsm_effect_batch_create(fixture.fsm_env, fixture.fsm_err, 4U, 256U);
+    status = p101_fsm_step_with_receipt(fixture.fsm, &burst, batch, &receipt);
+    EXPECT(status == P101_FSM_STEP_EXITED);
+    EXPECT(p101_fsm_effect_ring_publish(fixture.fsm_env, fixture.fsm_err, ring, batch, &receipt) == -1);
+    error_present = p101_error_is_error(fixture.fsm_err, P101_ERROR_USER, P101_FSM_ERROR_EFFECT_CAPACITY);
+    EXPECT(error_present);
+    p101_error_reset(fixture.fsm_err);
+    EXPECT(p101_fsm_effect_batch_count(batch) == 1U);
+    EXPECT(p101_fsm_effect_ring_count(ring) == 0U);
+    fixture_destroy(&fixture);
+
+    // A step that does not commit publishes nothing and still consumes the batch.
+    fixture_create(&fixture, "effect-ring-paused", paused, 1U, NULL);
+    status = p101_fsm_step_with_receipt(fixture.fsm, NULL, batch, &receipt);
+    EXPECT(status == P101_FSM_STEP_PAUSED);
+    EXPECT(p101_fsm_effect_ring_publish(fixture.fsm_env, fixture.fsm_err, ring, batch, &receipt) == 0);
+    EXPECT(p101_fsm_effect_batch_count(batch) == 0U);
+    EXPECT(!p101_fsm_effect_ring_peek(ring, &entry));
+    p101_fsm_effect_ring_release(ring);
+    EXPECT(p101_fsm_effect_ring_count(ring) == 0U);
+    EXPECT(p101_fsm_effect_ring_publish(fixture.fsm_env, fixture.fsm_err, ring, batch, &receipt) == -1);
+    p101_error_reset(fixture.fsm_err);
+    EXPECT(p101_fsm_effect_ring_publish(fixture.fsm_env, fixture.fsm_err, NULL, batch, &receipt) == -1);
+    error_present = p101_error_is_error(fixture.fsm_err, P101_ERROR_USER, P101_FSM_ERROR_INVALID_ARGUMENT);
+    EXPECT(error_present);
+    p101_error_reset(fixture.fsm_err);
+    EXPECT(p101_fsm_effect_ring_create(fixture.fsm_env, fixture.fsm_err, 0U, 64U) == NULL);
+    p101_error_reset(fixture.fsm_err);
+    EXPECT(p101_fsm_effect_ring_count(NULL) == 0U);
+    EXPECT(!p101_fsm_effect_ring_peek(NULL, &entry));
+    p101_fsm_effect_batch_destroy(fixture.fsm_env, &batch);
+    p101_fsm_effect_ring_destroy(fixture.fsm_env, &ring);
+    EXPECT(ring == NULL);
+    fixture_destroy(&fixture);
+}
+
+static void journal_replay_record(const struct p101_env *env, struct p101_error *err, void *context, const struct p101_fsm_journal_record *record, const struct p101_fsm_effect effects[])
+{
+    struct journal_replay_context *replay = (struct journal_replay_context *)context;
+
+    (void)env;
+    if(replay->fail)
+    {
+        P101_ERROR_RAISE_USER(err, "replay handler failed", P101_FSM_ERROR_EFFECT);
+        return;
+    }
+    if(record->effect_count != (size_t)(replay->next_value % 3 + 1) || record->next_state != STATE_A || (replay->records > 0U && record->sequence <= replay->last_sequence))
+    {
+        replay->disorders++;
+    }
+    for(size_t i = 0U; i < record->effect_count; ++i)
+    {
+        int value;
+
+        memcpy(&value, effects[i].data, sizeof(value));
+        if(value != replay->next_value || effects[i].data_size != sizeof(value) || strcmp(effects[i].kind, "ring") != 0 || effects[i].kind_id != P101_FSM_EFFECT_KIND_NONE)
+        {
+            replay->disorders++;
+        }
+    }
+    replay->last_sequence = record->sequence;
+    replay->next_value++;
+    replay->records++;
+    replay->effects += record->effect_count;
+}
+
+static void test_effect_journal(void)
+{
+    struct fixture                          fixture;
+    struct journal_replay_context           replay;
+    struct p101_fsm_journal                *journal;
+    struct p101_fsm_effect_batch           *batch;
+    struct p101_fsm_step_receipt            receipt;
+    struct p101_fsm_step_receipt            stale;
+    FILE                                   *file;
+    char                                    path[] = "/tmp/p101_fsm_journal_XXXXXX";
+    p101_fsm_step_status                    status;
+    int                                     counter;
+    int                                     fd;
+    bool                                    error_present;
+    static const struct p101_fsm_transition transitions[] = {
+        {P101_FSM_INIT, STATE_A, state_ring_step},
+        {STATE_A,       STATE_A, state_ring_step},
+    };
+    static const struct p101_fsm_transition paused[] = {
+        {P101_FSM_INIT, STATE_A, state_effect_then_pause},
+    };
+
+    fd = mkstemp(path);
+    EXPECT(fd != -1);
+    close(fd);
+
+    // A buffer smaller than most records forces writes and growth; the byte threshold groups several records per sync.
+    fixture_create(&fixture, "effect-journal", transitions, 2U, NULL);
+    journal = p101_fsm_journal_open(fixture.fsm_env, fixture.fsm_err, path, 64U, 256U, 0U);
+    EXPECT(journal != NULL);
+    batch   = p101_fsm_effect_batch_create(fixture.fsm_env, fixture.fsm_err, 4U, 64U);
+    counter = 0;
+    for(int i = 0; i < 10; ++i)
+    {
+        status = p101_fsm_step_with_receipt(fixture.fsm, &counter, batch, &receipt);
+        EXPECT(status == P101_FSM_STEP_TRANSITIONED);
+        stale = receipt;
+        EXPECT(p101_fsm_journal_append(fixture.fsm_env, fixture.fsm_err, journal, batch, &receipt) == 0);
+        EXPECT(p101_fsm_effect_batch_count(batch) == 0U);
+    }
+    EXPECT(p101_fsm_journal_get_records(fixture.fsm_env, journal) == 10U);
+    EXPECT(p101_fsm_journal_get_syncs(fixture.fsm_env, journal) >= 1U && p101_fsm_journal_get_syncs(fixture.fsm_env, journal) < 10U);
+    EXPECT(p101_fsm_journal_get_durable_records(fixture.fsm_env, journal) < 10U);
+    EXPECT(p101_fsm_journal_sync(fixture.fsm_env, fixture.fsm_err, journal) == 0);
+    EXPECT(p101_fsm_journal_get_durable_records(fixture.fsm_env, journal) == 10U);
+
+    // A finished receipt is stale and writes nothing.
+    EXPECT(p101_fsm_journal_append(fixture.fsm_env, fixture.fsm_err, journal, batch, &stale) == -1);
+    error_present = p101_error_is_error(fixture.fsm_err, P101_ERROR_USER, P101_FSM_ERROR_EFFECT);
+    EXPECT(error_present);
+    p101_error_reset(fixture.fsm_err);
+    EXPECT(p101_fsm_journal_get_records(fixture.fsm_env, journal) == 10U);
+    fixture_destroy(&fixture);
+
+    // A step that does not commit writes nothing and still consumes the batch.
+    fixture_create(&fixture, "effect-journal-paused", paused, 1U, NULL);
+    status = p101_fsm_step_with_receipt(fixture.fsm, NULL, batch, &receipt);
+    EXPECT(status == P101_FSM_STEP_PAUSED);
+    EXPECT(p101_fsm_journal_append(fixture.fsm_env, fixture.fsm_err, journal, batch, &receipt) == 0);
+    EXPECT(p101_fsm_effect_batch_count(batch) == 0U);
+    EXPECT(p101_fsm_journal_get_records(fixture.fsm_env, journal) == 10U);
+    EXPECT(p101_fsm_journal_close(fixture.fsm_env, fixture.fsm_err, &journal) == 0);
+    EXPECT(journal == NULL);
+
+    memset(&replay, 0, sizeof(replay));
+    EXPECT(p101_fsm_journal_replay(fixture.fsm_env, fixture.fsm_err, path, journal_replay_record, &replay) == 0);
+    EXPECT(replay.records == 10U && replay.effects == 19U && replay.disorders == 0);
+
+    // A handler error stops the replay.
+    memset(&replay, 0, sizeof(replay));
+    replay.fail = true;
+    EXPECT(p101_fsm_journal_replay(fixture.fsm_env, fixture.fsm_err, path, journal_replay_record, &replay) == -1);
+    error_present = p101_error_is_error(fixture.fsm_err, P101_ERROR_USER, P101_FSM_ERROR_EFFECT);
+    EXPECT(error_present);
+    p101_error_reset(fixture.fsm_err);
+
+    // A torn final record is dropped without an error.
+    file = fopen(path, "rb");
+    EXPECT(file != NULL);
+    fseek(file, 0L, SEEK_END);
+    EXPECT(truncate(path, ftell(file) - 3L) == 0);
+    fclose(file);
+    memset(&replay, 0, sizeof(replay));
+    EXPECT(p101_fsm_journal_replay(fixture.fsm_env, fixture.fsm_err, path, journal_replay_record, &replay) == 0);
+    EXPECT(replay.records == 9U && replay.disorders == 0);
+
+    // A flipped byte inside a complete record fails its checksum.
+    file = fopen(path, "r+b");
+    EXPECT(file != NULL);
+    fseek(file, 12L, SEEK_SET);
+    fputc(0x5A, file);
+    fclose(file);
+    memset(&replay, 0, sizeof(replay));
+    EXPECT(p101_fsm_journal_replay(fixture.fsm_env, fixture.fsm_err, path, journal_replay_record, &replay) == -1);
+    error_present = p101_error_is_error(fixture.fsm_err, P101_ERROR_USER, P101_FSM_ERROR_JOURNAL_CORRUPT);
+    EXPECT(error_present);
+    p101_error_reset(fixture.fsm_err);
+    fixture_destroy(&fixture);
+
+    // With no threshold and no interval every append is synced.
+    EXPECT(truncate(path, 0L) == 0);
+    counter = 0;
+    fixture_create(&fixture, "effect-journal-sync", transitions, 2U, NULL);
+    journal = p101_fsm_journal_open(fixture.fsm_env, fixture.fsm_err, path, 4096U, 0U, 0U);
+    for(int i = 0; i < 3; ++i)
+    {
+        status = p101_fsm_step_with_receipt(fixture.fsm, &counter, batch, &receipt);
+        EXPECT(p101_fsm_journal_append(fixture.fsm_env, fixture.fsm_err, journal, batch, &receipt) == 0);
+    }
+    EXPECT(p101_fsm_journal_get_syncs(fixture.fsm_env, journal) == 3U && p101_fsm_journal_get_durable_records(fixture.fsm_env, journal) == 3U);
+    EXPECT(p101_fsm_journal_close(fixture.fsm_env, fixture.fsm_err, &journal) == 0);
+    memset(&replay, 0, sizeof(replay));
+    EXPECT(p101_fsm_journal_replay(fixture.fsm_env, fixture.fsm_err, path, journal_replay_record, &replay) == 0);
+    EXPECT(replay.records == 3U && replay.effects == 6U && replay.disorders == 0);
+
+    // A damaged length fails the header checksum instead of passing for a torn tail.
+    file = fopen(path, "r+b");
+    EXPECT(file != NULL);
+    fseek(file, 2L, SEEK_SET);
+    fputc(0x7F, file);
+    fclose(file);
+    memset(&replay, 0, sizeof(replay));
+    EXPECT(p101_fsm_journal_replay(fixture.fsm_env, fixture.fsm_err, path, journal_replay_record, &replay) == -1);
+    error_present = p101_error_is_error(fixture.fsm_err, P101_ERROR_USER, P101_FSM_ERROR_JOURNAL_CORRUPT);
+    EXPECT(error_present && replay.records == 0U);
+    p101_error_reset(fixture.fsm_err);
+
+#if defined(__linux__)
+    // Every write to /dev/full fails, and the failure outlasts the sync that saw it.
+    journal = p101_fsm_journal_open(fixture.fsm_env, fixture.fsm_err, "/dev/full", 4096U, 65536U, 0U);
+    EXPECT(journal != NULL);
+    status = p101_fsm_step_with_receipt(fixture.fsm, &counter, batch, &receipt);
+    EXPECT(p101_fsm_journal_append(fixture.fsm_env, fixture.fsm_err, journal, batch, &receipt) == 0);
+    EXPECT(p101_fsm_journal_sync(fixture.fsm_env, fixture.fsm_err, journal) == -1);
+    EXPECT(p101_error_is_error(fixture.fsm_err, P101_ERROR_ERRNO, ENOSPC));
+    p101_error_reset(fixture.fsm_err);
+    status = p101_fsm_step_with_receipt(fixture.fsm, &counter, batch, &receipt);
+    EXPECT(p101_fsm_journal_append(fixture.fsm_env, fixture.fsm_err, journal, batch, &receipt) == -1);
+    EXPECT(p101_error_is_error(fixture.fsm_err, P101_ERROR_ERRNO, ENOSPC));
+    p101_error_reset(fixture.fsm_err);
+    EXPECT(p101_fsm_effect_batch_count(batch) > 0U);
+    EXPECT(p101_fsm_journal_get_durable_records(fixture.fsm_env, journal) == 0U);
+    EXPECT(p101_fsm_journal_close(fixture.fsm_env, fixture.fsm_err, &journal) == -1);
+    EXPECT(journal == NULL);
+    p101_error_reset(fixture.fsm_err);
+#endif
+
+    EXPECT(p101_fsm_journal_open(fixture.fsm_env, fixture.fsm_err, NULL, 4096U, 0U, 0U) == NULL);
+    error_present = p101_error_is_error(fixture.fsm_err, P101_ERROR_USER, P101_FSM_ERROR_INVALID_ARGUMENT);
+    EXPECT(error_present);
+    p101_error_reset(fixture.fsm_err);
+    EXPECT(p101_fsm_journal_append(fixture.fsm_env, fixture.fsm_err, NULL, batch, &receipt) == -1);
+    p101_error_reset(fixture.fsm_err);
+    EXPECT(unlink(path) == 0);
+    EXPECT(p101_fsm_journal_replay(fixture.fsm_env, fixture.fsm_err, path, journal_replay_record, &replay) == -1);
+    EXPECT(p101_error_is_error(fixture.fsm_err, P101_ERROR_ERRNO, ENOENT));
+    p101_error_reset(fixture.fsm_err);
+    p101_fsm_effect_batch_destroy(fixture.fsm_env, &batch);
+    fixture_destroy(&fixture);
+}
+
+static void state_aligned_effects(const struct p101_env *env, struct p101_error *err, void *arg, struct p101_fsm_effect_sink *sink, struct p101_fsm_decision *decision)
+{
+    static const char odd[3] = {1, 2, 3};
+
+    (void)arg;
+    for(uint64_t i = 0U; i < 6U; ++i)
+    {
+        struct aligned_payload payload;
+
+        payload.tag    = i;
+        payload.square = i * i;
+        p101_fsm_emit_effect(env, err, sink, "odd-kind", odd, sizeof(odd));
+        p101_fsm_emit_effect(env, err, sink, "typed", &payload, sizeof(payload));
+    }
+    p101_fsm_decide_transition(decision, STATE_A);
+}
+
+static void test_aligned_effect_payloads(void)
+{
+    struct fixture                          fixture;
+    struct p101_fsm_effect_batch           *batches[2];
+    struct p101_fsm_effect_sink             sink;
+    struct p101_fsm_step_receipt            receipt;
+    struct p101_fsm_effect                  effect;
+    p101_fsm_step_status                    status;
+    size_t                                  alignments[2];
+    bool                                    error_present;
+    static const struct p101_fsm_transition transitions[] = {
+        {P101_FSM_INIT, STATE_A, state_aligned_effects},
+        {STATE_A,       STATE_A, state_aligned_effects},
+    };
+
+    // A bounded batch at max_align_t and a growable one at a boundary wider than its chunks guarantee.
+    fixture_create(&fixture, "aligned-effects", transitions, 2U, NULL);
+    batches[0]    = p101_fsm_effect_batch_create(fixture.fsm_env, fixture.fsm_err, 16U, 1024U);
+    batches[1]    = p101_fsm_effect_batch_create_growable(fixture.fsm_env, fixture.fsm_err, 100U, 0U, 0U);
+    alignments[0] = p101_fsm_effect_batch_storage_align(fixture.fsm_env);
+    alignments[1] = 128U;
+    EXPECT(p101_fsm_effect_batch_get_alignment(fixture.fsm_env, batches[0]) == 1U);
+    for(size_t b = 0U; b < 2U; ++b)
+    {
+        EXPECT(p101_fsm_effect_batch_set_alignment(fixture.fsm_env, fixture.fsm_err, batches[b], alignments[b]) == 0);
+        EXPECT(p101_fsm_effect_batch_get_alignment(fixture.fsm_env, batches[b]) == alignments[b]);
+        status = p101_fsm_step_with_receipt(fixture.fsm, NULL, batches[b], &receipt);
+        EXPECT(status == P101_FSM_STEP_TRANSITIONED && receipt.effect_count == 12U);
+        for(size_t i = 0U; i < receipt.effect_count && p101_fsm_step_receipt_effect(&receipt, i, &effect); ++i)
+        {
+            EXPECT(((uintptr_t)effect.data % alignments[b]) == 0U);
+            if(i % 2U == 1U)
+            {
+                const struct aligned_payload *payload = (const struct aligned_payload *)effect.data;
+
+                EXPECT(strcmp(effect.kind, "typed") == 0 && payload->tag == i / 2U && payload->square == (i / 2U) * (i / 2U));
+            }
+            else
+            {
+                EXPECT(strcmp(effect.kind, "odd-kind") == 0 && ((const char *)effect.data)[2] == 3);
+            }
+        }
+
+        // The alignment is fixed while effects are staged.
+        EXPECT(p101_fsm_effect_batch_set_alignment(fixture.fsm_env, fixture.fsm_err, batches[b], 8U) == -1);
+        error_present = p101_error_is_error(fixture.fsm_err, P101_ERROR_USER, P101_FSM_ERROR_EFFECT);
+        EXPECT(error_present);
+        p101_error_reset(fixture.fsm_err);
+        p101_fsm_effect_batch_sink(batches[b], &sink);
+        EXPECT(p101_fsm_effect_batch_get_alignment(fixture.fsm_env, batches[b]) == alignments[b]);
+    }
+
+    EXPECT(p101_fsm_effect_batch_set_alignment(fixture.fsm_env, fixture.fsm_err, batches[0], 24U) == -1);
+    error_present = p101_error_is_error(fixture.fsm_err, P101_ERROR_USER, P101_FSM_ERROR_INVALID_ARGUMENT);
+    EXPECT(error_present);
+    p101_error_reset(fixture.fsm_err);
+    EXPECT(p101_fsm_effect_batch_get_alignment(fixture.fsm_env, NULL) == 0U);
+    p101_fsm_effect_batch_destroy(fixture.fsm_env, &batches[1]);
+    p101_fsm_effect_batch_destroy(fixture.fsm_env, &batches[0]);
+    fixture_destroy(&fixture);
+}
+
+static void test_effect_batch_pool(void)
+{
+    struct fixture                          fixtures[3];
+    struct callback_context                 context = {0};
+    struct p101_fsm_effect_batch_pool      *pool;
+    struct p101_fsm_effect_batch           *batches[3];
+    struct p101_fsm_effect_batch           *warmed[3];
+    struct p101_fsm_effect_batch           *other;
+    struct p101_fsm_step_receipt            receipts[3];
+    struct p101_fsm_step_receipt            stale;
+    struct p101_fsm_effect_sink             target;
+    struct p101_fsm_effect_sink             sink;
+    struct fault_context                    fault;
+    p101_fsm_step_status                    status;
+    int                                     counters[3] = {0, 0, 0};
+    int                                     delivered;
+    bool                                    error_present;
+    static const char                      *names[3]    = {"pool-a", "pool-b", "pool-c"};
+    static const struct p101_fsm_transition transitions[] = {
+        {P101_FSM_INIT, STATE_A, state_ring_step},
+        {STATE_A,       STATE_A, state_ring_step},
+    };
+
+    for(size_t m = 0U; m < 3U; ++m)
+    {
+        fixture_create(&fixtures[m], names[m], transitions, 2U, NULL);
+    }
+    pool           = p101_fsm_effect_batch_pool_create(fixtures[0].fsm_env, fixtures[0].fsm_err, 64U, 0U, 0U);
+    target.handle  = effect_handler;
+    target.context = &context;
+    EXPECT(pool != NULL);
+
+    // Three steps in flight need three batches; every one comes back on finish.
+    for(size_t m = 0U; m < 3U; ++m)
+    {
+        batches[m] = p101_fsm_effect_batch_pool_acquire(fixtures[0].fsm_env, fixtures[0].fsm_err, pool);
+        EXPECT(batches[m] != NULL);
+        status = p101_fsm_step_with_receipt(fixtures[m].fsm, &counters[m], batches[m], &receipts[m]);
+        EXPECT(status == P101_FSM_STEP_TRANSITIONED);
+    }
+    EXPECT(p101_fsm_effect_batch_pool_get_lent(fixtures[0].fsm_env, pool) == 3U && p101_fsm_effect_batch_pool_get_high_water(fixtures[0].fsm_env, pool) == 3U);
+    for(size_t m = 0U; m < 3U; ++m)
+    {
+        EXPECT(p101_fsm_effect_batch_pool_finish_receipt(fixtures[0].fsm_env, fixtures[0].fsm_err, pool, &receipts[m], &target) == 0);
+        warmed[m] = batches[m];
+    }
+    stale = receipts[0];
+    EXPECT(context.effects == 3);
+    EXPECT(p101_fsm_effect_batch_pool_get_lent(fixtures[0].fsm_env, pool) == 0U && p101_fsm_effect_batch_pool_get_idle(fixtures[0].fsm_env, pool) == 3U);
+
+    // A finished receipt is stale, and its batch is no longer lent.
+    EXPECT(p101_fsm_effect_batch_pool_finish_receipt(fixtures[0].fsm_env, fixtures[0].fsm_err, pool, &receipts[0], &target) == -1);
+    error_present = p101_error_is_error(fixtures[0].fsm_err, P101_ERROR_USER, P101_FSM_ERROR_INVALID_ARGUMENT);
+    EXPECT(error_present);
+    p101_error_reset(fixtures[0].fsm_err);
+
+    // One step at a time reuses one idle batch, so the next trim shrinks the pool to it.
+    p101_fsm_effect_batch_pool_trim(fixtures[0].fsm_env, pool);
+    EXPECT(p101_fsm_effect_batch_pool_get_idle(fixtures[0].fsm_env, pool) == 3U && p101_fsm_effect_batch_pool_get_high_water(fixtures[0].fsm_env, pool) == 0U);
+    for(size_t m = 0U; m < 3U; ++m)
+    {
+        batches[m] = p101_fsm_effect_batch_pool_acquire(fixtures[0].fsm_env, fixtures[0].fsm_err, pool);
+        status     = p101_fsm_step_with_receipt(fixtures[m].fsm, &counters[m], batches[m], &receipts[m]);
+        EXPECT(status == P101_FSM_STEP_TRANSITIONED);
+        EXPECT(p101_fsm_effect_batch_pool_finish_receipt(fixtures[0].fsm_env, fixtures[0].fsm_err, pool, &receipts[m], &target) == 0);
+    }
+    EXPECT(batches[0] == batches[1] && batches[1] == batches[2]);
+    EXPECT(context.effects == 9);
+    p101_fsm_effect_batch_pool_trim(fixtures[0].fsm_env, pool);
+    EXPECT(p101_fsm_effect_batch_pool_get_idle(fixtures[0].fsm_env, pool) == 3U);
+    for(size_t m = 0U; m < 3U; ++m)
+    {
+        size_t allocated;
+
+        allocated = p101_fsm_effect_batch_get_allocated_bytes(fixtures[0].fsm_env, warmed[m]);
+        EXPECT(warmed[m] == batches[0] ? allocated > 0U : allocated == 0U);
+    }
+
+    // Trimming keeps the batch objects, so a receipt for a trimmed batch is only stale.
+    EXPECT(warmed[0] != batches[0]);
+    EXPECT(p101_fsm_effect_batch_pool_finish_receipt(fixtures[0].fsm_env, fixtures[0].fsm_err, pool, &stale, &target) == -1);
+    error_present = p101_error_is_error(fixtures[0].fsm_err, P101_ERROR_USER, P101_FSM_ERROR_INVALID_ARGUMENT);
+    EXPECT(error_present);
+    p101_error_reset(fixtures[0].fsm_err);
+
+    // A trimmed batch is lent again and grows back on demand.
+    for(size_t m = 0U; m < 3U; ++m)
+    {
+        batches[m] = p101_fsm_effect_batch_pool_acquire(fixtures[0].fsm_env, fixtures[0].fsm_err, pool);
+        status     = p101_fsm_step_with_receipt(fixtures[m].fsm, &counters[m], batches[m], &receipts[m]);
+        EXPECT(status == P101_FSM_STEP_TRANSITIONED);
+    }
+    for(size_t m = 0U; m < 3U; ++m)
+    {
+        EXPECT(p101_fsm_effect_batch_pool_finish_receipt(fixtures[0].fsm_env, fixtures[0].fsm_err, pool, &receipts[m], &target) == 0);
+    }
+    EXPECT(context.effects == 18);
+    EXPECT(p101_fsm_effect_batch_pool_get_high_water(fixtures[0].fsm_env, pool) == 3U && p101_fsm_effect_batch_pool_get_idle(fixtures[0].fsm_env, pool) == 3U);
+
+    // A receipt made stale while its batch is lent leaves the batch with its borrower.
+    batches[0] = p101_fsm_effect_batch_pool_acquire(fixtures[0].fsm_env, fixtures[0].fsm_err, pool);
+    status     = p101_fsm_step_with_receipt(fixtures[0].fsm, &counters[0], batches[0], &receipts[0]);
+    EXPECT(status == P101_FSM_STEP_TRANSITIONED);
+    p101_fsm_effect_batch_sink(batches[0], &sink);
+    EXPECT(p101_fsm_effect_batch_pool_finish_receipt(fixtures[0].fsm_env, fixtures[0].fsm_err, pool, &receipts[0], &target) == -1);
+    error_present = p101_error_is_error(fixtures[0].fsm_err, P101_ERROR_USER, P101_FSM_ERROR_EFFECT);
+    EXPECT(error_present);
+    p101_error_reset(fixtures[0].fsm_err);
+    EXPECT(p101_fsm_effect_batch_pool_get_lent(fixtures[0].fsm_env, pool) == 1U);
+    EXPECT(p101_fsm_effect_batch_pool_release(fixtures[0].fsm_env, fixtures[0].fsm_err, pool, batches[0]) == 0);
+    EXPECT(p101_fsm_effect_batch_pool_release(fixtures[0].fsm_env, fixtures[0].fsm_err, pool, batches[0]) == -1);
+    error_present = p101_error_is_error(fixtures[0].fsm_err, P101_ERROR_USER, P101_FSM_ERROR_INVALID_ARGUMENT);
+    EXPECT(error_present);
+    p101_error_reset(fixtures[0].fsm_err);
+
+    // A finish that fails before delivering keeps the batch lent and its receipt good for a retry.
+    fault = (struct fault_context){"p101_fsm_effect_batch_finish_receipt", 1, 0};
+    p101_env_set_fault_injector(fixtures[0].fsm_env, fault_injector, &fault);
+    batches[0] = p101_fsm_effect_batch_pool_acquire(fixtures[0].fsm_env, fixtures[0].fsm_err, pool);
+    status     = p101_fsm_step_with_receipt(fixtures[0].fsm, &counters[0], batches[0], &receipts[0]);
+    EXPECT(status == P101_FSM_STEP_TRANSITIONED);
+    delivered = context.effects;
+    EXPECT(p101_fsm_effect_batch_pool_finish_receipt(fixtures[0].fsm_env, fixtures[0].fsm_err, pool, &receipts[0], &target) == -1);
+    EXPECT(p101_error_is_error(fixtures[0].fsm_err, P101_ERROR_ERRNO, ENOMEM));
+    p101_error_reset(fixtures[0].fsm_err);
+    EXPECT(context.effects == delivered && p101_fsm_effect_batch_pool_get_lent(fixtures[0].fsm_env, pool) == 1U);
+    EXPECT(p101_fsm_effect_batch_pool_finish_receipt(fixtures[0].fsm_env, fixtures[0].fsm_err, pool, &receipts[0], &target) == 0);
+    EXPECT(context.effects > delivered && p101_fsm_effect_batch_pool_get_lent(fixtures[0].fsm_env, pool) == 0U);
+
+    // Only batches the pool lent can go back to it.
+    other = p101_fsm_effect_batch_create(fixtures[0].fsm_env, fixtures[0].fsm_err, 4U, 64U);
+    EXPECT(p101_fsm_effect_batch_pool_release(fixtures[0].fsm_env, fixtures[0].fsm_err, pool, other) == -1);
+    p101_error_reset(fixtures[0].fsm_err);
+    EXPECT(p101_fsm_effect_batch_pool_acquire(fixtures[0].fsm_env, fixtures[0].fsm_err, NULL) == NULL);
+    p101_error_reset(fixtures[0].fsm_err);
+    EXPECT(p101_fsm_effect_batch_pool_create(fixtures[0].fsm_env, fixtures[0].fsm_err, 0U, 0U, 0U) == NULL);
+    p101_error_reset(fixtures[0].fsm_err);
+    EXPECT(p101_fsm_effect_batch_pool_get_high_water(fixtures[0].fsm_env, NULL) == 0U);
+    p101_fsm_effect_batch_destroy(fixtures[0].fsm_env, &other);
+    p101_fsm_effect_batch_pool_destroy(fixtures[0].fsm_env, &pool);
+    EXPECT(pool == NULL);
+    for(size_t m = 0U; m < 3U; ++m)
+    {
+        fixture_destroy(&fixtures[m]);
+    }
+}
+
+static void test_caller_storage(void)
+{
+    struct fixture                          fixture;
+    struct callback_context                 context = {0};
+    struct p101_fsm_step_result             result;
+    struct p101_fsm_step_receipt            receipt;
+    struct p101_fsm_definition             *definition;
+    struct p101_fsm_info                   *machine;
+    struct p101_fsm_effect_batch           *batch;
+    size_t                                  size;
+    bool                                    error_present;
+    static max_align_t                      definition_storage[256];
+    static max_align_t                      info_storage[64];
+    static max_align_t                      batch_storage[32];
+    static const struct p101_fsm_transition committed[] = {
+        {P101_FSM_INIT, STATE_A, state_effect},
+    };
+    static const struct p101_fsm_transition sparse_target[] = {
+        {P101_FSM_INIT, STATE_A,      state_to_b},
+        {STATE_A,       STATE_B,      state_exit},
+        {STATE_A,       STATE_SPARSE, state_exit},
+    };
+    static const struct p101_fsm_transition sparse_source[] = {
+        {P101_FSM_INIT, STATE_SPARSE, state_to_selected},
+        {STATE_SPARSE,  STATE_A,      state_exit       },
+    };
+    const struct p101_fsm_transition *tables[]       = {basic_transitions, sparse_target, sparse_source};
+    const size_t                      table_counts[] = {2U, 3U, 2U};
+
+    fixture_create(&fixture, "unused", basic_transitions, 2U, NULL);
+    EXPECT(p101_fsm_definition_storage_align(fixture.fsm_env) == _Alignof(max_align_t));
+    EXPECT(p101_fsm_info_storage_align(fixture.fsm_env) == _Alignof(max_align_t));
+    EXPECT(p101_fsm_effect_batch_storage_align(fixture.fsm_env) == _Alignof(max_align_t));
+    EXPECT(p101_fsm_info_storage_size(fixture.fsm_env) <= sizeof(info_storage));
+    for(size_t i = 0U; i < sizeof(tables) / sizeof(tables[0]); i++)
+    {
+        memset(&context, 0, sizeof(context));
+        context.selected_state = STATE_A;
+        size                   = p101_fsm_definition_storage_size(fixture.fsm_env, "stored", tables[i], table_counts[i]);
+        EXPECT(size > 0U && size <= sizeof(definition_storage));
+        definition = p101_fsm_definition_init(fixture.fsm_env, fixture.fsm_err, definition_storage, size, "stored", tables[i], table_counts[i]);
+        EXPECT(definition != NULL);
+        machine = p101_fsm_info_init(fixture.app_env, fixture.app_err, info_storage, sizeof(info_storage), definition, fixture.fsm_env, fixture.fsm_err, NULL);
+        EXPECT(machine != NULL);
+        EXPECT(strcmp(p101_fsm_info_get_name(fixture.app_env, machine), "stored") == 0);
+        EXPECT(p101_fsm_run(machine, &context, NULL, &result) == P101_FSM_RUN_EXITED);
+        p101_fsm_info_destroy(fixture.app_env, fixture.fsm_err, &machine);
+        EXPECT(machine == NULL);
+        p101_fsm_definition_destroy(fixture.fsm_env, &definition);
+    }
+
+    size       = p101_fsm_definition_storage_size(fixture.fsm_env, "stored", basic_transitions, 2U);
+    definition = p101_fsm_definition_init(fixture.fsm_env, fixture.fsm_err, definition_storage, size - 1U, "stored", basic_transitions, 2U);
+    EXPECT(definition == NULL);
+    error_present = p101_error_is_error(fixture.fsm_err, P101_ERROR_USER, P101_FSM_ERROR_INVALID_ARGUMENT);
+    EXPECT(error_present);
+    p101_error_reset(fixture.fsm_err);
+    definition = p101_fsm_definition_init(fixture.fsm_env, fixture.fsm_err, (unsigned char *)definition_storage + 1, size, "stored", basic_transitions, 2U);
+    EXPECT(definition == NULL);
+    error_present = p101_error_is_error(fixture.fsm_err, P101_ERROR_USER, P101_FSM_ERROR_INVALID_ARGUMENT);
+    EXPECT(error_present);
+    p101_error_reset(fixture.fsm_err);
+    EXPECT(p101_fsm_definition_storage_size(fixture.fsm_env, NULL, basic_transitions, 2U) == 0U);
+    EXPECT(p101_fsm_definition_storage_size(fixture.fsm_env, "stored", basic_transitions, 1U) > 0U);
+    EXPECT(p101_fsm_definition_storage_size(fixture.fsm_env, "stored", NULL, 0U) == 0U);
+    machine = p101_fsm_info_init(fixture.app_env, fixture.app_err, info_storage, sizeof(info_storage), NULL, fixture.fsm_env, fixture.fsm_err, NULL);
+    EXPECT(machine == NULL);
+    p101_error_reset(fixture.fsm_err);
+    definition = p101_fsm_definition_init(fixture.fsm_env, fixture.fsm_err, definition_storage, sizeof(definition_storage), "stored", basic_transitions, 2U);
+    EXPECT(definition != NULL);
+    machine = p101_fsm_info_init(fixture.app_env, fixture.app_err, NULL, sizeof(info_storage), definition, fixture.fsm_env, fixture.fsm_err, NULL);
+    EXPECT(machine == NULL);
+    error_present = p101_error_is_error(fixture.fsm_err, P101_ERROR_USER, P101_FSM_ERROR_INVALID_ARGUMENT);
+    EXPECT(error_present);
+    p101_error_reset(fixture.fsm_err);
+    p101_fsm_definition_destroy(fixture.fsm_env, &definition);
+    fixture_destroy(&fixture);
+
+    memset(&context, 0, sizeof(context));
+    fixture_create(&fixture, "stored-batch", committed, 1U, NULL);
+    size = p101_fsm_effect_batch_storage_size(fixture.fsm_env, 2U, 64U);
+    EXPECT(size > 0U && size <= sizeof(batch_storage));
+    EXPECT(p101_fsm_effect_batch_storage_size(fixture.fsm_env, 0U, 64U) == 0U);
+    batch = p101_fsm_effect_batch_init(fixture.fsm_env, fixture.fsm_err, batch_storage, size - 1U, 2U, 64U);
+    EXPECT(batch == NULL);
+    p101_error_reset(fixture.fsm_err);
+    batch = p101_fsm_effect_batch_init(fixture.fsm_env, fixture.fsm_err, batch_storage, size, 0U, 64U);
+    EXPECT(batch == NULL);
+    p101_error_reset(fixture.fsm_err);
+    batch = p101_fsm_effect_batch_init(fixture.fsm_env, fixture.fsm_err, batch_storage, size, 2U, 64U);
+    EXPECT(batch != NULL);
+    EXPECT(p101_fsm_step_with_receipt(fixture.fsm, NULL, batch, &receipt) == P101_FSM_STEP_EXITED);
+    EXPECT(p101_fsm_effect_batch_count(batch) == 1U);
+    p101_fsm_effect_batch_destroy(fixture.fsm_env, &batch);
+    EXPECT(batch == NULL);
+    fixture_destroy(&fixture);
+}
+
+static void test_invalid_create(void)
+{
+    struct fixture                          fixture;
+    static const struct p101_fsm_transition multiple_initial[] = {
+        {P101_FSM_INIT, STATE_A, state_exit},
+        {P101_FSM_INIT, STATE_B, state_exit},
+    };
+    static const struct p101_fsm_transition duplicate[] = {
+        {P101_FSM_INIT, STATE_A, state_exit},
+        {P101_FSM_INIT, STATE_A, state_to_b},
+    };
+    static const struct p101_fsm_transition null_callback[] = {
+        {P101_FSM_INIT, STATE_A, NULL},
+    };
+    static const struct p101_fsm_transition invalid_from[] = {
+        {P101_FSM_STATE_NONE, STATE_A, state_exit},
+    };
+    static const struct p101_fsm_transition invalid_to[] = {
+        {P101_FSM_INIT, P101_FSM_STATE_NONE, state_exit},
+    };
+
+    fixture_create(&fixture, NULL, basic_transitions, 2U, NULL);
+    EXPECT(fixture.fsm == NULL);
+    EXPECT(p101_error_is_error(fixture.fsm_err, P101_ERROR_USER, P101_FSM_ERROR_INVALID_ARGUMENT));
+    fixture_destroy(&fixture);
+
+    fixture_create(&fixture, "empty", NULL, 0U, NULL);
+    EXPECT(fixture.fsm == NULL);
+    EXPECT(p101_error_is_error(fixture.fsm_err, P101_ERROR_USER, P101_FSM_ERROR_INVALID_TRANSITION_TABLE));
+    fixture_destroy(&fixture);
+
+    fixture_create(&fixture, "zero-count", basic_transitions, 0U, NULL);
+    EXPECT(fixture.fsm == NULL);
+    EXPECT(p101_error_is_error(fixture.fsm_err, P101_ERROR_USER, P101_FSM_ERROR_INVALID_TRANSITION_TABLE));
+    fixture_destroy(&fixture);
+
+    fixture_create(&fixture, "oversized", basic_transitions, SIZE_MAX, NULL);
+    EXPECT(fixture.fsm == NULL);
+    EXPECT(p101_error_is_error(fixture.fsm_err, P101_ERROR_USER, P101_FSM_ERROR_INVALID_TRANSITION_TABLE));
+    fixture_destroy(&fixture);
+
+    fixture_create(&fixture, "multiple", multiple_initial, 2U, NULL);
+    EXPECT(fixture.fsm == NULL);
+    EXPECT(p101_error_is_error(fixture.fsm_err, P101_ERROR_USER, P101_FSM_ERROR_INVALID_TRANSITION_TABLE));
+    fixture_destroy(&fixture);
+
+    fixture_create(&fixture, "duplicate", duplicate, 2U, NULL);
+    EXPECT(fixture.fsm == NULL);
+    EXPECT(p101_error_is_error(fixture.fsm_err, P101_ERROR_USER, P101_FSM_ERROR_INVALID_TRANSITION_TABLE));
+    fixture_destroy(&fixture);
+
+    fixture_create(&fixture, "null", null_callback, 1U, NULL);
+    EXPECT(fixture.fsm == NULL);
+    EXPECT(p101_error_is_error(fixture.fsm_err, P101_ERROR_USER, P101_FSM_ERROR_INVALID_TRANSITION_TABLE));
+    fixture_destroy(&fixture);
+
+    fixture_create(&fixture, "invalid-from", invalid_from, 1U, NULL);
+    EXPECT(fixture.fsm == NULL);
+    EXPECT(p101_error_is_error(fixture.fsm_err, P101_ERROR_USER, P101_FSM_ERROR_INVALID_TRANSITION_TABLE));
+    fixture_destroy(&fixture);
+
+    fixture_create(&fixture, "invalid-to", invalid_to, 1U, NULL);
+    EXPECT(fixture.fsm == NULL);
+    EXPECT(p101_error_is_error(fixture.fsm_err, P101_ERROR_USER, P101_FSM_ERROR_INVALID_TRANSITION_TABLE));
+    fixture_destroy(&fixture);
+}
+
+P101_ATTR_SEMANTIC_ROLE("p101:boundary-case:boundary:fsm-transition:resource_limit")
+
+static void test_create_error_paths(void)
+{
+    struct fixture              fixture;
+    struct fault_context        fault;
+    struct p101_fsm_info       *fsm;
+    struct p101_error          *err;
+    struct p101_fsm_definition *definition;
+
+    memset(&fixture, 0, sizeof(fixture));
+    fixture.app_err = p101_error_create(false);
+    fixture.app_env = p101_env_create(fixture.app_err, NULL);
+    fixture.fsm_err = p101_error_create(false);
+    fixture.fsm_env = p101_env_create(fixture.fsm_err, NULL);
+    P101_ERROR_RAISE_USER(fixture.app_err, "pre-existing", P101_FSM_ERROR_INVALID_ARGUMENT);
+    fixture.fsm = p101_fsm_info_create(fixture.app_env, fixture.app_err, "error", fixture.fsm_env, fixture.fsm_err, basic_transitions, 2U, NULL);
+    EXPECT(fixture.fsm == NULL);
+    fixture_destroy(&fixture);
+
+    memset(&fixture, 0, sizeof(fixture));
+    fixture.app_err = p101_error_create(false);
+    fixture.app_env = p101_env_create(fixture.app_err, NULL);
+    fixture.fsm_err = p101_error_create(false);
+    P101_ERROR_RAISE_USER(fixture.fsm_err, "pre-existing", P101_FSM_ERROR_INVALID_ARGUMENT);
+    fixture.fsm = p101_fsm_info_create(fixture.app_env, fixture.app_err, "error", NULL, fixture.fsm_err, basic_transitions, 2U, NULL);
+    EXPECT(fixture.fsm == NULL);
+    fixture_destroy(&fixture);
+
+    memset(&fixture, 0, sizeof(fixture));
+    fixture.app_err = p101_error_create(false);
+    fixture.app_env = p101_env_create(fixture.app_err, NULL);
+    fixture.fsm     = p101_fsm_info_create(fixture.app_env, fixture.app_err, "default-env", NULL, NULL, basic_transitions, 2U, NULL);
+    EXPECT(fixture.fsm != NULL);
+    p101_fsm_info_destroy(fixture.app_env, fixture.app_err, &fixture.fsm);
+    fixture_destroy(&fixture);
+
+    err = p101_error_create(false);
+    fsm = p101_fsm_info_create(NULL, err, "null-env", NULL, NULL, basic_transitions, 2U, NULL);
+    EXPECT(fsm != NULL);
+    p101_fsm_info_destroy(NULL, err, &fsm);
+    EXPECT(fsm == NULL);
+    p101_error_destroy(err);
+
+    fault = (struct fault_context){"calloc", 1, 0};
+    fixture_create_with_fault(&fixture, &fault);
+    EXPECT(fixture.fsm == NULL);
+    EXPECT(p101_error_is_error(fixture.fsm_err, P101_ERROR_ERRNO, ENOMEM));
+    fixture_destroy(&fixture);
+
+    // A machine from p101_fsm_info_create() is one allocation, so later allocator faults are never reached.
+    fault = (struct fault_context){"p101_strdup", 1, 0};
+    fixture_create_with_fault(&fixture, &fault);
+    EXPECT(fixture.fsm != NULL);
+    EXPECT(fault.seen == 0);
+    fixture_destroy(&fixture);
+
+    fault = (struct fault_context){"calloc", 2, 0};
+    fixture_create_with_fault(&fixture, &fault);
+    EXPECT(fixture.fsm != NULL);
+    EXPECT(fault.seen == 1);
+    fixture_destroy(&fixture);
+
+    fault = (struct fault_context){"p101_strdup", 1, 0};
+    fixture_create_with_fault(&fixture, &fault);
+    definition = p101_fsm_definition_create(fixture.fsm_env, fixture.fsm_err, "fault", basic_transitions, 2U);
+    EXPECT(definition == NULL);
+    EXPECT(p101_error_is_error(fixture.fsm_err, P101_ERROR_ERRNO, ENOMEM));
+    fixture_destroy(&fixture);
+
+    fault = (struct fault_context){"calloc", 3, 0};
+    fixture_create_with_fault(&fixture, &fault);
+    definition = p101_fsm_definition_create(fixture.fsm_env, fixture.fsm_err, "fault", basic_transitions, 2U);
+    EXPECT(definition == NULL);
     EXPECT(p101_error_is_error(fixture.fsm_err, P101_ERROR_ERRNO, ENOMEM));
     fixture_destroy(&fixture);
 }
@@ -1400,6 +3673,30 @@ int main(void)
 {
     test_create_and_bound_table();
     test_transition_hash_map();
+    test_shared_definition();
+    test_transition_index_selection();
+    test_perfect_hash_index();
+    test_cached_perform();
+    test_specialised_step();
+    test_step_many();
+    test_run_bounded();
+    test_pool();
+    test_executor();
+    test_event_inbox();
+    test_timer_wheel();
+#if defined(__linux__)
+    test_reactor();
+#endif
+    test_growable_effect_batch();
+    test_interned_effect_kinds();
+    test_in_place_effects();
+    test_span_delivery();
+    test_batched_run();
+    test_effect_ring();
+    test_effect_journal();
+    test_aligned_effect_payloads();
+    test_effect_batch_pool();
+    test_caller_storage();
     test_invalid_create();
     test_create_error_paths();
     test_step_commit_and_terminal_result();